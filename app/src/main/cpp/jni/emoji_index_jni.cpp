@@ -0,0 +1,161 @@
+#include <jni.h>
+#include <android/log.h>
+#include <string>
+#include <vector>
+
+#include "marisa/EmojiIndex.h"
+
+#define LOG_TAG "EmojiIndexJNI"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// 表情关键词索引的JNI接口
+// 句柄是EmojiIndex的指针，由Kotlin的EmojiIndex持有。
+// 表情大多在BMP之外，modified UTF-8把它们编码成代理对，和索引中的标准UTF-8不同，
+// 所以字符串都按UTF-16读写，在这里和UTF-8互转
+
+namespace {
+
+    marisa::EmojiIndex* fromHandle(jlong handle) {
+        return reinterpret_cast<marisa::EmojiIndex*>(handle);
+    }
+
+    void appendUtf8(char32_t c, std::string& out) {
+        if (c < 0x80) {
+            out.push_back(static_cast<char>(c));
+        } else if (c < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        } else if (c < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+    }
+
+    // 单独的代理按原码元编码
+    std::string toUtf8(JNIEnv* env, jstring str) {
+        std::string result;
+        if (str == nullptr) {
+            return result;
+        }
+        jsize length = env->GetStringLength(str);
+        std::u16string utf16(length, u'\0');
+        env->GetStringRegion(str, 0, length, reinterpret_cast<jchar*>(&utf16[0]));
+
+        result.reserve(utf16.size() * 2);
+        for (size_t i = 0; i < utf16.size(); i++) {
+            char32_t c = utf16[i];
+            if (c >= 0xD800 && c <= 0xDBFF && i + 1 < utf16.size() &&
+                utf16[i + 1] >= 0xDC00 && utf16[i + 1] <= 0xDFFF) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (utf16[++i] - 0xDC00);
+            }
+            appendUtf8(c, result);
+        }
+        return result;
+    }
+
+    // 索引中的字符串都是合法的UTF-8
+    jstring toJavaString(JNIEnv* env, const std::string& utf8) {
+        std::u16string utf16;
+        utf16.reserve(utf8.size());
+        for (size_t i = 0; i < utf8.size(); ) {
+            unsigned char c = static_cast<unsigned char>(utf8[i]);
+            size_t length = c < 0x80 ? 1 : (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : 4;
+            char32_t code = length == 1 ? c : c & (0x7F >> length);
+            for (size_t j = 1; j < length && i + j < utf8.size(); j++) {
+                code = (code << 6) | (static_cast<unsigned char>(utf8[i + j]) & 0x3F);
+            }
+            if (code >= 0x10000) {
+                code -= 0x10000;
+                utf16.push_back(static_cast<char16_t>(0xD800 + (code >> 10)));
+                utf16.push_back(static_cast<char16_t>(0xDC00 + (code & 0x3FF)));
+            } else {
+                utf16.push_back(static_cast<char16_t>(code));
+            }
+            i += length;
+        }
+        return env->NewString(reinterpret_cast<const jchar*>(utf16.data()),
+                              static_cast<jsize>(utf16.size()));
+    }
+
+    jobjectArray toJavaArray(JNIEnv* env, const std::vector<std::string>& strings) {
+        jclass stringClass = env->FindClass("java/lang/String");
+        if (stringClass == nullptr) {
+            LOGE("Failed to find String class");
+            return nullptr;
+        }
+
+        jobjectArray array = env->NewObjectArray(strings.size(), stringClass, nullptr);
+        if (array == nullptr) {
+            LOGE("Failed to create String array");
+            return nullptr;
+        }
+
+        for (size_t i = 0; i < strings.size(); ++i) {
+            jstring str = toJavaString(env, strings[i]);
+            if (str == nullptr) {
+                LOGE("Failed to create string at index %zu", i);
+                continue;
+            }
+            env->SetObjectArrayElement(array, i, str);
+            env->DeleteLocalRef(str);
+        }
+        return array;
+    }
+
+} // namespace
+
+extern "C" {
+
+// mmap打开索引文件，失败返回0
+JNIEXPORT jlong JNICALL
+Java_com_example_nasboard_ime_emoji_EmojiIndex_nativeOpen(
+        JNIEnv* env, jclass /* clazz */, jstring filename) {
+
+    std::string path = toUtf8(env, filename);
+    auto* index = new marisa::EmojiIndex();
+    if (!index->loadFromFile(path.c_str())) {
+        LOGE("Failed to open emoji index: %s", path.c_str());
+        delete index;
+        return 0;
+    }
+    LOGD("Emoji index opened: %zu emojis, %zu keys", index->numEmojis(), index->numKeys());
+    return reinterpret_cast<jlong>(index);
+}
+
+JNIEXPORT void JNICALL
+Java_com_example_nasboard_ime_emoji_EmojiIndex_nativeClose(
+        JNIEnv* /* env */, jclass /* clazz */, jlong handle) {
+
+    delete fromHandle(handle);
+}
+
+// 关键词以query开头的表情，按名次排序
+JNIEXPORT jobjectArray JNICALL
+Java_com_example_nasboard_ime_emoji_EmojiIndex_nativeSearch(
+        JNIEnv* env, jclass /* clazz */, jlong handle, jstring query, jint maxResults) {
+
+    std::vector<std::string> results;
+    if (handle != 0) {
+        results = fromHandle(handle)->search(toUtf8(env, query), maxResults);
+    }
+    return toJavaArray(env, results);
+}
+
+JNIEXPORT jstring JNICALL
+Java_com_example_nasboard_ime_emoji_EmojiIndex_nativeGetInfo(
+        JNIEnv* env, jclass /* clazz */, jlong handle) {
+
+    if (handle == 0) {
+        return env->NewStringUTF("Emoji index not loaded");
+    }
+    return env->NewStringUTF(fromHandle(handle)->getInfo().c_str());
+}
+
+} // extern "C"
@@ -308,6 +308,30 @@ jobjectArray convertStringVectorToJavaArray(JNIEnv* env, const std::vector<std::
     return array;
 }
 
+std::vector<std::string> convertJavaArrayToStringVector(JNIEnv* env, jobjectArray array) {
+    std::vector<std::string> strings;
+    if (array == nullptr) {
+        return strings;
+    }
+
+    jsize length = env->GetArrayLength(array);
+    strings.reserve(length);
+    for (jsize i = 0; i < length; i++) {
+        jstring str = (jstring)env->GetObjectArrayElement(array, i);
+        if (str == nullptr) {
+            continue;
+        }
+        const char* cStr = env->GetStringUTFChars(str, nullptr);
+        if (cStr != nullptr) {
+            strings.push_back(cStr);
+            env->ReleaseStringUTFChars(str, cStr);
+        }
+        env->DeleteLocalRef(str);
+    }
+
+    return strings;
+}
+
 // ==================== 清理函数 ====================
 
 void cleanupKazakhPredictor() {
@@ -864,6 +888,110 @@ Java_com_example_nasboard_ime_dictionary_KazakhDictionaryManager_nativeCloseMari
 cleanupKazakhPredictor();
 }
 
+// ==================== 增量词典 ====================
+
+// 加载增量层文件
+JNIEXPORT jboolean JNICALL
+Java_com_example_nasboard_ime_dictionary_KazakhDictionaryManager_nativeLoadUnigramDelta(
+        JNIEnv* env, jobject /* this */, jstring filename) {
+
+if (!g_kazakh_predictor_initialized || g_kazakh_predictor == nullptr) {
+return JNI_FALSE;
+}
+
+const char* cFilename = env->GetStringUTFChars(filename, nullptr);
+if (cFilename == nullptr) {
+return JNI_FALSE;
+}
+
+bool success = false;
+try {
+std::unique_lock<std::mutex> lock(g_predictor_mutex);
+success = g_kazakh_predictor->loadUnigramDelta(cFilename);
+} catch (const std::exception& e) {
+LOGE("Load unigram delta exception: %s", e.what());
+}
+
+env->ReleaseStringUTFChars(filename, cFilename);
+return success ? JNI_TRUE : JNI_FALSE;
+}
+
+// 增加一层增量，userWords为true时按用户词典的规则处理删除的词
+static jboolean addUnigramDelta(JNIEnv* env, jobjectArray words, jfloatArray weights,
+                                jobjectArray removedWords, bool userWords) {
+
+if (!g_kazakh_predictor_initialized || g_kazakh_predictor == nullptr) {
+return JNI_FALSE;
+}
+
+std::vector<std::string> cWords = convertJavaArrayToStringVector(env, words);
+std::vector<std::string> cRemovedWords = convertJavaArrayToStringVector(env, removedWords);
+std::vector<float> cWeights;
+if (weights != nullptr) {
+cWeights.resize(env->GetArrayLength(weights));
+env->GetFloatArrayRegion(weights, 0, cWeights.size(), cWeights.data());
+}
+
+if (cWords.empty() && cRemovedWords.empty()) {
+return JNI_TRUE;
+}
+
+bool success = false;
+try {
+std::unique_lock<std::mutex> lock(g_predictor_mutex);
+if (userWords) {
+success = g_kazakh_predictor->addUserWordDelta(cWords, cWeights, cRemovedWords);
+} else {
+success = g_kazakh_predictor->addUnigramDelta(cWords, cWeights, cRemovedWords);
+}
+LOGD("Add unigram delta: %zu words, %zu removed -> %s",
+     cWords.size(), cRemovedWords.size(), success ? "SUCCESS" : "FAILED");
+} catch (const std::exception& e) {
+LOGE("Add unigram delta exception: %s", e.what());
+}
+
+return success ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_example_nasboard_ime_dictionary_KazakhDictionaryManager_nativeAddUnigramDelta(
+        JNIEnv* env, jobject /* this */, jobjectArray words, jfloatArray weights,
+        jobjectArray removedWords) {
+return addUnigramDelta(env, words, weights, removedWords, false);
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_example_nasboard_ime_dictionary_KazakhDictionaryManager_nativeAddUserWordDelta(
+        JNIEnv* env, jobject /* this */, jobjectArray words, jfloatArray weights,
+        jobjectArray removedWords) {
+return addUnigramDelta(env, words, weights, removedWords, true);
+}
+
+// 后台合并增量层
+JNIEXPORT void JNICALL
+Java_com_example_nasboard_ime_dictionary_KazakhDictionaryManager_nativeCompactUnigramDeltas(
+        JNIEnv* /* env */, jobject /* this */) {
+
+if (!g_kazakh_predictor_initialized || g_kazakh_predictor == nullptr) {
+return;
+}
+
+std::unique_lock<std::mutex> lock(g_predictor_mutex);
+g_kazakh_predictor->compactUnigramDeltas();
+}
+
+JNIEXPORT jint JNICALL
+Java_com_example_nasboard_ime_dictionary_KazakhDictionaryManager_nativeGetUnigramDeltaCount(
+        JNIEnv* /* env */, jobject /* this */) {
+
+if (!g_kazakh_predictor_initialized || g_kazakh_predictor == nullptr) {
+return 0;
+}
+
+std::unique_lock<std::mutex> lock(g_predictor_mutex);
+return static_cast<jint>(g_kazakh_predictor->getUnigramDeltaCount());
+}
+
 // ==================== 用户词典函数 ====================
 
 // 加载用户词典
@@ -1298,6 +1426,56 @@ env->ReleaseStringUTFChars(word, cWord);
 return found ? JNI_TRUE : JNI_FALSE;
 }
 
+// 获取所有单词
+JNIEXPORT jobjectArray JNICALL
+Java_com_example_nasboard_ime_dictionary_KazakhUserDictManager_nativeGetAllWords(
+        JNIEnv* env, jobject /* this */) {
+
+if (!g_kazakh_user_dict_initialized || g_kazakh_user_dict == nullptr) {
+LOGE("User dictionary not initialized for listing words");
+return nullptr;
+}
+
+std::vector<std::string> words;
+try {
+words = g_kazakh_user_dict->getAllWords();
+} catch (const std::exception& e) {
+LOGE("Exception listing user dict words: %s", e.what());
+}
+
+return convertStringVectorToJavaArray(env, words);
+}
+
+// 批量查询词频，不存在的词为0
+JNIEXPORT jintArray JNICALL
+Java_com_example_nasboard_ime_dictionary_KazakhUserDictManager_nativeGetWordFrequencies(
+        JNIEnv* env, jobject /* this */, jobjectArray wordsArray) {
+
+if (!g_kazakh_user_dict_initialized || g_kazakh_user_dict == nullptr) {
+LOGE("User dictionary not initialized for frequency lookup");
+return nullptr;
+}
+
+std::vector<std::string> words = convertJavaArrayToStringVector(env, wordsArray);
+std::vector<jint> frequencies(words.size(), 0);
+
+try {
+for (size_t i = 0; i < words.size(); i++) {
+frequencies[i] = g_kazakh_user_dict->getWordFrequency(words[i]);
+}
+} catch (const std::exception& e) {
+LOGE("Exception getting word frequencies: %s", e.what());
+}
+
+jintArray result = env->NewIntArray(frequencies.size());
+if (result == nullptr) {
+LOGE("Failed to create int array");
+return nullptr;
+}
+env->SetIntArrayRegion(result, 0, frequencies.size(), frequencies.data());
+return result;
+}
+
 // 批量导入单词
 JNIEXPORT jboolean JNICALL
         Java_com_example_nasboard_ime_dictionary_KazakhUserDictManager_nativeImportWords(
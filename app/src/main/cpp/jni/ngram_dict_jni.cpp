@@ -0,0 +1,231 @@
+#include <jni.h>
+#include <android/log.h>
+#include <string>
+#include <vector>
+
+#include "marisa/NgramPredictor.h"
+
+#define LOG_TAG "NgramDictJNI"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// 英语、俄语n-gram词典的JNI接口
+// 每个词典是一个NgramPredictor，句柄是它的指针，由Kotlin的NgramDictionary持有。
+// 查询只读mmap的Trie，调用方负责不在查询期间关闭词典
+
+namespace {
+
+    marisa::NgramPredictor* fromHandle(jlong handle) {
+        return reinterpret_cast<marisa::NgramPredictor*>(handle);
+    }
+
+    // 自动释放的jstring内容
+    class JStringChars {
+    public:
+        JStringChars(JNIEnv* env, jstring str)
+                : env_(env), str_(str),
+                  chars_(str != nullptr ? env->GetStringUTFChars(str, nullptr) : nullptr) {}
+
+        ~JStringChars() {
+            if (chars_ != nullptr) env_->ReleaseStringUTFChars(str_, chars_);
+        }
+
+        JStringChars(const JStringChars&) = delete;
+        JStringChars& operator=(const JStringChars&) = delete;
+
+        bool ok() const { return chars_ != nullptr; }
+        const char* get() const { return chars_; }
+
+    private:
+        JNIEnv* env_;
+        jstring str_;
+        const char* chars_;
+    };
+
+    jobjectArray toJavaArray(JNIEnv* env, const std::vector<std::string>& strings) {
+        jclass stringClass = env->FindClass("java/lang/String");
+        if (stringClass == nullptr) {
+            LOGE("Failed to find String class");
+            return nullptr;
+        }
+
+        jobjectArray array = env->NewObjectArray(strings.size(), stringClass, nullptr);
+        if (array == nullptr) {
+            LOGE("Failed to create String array");
+            return nullptr;
+        }
+
+        for (size_t i = 0; i < strings.size(); ++i) {
+            jstring str = env->NewStringUTF(strings[i].c_str());
+            if (str == nullptr) {
+                continue;
+            }
+            env->SetObjectArrayElement(array, i, str);
+            env->DeleteLocalRef(str);
+        }
+        return array;
+    }
+
+    jobjectArray emptyArray(JNIEnv* env) {
+        return toJavaArray(env, std::vector<std::string>());
+    }
+
+} // namespace
+
+extern "C" {
+
+// 打开词典，返回句柄，失败返回0
+JNIEXPORT jlong JNICALL
+Java_com_example_nasboard_ime_dictionary_NgramDictionary_nativeOpen(
+        JNIEnv* env, jclass /* clazz */, jstring filename) {
+
+    JStringChars cFilename(env, filename);
+    if (!cFilename.ok()) {
+        return 0;
+    }
+
+    auto* predictor = new marisa::NgramPredictor();
+    if (!predictor->loadFromFile(cFilename.get())) {
+        LOGE("Failed to load ngram dictionary: %s", cFilename.get());
+        delete predictor;
+        return 0;
+    }
+
+    LOGD("Loaded ngram dictionary: %s, unigrams: %zu, bigrams: %zu, trigrams: %zu",
+         cFilename.get(), predictor->getCount(1), predictor->getCount(2), predictor->getCount(3));
+    return reinterpret_cast<jlong>(predictor);
+}
+
+JNIEXPORT void JNICALL
+Java_com_example_nasboard_ime_dictionary_NgramDictionary_nativeClose(
+        JNIEnv* /* env */, jclass /* clazz */, jlong handle) {
+
+    delete fromHandle(handle);
+}
+
+// 前缀搜索，按频率降序
+JNIEXPORT jobjectArray JNICALL
+Java_com_example_nasboard_ime_dictionary_NgramDictionary_nativePrefixSearch(
+        JNIEnv* env, jclass /* clazz */, jlong handle, jstring prefix, jint maxResults) {
+
+    JStringChars cPrefix(env, prefix);
+    if (handle == 0 || !cPrefix.ok()) {
+        return emptyArray(env);
+    }
+
+    try {
+        return toJavaArray(env, fromHandle(handle)->prefixSearch(cPrefix.get(), maxResults));
+    } catch (const std::exception& e) {
+        LOGE("Prefix search exception: %s", e.what());
+        return emptyArray(env);
+    }
+}
+
+// bigram上下文预测
+JNIEXPORT jobjectArray JNICALL
+Java_com_example_nasboard_ime_dictionary_NgramDictionary_nativeContextPredict(
+        JNIEnv* env, jclass /* clazz */, jlong handle, jstring previousWord,
+        jstring currentPrefix, jint maxResults) {
+
+    JStringChars cPreviousWord(env, previousWord);
+    JStringChars cCurrentPrefix(env, currentPrefix);
+    if (handle == 0 || !cPreviousWord.ok() || !cCurrentPrefix.ok()) {
+        return emptyArray(env);
+    }
+
+    try {
+        return toJavaArray(env, fromHandle(handle)->contextPredict(
+                cPreviousWord.get(), cCurrentPrefix.get(), maxResults));
+    } catch (const std::exception& e) {
+        LOGE("Context predict exception: %s", e.what());
+        return emptyArray(env);
+    }
+}
+
+// trigram上下文预测
+JNIEXPORT jobjectArray JNICALL
+Java_com_example_nasboard_ime_dictionary_NgramDictionary_nativeTrigramPredict(
+        JNIEnv* env, jclass /* clazz */, jlong handle, jstring firstWord, jstring secondWord,
+        jstring currentPrefix, jint maxResults) {
+
+    JStringChars cFirstWord(env, firstWord);
+    JStringChars cSecondWord(env, secondWord);
+    JStringChars cCurrentPrefix(env, currentPrefix);
+    if (handle == 0 || !cFirstWord.ok() || !cSecondWord.ok() || !cCurrentPrefix.ok()) {
+        return emptyArray(env);
+    }
+
+    try {
+        return toJavaArray(env, fromHandle(handle)->trigramPredict(
+                cFirstWord.get(), cSecondWord.get(), cCurrentPrefix.get(), maxResults));
+    } catch (const std::exception& e) {
+        LOGE("Trigram predict exception: %s", e.what());
+        return emptyArray(env);
+    }
+}
+
+// 高频词
+JNIEXPORT jobjectArray JNICALL
+Java_com_example_nasboard_ime_dictionary_NgramDictionary_nativeMostFrequentWords(
+        JNIEnv* env, jclass /* clazz */, jlong handle, jint maxResults) {
+
+    if (handle == 0) {
+        return emptyArray(env);
+    }
+
+    try {
+        return toJavaArray(env, fromHandle(handle)->mostFrequentWords(maxResults));
+    } catch (const std::exception& e) {
+        LOGE("Most frequent words exception: %s", e.what());
+        return emptyArray(env);
+    }
+}
+
+// 精确匹配
+JNIEXPORT jboolean JNICALL
+Java_com_example_nasboard_ime_dictionary_NgramDictionary_nativeExactMatch(
+        JNIEnv* env, jclass /* clazz */, jlong handle, jstring word) {
+
+    JStringChars cWord(env, word);
+    if (handle == 0 || !cWord.ok()) {
+        return JNI_FALSE;
+    }
+
+    try {
+        return fromHandle(handle)->exactMatch(cWord.get()) ? JNI_TRUE : JNI_FALSE;
+    } catch (const std::exception& e) {
+        LOGE("Exact match exception: %s", e.what());
+        return JNI_FALSE;
+    }
+}
+
+// unigram频率
+JNIEXPORT jlong JNICALL
+Java_com_example_nasboard_ime_dictionary_NgramDictionary_nativeGetFrequency(
+        JNIEnv* env, jclass /* clazz */, jlong handle, jstring word) {
+
+    JStringChars cWord(env, word);
+    if (handle == 0 || !cWord.ok()) {
+        return 0;
+    }
+
+    try {
+        return static_cast<jlong>(fromHandle(handle)->getFrequency(cWord.get()));
+    } catch (const std::exception& e) {
+        LOGE("Get frequency exception: %s", e.what());
+        return 0;
+    }
+}
+
+// 词典信息
+JNIEXPORT jstring JNICALL
+Java_com_example_nasboard_ime_dictionary_NgramDictionary_nativeGetInfo(
+        JNIEnv* env, jclass /* clazz */, jlong handle) {
+
+    if (handle == 0) {
+        return env->NewStringUTF("Ngram dictionary not loaded");
+    }
+    return env->NewStringUTF(fromHandle(handle)->getInfo().c_str());
+}
+
+} // extern "C"
@@ -9,11 +9,13 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <pthread.h>
 
 // 修正头文件包含路径
 // 根据您的目录结构，应该包含pinyinime.h
 // 由于pinyin/CMakeLists.txt已经设置了包含目录，这里可以使用相对路径
 #include "pinyinime.h"
+#include "decodeworker.h"
 
 // 如果上述不行，尝试：
 // #include "../pinyin/include/pinyinime.h"
@@ -36,6 +38,94 @@ static bool g_decoder_initialized = false;
 static char16 (*predict_buf)[kMaxPredictSize + 1] = NULL;
 static size_t predict_len;
 
+// ==================== 后台解码 ====================
+// 解码线程在自己的会话中解码最新的拼音，把第一页候选词回调给
+// PinyinDecoder.onDecodePage()。启动、停止和投递都在g_worker_mutex下进行
+
+/**
+ * 在解码线程上把候选页转成Java对象并回调，线程第一次回调时附加到JVM，退出前分离
+ */
+class JniDecodeListener : public DecodeListener {
+public:
+    JniDecodeListener(JavaVM* vm, jobject decoder, jmethodID on_page)
+            : vm_(vm), decoder_(decoder), on_page_(on_page), env_(NULL) {}
+
+    void on_page(const DecodePage* page) {
+        JNIEnv* env = attach();
+        if (env == NULL) {
+            return;
+        }
+
+        jclass string_class = env->FindClass("java/lang/String");
+        jobjectArray cands = env->NewObjectArray(page->cand_num, string_class, NULL);
+        for (size_t i = 0; i < page->cand_num; i++) {
+            jstring cand = env->NewString((const jchar*)page->cands[i], page->cand_lens[i]);
+            env->SetObjectArrayElement(cands, i, cand);
+            env->DeleteLocalRef(cand);
+        }
+        jstring pinyin = env->NewStringUTF(page->sps);
+
+        env->CallVoidMethod(decoder_, on_page_, (jint)page->version, pinyin, cands,
+                            (jint)page->total_num);
+        if (env->ExceptionCheck()) {
+            LOGE("onDecodePage threw an exception");
+            env->ExceptionDescribe();
+            env->ExceptionClear();
+        }
+
+        env->DeleteLocalRef(pinyin);
+        env->DeleteLocalRef(cands);
+        env->DeleteLocalRef(string_class);
+    }
+
+    void on_exit() {
+        if (env_ != NULL) {
+            vm_->DetachCurrentThread();
+            env_ = NULL;
+        }
+    }
+
+    jobject decoder() const { return decoder_; }
+
+private:
+    JNIEnv* attach() {
+        if (env_ == NULL && vm_->AttachCurrentThread(&env_, NULL) != JNI_OK) {
+            LOGE("Failed to attach the decode thread");
+            env_ = NULL;
+        }
+        return env_;
+    }
+
+    JavaVM* vm_;
+    jobject decoder_;       // PinyinDecoder的全局引用
+    jmethodID on_page_;
+    JNIEnv* env_;           // 解码线程的JNIEnv，只在解码线程上使用
+};
+
+static pthread_mutex_t g_worker_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DecodeWorker* g_worker = NULL;
+static JniDecodeListener* g_worker_listener = NULL;
+
+// 调用方持有g_worker_mutex
+static void stop_worker_locked(JNIEnv* env) {
+    if (g_worker == NULL) {
+        return;
+    }
+    im_close_worker(g_worker);
+    g_worker = NULL;
+
+    env->DeleteGlobalRef(g_worker_listener->decoder());
+    delete g_worker_listener;
+    g_worker_listener = NULL;
+    LOGD("Decode worker stopped");
+}
+
+static void stop_worker(JNIEnv* env) {
+    pthread_mutex_lock(&g_worker_mutex);
+    stop_worker_locked(env);
+    pthread_mutex_unlock(&g_worker_mutex);
+}
+
 // 声明哈萨克语词库清理函数（在kazakh_dict_jni.cpp中定义）
 #ifdef __cplusplus
 extern "C" {
@@ -58,6 +148,9 @@ JNIEXPORT jboolean JNICALL Java_com_example_nasboard_ime_dictionary_PinyinDecode
 
     LOGD("nativeImOpenDecoderFd: Starting decoder initialization...");
 
+    // 解码线程的会话必须在解码器关闭前关闭
+    stop_worker(env);
+
     if (g_decoder_initialized) {
         LOGD("nativeImOpenDecoderFd: Decoder already initialized, closing first...");
         im_close_decoder();
@@ -142,6 +235,8 @@ JNIEXPORT jboolean JNICALL Java_com_example_nasboard_ime_dictionary_PinyinDecode
 JNIEXPORT void JNICALL Java_com_example_nasboard_ime_dictionary_PinyinDecoder_nativeImCloseDecoder(
         JNIEnv* env, jobject thiz) {
 
+    stop_worker(env);
+
     if (g_decoder_initialized) {
         im_close_decoder();
         g_decoder_initialized = false;
@@ -217,6 +312,44 @@ JNIEXPORT jstring JNICALL Java_com_example_nasboard_ime_dictionary_PinyinDecoder
     return env->NewStringUTF("");
 }
 
+/**
+ * 一次获取一页候选词，每个候选词以'\0'结尾，依次放在返回的数组中
+ */
+JNIEXPORT jcharArray JNICALL Java_com_example_nasboard_ime_dictionary_PinyinDecoder_nativeImGetChoices(
+        JNIEnv* env, jobject thiz, jint start, jint count) {
+
+    if (!g_decoder_initialized) {
+        LOGE("nativeImGetChoices: Decoder not initialized");
+        return env->NewCharArray(0);
+    }
+
+    if (start < 0 || count <= 0) {
+        return env->NewCharArray(0);
+    }
+
+    // 候选词最长是整句，不超过kMaxSearchSteps个字
+    size_t buf_len = (size_t)count * (kMaxSearchSteps + 1);
+    char16* buf = new char16[buf_len];
+    size_t num = im_get_candidates(start, count, buf, buf_len);
+
+    size_t len = 0;
+    for (size_t i = 0; i < num; i++) {
+        while (buf[len] != 0) {
+            len++;
+        }
+        len++;
+    }
+
+    jcharArray result = env->NewCharArray(len);
+    if (result != NULL) {
+        env->SetCharArrayRegion(result, 0, len, (const jchar*)buf);
+    }
+    delete[] buf;
+
+    LOGD("nativeImGetChoices: Got %zu candidates from %d", num, start);
+    return result;
+}
+
 /**
  * 重置搜索
  */
@@ -241,6 +374,30 @@ JNIEXPORT void JNICALL Java_com_example_nasboard_ime_dictionary_PinyinDecoder_na
     }
 }
 
+/**
+ * 设置模糊音，flags为spellingtrie.h中kFuzzyXxx的组合，0表示关闭
+ */
+JNIEXPORT void JNICALL Java_com_example_nasboard_ime_dictionary_PinyinDecoder_nativeImSetFuzzy(
+        JNIEnv* env, jobject thiz, jint flags) {
+
+    if (g_decoder_initialized) {
+        im_set_fuzzy(static_cast<uint16>(flags));
+        LOGD("nativeImSetFuzzy: Set fuzzy flags 0x%x", flags);
+    }
+}
+
+/**
+ * 设置九键输入，打开后搜索的拼音串是数字2-9
+ */
+JNIEXPORT void JNICALL Java_com_example_nasboard_ime_dictionary_PinyinDecoder_nativeImSetT9(
+        JNIEnv* env, jobject thiz, jboolean enable) {
+
+    if (g_decoder_initialized) {
+        im_set_t9(enable == JNI_TRUE);
+        LOGD("nativeImSetT9: T9 %s", enable ? "enabled" : "disabled");
+    }
+}
+
 /**
  * 删除搜索
  */
@@ -504,6 +661,97 @@ JNIEXPORT jstring JNICALL Java_com_example_nasboard_ime_dictionary_PinyinDecoder
     return env->NewString((const jchar*)predict_item, len);
 }
 
+/**
+ * 启动后台解码线程，每页最多page_size个候选词
+ */
+JNIEXPORT jboolean JNICALL Java_com_example_nasboard_ime_dictionary_PinyinDecoder_nativeImStartWorker(
+        JNIEnv* env, jobject thiz, jint page_size) {
+
+    if (!g_decoder_initialized) {
+        LOGE("nativeImStartWorker: Decoder not initialized");
+        return JNI_FALSE;
+    }
+
+    jclass clazz = env->GetObjectClass(thiz);
+    jmethodID on_page = env->GetMethodID(clazz, "onDecodePage",
+                                         "(ILjava/lang/String;[Ljava/lang/String;I)V");
+    env->DeleteLocalRef(clazz);
+    if (on_page == NULL) {
+        LOGE("nativeImStartWorker: onDecodePage not found");
+        return JNI_FALSE;
+    }
+
+    JavaVM* vm = NULL;
+    if (env->GetJavaVM(&vm) != JNI_OK) {
+        LOGE("nativeImStartWorker: Failed to get JavaVM");
+        return JNI_FALSE;
+    }
+
+    pthread_mutex_lock(&g_worker_mutex);
+    stop_worker_locked(env);
+
+    g_worker_listener = new JniDecodeListener(vm, env->NewGlobalRef(thiz), on_page);
+    g_worker = im_open_worker(page_size, g_worker_listener);
+    if (g_worker == NULL) {
+        LOGE("nativeImStartWorker: Failed to start decode worker");
+        env->DeleteGlobalRef(g_worker_listener->decoder());
+        delete g_worker_listener;
+        g_worker_listener = NULL;
+    }
+    jboolean started = g_worker != NULL ? JNI_TRUE : JNI_FALSE;
+    pthread_mutex_unlock(&g_worker_mutex);
+
+    LOGD("nativeImStartWorker: %s", started ? "started" : "failed");
+    return started;
+}
+
+/**
+ * 停止后台解码线程，未解码的输入被丢弃
+ */
+JNIEXPORT void JNICALL Java_com_example_nasboard_ime_dictionary_PinyinDecoder_nativeImStopWorker(
+        JNIEnv* env, jobject thiz) {
+
+    stop_worker(env);
+}
+
+/**
+ * 投递拼音给解码线程，取代还没有解码的输入，返回这次输入的版本号，没有解码线程时返回0
+ */
+JNIEXPORT jint JNICALL Java_com_example_nasboard_ime_dictionary_PinyinDecoder_nativeImPostSearch(
+        JNIEnv* env, jobject thiz, jbyteArray py_buf, jint py_len) {
+
+    jbyte* array_body = env->GetByteArrayElements(py_buf, NULL);
+    if (array_body == NULL) {
+        LOGE("nativeImPostSearch: Failed to get byte array elements");
+        return 0;
+    }
+
+    pthread_mutex_lock(&g_worker_mutex);
+    uint32 version = 0;
+    if (g_worker != NULL) {
+        version = g_worker->post_search((const char*)array_body, py_len);
+    }
+    pthread_mutex_unlock(&g_worker_mutex);
+
+    env->ReleaseByteArrayElements(py_buf, array_body, JNI_ABORT);
+    return (jint)version;
+}
+
+/**
+ * 让解码线程重置搜索，例如提交之后
+ */
+JNIEXPORT jint JNICALL Java_com_example_nasboard_ime_dictionary_PinyinDecoder_nativeImPostReset(
+        JNIEnv* env, jobject thiz) {
+
+    pthread_mutex_lock(&g_worker_mutex);
+    uint32 version = 0;
+    if (g_worker != NULL) {
+        version = g_worker->post_reset();
+    }
+    pthread_mutex_unlock(&g_worker_mutex);
+    return (jint)version;
+}
+
 /**
  * 检查是否已初始化
  */
@@ -542,6 +790,16 @@ JNIEXPORT void JNI_OnUnload(JavaVM* vm, void* reserved) {
     LOGD("JNI_OnUnload: Cleaning up nasboard-pinyin JNI library (清理拼音解码器和哈萨克语词库)");
 
     // 1. 清理拼音解码器资源
+    // 解码线程持有PinyinDecoder的全局引用，卸载时JVM已不再需要它
+    pthread_mutex_lock(&g_worker_mutex);
+    if (g_worker != NULL) {
+        im_close_worker(g_worker);
+        g_worker = NULL;
+        delete g_worker_listener;
+        g_worker_listener = NULL;
+    }
+    pthread_mutex_unlock(&g_worker_mutex);
+
     // 释放预测缓冲区
     if (predict_buf != NULL) {
         delete[] predict_buf;
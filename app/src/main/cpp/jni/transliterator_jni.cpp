@@ -0,0 +1,160 @@
+#include <jni.h>
+#include <android/log.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "marisa/Transliterator.h"
+
+#define LOG_TAG "TransliteratorJNI"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// 哈萨克文字母互转的JNI接口
+// 句柄是Transliterator和Transliterator::Stream的指针，由Kotlin的Transliterator持有。
+// JNI的字符串是modified UTF-8，没有规则的字节原样保留，所以可以直接转换
+
+namespace {
+
+    marisa::Transliterator* fromHandle(jlong handle) {
+        return reinterpret_cast<marisa::Transliterator*>(handle);
+    }
+
+    marisa::Transliterator::Stream* streamFromHandle(jlong handle) {
+        return reinterpret_cast<marisa::Transliterator::Stream*>(handle);
+    }
+
+    std::string toStdString(JNIEnv* env, jstring str) {
+        std::string result;
+        if (str == nullptr) {
+            return result;
+        }
+        const char* chars = env->GetStringUTFChars(str, nullptr);
+        if (chars != nullptr) {
+            result = chars;
+            env->ReleaseStringUTFChars(str, chars);
+        }
+        return result;
+    }
+
+} // namespace
+
+extern "C" {
+
+// 编译规则表，from[i] -> to[i]，返回句柄
+JNIEXPORT jlong JNICALL
+Java_com_example_nasboard_ime_conversion_Transliterator_nativeCreate(
+        JNIEnv* env, jclass /* clazz */, jobjectArray from, jobjectArray to) {
+
+    jsize count = env->GetArrayLength(from);
+    if (count != env->GetArrayLength(to)) {
+        LOGE("Rule arrays differ in length");
+        return 0;
+    }
+
+    std::vector<marisa::Transliterator::Rule> rules;
+    rules.reserve(count);
+    for (jsize i = 0; i < count; i++) {
+        auto key = static_cast<jstring>(env->GetObjectArrayElement(from, i));
+        auto value = static_cast<jstring>(env->GetObjectArrayElement(to, i));
+        rules.emplace_back(toStdString(env, key), toStdString(env, value));
+        env->DeleteLocalRef(key);
+        env->DeleteLocalRef(value);
+    }
+
+    try {
+        auto* transliterator = new marisa::Transliterator();
+        transliterator->build(rules);
+        LOGD("Transliterator built: %zu rules, %zu states",
+             transliterator->numRules(), transliterator->numStates());
+        return reinterpret_cast<jlong>(transliterator);
+    } catch (const std::exception& e) {
+        LOGE("Transliterator build exception: %s", e.what());
+        return 0;
+    }
+}
+
+JNIEXPORT void JNICALL
+Java_com_example_nasboard_ime_conversion_Transliterator_nativeDestroy(
+        JNIEnv* /* env */, jclass /* clazz */, jlong handle) {
+
+    delete fromHandle(handle);
+}
+
+// 转换整段文本
+JNIEXPORT jstring JNICALL
+Java_com_example_nasboard_ime_conversion_Transliterator_nativeConvert(
+        JNIEnv* env, jclass /* clazz */, jlong handle, jstring text) {
+
+    if (handle == 0) {
+        return text;
+    }
+    std::string result = fromHandle(handle)->convert(toStdString(env, text));
+    return env->NewStringUTF(result.c_str());
+}
+
+// ==================== 流式转换 ====================
+
+JNIEXPORT jlong JNICALL
+Java_com_example_nasboard_ime_conversion_Transliterator_nativeStreamCreate(
+        JNIEnv* /* env */, jclass /* clazz */, jlong handle) {
+
+    if (handle == 0) {
+        return 0;
+    }
+    return reinterpret_cast<jlong>(new marisa::Transliterator::Stream(*fromHandle(handle)));
+}
+
+JNIEXPORT void JNICALL
+Java_com_example_nasboard_ime_conversion_Transliterator_nativeStreamDestroy(
+        JNIEnv* /* env */, jclass /* clazz */, jlong stream) {
+
+    delete streamFromHandle(stream);
+}
+
+// 输入一段文本，返回新确定的结果
+JNIEXPORT jstring JNICALL
+Java_com_example_nasboard_ime_conversion_Transliterator_nativeStreamFeed(
+        JNIEnv* env, jclass /* clazz */, jlong stream, jstring text) {
+
+    std::string out;
+    if (stream != 0) {
+        streamFromHandle(stream)->feed(toStdString(env, text), out);
+    }
+    return env->NewStringUTF(out.c_str());
+}
+
+// 未确定部分按输入结束时的结果
+JNIEXPORT jstring JNICALL
+Java_com_example_nasboard_ime_conversion_Transliterator_nativeStreamPreview(
+        JNIEnv* env, jclass /* clazz */, jlong stream) {
+
+    std::string out;
+    if (stream != 0) {
+        out = streamFromHandle(stream)->preview();
+    }
+    return env->NewStringUTF(out.c_str());
+}
+
+// 结束输入，返回未确定部分的结果
+JNIEXPORT jstring JNICALL
+Java_com_example_nasboard_ime_conversion_Transliterator_nativeStreamFinish(
+        JNIEnv* env, jclass /* clazz */, jlong stream) {
+
+    std::string out;
+    if (stream != 0) {
+        streamFromHandle(stream)->finish(out);
+    }
+    return env->NewStringUTF(out.c_str());
+}
+
+JNIEXPORT void JNICALL
+Java_com_example_nasboard_ime_conversion_Transliterator_nativeStreamReset(
+        JNIEnv* /* env */, jclass /* clazz */, jlong stream) {
+
+    if (stream != 0) {
+        streamFromHandle(stream)->reset();
+    }
+}
+
+} // extern "C"
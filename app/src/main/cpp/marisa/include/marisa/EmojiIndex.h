@@ -0,0 +1,63 @@
+#ifndef MARISA_EMOJI_INDEX_H
+#define MARISA_EMOJI_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "marisa/payload.h"
+#include "marisa/trie.h"
+
+namespace marisa {
+
+    // 表情搜索的关键词索引
+    // 每个表情的名称、各语言的CLDR关键词，以及其中每个词开头的后缀，
+    // 转成小写后和表情组成键"关键词\0表情"，放在同一个Trie中。
+    // Trie后面紧跟一个Payload，第0列是表情的名次（按使用频率降序）。
+    // 输入的每个字符只需一次前缀搜索，按名次取前K个不同的表情。
+    class EmojiIndex {
+    public:
+        // 索引编译时的一个表情，keywords包括名称和所有语言的关键词
+        struct Entry {
+            std::string emoji;
+            std::vector<std::string> keywords;
+        };
+
+        EmojiIndex();
+        ~EmojiIndex();
+
+        EmojiIndex(const EmojiIndex&) = delete;
+        EmojiIndex& operator=(const EmojiIndex&) = delete;
+
+        // 编译索引：entries按使用频率降序，同一个表情出现多次时合并关键词，
+        // 名次取第一次出现的位置
+        static void build(const std::vector<Entry>& entries, const char* filename,
+                          int configFlags = 0);
+
+        // mmap打开编译好的索引
+        bool loadFromFile(const char* filename);
+
+        // 关键词中有以query开头的词的表情，按名次排序，不区分大小写，忽略开头的空白
+        std::vector<std::string> search(std::string_view query, int maxResults) const;
+
+        size_t numEmojis() const { return numEmojis_; }
+        size_t numKeys() const;
+        std::string getInfo() const;
+        bool isLoaded() const;
+
+        void clear();
+
+        // 拉丁、西里尔字母（包括哈萨克字母）转成小写，其他字符不变
+        static std::string foldCase(std::string_view text);
+
+    private:
+        Trie trie_;
+        Payload payload_;
+        bool loaded_ = false;
+        size_t numEmojis_ = 0;
+    };
+
+} // namespace marisa
+
+#endif // MARISA_EMOJI_INDEX_H
@@ -0,0 +1,38 @@
+#ifndef MARISA_KAZAKH_ALPHABET_H
+#define MARISA_KAZAKH_ALPHABET_H
+
+#include <string>
+#include <string_view>
+
+#include "marisa/keyset.h"
+#include "marisa/trie.h"
+
+namespace marisa {
+
+    // 哈萨克文单字节字母表
+    // 42个哈萨克文西里尔字母的大小写和常用标点各映射为一个字节，ASCII保持不变，
+    // 其他字符转义后原样保存。编码逐字符进行，前缀的编码就是编码的前缀，
+    // 所以前缀搜索可以直接用编码后的查询。每个字母在Trie中只占一层，
+    // 词典和查询路径都只有UTF-8的一半长。
+    class KazakhAlphabet {
+    public:
+        // 编码后的Trie中带有这个键，用来和旧的UTF-8词典区分
+        static const std::string_view MARKER_KEY;
+
+        // UTF-8 -> 单字节编码，结果追加到out
+        static void encode(std::string_view utf8, std::string& out);
+
+        // 单字节编码 -> UTF-8，结果追加到out
+        static void decode(std::string_view encoded, std::string& out);
+
+        // Trie是否用本字母表编码
+        static bool isEncoded(const Trie& trie);
+
+        // 用UTF-8键集构建编码后的Trie，权重保持不变。
+        // 和Trie::build一样，构建后utf8Keys[i].id()是该键在Trie中的ID
+        static void buildTrie(Keyset& utf8Keys, Trie& trie, int configFlags = 0);
+    };
+
+} // namespace marisa
+
+#endif // MARISA_KAZAKH_ALPHABET_H
@@ -28,9 +28,33 @@ namespace marisa {
         // 搜索功能
         std::vector<std::string> prefixSearch(const std::string& prefix, int maxResults = 20);
         std::vector<std::string> contextPredict(const std::string& previousWord, const std::string& currentPrefix, int maxResults = 15);
+        // 同上，结果写入调用方保留的results，返回结果数，只有前面这么多个有效。
+        // 同一组前词和前缀再次查询时命中缓存，复用results不再分配堆内存
+        size_t contextPredict(const std::string& previousWord, const std::string& currentPrefix, int maxResults,
+                              std::vector<std::string>& results);
         std::vector<std::string> pureContextPredict(const std::string& previousWord, int maxResults = 10);
+        // 同上，结果写入调用方保留的results，返回结果数，只有前面这么多个有效。
+        // 每次按键复用同一个results时，字符串的容量留着再用，不再分配堆内存
+        size_t pureContextPredict(const std::string& previousWord, int maxResults,
+                                  std::vector<std::string>& results);
         bool exactMatch(const std::string& word);
 
+        // 增量词典：在unigram词典之上叠加小的增量层（TrieLevel，UTF-8键），
+        // 增加、修改或删除词条不需要重建和重新发布整个词典。
+        // 上层优先，removedWords中的词对查询不再可见
+        bool loadUnigramDelta(const char* filename);
+        bool addUnigramDelta(const std::vector<std::string>& words,
+                             const std::vector<float>& weights,
+                             const std::vector<std::string>& removedWords = {});
+        // 用户词典的增量：从用户词典删除的词如果unigram词典里也有，恢复为词典里的
+        // 权重，不加墓碑，否则会连系统词一起隐藏
+        bool addUserWordDelta(const std::vector<std::string>& words,
+                              const std::vector<float>& weights,
+                              const std::vector<std::string>& removedWords);
+        // 后台合并所有增量层，层数过多时也会自动合并
+        void compactUnigramDeltas();
+        size_t getUnigramDeltaCount() const;
+
         // 拼写纠正功能
         std::vector<std::string> spellCorrect(const std::string& input, int maxResults = 10);
 
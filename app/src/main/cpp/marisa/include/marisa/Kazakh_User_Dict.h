@@ -47,6 +47,9 @@ namespace kazakh_ime {
                                                    const std::string& currentPrefix,
                                                    int maxResults = 15);
         bool containsWord(const std::string& word);
+        // 读工作数据，刚写入的词也能查到；不存在时返回0
+        int getWordFrequency(const std::string& word) const;
+        std::vector<std::string> getAllWords() const;
 
         // ========== 批量操作 ==========
         bool importWords(const std::vector<std::string>& words);
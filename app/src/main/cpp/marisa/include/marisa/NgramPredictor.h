@@ -0,0 +1,86 @@
+#ifndef MARISA_NGRAM_PREDICTOR_H
+#define MARISA_NGRAM_PREDICTOR_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "marisa/payload.h"
+#include "marisa/trie.h"
+
+namespace marisa {
+
+    // 英语、俄语等空格分词语言的n-gram词典
+    // unigram、bigram、trigram放在同一个Trie中，键是阶数标记加空格连接的词，
+    // 例如"\x02of the"。Trie后面紧跟一个Payload：第0列是该键在同阶中按频率
+    // 降序的名次，评分列是频率。整个文件用mmap打开，不占Java堆，
+    // 上下文预测就是一次前缀搜索加按名次取前K个。
+    class NgramPredictor {
+    public:
+        // 词典编译时的一个n-gram，words是空格连接的1到3个词
+        struct Entry {
+            std::string words;
+            double frequency;
+        };
+
+        static const int MAX_ORDER = 3;
+
+        NgramPredictor();
+        ~NgramPredictor();
+
+        NgramPredictor(const NgramPredictor&) = delete;
+        NgramPredictor& operator=(const NgramPredictor&) = delete;
+
+        // 编译词典：同一n-gram出现多次时取最大频率，同频率的按entries中的顺序排名
+        static void build(const std::vector<Entry>& entries, const char* filename,
+                          int configFlags = 0);
+
+        // mmap打开编译好的词典
+        bool loadFromFile(const char* filename);
+
+        // 以prefix开头的词，按频率降序
+        std::vector<std::string> prefixSearch(std::string_view prefix, int maxResults) const;
+
+        // previousWord之后以currentPrefix开头的词，按bigram频率降序
+        std::vector<std::string> contextPredict(std::string_view previousWord,
+                                                std::string_view currentPrefix,
+                                                int maxResults) const;
+
+        // 前两个词之后以currentPrefix开头的词，按trigram频率降序
+        std::vector<std::string> trigramPredict(std::string_view firstWord,
+                                                std::string_view secondWord,
+                                                std::string_view currentPrefix,
+                                                int maxResults) const;
+
+        // 频率最高的词，不含单字符的词
+        std::vector<std::string> mostFrequentWords(int maxResults) const;
+
+        bool exactMatch(std::string_view word) const;
+
+        // unigram频率（评分码本的近似值），不在词典中返回0
+        double getFrequency(std::string_view word) const;
+
+        size_t getCount(int order) const;
+        std::string getInfo() const;
+        bool isLoaded() const;
+
+        void clear();
+
+    private:
+        Trie trie_;
+        Payload payload_;
+        bool loaded_ = false;
+        size_t counts_[MAX_ORDER] = {};
+        // 频率最高的多字符词，加载时取出，避免每次扫描整个unigram
+        std::vector<std::string> topWords_;
+
+        // 在以query开头的键中按名次取前maxResults个，
+        // 结果是键中从wordOffset开始的部分，即最后一个词
+        std::vector<std::string> topCompletions(std::string_view query, size_t wordOffset,
+                                                int maxResults) const;
+    };
+
+} // namespace marisa
+
+#endif // MARISA_NGRAM_PREDICTOR_H
@@ -0,0 +1,100 @@
+#ifndef MARISA_TRANSLITERATOR_H
+#define MARISA_TRANSLITERATOR_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace marisa {
+
+    // 哈萨克文拉丁/西里尔/阿拉伯字母互转
+    // 规则表只编译一次，得到按UTF-8字节转移的自动机（Aho–Corasick的goto树），
+    // 从左到右每次取最长匹配的规则，没有规则的字符原样保留。
+    // 规则的键最长只有几个字符，失配时只需回看还没确定的几个字节，
+    // 所以不需要失败链接，每个输入字节的代价是常数。
+    class Transliterator {
+    public:
+        using Rule = std::pair<std::string, std::string>;
+
+        Transliterator();
+        ~Transliterator();
+
+        Transliterator(const Transliterator&) = delete;
+        Transliterator& operator=(const Transliterator&) = delete;
+
+        // 编译规则表，同一个键出现多次时以最后一次为准，空键被忽略
+        void build(const std::vector<Rule>& rules);
+
+        // 转换整段文本
+        std::string convert(std::string_view text) const;
+
+        size_t numRules() const { return numRules_; }
+        size_t numStates() const { return states_.size(); }
+
+        // 流式转换：逐段输入正在组字的文本，已经确定的结果立即输出，
+        // 可能被后面的输入延长的匹配留到下次。结果和一次转换整段文本相同
+        class Stream {
+        public:
+            explicit Stream(const Transliterator& transliterator);
+
+            // 输入一段文本，确定的结果追加到out
+            void feed(std::string_view text, std::string& out);
+
+            // 没有更多输入时未确定部分的结果，不改变状态
+            std::string preview() const;
+
+            // 结束输入，未确定部分的结果追加到out
+            void finish(std::string& out);
+
+            void reset();
+
+            // 还没有确定的输入
+            const std::string& pending() const { return pending_; }
+
+        private:
+            const Transliterator* transliterator_;
+            std::string pending_;
+            uint32_t state_;
+            // pending_中最长的已匹配规则的长度和规则编号
+            size_t matchLength_ = 0;
+            int32_t matchRule_ = -1;
+
+            void advance(std::string& out);
+            void restart(std::string& out);
+        };
+
+    private:
+        static const uint32_t NO_STATE = UINT32_MAX;
+
+        struct State {
+            uint32_t firstEdge = 0;
+            uint32_t numEdges = 0;
+            int32_t rule = -1;   // 在此结束的规则，-1表示没有
+        };
+
+        struct Edge {
+            uint8_t label;
+            uint32_t target;
+        };
+
+        std::vector<State> states_;
+        std::vector<Edge> edges_;
+        // 根状态的转移直接查表
+        uint32_t rootEdges_[256];
+        // 各规则的输出
+        std::vector<std::string> outputs_;
+        size_t numRules_ = 0;
+
+        uint32_t step(uint32_t state, uint8_t byte) const;
+
+        // 从pending开头解析一段：有匹配时输出最长规则，否则原样输出一个字符，
+        // 返回消耗的字节数
+        size_t resolve(std::string_view pending, size_t matchLength, int32_t matchRule,
+                       std::string& out) const;
+    };
+
+} // namespace marisa
+
+#endif // MARISA_TRANSLITERATOR_H
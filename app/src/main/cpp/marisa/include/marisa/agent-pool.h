@@ -0,0 +1,84 @@
+#ifndef MARISA_AGENT_POOL_H_
+#define MARISA_AGENT_POOL_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "marisa/agent.h"
+
+namespace marisa {
+
+// AgentPool lends agents, each with a query buffer, to the callers of a trie
+// that is searched from several threads. A returned agent is reset() and
+// keeps its State, so searching with a leased agent allocates no memory once
+// the pool has as many agents as concurrent callers.
+class AgentPool {
+ public:
+  struct Entry {
+    Agent agent;
+    std::string query;
+  };
+
+  // Lease gives the entry back to the pool when it is destroyed.
+  class Lease {
+   public:
+    Lease(AgentPool *pool, std::unique_ptr<Entry> entry)
+        : pool_(pool), entry_(std::move(entry)) {}
+    Lease(Lease &&) = default;
+    Lease &operator=(Lease &&) = delete;
+    ~Lease() {
+      if (entry_) {
+        pool_->release(std::move(entry_));
+      }
+    }
+
+    Agent &agent() {
+      return entry_->agent;
+    }
+    std::string &query() {
+      return entry_->query;
+    }
+
+   private:
+    AgentPool *pool_;
+    std::unique_ptr<Entry> entry_;
+  };
+
+  AgentPool() = default;
+
+  AgentPool(const AgentPool &) = delete;
+  AgentPool &operator=(const AgentPool &) = delete;
+
+  Lease acquire() {
+    std::unique_ptr<Entry> entry;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!entries_.empty()) {
+        entry = std::move(entries_.back());
+        entries_.pop_back();
+      }
+    }
+    if (!entry) {
+      entry = std::make_unique<Entry>();
+    }
+    return Lease(this, std::move(entry));
+  }
+
+ private:
+  std::vector<std::unique_ptr<Entry>> entries_;
+  std::mutex mutex_;
+
+  void release(std::unique_ptr<Entry> entry) {
+    entry->agent.reset();
+    entry->query.clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.push_back(std::move(entry));
+  }
+};
+
+}  // namespace marisa
+
+#endif  // MARISA_AGENT_POOL_H_
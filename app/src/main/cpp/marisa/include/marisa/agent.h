@@ -28,6 +28,8 @@ class Agent {
   const Query &query() const {
     return query_;
   }
+  // key().str() points into the query, the trie or the state of this agent,
+  // and stays valid until the next search or set_query() with this agent.
   const Key &key() const {
     return key_;
   }
@@ -68,6 +70,10 @@ class Agent {
   }
   void init_state();
 
+  // reset() forgets the query and the key but keeps the state and its
+  // buffers, so that a reused agent searches without allocating. clear()
+  // frees them.
+  void reset() noexcept;
   void clear() noexcept;
   void swap(Agent &rhs) noexcept;
 
@@ -0,0 +1,42 @@
+#ifndef MARISA_GRIMOIRE_ALGORITHM_PARALLEL_H_
+#define MARISA_GRIMOIRE_ALGORITHM_PARALLEL_H_
+
+#include <cassert>
+#include <future>
+#include <vector>
+
+#include "marisa/base.h"
+
+namespace marisa::grimoire::algorithm {
+
+// parallel_for() calls func(block_id, begin, end) for each of num_blocks
+// consecutive blocks of [0, size). Block 0 runs on the calling thread and
+// the others on their own threads. It returns after all blocks are done and
+// rethrows an exception thrown by any of them.
+template <typename Func>
+void parallel_for(std::size_t size, std::size_t num_blocks, Func func) {
+  assert(num_blocks != 0);
+
+  if (num_blocks <= 1) {
+    func(std::size_t{0}, std::size_t{0}, size);
+    return;
+  }
+
+  std::vector<std::future<void>> tasks;
+  tasks.reserve(num_blocks - 1);
+  for (std::size_t i = 1; i < num_blocks; ++i) {
+    const std::size_t begin = size * i / num_blocks;
+    const std::size_t end = size * (i + 1) / num_blocks;
+    tasks.push_back(std::async(std::launch::async, [&func, i, begin, end] {
+      func(i, begin, end);
+    }));
+  }
+  func(std::size_t{0}, std::size_t{0}, size / num_blocks);
+  for (std::size_t i = 0; i < tasks.size(); ++i) {
+    tasks[i].get();
+  }
+}
+
+}  // namespace marisa::grimoire::algorithm
+
+#endif  // MARISA_GRIMOIRE_ALGORITHM_PARALLEL_H_
@@ -3,9 +3,12 @@
 #include <algorithm>
 #include <cassert>
 #include <functional>
-#include <queue>
+#include <memory>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
+#include "marisa/grimoire/algorithm/parallel.h"
 #include "marisa/grimoire/algorithm/sort.h"
 #include "marisa/grimoire/trie/header.h"
 #include "marisa/grimoire/trie/range.h"
@@ -17,12 +20,16 @@ LoudsTrie::LoudsTrie() = default;
 
 LoudsTrie::~LoudsTrie() = default;
 
-void LoudsTrie::build(Keyset &keyset, int flags) {
+void LoudsTrie::build(Keyset &keyset, int flags, std::size_t num_threads,
+                      const Keyset *query_log) {
   Config config;
   config.parse(flags);
 
   LoudsTrie temp;
-  temp.build_(keyset, config);
+  temp.build_(keyset, config, (num_threads != 0) ? num_threads : 1);
+  if (query_log != nullptr) {
+    temp.tune_cache(*query_log);
+  }
   swap(temp);
 }
 
@@ -67,6 +74,56 @@ bool LoudsTrie::lookup(Agent &agent) const {
   return true;
 }
 
+std::size_t LoudsTrie::lookup_batch(const std::string_view *keys,
+                                    std::size_t num_keys,
+                                    std::size_t *key_ids) const {
+  // A lookup resumes from the deepest state of the previous walk which only
+  // depends on the prefix shared by both keys. Spelling candidates of one
+  // word are mostly emitted position by position, so neighbouring keys share
+  // long prefixes and skip most of their transitions.
+  //
+  // (query_pos, node_id) after each transition of the previous walk.
+  std::vector<std::pair<std::size_t, std::size_t>> path;
+  path.emplace_back(0, 0);
+
+  Agent agent;
+  agent.init_state();
+  State &state = agent.state();
+  std::string_view prev_key;
+  std::size_t num_found = 0;
+  for (std::size_t i = 0; i < num_keys; ++i) {
+    const std::string_view key = keys[i];
+    std::size_t lcp = 0;
+    while ((lcp < key.length()) && (lcp < prev_key.length()) &&
+           (key[lcp] == prev_key[lcp])) {
+      ++lcp;
+    }
+    while (path.back().first > lcp) {
+      path.pop_back();
+    }
+
+    agent.set_query(key.data(), key.length());
+    state.set_query_pos(path.back().first);
+    state.set_node_id(path.back().second);
+    bool found = true;
+    while (state.query_pos() < key.length()) {
+      if (!find_child(agent)) {
+        found = false;
+        break;
+      }
+      path.emplace_back(state.query_pos(), state.node_id());
+    }
+    if (found && terminal_flags_[state.node_id()]) {
+      key_ids[i] = terminal_flags_.rank1(state.node_id());
+      ++num_found;
+    } else {
+      key_ids[i] = MARISA_INVALID_KEY_ID;
+    }
+    prev_key = key;
+  }
+  return num_found;
+}
+
 void LoudsTrie::reverse_lookup(Agent &agent) const {
   assert(agent.has_state());
   MARISA_THROW_IF(agent.query().id() >= size(), std::out_of_range);
@@ -244,7 +301,8 @@ void LoudsTrie::swap(LoudsTrie &rhs) noexcept {
   mapper_.swap(rhs.mapper_);
 }
 
-void LoudsTrie::build_(Keyset &keyset, const Config &config) {
+void LoudsTrie::build_(Keyset &keyset, const Config &config,
+                       std::size_t num_threads) {
   Vector<Key> keys;
   keys.resize(keyset.size());
   for (std::size_t i = 0; i < keyset.size(); ++i) {
@@ -253,7 +311,7 @@ void LoudsTrie::build_(Keyset &keyset, const Config &config) {
   }
 
   Vector<uint32_t> terminals;
-  build_trie(keys, &terminals, config, 1);
+  build_trie(keys, &terminals, config, 1, num_threads);
 
   using TerminalIdPair = std::pair<uint32_t, uint32_t>;
   const std::size_t pairs_size = terminals.size();
@@ -290,12 +348,13 @@ void LoudsTrie::build_(Keyset &keyset, const Config &config) {
 
 template <typename T>
 void LoudsTrie::build_trie(Vector<T> &keys, Vector<uint32_t> *terminals,
-                           const Config &config, std::size_t trie_id) {
-  build_current_trie(keys, terminals, config, trie_id);
+                           const Config &config, std::size_t trie_id,
+                           std::size_t num_threads) {
+  build_current_trie(keys, terminals, config, trie_id, num_threads);
 
   Vector<uint32_t> next_terminals;
   if (!keys.empty()) {
-    build_next_trie(keys, &next_terminals, config, trie_id);
+    build_next_trie(keys, &next_terminals, config, trie_id, num_threads);
   }
 
   if (next_trie_ != nullptr) {
@@ -320,13 +379,59 @@ void LoudsTrie::build_trie(Vector<T> &keys, Vector<uint32_t> *terminals,
   fill_cache();
 }
 
+namespace {
+
+// A child found while splitting a range: w_range.key_pos() is the position
+// of its label, and key_pos is the end of the label or of its link. The label
+// is kept so that the keys are not read again when the child is appended.
+struct ChildRange {
+  WeightedRange w_range;
+  std::size_t key_pos;
+  char label;
+};
+
+// Splits ranges of one level into blocks which hold about the same number of
+// keys, so that the blocks can be split into children on their own threads.
+std::size_t split_level(const Vector<Range> &ranges, std::size_t num_threads,
+                        Vector<std::size_t> *block_ends) {
+  std::size_t num_keys = 0;
+  for (std::size_t i = 0; i < ranges.size(); ++i) {
+    num_keys += ranges[i].end() - ranges[i].begin();
+  }
+  std::size_t num_blocks = std::min(num_threads, num_keys / 65536);
+  if (num_blocks <= 1) {
+    block_ends->resize(1);
+    (*block_ends)[0] = ranges.size();
+    return 1;
+  }
+
+  block_ends->resize(num_blocks);
+  std::size_t block_id = 0;
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < ranges.size(); ++i) {
+    count += ranges[i].end() - ranges[i].begin();
+    while ((block_id + 1 < num_blocks) &&
+           (count >= num_keys * (block_id + 1) / num_blocks)) {
+      (*block_ends)[block_id++] = i + 1;
+    }
+  }
+  while (block_id < num_blocks) {
+    (*block_ends)[block_id++] = ranges.size();
+  }
+  return num_blocks;
+}
+
+}  // namespace
+
 template <typename T>
 void LoudsTrie::build_current_trie(Vector<T> &keys, Vector<uint32_t> *terminals,
-                                   const Config &config, std::size_t trie_id) {
+                                   const Config &config, std::size_t trie_id,
+                                   std::size_t num_threads) {
   for (std::size_t i = 0; i < keys.size(); ++i) {
     keys[i].set_id(i);
   }
-  const std::size_t num_keys = algorithm::sort(keys.begin(), keys.end());
+  const std::size_t num_keys =
+      algorithm::sort(keys.begin(), keys.end(), num_threads);
   reserve_cache(config, trie_id, num_keys);
 
   louds_.push_back(true);
@@ -334,88 +439,133 @@ void LoudsTrie::build_current_trie(Vector<T> &keys, Vector<uint32_t> *terminals,
   bases_.push_back('\0');
   link_flags_.push_back(false);
 
+  // Nodes are numbered in breadth-first order, so the trie is built one
+  // level at a time. Splitting the ranges of a level into children reads
+  // only their own keys and may run on several threads, and then the nodes
+  // are appended in order.
   Vector<T> next_keys;
-  std::queue<Range> queue;
-  Vector<WeightedRange> w_ranges;
-
-  queue.push(make_range(0, keys.size(), 0));
-  while (!queue.empty()) {
-    const std::size_t node_id = link_flags_.size() - queue.size();
-
-    Range range = queue.front();
-    queue.pop();
-
-    while ((range.begin() < range.end()) &&
-           (keys[range.begin()].length() == range.key_pos())) {
-      keys[range.begin()].set_terminal(node_id);
-      range.set_begin(range.begin() + 1);
-    }
-
-    if (range.begin() == range.end()) {
-      louds_.push_back(false);
-      continue;
-    }
+  Vector<Range> ranges;
+  Vector<Range> next_ranges;
+  Vector<std::size_t> block_ends;
+  std::unique_ptr<Vector<ChildRange>[]> children(
+      new Vector<ChildRange>[num_threads]);
+  Vector<uint32_t> num_children;
+
+  ranges.push_back(make_range(0, keys.size(), 0));
+  std::size_t level_node_id = 0;
+  while (!ranges.empty()) {
+    num_children.resize(ranges.size());
+    const std::size_t num_blocks =
+        split_level(ranges, num_threads, &block_ends);
+    algorithm::parallel_for(
+        num_blocks, num_blocks,
+        [&](std::size_t block_id, std::size_t, std::size_t) {
+          Vector<ChildRange> &block_children = children[block_id];
+          Vector<WeightedRange> w_ranges;
+          block_children.clear();
+          const std::size_t begin =
+              (block_id == 0) ? 0 : block_ends[block_id - 1];
+          for (std::size_t i = begin; i < block_ends[block_id]; ++i) {
+            const std::size_t node_id = level_node_id + i;
+            Range range = ranges[i];
+            while ((range.begin() < range.end()) &&
+                   (keys[range.begin()].length() == range.key_pos())) {
+              keys[range.begin()].set_terminal(node_id);
+              range.set_begin(range.begin() + 1);
+            }
+
+            num_children[i] = 0;
+            if (range.begin() == range.end()) {
+              continue;
+            }
+
+            w_ranges.clear();
+            double weight = double{keys[range.begin()].weight()};
+            for (std::size_t j = range.begin() + 1; j < range.end(); ++j) {
+              if (keys[j - 1][range.key_pos()] != keys[j][range.key_pos()]) {
+                w_ranges.push_back(make_weighted_range(
+                    range.begin(), j, range.key_pos(),
+                    static_cast<float>(weight)));
+                range.set_begin(j);
+                weight = 0.0;
+              }
+              weight += double{keys[j].weight()};
+            }
+            w_ranges.push_back(make_weighted_range(
+                range.begin(), range.end(), range.key_pos(),
+                static_cast<float>(weight)));
+            if (config.node_order() == MARISA_WEIGHT_ORDER) {
+              std::stable_sort(w_ranges.begin(), w_ranges.end(),
+                               std::greater<WeightedRange>());
+            }
+
+            for (std::size_t j = 0; j < w_ranges.size(); ++j) {
+              const WeightedRange &w_range = w_ranges[j];
+              std::size_t key_pos = w_range.key_pos() + 1;
+              while (key_pos < keys[w_range.begin()].length()) {
+                std::size_t k;
+                for (k = w_range.begin() + 1; k < w_range.end(); ++k) {
+                  if (keys[k - 1][key_pos] != keys[k][key_pos]) {
+                    break;
+                  }
+                }
+                if (k < w_range.end()) {
+                  break;
+                }
+                ++key_pos;
+              }
+              block_children.push_back(ChildRange{
+                  w_range, key_pos, keys[w_range.begin()][w_range.key_pos()]});
+            }
+            num_children[i] = static_cast<uint32_t>(w_ranges.size());
+          }
+        });
+
+    next_ranges.clear();
+    std::size_t block_id = 0;
+    std::size_t child_id = 0;
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+      while (i >= block_ends[block_id]) {
+        ++block_id;
+        child_id = 0;
+      }
+      const std::size_t node_id = level_node_id + i;
+      if (num_children[i] == 0) {
+        louds_.push_back(false);
+        continue;
+      }
 
-    w_ranges.clear();
-    double weight = double{keys[range.begin()].weight()};
-    for (std::size_t i = range.begin() + 1; i < range.end(); ++i) {
-      if (keys[i - 1][range.key_pos()] != keys[i][range.key_pos()]) {
-        w_ranges.push_back(make_weighted_range(
-            range.begin(), i, range.key_pos(), static_cast<float>(weight)));
-        range.set_begin(i);
-        weight = 0.0;
+      if (node_id == 0) {
+        num_l1_nodes_ = num_children[i];
       }
-      weight += double{keys[i].weight()};
-    }
-    w_ranges.push_back(make_weighted_range(range.begin(), range.end(),
-                                           range.key_pos(),
-                                           static_cast<float>(weight)));
-    if (config.node_order() == MARISA_WEIGHT_ORDER) {
-      std::stable_sort(w_ranges.begin(), w_ranges.end(),
-                       std::greater<WeightedRange>());
-    }
 
-    if (node_id == 0) {
-      num_l1_nodes_ = w_ranges.size();
-    }
+      for (std::size_t j = 0; j < num_children[i]; ++j) {
+        const ChildRange &child = children[block_id][child_id++];
+        WeightedRange w_range = child.w_range;
+        cache<T>(node_id, bases_.size(), w_range.weight(), child.label);
 
-    for (std::size_t i = 0; i < w_ranges.size(); ++i) {
-      WeightedRange &w_range = w_ranges[i];
-      std::size_t key_pos = w_range.key_pos() + 1;
-      while (key_pos < keys[w_range.begin()].length()) {
-        std::size_t j;
-        for (j = w_range.begin() + 1; j < w_range.end(); ++j) {
-          if (keys[j - 1][key_pos] != keys[j][key_pos]) {
-            break;
-          }
-        }
-        if (j < w_range.end()) {
-          break;
+        if (child.key_pos == w_range.key_pos() + 1) {
+          bases_.push_back(static_cast<unsigned char>(child.label));
+          link_flags_.push_back(false);
+        } else {
+          bases_.push_back('\0');
+          link_flags_.push_back(true);
+          T next_key;
+          next_key.set_str(keys[w_range.begin()].ptr(),
+                           keys[w_range.begin()].length());
+          next_key.substr(w_range.key_pos(),
+                          child.key_pos - w_range.key_pos());
+          next_key.set_weight(w_range.weight());
+          next_keys.push_back(next_key);
         }
-        ++key_pos;
+        w_range.set_key_pos(child.key_pos);
+        next_ranges.push_back(w_range.range());
+        louds_.push_back(true);
       }
-      cache<T>(node_id, bases_.size(), w_range.weight(),
-               keys[w_range.begin()][w_range.key_pos()]);
-
-      if (key_pos == w_range.key_pos() + 1) {
-        bases_.push_back(static_cast<unsigned char>(
-            keys[w_range.begin()][w_range.key_pos()]));
-        link_flags_.push_back(false);
-      } else {
-        bases_.push_back('\0');
-        link_flags_.push_back(true);
-        T next_key;
-        next_key.set_str(keys[w_range.begin()].ptr(),
-                         keys[w_range.begin()].length());
-        next_key.substr(w_range.key_pos(), key_pos - w_range.key_pos());
-        next_key.set_weight(w_range.weight());
-        next_keys.push_back(next_key);
-      }
-      w_range.set_key_pos(key_pos);
-      queue.push(w_range.range());
-      louds_.push_back(true);
+      louds_.push_back(false);
     }
-    louds_.push_back(false);
+    level_node_id += ranges.size();
+    ranges.swap(next_ranges);
   }
 
   louds_.push_back(false);
@@ -428,14 +578,15 @@ void LoudsTrie::build_current_trie(Vector<T> &keys, Vector<uint32_t> *terminals,
 
 template <>
 void LoudsTrie::build_next_trie(Vector<Key> &keys, Vector<uint32_t> *terminals,
-                                const Config &config, std::size_t trie_id) {
+                                const Config &config, std::size_t trie_id,
+                                std::size_t num_threads) {
   if (trie_id == config.num_tries()) {
     Vector<Entry> entries;
     entries.resize(keys.size());
     for (std::size_t i = 0; i < keys.size(); ++i) {
       entries[i].set_str(keys[i].ptr(), keys[i].length());
     }
-    tail_.build(entries, terminals, config.tail_mode());
+    tail_.build(entries, terminals, config.tail_mode(), num_threads);
     return;
   }
   Vector<ReverseKey> reverse_keys;
@@ -446,24 +597,26 @@ void LoudsTrie::build_next_trie(Vector<Key> &keys, Vector<uint32_t> *terminals,
   }
   keys.clear();
   next_trie_.reset(new LoudsTrie);
-  next_trie_->build_trie(reverse_keys, terminals, config, trie_id + 1);
+  next_trie_->build_trie(reverse_keys, terminals, config, trie_id + 1,
+                         num_threads);
 }
 
 template <>
 void LoudsTrie::build_next_trie(Vector<ReverseKey> &keys,
                                 Vector<uint32_t> *terminals,
-                                const Config &config, std::size_t trie_id) {
+                                const Config &config, std::size_t trie_id,
+                                std::size_t num_threads) {
   if (trie_id == config.num_tries()) {
     Vector<Entry> entries;
     entries.resize(keys.size());
     for (std::size_t i = 0; i < keys.size(); ++i) {
       entries[i].set_str(keys[i].ptr(), keys[i].length());
     }
-    tail_.build(entries, terminals, config.tail_mode());
+    tail_.build(entries, terminals, config.tail_mode(), num_threads);
     return;
   }
   next_trie_.reset(new LoudsTrie);
-  next_trie_->build_trie(keys, terminals, config, trie_id + 1);
+  next_trie_->build_trie(keys, terminals, config, trie_id + 1, num_threads);
 }
 
 template <typename T>
@@ -517,10 +670,7 @@ void LoudsTrie::fill_cache() {
   for (std::size_t i = 0; i < cache_.size(); ++i) {
     const std::size_t node_id = cache_[i].child();
     if (node_id != 0) {
-      cache_[i].set_base(bases_[node_id]);
-      cache_[i].set_extra(!link_flags_[node_id]
-                              ? MARISA_INVALID_EXTRA
-                              : extras_[link_flags_.rank1(node_id)]);
+      fill_cache(cache_[i], node_id);
     } else {
       cache_[i].set_parent(UINT32_MAX);
       cache_[i].set_child(UINT32_MAX);
@@ -528,6 +678,81 @@ void LoudsTrie::fill_cache() {
   }
 }
 
+void LoudsTrie::fill_cache(Cache &entry, std::size_t node_id) const {
+  entry.set_base(bases_[node_id]);
+  entry.set_extra(!link_flags_[node_id] ? MARISA_INVALID_EXTRA
+                                        : extras_[link_flags_.rank1(node_id)]);
+}
+
+// Calls callback(parent, child, label, weight, hit) for each transition that
+// predictive_search() takes in the first trie for each query, where label is
+// the query byte it was looked up by and hit tells whether the cache held it.
+template <typename Callback>
+void LoudsTrie::replay(const Keyset &queries, Callback callback) const {
+  Agent agent;
+  agent.init_state();
+  State &state = agent.state();
+  for (std::size_t i = 0; i < queries.size(); ++i) {
+    const marisa::Key &query = queries[i];
+    agent.set_query(query.ptr(), query.length());
+    state.predictive_search_init();
+    while (state.query_pos() < query.length()) {
+      const std::size_t parent = state.node_id();
+      const char label = query[state.query_pos()];
+      const bool hit = cache_[get_cache_id(parent, label)].parent() == parent;
+      if (!predictive_find_child(agent)) {
+        break;
+      }
+      callback(parent, state.node_id(), label, query.weight(), hit);
+    }
+  }
+}
+
+// The static cache keeps, for each slot, the transition to the heaviest
+// subtree, which is not what users type most. Each logged query is replayed
+// with its weight, and a slot is taken over by the transition with the most
+// traffic among those mapped to it. Slots that no logged query reaches keep
+// their static entries. Only the first trie is tuned: its transitions are
+// the ones find_child() takes on every keystroke.
+void LoudsTrie::tune_cache(const Keyset &query_log) {
+  // A node has one parent, so traffic and labels are indexed by child.
+  std::vector<double> traffic(bases_.size(), 0.0);
+  std::vector<char> labels(bases_.size(), '\0');
+  replay(query_log, [&](std::size_t, std::size_t child, char label,
+                        float weight, bool) {
+    traffic[child] += weight;
+    labels[child] = label;
+  });
+
+  std::vector<double> slot_traffic(cache_.size(), 0.0);
+  for (std::size_t child = 1; child < traffic.size(); ++child) {
+    if (traffic[child] <= 0.0) {
+      continue;
+    }
+    const std::size_t parent = louds_.select1(child) - child - 1;
+    const std::size_t cache_id = get_cache_id(parent, labels[child]);
+    if (traffic[child] > slot_traffic[cache_id]) {
+      slot_traffic[cache_id] = traffic[child];
+      cache_[cache_id].set_parent(parent);
+      cache_[cache_id].set_child(child);
+      fill_cache(cache_[cache_id], child);
+    }
+  }
+}
+
+void LoudsTrie::count_cache_hits(const Keyset &queries, double *num_hits,
+                                 double *num_misses) const {
+  MARISA_THROW_IF((num_hits == nullptr) || (num_misses == nullptr),
+                  std::invalid_argument);
+  double hits = 0.0;
+  double misses = 0.0;
+  replay(queries, [&](std::size_t, std::size_t, char, float weight, bool hit) {
+    (hit ? hits : misses) += weight;
+  });
+  *num_hits = hits;
+  *num_misses = misses;
+}
+
 void LoudsTrie::map_(Mapper &mapper) {
   louds_.map(mapper);
   terminal_flags_.map(mapper);
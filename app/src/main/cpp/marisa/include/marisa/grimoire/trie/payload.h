@@ -0,0 +1,88 @@
+#ifndef MARISA_GRIMOIRE_TRIE_PAYLOAD_H_
+#define MARISA_GRIMOIRE_TRIE_PAYLOAD_H_
+
+#include <cassert>
+#include <memory>
+
+#include "marisa/grimoire/io.h"
+#include "marisa/grimoire/vector.h"
+
+namespace marisa::grimoire::trie {
+
+class Payload {
+ public:
+  enum {
+    HEADER_SIZE = 16,
+    MAX_NUM_COLUMNS = 256,
+    MAX_NUM_LEVELS = 1 << 16
+  };
+
+  Payload();
+  ~Payload();
+
+  Payload(const Payload &) = delete;
+  Payload &operator=(const Payload &) = delete;
+
+  void build(std::size_t num_keys, std::size_t num_columns,
+             const uint32_t *values, const float *scores,
+             std::size_t num_levels);
+
+  void map(Mapper &mapper);
+  void read(Reader &reader);
+  void write(Writer &writer) const;
+
+  uint32_t value(std::size_t key_id, std::size_t column) const {
+    assert(column < num_columns_);
+    return columns_[column][key_id];
+  }
+  uint32_t score_code(std::size_t key_id) const {
+    assert(has_scores());
+    return codes_[key_id];
+  }
+  float score(std::size_t key_id) const {
+    return codebook_[score_code(key_id)];
+  }
+
+  std::size_t num_keys() const {
+    return num_keys_;
+  }
+  std::size_t num_columns() const {
+    return num_columns_;
+  }
+  std::size_t num_levels() const {
+    return codebook_.size();
+  }
+  bool has_scores() const {
+    return !codebook_.empty();
+  }
+
+  bool empty() const {
+    return num_keys_ == 0;
+  }
+  std::size_t size() const {
+    return num_keys_;
+  }
+  std::size_t total_size() const;
+  std::size_t io_size() const;
+
+  void clear() noexcept;
+  void swap(Payload &rhs) noexcept;
+
+ private:
+  std::unique_ptr<FlatVector[]> columns_;
+  FlatVector codes_;
+  Vector<float> codebook_;
+  std::size_t num_keys_ = 0;
+  std::size_t num_columns_ = 0;
+  Mapper mapper_;
+
+  void build_scores(const float *scores, std::size_t num_levels);
+
+  void map_(Mapper &mapper);
+  void read_(Reader &reader);
+  void write_(Writer &writer) const;
+};
+
+}  // namespace marisa::grimoire::trie
+
+#endif  // MARISA_GRIMOIRE_TRIE_PAYLOAD_H_
@@ -16,7 +16,8 @@ class Tail {
   Tail(const Tail &) = delete;
   Tail &operator=(const Tail &) = delete;
 
-  void build(Vector<Entry> &entries, Vector<uint32_t> *offsets, TailMode mode);
+  void build(Vector<Entry> &entries, Vector<uint32_t> *offsets, TailMode mode,
+             std::size_t num_threads = 1);
 
   void map(Mapper &mapper);
   void read(Reader &reader);
@@ -55,7 +56,8 @@ class Tail {
   Vector<char> buf_;
   BitVector end_flags_;
 
-  void build_(Vector<Entry> &entries, Vector<uint32_t> *offsets, TailMode mode);
+  void build_(Vector<Entry> &entries, Vector<uint32_t> *offsets, TailMode mode,
+              std::size_t num_threads);
 
   void map_(Mapper &mapper);
   void read_(Reader &reader);
@@ -0,0 +1,76 @@
+#ifndef MARISA_PAYLOAD_H_
+#define MARISA_PAYLOAD_H_
+
+#include <memory>
+
+#include "marisa/base.h"
+
+namespace marisa {
+namespace grimoire::trie {
+
+class Payload;
+
+}  // namespace grimoire::trie
+
+// Payload keeps per-key values next to a Trie, indexed by key ID, so that a
+// candidate is ranked with one array read instead of a second lookup.
+// Integer columns are bit-packed to the width of their largest value, and
+// the optional score column is quantized to a codebook of num_levels means.
+//
+// A payload is saved to its own file, or written right after a trie to the
+// same file and opened from offset trie.io_size(). Loading a trie ignores
+// the bytes after it, so tries with a payload still open without one.
+class Payload {
+ public:
+  Payload();
+  ~Payload();
+
+  Payload(const Payload &) = delete;
+  Payload &operator=(const Payload &) = delete;
+
+  Payload(Payload &&) noexcept;
+  Payload &operator=(Payload &&) noexcept;
+
+  // values holds num_keys rows of num_columns integers, and scores holds
+  // num_keys scores or is nullptr. Row i belongs to the key whose ID is i.
+  void build(std::size_t num_keys, std::size_t num_columns,
+             const uint32_t *values, const float *scores = nullptr,
+             std::size_t num_levels = 256);
+
+  void mmap(const char *filename, int flags = 0, std::size_t offset = 0);
+  void map(const void *ptr, std::size_t size);
+
+  void load(const char *filename, std::size_t offset = 0);
+  void read(int fd);
+
+  void save(const char *filename) const;
+  void write(int fd) const;
+
+  uint32_t value(std::size_t key_id, std::size_t column) const;
+  // Codes are in the same order as the scores, so candidates can be
+  // compared by code without looking up the codebook.
+  uint32_t score_code(std::size_t key_id) const;
+  float score(std::size_t key_id) const;
+
+  std::size_t num_keys() const;
+  std::size_t num_columns() const;
+  // The codebook is padded to a power of two, so num_levels() may be more
+  // than the number of levels used.
+  std::size_t num_levels() const;
+  bool has_scores() const;
+
+  bool empty() const;
+  std::size_t size() const;
+  std::size_t total_size() const;
+  std::size_t io_size() const;
+
+  void clear() noexcept;
+  void swap(Payload &rhs) noexcept;
+
+ private:
+  std::unique_ptr<grimoire::trie::Payload> payload_;
+};
+
+}  // namespace marisa
+
+#endif  // MARISA_PAYLOAD_H_
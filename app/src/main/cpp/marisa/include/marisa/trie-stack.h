@@ -0,0 +1,143 @@
+#ifndef MARISA_TRIE_STACK_H_
+#define MARISA_TRIE_STACK_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "marisa/payload.h"
+#include "marisa/trie.h"
+
+namespace marisa {
+
+// TrieLevel is one immutable level of a TrieStack: a trie, and per key a
+// weight and whether the key is a tombstone, which deletes the same key from
+// the levels below. The file is the trie followed by a payload whose score
+// column holds the weights and whose first column holds the tombstone flags.
+// A plain trie file is a level with zero weights and no tombstones.
+class TrieLevel {
+ public:
+  TrieLevel();
+  ~TrieLevel();
+
+  TrieLevel(const TrieLevel &) = delete;
+  TrieLevel &operator=(const TrieLevel &) = delete;
+
+  TrieLevel(TrieLevel &&) noexcept;
+  TrieLevel &operator=(TrieLevel &&) noexcept;
+
+  // keyset holds the keys of the level with their weights, and tombstones
+  // the keys that the level deletes. A key found in both is kept. The
+  // weights of both keysets are overwritten with key IDs, as Trie::build()
+  // does.
+  void build(Keyset &keyset, Keyset *tombstones = nullptr,
+             int config_flags = 0);
+
+  void mmap(const char *filename, int flags = 0);
+  void load(const char *filename);
+  void save(const char *filename) const;
+
+  // Looks up the query of agent. Returns false if the level has no such
+  // key, and otherwise sets agent.key() and tells whether it is a tombstone.
+  bool lookup(Agent &agent, bool *tombstone = nullptr) const;
+
+  float weight(std::size_t key_id) const;
+  bool is_tombstone(std::size_t key_id) const;
+
+  const Trie &trie() const {
+    return trie_;
+  }
+  std::size_t num_keys() const {
+    return trie_.num_keys();
+  }
+
+  void clear() noexcept;
+  void swap(TrieLevel &rhs) noexcept;
+
+ private:
+  Trie trie_;
+  Payload payload_;
+  bool has_payload_ = false;
+
+  void load_payload(const char *filename, bool mapped, int flags);
+};
+
+// TrieStack answers queries over a base level and smaller delta levels
+// pushed on top of it, like the levels of an LSM tree. A key is taken from
+// the topmost level that holds it, so deltas add keys, change weights and
+// delete keys with tombstones without rebuilding the base. compact() merges
+// a run of levels into one.
+//
+// Levels are shared and never modified. Searches work on a snapshot of the
+// level list, so push() and compact() may run on other threads meanwhile.
+class TrieStack {
+ public:
+  using Level = std::shared_ptr<const TrieLevel>;
+
+  struct Result {
+    std::string key;
+    float weight;
+  };
+
+  TrieStack();
+  ~TrieStack();
+
+  TrieStack(const TrieStack &) = delete;
+  TrieStack &operator=(const TrieStack &) = delete;
+
+  // Puts level on top of the stack.
+  void push(Level level);
+
+  // Levels from the bottom up.
+  std::vector<Level> levels() const;
+  std::size_t num_levels() const;
+  bool empty() const {
+    return num_levels() == 0;
+  }
+
+  // Returns 1 if the topmost level holding key keeps it, -1 if it is a
+  // tombstone and 0 if no level holds key. The weight of a kept key is
+  // stored to weight.
+  int find(std::string_view key, float *weight = nullptr) const;
+  bool lookup(std::string_view key, float *weight = nullptr) const {
+    return find(key, weight) > 0;
+  }
+
+  // Finds keys starting with prefix, each once with the weight of its
+  // topmost level and without the deleted ones, and stores the heaviest
+  // max_results of them to results, heaviest first. Ties keep the order of
+  // the levels, from the top, and then of the trie. Each level contributes
+  // at most scan_limit matches (8 * max_results if 0), so the order is
+  // exact for levels with fewer matches and approximate for larger ones.
+  std::size_t predictive_search(std::string_view prefix,
+                                std::size_t max_results,
+                                std::vector<Result> *results,
+                                std::size_t scan_limit = 0) const;
+
+  // Merges levels [first, num_levels()) of the current stack into one
+  // level. Levels pushed while it is being built stay on top of it.
+  // Tombstones are kept for the levels below, or for a dictionary that the
+  // caller keeps outside the stack, unless drop_tombstones is true. Only the
+  // merged levels are read, so compacting deltas costs O(delta). Runs one at
+  // a time, and is meant for a background thread.
+  void compact(std::size_t first = 0, bool drop_tombstones = false,
+               int config_flags = 0);
+
+  void clear();
+
+ private:
+  using Levels = std::vector<Level>;
+
+  std::shared_ptr<const Levels> levels_;
+  mutable std::mutex levels_mutex_;
+  std::mutex compact_mutex_;
+
+  std::shared_ptr<const Levels> snapshot() const;
+};
+
+}  // namespace marisa
+
+#endif  // MARISA_TRIE_STACK_H_
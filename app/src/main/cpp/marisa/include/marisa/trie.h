@@ -26,7 +26,15 @@ class Trie {
   Trie(Trie &&) noexcept;
   Trie &operator=(Trie &&) noexcept;
 
-  void build(Keyset &keyset, int config_flags = 0);
+  // Given num_threads > 1, sorting and splitting keys run on up to
+  // num_threads threads. The trie is the same as with one thread.
+  void build(Keyset &keyset, int config_flags = 0, std::size_t num_threads = 1);
+  // Builds the same trie, but fills the cache with the transitions that the
+  // prefixes in query_log take most often, each counted weight() times,
+  // instead of those leading to the heaviest subtrees. Key IDs do not
+  // change, so payloads built for the trie stay valid.
+  void build(Keyset &keyset, const Keyset &query_log, int config_flags = 0,
+             std::size_t num_threads = 1);
 
   void mmap(const char *filename, int flags = 0);
   void map(const void *ptr, std::size_t size);
@@ -38,9 +46,35 @@ class Trie {
   void write(int fd) const;
 
   bool lookup(Agent &agent) const;
+  // Looks up keys[0..num_keys) at once and stores their IDs, or
+  // MARISA_INVALID_KEY_ID for the missing ones, to key_ids. Returns the
+  // number of keys found.
+  std::size_t lookup_batch(const std::string_view *keys, std::size_t num_keys,
+                           std::size_t *key_ids) const;
   void reverse_lookup(Agent &agent) const;
   bool common_prefix_search(Agent &agent) const;
   bool predictive_search(Agent &agent) const;
+  // Calls callback(key) for each key starting with the query of agent until
+  // it returns false, and returns the number of calls. key is only valid
+  // during the call. Given an agent that was used before, no memory is
+  // allocated.
+  template <typename Callback>
+  std::size_t predictive_search(Agent &agent, Callback callback) const {
+    std::size_t count = 0;
+    while (predictive_search(agent)) {
+      ++count;
+      if (!callback(agent.key())) {
+        break;
+      }
+    }
+    return count;
+  }
+
+  // Replays queries as prefix searches and adds up, by weight, the
+  // transitions of the first trie that are served by the cache and the ones
+  // that have to scan the children.
+  void count_cache_hits(const Keyset &queries, double *num_hits,
+                        double *num_misses) const;
 
   std::size_t num_tries() const;
   std::size_t num_keys() const;
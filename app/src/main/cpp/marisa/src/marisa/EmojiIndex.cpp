@@ -0,0 +1,259 @@
+#include "marisa/EmojiIndex.h"
+#include "marisa/agent.h"
+#include "marisa/keyset.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace marisa {
+
+    namespace {
+
+        // Payload中名次所在的列
+        const size_t RANK_COLUMN = 0;
+
+        // 关键词和表情之间的分隔符，不会出现在关键词中
+        const char SEPARATOR = '\0';
+
+        // 词的边界，其后开始的后缀也作为关键词，输入"eyes"能找到"heart-eyes"
+        bool isWordBoundary(char c) {
+            return std::strchr(" -:_(", c) != nullptr;
+        }
+
+        char32_t toLower(char32_t c) {
+            if (c < 0x80) {
+                return (c >= 'A' && c <= 'Z') ? c + 0x20 : c;
+            }
+            if (c >= 0xC0 && c <= 0xDE && c != 0xD7) return c + 0x20;   // Latin-1
+            if (c == 0x130) return 'i';                                  // İ
+            if ((c >= 0x100 && c <= 0x137) || (c >= 0x14A && c <= 0x177)) {
+                return c | 1;                                            // 拉丁扩展A，偶数大写
+            }
+            if ((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17E)) {
+                return (c & 1) ? c + 1 : c;                              // 拉丁扩展A，奇数大写
+            }
+            if (c == 0x178) return 0xFF;                                 // Ÿ
+            if (c >= 0x400 && c <= 0x40F) return c + 0x50;               // Ѐ-Џ
+            if (c >= 0x410 && c <= 0x42F) return c + 0x20;               // А-Я
+            if ((c >= 0x460 && c <= 0x481) || (c >= 0x48A && c <= 0x4BF) ||
+                (c >= 0x4D0 && c <= 0x4FF)) {
+                return c | 1;                                            // Ғ Қ Ң Ү Ұ Һ Ә Ө等
+            }
+            if (c == 0x4C0) return 0x4CF;                                // Ӏ
+            if (c >= 0x4C1 && c <= 0x4CE) return (c & 1) ? c + 1 : c;
+            return c;
+        }
+
+        void appendUtf8(char32_t c, std::string& out) {
+            if (c < 0x80) {
+                out.push_back(static_cast<char>(c));
+            } else if (c < 0x800) {
+                out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+                out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+            } else {
+                out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+                out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+            }
+        }
+
+        std::string_view trim(std::string_view text) {
+            size_t begin = text.find_first_not_of(" \t\r\n");
+            if (begin == std::string_view::npos) {
+                return {};
+            }
+            size_t end = text.find_last_not_of(" \t\r\n");
+            return text.substr(begin, end - begin + 1);
+        }
+
+    } // namespace
+
+    EmojiIndex::EmojiIndex() = default;
+
+    EmojiIndex::~EmojiIndex() = default;
+
+    std::string EmojiIndex::foldCase(std::string_view text) {
+        std::string result;
+        result.reserve(text.size());
+        for (size_t i = 0; i < text.size(); ) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            // 只有两字节的字符（U+0080到U+07FF）需要解码，其他字节原样复制
+            if (c < 0x80) {
+                result.push_back(static_cast<char>(toLower(c)));
+                i++;
+            } else if ((c & 0xE0) == 0xC0 && i + 1 < text.size() &&
+                       (static_cast<unsigned char>(text[i + 1]) & 0xC0) == 0x80) {
+                char32_t code = ((c & 0x1F) << 6) | (static_cast<unsigned char>(text[i + 1]) & 0x3F);
+                appendUtf8(toLower(code), result);
+                i += 2;
+            } else {
+                result.push_back(text[i]);
+                i++;
+            }
+        }
+        return result;
+    }
+
+    void EmojiIndex::build(const std::vector<Entry>& entries, const char* filename,
+                           int configFlags) {
+        MARISA_THROW_IF(filename == nullptr, std::invalid_argument);
+
+        // 表情的名次取第一次出现的位置
+        std::unordered_map<std::string, uint32_t> ranks;
+        std::unordered_set<std::string> keySet;
+        std::vector<std::string> keys;
+        std::vector<uint32_t> keyRanks;
+
+        auto addKey = [&](std::string_view term, const std::string& emoji, uint32_t rank) {
+            std::string key(term);
+            key.push_back(SEPARATOR);
+            key.append(emoji);
+            if (keySet.insert(key).second) {
+                keys.push_back(std::move(key));
+                keyRanks.push_back(rank);
+            }
+        };
+
+        for (const Entry& entry : entries) {
+            std::string emoji(trim(entry.emoji));
+            if (emoji.empty() || emoji.find(SEPARATOR) != std::string::npos) {
+                throw std::invalid_argument("invalid emoji: " + entry.emoji);
+            }
+            uint32_t rank = ranks.emplace(emoji, static_cast<uint32_t>(ranks.size())).first->second;
+
+            // 表情本身也能搜索
+            addKey(emoji, emoji, rank);
+            for (const std::string& keyword : entry.keywords) {
+                std::string term = foldCase(trim(keyword));
+                if (term.empty() || term.find(SEPARATOR) != std::string::npos) continue;
+                addKey(term, emoji, rank);
+                for (size_t i = 1; i < term.size(); i++) {
+                    if (isWordBoundary(term[i - 1]) && !isWordBoundary(term[i])) {
+                        addKey(std::string_view(term).substr(i), emoji, rank);
+                    }
+                }
+            }
+        }
+
+        Keyset keyset;
+        for (const std::string& key : keys) {
+            keyset.push_back(key);
+        }
+        Trie trie;
+        trie.build(keyset, configFlags);
+
+        std::vector<uint32_t> values(trie.num_keys());
+        for (size_t i = 0; i < keys.size(); i++) {
+            values[keyset[i].id()] = keyRanks[i];
+        }
+        Payload payload;
+        payload.build(trie.num_keys(), 1, values.data());
+
+        const int fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        MARISA_THROW_SYSTEM_ERROR_IF(fd == -1, errno, std::generic_category(), "open");
+        try {
+            trie.write(fd);
+            payload.write(fd);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+    }
+
+    bool EmojiIndex::loadFromFile(const char* filename) {
+        Trie trie;
+        Payload payload;
+        try {
+            trie.mmap(filename);
+            payload.mmap(filename, 0, trie.io_size());
+        } catch (const std::exception&) {
+            return false;
+        }
+        if (payload.num_keys() != trie.num_keys() || payload.num_columns() <= RANK_COLUMN) {
+            return false;
+        }
+
+        clear();
+        trie_.swap(trie);
+        payload_.swap(payload);
+        loaded_ = true;
+
+        for (size_t i = 0; i < payload_.num_keys(); i++) {
+            numEmojis_ = std::max<size_t>(numEmojis_, payload_.value(i, RANK_COLUMN) + 1);
+        }
+        return true;
+    }
+
+    std::vector<std::string> EmojiIndex::search(std::string_view query, int maxResults) const {
+        std::vector<std::string> results;
+        // 关键词都从词首开始，开头的空白不参与匹配
+        size_t begin = query.find_first_not_of(" \t");
+        std::string folded = foldCase(begin == std::string_view::npos ? std::string_view()
+                                                                      : query.substr(begin));
+        if (!isLoaded() || folded.empty() || maxResults <= 0 ||
+            folded.find(SEPARATOR) != std::string::npos) {
+            return results;
+        }
+
+        // 同一个表情可能由多个关键词匹配，按名次去重
+        std::vector<bool> seen(numEmojis_, false);
+        std::vector<std::pair<uint32_t, std::string>> matches;
+        Agent agent;
+        agent.set_query(folded);
+        trie_.predictive_search(agent, [&](const Key& key) {
+            uint32_t rank = payload_.value(key.id(), RANK_COLUMN);
+            if (!seen[rank]) {
+                seen[rank] = true;
+                std::string_view str = key.str();
+                matches.emplace_back(rank, std::string(str.substr(str.find(SEPARATOR) + 1)));
+            }
+            return true;
+        });
+
+        size_t count = std::min(matches.size(), static_cast<size_t>(maxResults));
+        std::partial_sort(matches.begin(), matches.begin() + count, matches.end());
+        results.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            results.push_back(std::move(matches[i].second));
+        }
+        return results;
+    }
+
+    size_t EmojiIndex::numKeys() const {
+        return isLoaded() ? trie_.num_keys() : 0;
+    }
+
+    std::string EmojiIndex::getInfo() const {
+        std::string info = "=== Emoji Index Info ===\n";
+        if (!isLoaded()) {
+            info += "Status: Not loaded\n";
+            return info;
+        }
+        info += "Emojis: " + std::to_string(numEmojis_) + "\n";
+        info += "Keywords: " + std::to_string(trie_.num_keys()) + "\n";
+        info += "Size: " + std::to_string(trie_.io_size() + payload_.io_size()) + " bytes\n";
+        return info;
+    }
+
+    bool EmojiIndex::isLoaded() const {
+        return loaded_;
+    }
+
+    void EmojiIndex::clear() {
+        trie_.clear();
+        payload_.clear();
+        loaded_ = false;
+        numEmojis_ = 0;
+    }
+
+} // namespace marisa
@@ -0,0 +1,207 @@
+#include "marisa/KazakhAlphabet.h"
+#include "marisa/agent.h"
+#include <cstdint>
+
+namespace marisa {
+
+    namespace {
+
+        // 哈萨克文字母表顺序的42个小写字母，大写字母在同一位置
+        const char32_t LOWER_LETTERS[] = {
+                0x0430, 0x04D9, 0x0431, 0x0432, 0x0433, 0x0493, 0x0434, // а ә б в г ғ д
+                0x0435, 0x0451, 0x0436, 0x0437, 0x0438, 0x0439, 0x043A, // е ё ж з и й к
+                0x049B, 0x043B, 0x043C, 0x043D, 0x04A3, 0x043E, 0x04E9, // қ л м н ң о ө
+                0x043F, 0x0440, 0x0441, 0x0442, 0x0443, 0x04B1, 0x04AF, // п р с т у ұ ү
+                0x0444, 0x0445, 0x04BB, 0x0446, 0x0447, 0x0448, 0x0449, // ф х һ ц ч ш щ
+                0x044A, 0x044B, 0x0456, 0x044C, 0x044D, 0x044E, 0x044F, // ъ ы і ь э ю я
+        };
+        const char32_t UPPER_LETTERS[] = {
+                0x0410, 0x04D8, 0x0411, 0x0412, 0x0413, 0x0492, 0x0414, // А Ә Б В Г Ғ Д
+                0x0415, 0x0401, 0x0416, 0x0417, 0x0418, 0x0419, 0x041A, // Е Ё Ж З И Й К
+                0x049A, 0x041B, 0x041C, 0x041D, 0x04A2, 0x041E, 0x04E8, // Қ Л М Н Ң О Ө
+                0x041F, 0x0420, 0x0421, 0x0422, 0x0423, 0x04B0, 0x04AE, // П Р С Т У Ұ Ү
+                0x0424, 0x0425, 0x04BA, 0x0426, 0x0427, 0x0428, 0x0429, // Ф Х Һ Ц Ч Ш Щ
+                0x042A, 0x042B, 0x0406, 0x042C, 0x042D, 0x042E, 0x042F, // Ъ Ы І Ь Э Ю Я
+        };
+        // 常用的非ASCII标点
+        const char32_t PUNCTUATION[] = {
+                0x00AB, 0x00BB, 0x2013, 0x2014, 0x201C, 0x201D, 0x2026, 0x2116, // « » – — “ ” … №
+        };
+
+        const size_t NUM_LETTERS = sizeof(LOWER_LETTERS) / sizeof(LOWER_LETTERS[0]);
+        const size_t NUM_PUNCTUATION = sizeof(PUNCTUATION) / sizeof(PUNCTUATION[0]);
+
+        // 编码字节：小写0x80起，大写0xB0起，标点0xE0起
+        const uint8_t LOWER_BASE = 0x80;
+        const uint8_t UPPER_BASE = 0xB0;
+        const uint8_t PUNCTUATION_BASE = 0xE0;
+        // 转义：ESCAPE_BYTE后是一个非法UTF-8字节，ESCAPE_CHAR后是一个完整的UTF-8字符
+        const uint8_t ESCAPE_BYTE = 0xFE;
+        const uint8_t ESCAPE_CHAR = 0xFF;
+
+        static_assert(LOWER_BASE + sizeof(LOWER_LETTERS) / sizeof(char32_t) <= UPPER_BASE,
+                      "lowercase letters overlap uppercase codes");
+        static_assert(UPPER_BASE + sizeof(UPPER_LETTERS) / sizeof(char32_t) <= PUNCTUATION_BASE,
+                      "uppercase letters overlap punctuation codes");
+        static_assert(PUNCTUATION_BASE + sizeof(PUNCTUATION) / sizeof(char32_t) <= ESCAPE_BYTE,
+                      "punctuation overlaps escape codes");
+
+        struct Tables {
+            uint8_t cyrillicCodes[0x100] = {};  // U+0400..U+04FF -> 编码，0表示没有
+            char32_t codePoints[0x100] = {};    // 编码 -> 字符，0表示不是单字节编码
+
+            Tables() {
+                for (size_t i = 0; i < NUM_LETTERS; i++) {
+                    add(LOWER_LETTERS[i], static_cast<uint8_t>(LOWER_BASE + i));
+                    add(UPPER_LETTERS[i], static_cast<uint8_t>(UPPER_BASE + i));
+                }
+                for (size_t i = 0; i < NUM_PUNCTUATION; i++) {
+                    codePoints[PUNCTUATION_BASE + i] = PUNCTUATION[i];
+                }
+            }
+
+            void add(char32_t code, uint8_t byte) {
+                cyrillicCodes[code - 0x0400] = byte;
+                codePoints[byte] = code;
+            }
+
+            uint8_t find(char32_t code) const {
+                if (code >= 0x0400 && code <= 0x04FF) {
+                    return cyrillicCodes[code - 0x0400];
+                }
+                for (size_t i = 0; i < NUM_PUNCTUATION; i++) {
+                    if (PUNCTUATION[i] == code) {
+                        return static_cast<uint8_t>(PUNCTUATION_BASE + i);
+                    }
+                }
+                return 0;
+            }
+        };
+
+        const Tables& tables() {
+            static const Tables instance;
+            return instance;
+        }
+
+        // 读取一个UTF-8字符，返回字节数，非法序列返回0。
+        // 超长编码也算非法，否则解码后会变成另一种字节序列
+        size_t readUtf8(std::string_view str, size_t pos, char32_t& code) {
+            static const char32_t MIN_CODES[] = {0, 0, 0x80, 0x800, 0x10000};
+            unsigned char c = static_cast<unsigned char>(str[pos]);
+            size_t length;
+            if ((c & 0xE0) == 0xC0) {
+                length = 2;
+                code = c & 0x1F;
+            } else if ((c & 0xF0) == 0xE0) {
+                length = 3;
+                code = c & 0x0F;
+            } else if ((c & 0xF8) == 0xF0) {
+                length = 4;
+                code = c & 0x07;
+            } else {
+                return 0;
+            }
+            if (pos + length > str.size()) {
+                return 0;
+            }
+            for (size_t i = 1; i < length; i++) {
+                unsigned char next = static_cast<unsigned char>(str[pos + i]);
+                if ((next & 0xC0) != 0x80) {
+                    return 0;
+                }
+                code = (code << 6) | (next & 0x3F);
+            }
+            return code >= MIN_CODES[length] ? length : 0;
+        }
+
+        void appendUtf8(char32_t code, std::string& out) {
+            if (code <= 0x7FF) {
+                out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+                out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            } else {
+                out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+                out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+        }
+
+    } // namespace
+
+    const std::string_view KazakhAlphabet::MARKER_KEY("\0kk-alphabet-1", 14);
+
+    void KazakhAlphabet::encode(std::string_view utf8, std::string& out) {
+        const Tables& t = tables();
+        size_t pos = 0;
+        while (pos < utf8.size()) {
+            unsigned char c = static_cast<unsigned char>(utf8[pos]);
+            if (c < 0x80) {
+                out.push_back(static_cast<char>(c));
+                pos++;
+                continue;
+            }
+
+            char32_t code = 0;
+            size_t length = readUtf8(utf8, pos, code);
+            if (length == 0) {
+                out.push_back(static_cast<char>(ESCAPE_BYTE));
+                out.push_back(static_cast<char>(c));
+                pos++;
+                continue;
+            }
+
+            uint8_t byte = t.find(code);
+            if (byte != 0) {
+                out.push_back(static_cast<char>(byte));
+            } else {
+                out.push_back(static_cast<char>(ESCAPE_CHAR));
+                out.append(utf8.data() + pos, length);
+            }
+            pos += length;
+        }
+    }
+
+    void KazakhAlphabet::decode(std::string_view encoded, std::string& out) {
+        const Tables& t = tables();
+        size_t pos = 0;
+        while (pos < encoded.size()) {
+            unsigned char c = static_cast<unsigned char>(encoded[pos++]);
+            if (c < 0x80) {
+                out.push_back(static_cast<char>(c));
+            } else if (c == ESCAPE_BYTE) {
+                if (pos < encoded.size()) out.push_back(encoded[pos++]);
+            } else if (c == ESCAPE_CHAR) {
+                char32_t code = 0;
+                size_t length = pos < encoded.size() ? readUtf8(encoded, pos, code) : 0;
+                if (length == 0) continue;
+                out.append(encoded.data() + pos, length);
+                pos += length;
+            } else if (t.codePoints[c] != 0) {
+                appendUtf8(t.codePoints[c], out);
+            }
+        }
+    }
+
+    bool KazakhAlphabet::isEncoded(const Trie& trie) {
+        Agent agent;
+        agent.set_query(MARKER_KEY);
+        return trie.lookup(agent);
+    }
+
+    void KazakhAlphabet::buildTrie(Keyset& utf8Keys, Trie& trie, int configFlags) {
+        Keyset encodedKeys;
+        std::string buf;
+        for (size_t i = 0; i < utf8Keys.size(); i++) {
+            buf.clear();
+            encode(utf8Keys[i].str(), buf);
+            encodedKeys.push_back(buf, utf8Keys[i].weight());
+        }
+        encodedKeys.push_back(MARKER_KEY);
+
+        trie.build(encodedKeys, configFlags);
+
+        for (size_t i = 0; i < utf8Keys.size(); i++) {
+            utf8Keys[i].set_id(encodedKeys[i].id());
+        }
+    }
+
+} // namespace marisa
@@ -1,7 +1,11 @@
 #include "marisa/KazakhContextPredictor.h"
 #include "marisa/trie.h"
 #include "marisa/agent.h"
+#include "marisa/agent-pool.h"
 #include "marisa/iostream.h"
+#include "marisa/payload.h"
+#include "marisa/KazakhAlphabet.h"
+#include "marisa/trie-stack.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -170,6 +174,28 @@ namespace marisa {
             return true;
         }
 
+        // 同get，但value的元素依次赋给out中已有的元素，不够时才追加，返回元素数。
+        // out原有元素的容量留着再用，命中时不分配堆内存
+        bool getInto(const K& key, V& out, size_t& count) {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            auto it = cacheMap.find(key);
+            if (it == cacheMap.end()) {
+                return false;
+            }
+
+            Node* node = it->second;
+            count = node->value.size();
+            for (size_t i = 0; i < count; i++) {
+                if (i < out.size()) {
+                    out[i] = node->value[i];
+                } else {
+                    out.push_back(node->value[i]);
+                }
+            }
+            moveToHead(node);
+            return true;
+        }
+
         void put(const K& key, const V& value) {
             std::lock_guard<std::mutex> lock(cacheMutex);
 
@@ -203,41 +229,125 @@ namespace marisa {
     class BatchTrieLookup {
     private:
         Trie* trie;
+        const Payload* payload = nullptr;
         std::unique_ptr<Agent> agent;
         std::mutex lookupMutex;
 
+        // Trie的键是否用KazakhAlphabet编码；编码时查询先编码，结果再解码
+        bool encoded;
+        std::string encodedQuery;
+
+        // 有评分时，前缀搜索最多扫描 maxResults 的这么多倍再排序
+        static constexpr int RANK_SCAN_FACTOR = 8;
+
     public:
-        BatchTrieLookup(Trie* t) : trie(t), agent(std::make_unique<Agent>()) {}
+        BatchTrieLookup(Trie* t)
+                : trie(t), agent(std::make_unique<Agent>()), encoded(KazakhAlphabet::isEncoded(*t)) {}
+
+        bool isEncoded() const {
+            return encoded;
+        }
+
+        // 设置按键ID索引的评分，nullptr表示按Trie顺序返回
+        void setPayload(const Payload* p) {
+            std::lock_guard<std::mutex> lock(lookupMutex);
+            payload = p;
+        }
 
         bool exactMatch(const std::string_view& word) {
             std::lock_guard<std::mutex> lock(lookupMutex);
-            agent->set_query(word.data(), word.length());
+            setQuery(word);
             return trie->lookup(*agent);
         }
 
+        // 批量精确匹配，keyIds中未找到的词为MARISA_INVALID_KEY_ID。
+        // 编码用的缓冲区每个线程一份，字符串清空后保留容量，批量变大时才分配
+        size_t exactMatchBatch(const std::string_view* words, size_t count, size_t* keyIds) const {
+            if (!encoded) {
+                return trie->lookup_batch(words, count, keyIds);
+            }
+
+            thread_local std::vector<std::string> encodedWords;
+            thread_local std::vector<std::string_view> queries;
+            if (encodedWords.size() < count) {
+                encodedWords.resize(count);
+            }
+            queries.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                encodedWords[i].clear();
+                KazakhAlphabet::encode(words[i], encodedWords[i]);
+                queries[i] = encodedWords[i];
+            }
+            return trie->lookup_batch(queries.data(), count, keyIds);
+        }
+
         std::vector<std::string> prefixSearch(const std::string_view& prefix, int maxResults) {
             std::lock_guard<std::mutex> lock(lookupMutex);
             std::vector<std::string> results;
 
-            if (!trie || trie->empty() || prefix.empty()) {
+            if (!trie || trie->empty() || prefix.empty() || maxResults <= 0) {
                 return results;
             }
 
-            agent->set_query(prefix.data(), prefix.length());
+            setQuery(prefix);
+            const size_t queryLength = agent->query().length();
 
-            int count = 0;
-            while (trie->predictive_search(*agent)) {
-                const Key& key = agent->key();
-                std::string word(key.ptr(), key.length());
+            if (payload == nullptr) {
+                // 与前缀相同的键长度等于前缀，其余直接从Trie的键构造结果
+                size_t limit = static_cast<size_t>(maxResults);
+                results.reserve(limit);
+                trie->predictive_search(*agent, [&](const Key& key) {
+                    if (key.length() != queryLength) {
+                        appendKey(key.str(), results.emplace_back());
+                    }
+                    return results.size() < limit;
+                });
+                return results;
+            }
 
-                if (word != prefix) {
-                    results.push_back(word);
-                    if (++count >= maxResults) break;
+            // 按评分排序：每个候选只读一次评分码，码的大小顺序即评分顺序
+            std::vector<std::pair<uint32_t, std::string>> scored;
+            const size_t scanLimit = static_cast<size_t>(maxResults) * RANK_SCAN_FACTOR;
+            scored.reserve(scanLimit);
+            trie->predictive_search(*agent, [&](const Key& key) {
+                if (key.length() != queryLength) {
+                    auto& entry = scored.emplace_back(payload->score_code(key.id()), std::string());
+                    appendKey(key.str(), entry.second);
                 }
-            }
+                return scored.size() < scanLimit;
+            });
 
+            // 稳定排序：评分相同的词保持Trie顺序
+            size_t topCount = std::min(static_cast<size_t>(maxResults), scored.size());
+            std::stable_sort(scored.begin(), scored.end(),
+                             [](const auto& a, const auto& b) { return a.first > b.first; });
+
+            results.reserve(topCount);
+            for (size_t i = 0; i < topCount; i++) {
+                results.push_back(std::move(scored[i].second));
+            }
             return results;
         }
+
+    private:
+        // 调用方持有lookupMutex；编码后的查询在encodedQuery中，Agent只保存视图
+        void setQuery(std::string_view query) {
+            if (!encoded) {
+                agent->set_query(query);
+                return;
+            }
+            encodedQuery.clear();
+            KazakhAlphabet::encode(query, encodedQuery);
+            agent->set_query(encodedQuery);
+        }
+
+        void appendKey(std::string_view key, std::string& out) const {
+            if (encoded) {
+                KazakhAlphabet::decode(key, out);
+            } else {
+                out.append(key);
+            }
+        }
     };
 
     class KazakhContextPredictor::Impl {
@@ -245,6 +355,12 @@ namespace marisa {
         // UTF-32缓存
         LRUCache<std::string, std::vector<char32_t>> utf32Cache{5000};
 
+        // 叠加在unigram词典之上的增量层（UTF-8键），新词、改权重和删除（墓碑）
+        // 只需构建小的增量层。后台合并在线程池中运行，所以要在线程池之前声明，
+        // 析构时线程池先停止
+        TrieStack unigramDeltas;
+        static constexpr size_t MAX_UNIGRAM_DELTAS = 4;
+
         // 线程池
         std::unique_ptr<ThreadPool> threadPool;
 
@@ -252,6 +368,25 @@ namespace marisa {
         std::unique_ptr<BatchTrieLookup> unigramLookup;
         std::unique_ptr<BatchTrieLookup> bigramLookup;
 
+        // 上下文查询复用的Agent
+        AgentPool agentPool;
+
+        // 按键ID索引的unigram评分（附加在词典文件的Trie之后，可缺省）
+        Payload unigramPayload;
+        bool unigramPayloadLoaded = false;
+
+        // 拼写纠错候选：编辑距离相同时按评分码从高到低
+        struct ScoredCandidate {
+            std::string word;
+            int distance;
+            uint32_t scoreCode;
+        };
+
+        static bool compareScoredCandidates(const ScoredCandidate& a, const ScoredCandidate& b) {
+            if (a.distance != b.distance) return a.distance < b.distance;
+            return a.scoreCode > b.scoreCode;
+        }
+
         // 线程安全控制
         mutable std::mutex predictMutex;
         std::atomic<bool> cancelHeavyTask{false};
@@ -259,8 +394,14 @@ namespace marisa {
 
         // 布隆过滤器模拟（快速排除不在词典中的词）
         std::unordered_set<std::string> fastRejectSet;
+        std::mutex fastRejectMutex;
         const size_t MAX_FAST_REJECT_SIZE = 10000;
 
+        // batchExactMatch的查询缓冲区，由fastRejectMutex保护，跨调用复用
+        std::vector<std::string_view> batchQueries;
+        std::vector<size_t> batchQueryIndices;
+        std::vector<size_t> batchKeyIds;
+
         // 快速编辑距离计算（优化版）
         static int calculateEditDistanceSimple(const std::vector<char32_t>& s1,
                                                const std::vector<char32_t>& s2,
@@ -438,48 +579,63 @@ namespace marisa {
         }
 
         // 批量检查单词是否在词典中
-        std::vector<std::string> batchExactMatch(const std::vector<std::string>& candidates) {
+        std::vector<std::string> batchExactMatch(const std::vector<std::string>& candidates,
+                                                 std::vector<size_t>* validKeyIds = nullptr) {
             std::vector<std::string> validWords;
             validWords.reserve(candidates.size());
 
-            // 使用线程池并行检查
-            std::vector<std::future<bool>> futures;
-            std::mutex resultsMutex;
-
-            for (const auto& candidate : candidates) {
-                futures.push_back(std::async(std::launch::async, [this, &candidate, &validWords, &resultsMutex]() {
-                    // 快速拒绝：检查布隆过滤器
-                    if (fastRejectSet.find(candidate) != fastRejectSet.end()) {
-                        return false;
-                    }
-
-                    bool exists = unigramLookup->exactMatch(candidate);
-
-                    if (!exists) {
-                        // 添加到快速拒绝集
-                        std::lock_guard<std::mutex> lock(resultsMutex);
-                        if (fastRejectSet.size() < MAX_FAST_REJECT_SIZE) {
-                            fastRejectSet.insert(candidate);
-                        }
-                    }
+            // 快速拒绝：跳过已知不存在的词，其余一次批量查找
+            std::lock_guard<std::mutex> lock(fastRejectMutex);
+            std::vector<std::string_view>& queries = batchQueries;
+            std::vector<size_t>& queryIndices = batchQueryIndices;
+            queries.clear();
+            queryIndices.clear();
+            for (size_t i = 0; i < candidates.size(); i++) {
+                if (fastRejectSet.find(candidates[i]) == fastRejectSet.end()) {
+                    queries.push_back(candidates[i]);
+                    queryIndices.push_back(i);
+                }
+            }
 
-                    if (exists) {
-                        std::lock_guard<std::mutex> lock(resultsMutex);
-                        validWords.push_back(candidate);
+            std::vector<size_t>& keyIds = batchKeyIds;
+            keyIds.resize(queries.size());
+            unigramLookup->exactMatchBatch(queries.data(), queries.size(), keyIds.data());
+
+            // 增量层优先：被删除的词无效，只在增量层中的词没有键ID
+            if (!unigramDeltas.empty()) {
+                for (size_t i = 0; i < queries.size(); i++) {
+                    int found = unigramDeltas.find(queries[i]);
+                    if (found < 0) {
+                        keyIds[i] = MARISA_INVALID_KEY_ID;
+                    } else if (found > 0 && keyIds[i] == MARISA_INVALID_KEY_ID) {
+                        validWords.push_back(candidates[queryIndices[i]]);
+                        if (validKeyIds) validKeyIds->push_back(MARISA_INVALID_KEY_ID);
+                        queryIndices[i] = candidates.size();
                     }
-
-                    return exists;
-                }));
+                }
             }
 
-            // 等待所有任务完成
-            for (auto& future : futures) {
-                future.wait();
+            for (size_t i = 0; i < queries.size(); i++) {
+                if (queryIndices[i] == candidates.size()) continue;
+                const std::string& candidate = candidates[queryIndices[i]];
+                if (keyIds[i] != MARISA_INVALID_KEY_ID) {
+                    validWords.push_back(candidate);
+                    if (validKeyIds) validKeyIds->push_back(keyIds[i]);
+                } else if (fastRejectSet.size() < MAX_FAST_REJECT_SIZE) {
+                    // 添加到快速拒绝集
+                    fastRejectSet.insert(candidate);
+                }
             }
 
             return validWords;
         }
 
+        // 评分码，没有评分或只在增量层中的词是0
+        uint32_t getScoreCode(size_t keyId) const {
+            if (!unigramPayloadLoaded || keyId == MARISA_INVALID_KEY_ID) return 0;
+            return unigramPayload.score_code(keyId);
+        }
+
         // 标准化缓存键
         std::string makeCacheKey(const std::string& type, const std::string& key, int maxResults = 0) {
             if (maxResults > 0) {
@@ -496,6 +652,7 @@ namespace marisa {
         // 双字词典
         Trie bigramTrie;
         bool bigramLoaded = false;
+        bool bigramEncoded = false;
 
         // 结果缓存（不同大小）
         LRUCache<std::string, std::vector<std::string>> prefixCache{500};   // 前缀缓存
@@ -605,6 +762,7 @@ namespace marisa {
 
                 // 创建查找器
                 unigramLookup = std::make_unique<BatchTrieLookup>(&unigramTrie);
+                loadUnigramPayload(filename);
 
                 std::cout << "Unigram dictionary loaded successfully" << std::endl;
                 return true;
@@ -614,6 +772,27 @@ namespace marisa {
             }
         }
 
+        // 读取紧跟在Trie之后的评分，评分由tools/marisa-payload-build从词频表写入。
+        // 没有评分的词典（目前发布的unigram_kazakh.dic还没有词频数据）按Trie顺序排序
+        void loadUnigramPayload(const char* filename) {
+            unigramPayloadLoaded = false;
+            unigramPayload.clear();
+            try {
+                Payload payload;
+                payload.load(filename, unigramTrie.io_size());
+                if (payload.num_keys() != unigramTrie.num_keys() || !payload.has_scores()) {
+                    std::cerr << "Unigram payload does not match the dictionary, ignored" << std::endl;
+                    return;
+                }
+                unigramPayload.swap(payload);
+                unigramPayloadLoaded = true;
+                unigramLookup->setPayload(&unigramPayload);
+                std::cout << "Unigram payload loaded: " << unigramPayload.num_levels() << " levels" << std::endl;
+            } catch (const std::exception&) {
+                std::cout << "Unigram dictionary has no payload" << std::endl;
+            }
+        }
+
         // 从文件加载bigram词典
         bool loadBigramFromFile(const char* filename) {
             try {
@@ -629,6 +808,7 @@ namespace marisa {
 
                 // 创建查找器
                 bigramLookup = std::make_unique<BatchTrieLookup>(&bigramTrie);
+                bigramEncoded = bigramLookup->isEncoded();
 
                 std::cout << "Bigram dictionary loaded successfully" << std::endl;
                 return true;
@@ -660,7 +840,11 @@ namespace marisa {
             }
 
             try {
-                results = unigramLookup->prefixSearch(prefix, maxResults);
+                if (unigramDeltas.empty()) {
+                    results = unigramLookup->prefixSearch(prefix, maxResults);
+                } else {
+                    results = prefixSearchWithDeltas(prefix, maxResults);
+                }
 
                 // 缓存结果
                 prefixCache.put(cacheKey, results);
@@ -676,6 +860,50 @@ namespace marisa {
             return results;
         }
 
+        // 增量层和词典的词按权重合并，被增量层删除的词去掉。增量层里有的词用增量层的
+        // 权重；词典没有评分时词典的词权重为0，保持Trie顺序，权重相同时词典的词在前
+        std::vector<std::string> prefixSearchWithDeltas(const std::string& prefix, int maxResults) {
+            std::vector<std::string> results;
+            if (maxResults <= 0) {
+                return results;
+            }
+
+            std::vector<TrieStack::Result> merged;
+            std::unordered_set<std::string> seen;
+            // 多取一些，补上被删除的词
+            auto baseResults = unigramLookup->prefixSearch(prefix, maxResults * 2);
+            for (auto& word : baseResults) {
+                float weight = 0.0f;
+                int found = unigramDeltas.find(word, &weight);
+                if (found < 0 || !seen.insert(word).second) {
+                    continue;
+                }
+                if (found == 0) {
+                    weight = getBaseWordWeight(word);
+                }
+                merged.push_back({std::move(word), weight});
+            }
+
+            std::vector<TrieStack::Result> deltaResults;
+            unigramDeltas.predictive_search(prefix, static_cast<size_t>(maxResults) + 1, &deltaResults);
+            for (auto& result : deltaResults) {
+                if (result.key != prefix && seen.insert(result.key).second) {
+                    merged.push_back(std::move(result));
+                }
+            }
+
+            std::stable_sort(merged.begin(), merged.end(),
+                             [](const TrieStack::Result& a, const TrieStack::Result& b) {
+                                 return a.weight > b.weight;
+                             });
+            size_t count = std::min(merged.size(), static_cast<size_t>(maxResults));
+            results.reserve(count);
+            for (size_t i = 0; i < count; i++) {
+                results.push_back(std::move(merged[i].key));
+            }
+            return results;
+        }
+
         // Stage 2: 键盘邻近纠错（< 15ms）
         std::vector<std::string> keyboardNeighborCorrect(const std::string& input, int maxResults) {
             auto start = std::chrono::steady_clock::now();
@@ -770,19 +998,20 @@ namespace marisa {
             }
 
             // 批量检查哪些候选词在词典中
-            auto validCandidates = batchExactMatch(allCandidates);
+            std::vector<size_t> validKeyIds;
+            auto validCandidates = batchExactMatch(allCandidates, &validKeyIds);
 
             // 计算编辑距离并排序（使用部分排序）
-            std::vector<std::pair<std::string, int>> scoredCandidates;
+            std::vector<ScoredCandidate> scoredCandidates;
             scoredCandidates.reserve(validCandidates.size());
 
             auto inputUtf32 = utf32;
 
-            for (const auto& candidate : validCandidates) {
-                auto candUtf32 = getUtf32Cached(candidate);
+            for (size_t i = 0; i < validCandidates.size(); i++) {
+                auto candUtf32 = getUtf32Cached(validCandidates[i]);
                 int distance = calculateEditDistanceSimple(inputUtf32, candUtf32, 2);
                 if (distance <= 2) {
-                    scoredCandidates.emplace_back(candidate, distance);
+                    scoredCandidates.push_back({validCandidates[i], distance, getScoreCode(validKeyIds[i])});
                 }
             }
 
@@ -791,12 +1020,12 @@ namespace marisa {
                     scoredCandidates.begin(),
                     scoredCandidates.begin() + std::min(static_cast<size_t>(maxResults), scoredCandidates.size()),
                     scoredCandidates.end(),
-                    [](const auto& a, const auto& b) { return a.second < b.second; }
+                    compareScoredCandidates
             );
 
             // 提取结果
             for (size_t i = 0; i < std::min(static_cast<size_t>(maxResults), scoredCandidates.size()); i++) {
-                results.push_back(scoredCandidates[i].first);
+                results.push_back(scoredCandidates[i].word);
             }
 
             // 缓存结果
@@ -896,17 +1125,18 @@ namespace marisa {
             }
 
             // 批量检查候选词
-            auto validCandidates = batchExactMatch(allCandidates);
+            std::vector<size_t> validKeyIds;
+            auto validCandidates = batchExactMatch(allCandidates, &validKeyIds);
 
             // 计算编辑距离并排序
-            std::vector<std::pair<std::string, int>> scoredCandidates;
+            std::vector<ScoredCandidate> scoredCandidates;
             scoredCandidates.reserve(validCandidates.size());
 
-            for (const auto& candidate : validCandidates) {
-                auto candUtf32 = getUtf32Cached(candidate);
+            for (size_t i = 0; i < validCandidates.size(); i++) {
+                auto candUtf32 = getUtf32Cached(validCandidates[i]);
                 int distance = calculateEditDistanceSimple(utf32, candUtf32, 3);
                 if (distance <= 3) {
-                    scoredCandidates.emplace_back(candidate, distance);
+                    scoredCandidates.push_back({validCandidates[i], distance, getScoreCode(validKeyIds[i])});
                 }
             }
 
@@ -915,12 +1145,12 @@ namespace marisa {
                     scoredCandidates.begin(),
                     scoredCandidates.begin() + std::min(static_cast<size_t>(maxResults), scoredCandidates.size()),
                     scoredCandidates.end(),
-                    [](const auto& a, const auto& b) { return a.second < b.second; }
+                    compareScoredCandidates
             );
 
             // 提取结果
             for (size_t i = 0; i < std::min(static_cast<size_t>(maxResults), scoredCandidates.size()); i++) {
-                results.push_back(scoredCandidates[i].first);
+                results.push_back(scoredCandidates[i].word);
             }
 
             // 缓存结果
@@ -938,22 +1168,55 @@ namespace marisa {
         // ==================== 上下文预测（优化版） ====================
 
         std::vector<std::string> contextPredict(const std::string& previousWord, const std::string& currentPrefix, int maxResults) {
+            std::vector<std::string> results;
+            results.resize(contextPredict(previousWord, currentPrefix, maxResults, results));
+            return results;
+        }
+
+        // 结果依次覆盖results中已有的字符串，不够时才追加，多出的保留不删。
+        // 缓存键写在每个线程一份的缓冲区里，缓存命中时不分配堆内存
+        size_t contextPredict(const std::string& previousWord, const std::string& currentPrefix, int maxResults,
+                              std::vector<std::string>& results) {
             auto start = std::chrono::steady_clock::now();
 
-            // 构建缓存键
-            std::string cacheKey = makeCacheKey("context", previousWord + "|" + currentPrefix, maxResults);
+            // 构建缓存键，与makeCacheKey("context", previousWord + "|" + currentPrefix, maxResults)相同
+            thread_local std::string cacheKey;
+            cacheKey.assign("context:");
+            cacheKey.append(previousWord);
+            cacheKey.push_back('|');
+            cacheKey.append(currentPrefix);
+            if (maxResults > 0) {
+                cacheKey.push_back(':');
+                cacheKey.append(std::to_string(maxResults));
+            }
 
             // 检查缓存
-            std::vector<std::string> results;
-            std::vector<std::string> cachedResults;
-            if (contextCache.get(cacheKey, cachedResults)) {
+            size_t count = 0;
+            if (contextCache.getInto(cacheKey, results, count)) {
                 auto end = std::chrono::steady_clock::now();
                 auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
                 std::cout << "Context cache hit: " << duration.count() << "µs" << std::endl;
-                return cachedResults;
+                return count;
             }
 
-            if (!bigramLoaded || bigramTrie.empty() || previousWord.empty()) {
+            std::vector<std::string> predicted = predictContext(previousWord, currentPrefix, maxResults, cacheKey);
+            for (size_t i = 0; i < predicted.size(); i++) {
+                if (i < results.size()) {
+                    results[i].swap(predicted[i]);
+                } else {
+                    results.push_back(std::move(predicted[i]));
+                }
+            }
+            return predicted.size();
+        }
+
+        // 缓存未命中时查bigram词典，结果以cacheKey存入缓存
+        std::vector<std::string> predictContext(const std::string& previousWord, const std::string& currentPrefix,
+                                                int maxResults, const std::string& cacheKey) {
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::string> results;
+
+            if (!bigramLoaded || bigramTrie.empty() || previousWord.empty() || maxResults <= 0) {
                 results = fastPrefixSearch(currentPrefix, maxResults);
                 contextCache.put(cacheKey, results);
                 return results;
@@ -961,22 +1224,19 @@ namespace marisa {
 
             try {
                 // 构建搜索前缀
-                std::string searchPrefix = previousWord + " " + currentPrefix;
-                Agent agent;
-                agent.set_query(searchPrefix.c_str(), searchPrefix.length());
-
-                int count = 0;
-                while (bigramTrie.predictive_search(agent) && count < maxResults * 2) {
-                    const Key& key = agent.key();
-                    std::string fullKey(key.ptr(), key.length());
-
-                    size_t spacePos = fullKey.find(' ');
-                    if (spacePos != std::string::npos) {
-                        std::string secondWord = fullKey.substr(spacePos + 1);
-                        results.push_back(secondWord);
-                        count++;
-                    }
-                }
+                auto lease = agentPool.acquire();
+                std::string& searchPrefix = lease.query();
+                appendBigramQuery(previousWord, searchPrefix);
+                searchPrefix.push_back(' ');
+                appendBigramQuery(currentPrefix, searchPrefix);
+                lease.agent().set_query(searchPrefix);
+
+                size_t limit = static_cast<size_t>(maxResults) * 2;
+                results.reserve(limit);
+                bigramTrie.predictive_search(lease.agent(), [&](const Key& key) {
+                    appendSecondWord(key.str(), bigramEncoded, results);
+                    return results.size() < limit;
+                });
 
                 // 限制结果数量
                 if (results.size() > static_cast<size_t>(maxResults)) {
@@ -1010,44 +1270,202 @@ namespace marisa {
 
         std::vector<std::string> pureContextPredict(const std::string& previousWord, int maxResults) {
             std::vector<std::string> results;
+            if (maxResults > 0) {
+                results.reserve(static_cast<size_t>(maxResults));
+            }
+            results.resize(pureContextPredict(previousWord, maxResults, results));
+            return results;
+        }
 
-            if (!bigramLoaded || bigramTrie.empty() || previousWord.empty()) {
-                return results;
+        // 结果依次覆盖results中已有的字符串，不够时才追加，多出的保留不删
+        size_t pureContextPredict(const std::string& previousWord, int maxResults,
+                                  std::vector<std::string>& results) {
+            size_t count = 0;
+
+            if (!bigramLoaded || bigramTrie.empty() || previousWord.empty() || maxResults <= 0) {
+                return count;
             }
 
             try {
-                std::string searchPrefix = previousWord + " ";
-                Agent agent;
-                agent.set_query(searchPrefix.c_str(), searchPrefix.length());
-
-                int count = 0;
-                while (bigramTrie.predictive_search(agent) && count < maxResults) {
-                    const Key& key = agent.key();
-                    std::string fullKey(key.ptr(), key.length());
-
-                    size_t spacePos = fullKey.find(' ');
-                    if (spacePos != std::string::npos) {
-                        std::string secondWord = fullKey.substr(spacePos + 1);
-                        results.push_back(secondWord);
+                auto lease = agentPool.acquire();
+                std::string& searchPrefix = lease.query();
+                appendBigramQuery(previousWord, searchPrefix);
+                searchPrefix.push_back(' ');
+                lease.agent().set_query(searchPrefix);
+
+                size_t limit = static_cast<size_t>(maxResults);
+                bigramTrie.predictive_search(lease.agent(), [&](const Key& key) {
+                    if (count == results.size()) {
+                        results.emplace_back();
+                    }
+                    if (assignSecondWord(key.str(), bigramEncoded, results[count])) {
                         count++;
                     }
-                }
+                    return count < limit;
+                });
 
             } catch (const std::exception& e) {
                 std::cerr << "Error in pure context predict: " << e.what() << std::endl;
             }
 
-            return results;
+            return count;
         }
 
         // ==================== 辅助函数 ====================
 
+        // 取出bigram键"前词 后词"中的后词，直接从Trie的键构造结果字符串。
+        // 空格是ASCII，编码后仍是分隔符，只需解码后词
+        static void appendSecondWord(std::string_view fullKey, bool encoded,
+                                     std::vector<std::string>& results) {
+            if (!assignSecondWord(fullKey, encoded, results.emplace_back())) {
+                results.pop_back();
+            }
+        }
+
+        // 同上，后词写入out，out原有的容量保留
+        static bool assignSecondWord(std::string_view fullKey, bool encoded, std::string& out) {
+            size_t spacePos = fullKey.find(' ');
+            if (spacePos == std::string_view::npos) {
+                return false;
+            }
+            std::string_view secondWord = fullKey.substr(spacePos + 1);
+            out.clear();
+            if (encoded) {
+                KazakhAlphabet::decode(secondWord, out);
+            } else {
+                out.append(secondWord);
+            }
+            return true;
+        }
+
+        void appendBigramQuery(std::string_view word, std::string& query) const {
+            if (bigramEncoded) {
+                KazakhAlphabet::encode(word, query);
+            } else {
+                query.append(word);
+            }
+        }
+
         bool exactMatch(const std::string& word) {
+            int found = unigramDeltas.find(word);
+            if (found != 0) {
+                return found > 0;
+            }
             return unigramLookup->exactMatch(word);
         }
 
+        // ==================== 增量词典 ====================
+
+        bool loadUnigramDelta(const char* filename) {
+            try {
+                auto level = std::make_shared<TrieLevel>();
+                level->load(filename);
+                pushUnigramDelta(std::move(level));
+                std::cout << "Unigram delta loaded: " << filename << std::endl;
+                return true;
+            } catch (const std::exception& e) {
+                std::cerr << "Error loading unigram delta: " << e.what() << std::endl;
+                return false;
+            }
+        }
+
+        bool addUnigramDelta(const std::vector<std::string>& words,
+                             const std::vector<float>& weights,
+                             const std::vector<std::string>& removedWords) {
+            try {
+                Keyset keyset;
+                for (size_t i = 0; i < words.size(); i++) {
+                    keyset.push_back(words[i], i < weights.size() ? weights[i] : 1.0f);
+                }
+                Keyset tombstones;
+                for (const auto& word : removedWords) {
+                    tombstones.push_back(word);
+                }
+                auto level = std::make_shared<TrieLevel>();
+                level->build(keyset, &tombstones);
+                pushUnigramDelta(std::move(level));
+                return true;
+            } catch (const std::exception& e) {
+                std::cerr << "Error adding unigram delta: " << e.what() << std::endl;
+                return false;
+            }
+        }
+
+        bool addUserWordDelta(const std::vector<std::string>& words,
+                              const std::vector<float>& weights,
+                              const std::vector<std::string>& removedWords) {
+            std::vector<std::string> deltaWords(words);
+            std::vector<float> deltaWeights(weights);
+            deltaWeights.resize(deltaWords.size(), 1.0f);
+            std::vector<std::string> tombstones;
+            for (const auto& word : removedWords) {
+                if (unigramLookup && unigramLookup->exactMatch(word)) {
+                    // 恢复词典里的权重，排序与没加过这个词时一样
+                    deltaWords.push_back(word);
+                    deltaWeights.push_back(getBaseWordWeight(word));
+                } else {
+                    tombstones.push_back(word);
+                }
+            }
+            return addUnigramDelta(deltaWords, deltaWeights, tombstones);
+        }
+
+        // 在线程池中把所有增量层合并为一层，合并期间查询照常进行。
+        // 词典在栈外，所以墓碑要保留
+        void compactUnigramDeltas() {
+            threadPool->enqueue([this] {
+                try {
+                    unigramDeltas.compact();
+                } catch (const std::exception& e) {
+                    std::cerr << "Error compacting unigram deltas: " << e.what() << std::endl;
+                }
+            });
+        }
+
+        size_t getUnigramDeltaCount() const {
+            return unigramDeltas.num_levels();
+        }
+
+        void pushUnigramDelta(std::shared_ptr<const TrieLevel> level) {
+            unigramDeltas.push(std::move(level));
+
+            // 缓存的结果和拒绝集都可能过时
+            prefixCache.clear();
+            spellCache.clear();
+            contextCache.clear();
+            {
+                std::lock_guard<std::mutex> lock(fastRejectMutex);
+                fastRejectSet.clear();
+            }
+
+            if (unigramDeltas.num_levels() > MAX_UNIGRAM_DELTAS) {
+                compactUnigramDeltas();
+            }
+        }
+
+        // 词典评分里的权重，没有评分或没有这个词时为0
+        float getBaseWordWeight(const std::string& word) {
+            if (unigramPayloadLoaded) {
+                std::string_view query(word);
+                size_t keyId = MARISA_INVALID_KEY_ID;
+                unigramLookup->exactMatchBatch(&query, 1, &keyId);
+                if (keyId != MARISA_INVALID_KEY_ID) {
+                    return unigramPayload.score(keyId);
+                }
+            }
+            return 0.0f;
+        }
+
         double getWordWeight(const std::string& word) {
-            // 简单权重计算
+            if (unigramPayloadLoaded) {
+                std::string_view query(word);
+                size_t keyId = MARISA_INVALID_KEY_ID;
+                unigramLookup->exactMatchBatch(&query, 1, &keyId);
+                if (keyId != MARISA_INVALID_KEY_ID) {
+                    return unigramPayload.score(keyId);
+                }
+            }
+            // 没有评分时的简单权重计算
             return 1.0 / (word.length() * 0.5 + 1);
         }
 
@@ -1116,9 +1534,13 @@ namespace marisa {
                 unigramTrie.clear();
                 unigramLoaded = false;
             }
+            unigramPayload.clear();
+            unigramPayloadLoaded = false;
+            unigramDeltas.clear();
             if (bigramLoaded) {
                 bigramTrie.clear();
                 bigramLoaded = false;
+                bigramEncoded = false;
             }
 
             utf32Cache.clear();
@@ -1250,14 +1672,48 @@ namespace marisa {
         return impl_->contextPredict(previousWord, currentPrefix, maxResults);
     }
 
+    size_t KazakhContextPredictor::contextPredict(const std::string& previousWord, const std::string& currentPrefix,
+                                                  int maxResults, std::vector<std::string>& results) {
+        return impl_->contextPredict(previousWord, currentPrefix, maxResults, results);
+    }
+
     std::vector<std::string> KazakhContextPredictor::pureContextPredict(const std::string& previousWord, int maxResults) {
         return impl_->pureContextPredict(previousWord, maxResults);
     }
 
+    size_t KazakhContextPredictor::pureContextPredict(const std::string& previousWord, int maxResults,
+                                                      std::vector<std::string>& results) {
+        return impl_->pureContextPredict(previousWord, maxResults, results);
+    }
+
     bool KazakhContextPredictor::exactMatch(const std::string& word) {
         return impl_->exactMatch(word);
     }
 
+    bool KazakhContextPredictor::loadUnigramDelta(const char* filename) {
+        return impl_->loadUnigramDelta(filename);
+    }
+
+    bool KazakhContextPredictor::addUnigramDelta(const std::vector<std::string>& words,
+                                                 const std::vector<float>& weights,
+                                                 const std::vector<std::string>& removedWords) {
+        return impl_->addUnigramDelta(words, weights, removedWords);
+    }
+
+    bool KazakhContextPredictor::addUserWordDelta(const std::vector<std::string>& words,
+                                                  const std::vector<float>& weights,
+                                                  const std::vector<std::string>& removedWords) {
+        return impl_->addUserWordDelta(words, weights, removedWords);
+    }
+
+    void KazakhContextPredictor::compactUnigramDeltas() {
+        impl_->compactUnigramDeltas();
+    }
+
+    size_t KazakhContextPredictor::getUnigramDeltaCount() const {
+        return impl_->getUnigramDeltaCount();
+    }
+
     std::vector<std::string> KazakhContextPredictor::spellCorrect(const std::string& input, int maxResults) {
         return impl_->spellCorrect(input, maxResults);
     }
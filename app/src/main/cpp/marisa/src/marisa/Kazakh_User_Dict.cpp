@@ -1097,6 +1097,29 @@ namespace kazakh_ime {
         return snapshot->normalizedWordMap.find(normalizedWord) != snapshot->normalizedWordMap.end();
     }
 
+    int KazakhUserDict::getWordFrequency(const std::string& word) const {
+        if (word.empty()) {
+            return 0;
+        }
+
+        std::string normalizedWord = normalizeAndConvertToString(word);
+
+        std::shared_lock<std::shared_mutex> lock(workingDataMutex_);
+        auto it = workingData_->normalizedWordMap.find(normalizedWord);
+        return it != workingData_->normalizedWordMap.end() ? it->second->frequency : 0;
+    }
+
+    std::vector<std::string> KazakhUserDict::getAllWords() const {
+        std::shared_lock<std::shared_mutex> lock(workingDataMutex_);
+
+        std::vector<std::string> words;
+        words.reserve(workingData_->normalizedWordMap.size());
+        for (const auto& pair : workingData_->normalizedWordMap) {
+            words.push_back(pair.second->word);
+        }
+        return words;
+    }
+
 // ========== 批量操作 ==========
     bool KazakhUserDict::importWords(const std::vector<std::string>& words) {
         std::unique_lock<std::shared_mutex> lock(workingDataMutex_);
@@ -0,0 +1,309 @@
+#include "marisa/NgramPredictor.h"
+#include "marisa/agent.h"
+#include "marisa/keyset.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <queue>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+namespace marisa {
+
+    namespace {
+
+        // Payload中名次所在的列
+        const size_t RANK_COLUMN = 0;
+
+        // 加载时预先取出的高频词个数
+        const int TOP_WORDS = 64;
+
+        // 键的第一个字节是阶数，不会和词中的字符混淆
+        char orderTag(int order) {
+            return static_cast<char>(order);
+        }
+
+        int countOrder(std::string_view words) {
+            return static_cast<int>(std::count(words.begin(), words.end(), ' ')) + 1;
+        }
+
+        // UTF-8字符数，不计续字节
+        size_t countChars(std::string_view word) {
+            size_t count = 0;
+            for (char c : word) {
+                if ((static_cast<unsigned char>(c) & 0xC0) != 0x80) count++;
+            }
+            return count;
+        }
+
+    } // namespace
+
+    NgramPredictor::NgramPredictor() = default;
+
+    NgramPredictor::~NgramPredictor() = default;
+
+    void NgramPredictor::build(const std::vector<Entry>& entries, const char* filename,
+                               int configFlags) {
+        MARISA_THROW_IF(filename == nullptr, std::invalid_argument);
+
+        // 去重，同一n-gram取最大频率，保留第一次出现的位置用于同频排名
+        std::vector<std::string> keys;
+        std::vector<double> frequencies;
+        std::unordered_map<std::string, size_t> indices;
+        std::string key;
+        for (const Entry& entry : entries) {
+            int order = countOrder(entry.words);
+            if (entry.words.empty() || order > MAX_ORDER) {
+                throw std::invalid_argument("invalid n-gram: " + entry.words);
+            }
+            key.clear();
+            key.push_back(orderTag(order));
+            key.append(entry.words);
+            auto inserted = indices.emplace(key, keys.size());
+            if (inserted.second) {
+                keys.push_back(key);
+                frequencies.push_back(entry.frequency);
+            } else {
+                double& frequency = frequencies[inserted.first->second];
+                frequency = std::max(frequency, entry.frequency);
+            }
+        }
+
+        // 每一阶内按频率降序排名
+        std::vector<size_t> order(keys.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+            if (keys[lhs][0] != keys[rhs][0]) return keys[lhs][0] < keys[rhs][0];
+            return frequencies[lhs] > frequencies[rhs];
+        });
+        std::vector<uint32_t> ranks(keys.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            bool first = (i == 0) || (keys[order[i]][0] != keys[order[i - 1]][0]);
+            ranks[order[i]] = first ? 0 : ranks[order[i - 1]] + 1;
+        }
+
+        Keyset keyset;
+        for (size_t i = 0; i < keys.size(); i++) {
+            keyset.push_back(keys[i], static_cast<float>(frequencies[i]));
+        }
+        Trie trie;
+        trie.build(keyset, configFlags);
+
+        std::vector<uint32_t> values(trie.num_keys());
+        std::vector<float> scores(trie.num_keys());
+        for (size_t i = 0; i < keys.size(); i++) {
+            values[keyset[i].id()] = ranks[i];
+            scores[keyset[i].id()] = static_cast<float>(frequencies[i]);
+        }
+        Payload payload;
+        payload.build(trie.num_keys(), 1, values.data(), scores.data());
+
+        const int fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        MARISA_THROW_SYSTEM_ERROR_IF(fd == -1, errno, std::generic_category(), "open");
+        try {
+            trie.write(fd);
+            payload.write(fd);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+    }
+
+    bool NgramPredictor::loadFromFile(const char* filename) {
+        Trie trie;
+        Payload payload;
+        try {
+            trie.mmap(filename);
+            payload.mmap(filename, 0, trie.io_size());
+        } catch (const std::exception&) {
+            return false;
+        }
+        if (payload.num_keys() != trie.num_keys() || payload.num_columns() <= RANK_COLUMN) {
+            return false;
+        }
+
+        clear();
+        trie_.swap(trie);
+        payload_.swap(payload);
+        loaded_ = true;
+
+        Agent agent;
+        for (int order = 1; order <= MAX_ORDER; order++) {
+            char tag = orderTag(order);
+            agent.set_query(std::string_view(&tag, 1));
+            counts_[order - 1] = trie_.predictive_search(agent, [](const Key&) { return true; });
+        }
+
+        std::string tag(1, orderTag(1));
+        for (std::string& word : topCompletions(tag, 1, TOP_WORDS * 2)) {
+            if (countChars(word) > 1 && topWords_.size() < TOP_WORDS) {
+                topWords_.push_back(std::move(word));
+            }
+        }
+        return true;
+    }
+
+    std::vector<std::string> NgramPredictor::topCompletions(std::string_view query,
+                                                            size_t wordOffset,
+                                                            int maxResults) const {
+        std::vector<std::string> results;
+        if (!isLoaded() || maxResults <= 0) {
+            return results;
+        }
+
+        // 名次最大的在堆顶，堆中始终是目前最好的maxResults个
+        using Candidate = std::pair<uint32_t, size_t>;
+        std::priority_queue<Candidate> heap;
+        size_t limit = static_cast<size_t>(maxResults);
+
+        auto collect = [&](const Key& key) {
+            uint32_t rank = payload_.value(key.id(), RANK_COLUMN);
+            if (heap.size() < limit) {
+                heap.emplace(rank, key.id());
+            } else if (rank < heap.top().first) {
+                heap.pop();
+                heap.emplace(rank, key.id());
+            }
+            return true;
+        };
+
+        Agent agent;
+        agent.set_query(query);
+        trie_.predictive_search(agent, collect);
+
+        // 和原来SQLite的LIKE一样，ASCII首字母不区分大小写，
+        // 输入"am"也能得到"America"
+        if (query.size() > wordOffset && std::isalpha(static_cast<unsigned char>(query[wordOffset]))) {
+            std::string otherCase(query);
+            otherCase[wordOffset] ^= 0x20;
+            agent.set_query(otherCase);
+            trie_.predictive_search(agent, collect);
+        }
+
+        results.resize(heap.size());
+        for (size_t i = heap.size(); i > 0; i--) {
+            agent.set_query(heap.top().second);
+            trie_.reverse_lookup(agent);
+            results[i - 1].assign(agent.key().str().substr(wordOffset));
+            heap.pop();
+        }
+        return results;
+    }
+
+    std::vector<std::string> NgramPredictor::prefixSearch(std::string_view prefix,
+                                                          int maxResults) const {
+        std::string query(1, orderTag(1));
+        query.append(prefix);
+        return topCompletions(query, 1, maxResults);
+    }
+
+    std::vector<std::string> NgramPredictor::contextPredict(std::string_view previousWord,
+                                                            std::string_view currentPrefix,
+                                                            int maxResults) const {
+        std::string query(1, orderTag(2));
+        query.append(previousWord);
+        query.push_back(' ');
+        size_t wordOffset = query.size();
+        query.append(currentPrefix);
+        return topCompletions(query, wordOffset, maxResults);
+    }
+
+    std::vector<std::string> NgramPredictor::trigramPredict(std::string_view firstWord,
+                                                            std::string_view secondWord,
+                                                            std::string_view currentPrefix,
+                                                            int maxResults) const {
+        std::string query(1, orderTag(3));
+        query.append(firstWord);
+        query.push_back(' ');
+        query.append(secondWord);
+        query.push_back(' ');
+        size_t wordOffset = query.size();
+        query.append(currentPrefix);
+        return topCompletions(query, wordOffset, maxResults);
+    }
+
+    std::vector<std::string> NgramPredictor::mostFrequentWords(int maxResults) const {
+        if (maxResults <= 0) {
+            return {};
+        }
+        if (static_cast<size_t>(maxResults) <= topWords_.size()) {
+            return std::vector<std::string>(topWords_.begin(), topWords_.begin() + maxResults);
+        }
+
+        // 超出预取的个数时才扫描整个unigram
+        std::vector<std::string> results;
+        std::string tag(1, orderTag(1));
+        for (std::string& word : topCompletions(tag, 1, static_cast<int>(counts_[0]))) {
+            if (countChars(word) > 1) {
+                results.push_back(std::move(word));
+                if (results.size() == static_cast<size_t>(maxResults)) break;
+            }
+        }
+        return results;
+    }
+
+    bool NgramPredictor::exactMatch(std::string_view word) const {
+        if (!isLoaded() || word.empty()) {
+            return false;
+        }
+        std::string query(1, orderTag(1));
+        query.append(word);
+        Agent agent;
+        agent.set_query(query);
+        return trie_.lookup(agent);
+    }
+
+    double NgramPredictor::getFrequency(std::string_view word) const {
+        if (!isLoaded() || word.empty()) {
+            return 0.0;
+        }
+        std::string query(1, orderTag(1));
+        query.append(word);
+        Agent agent;
+        agent.set_query(query);
+        if (!trie_.lookup(agent)) {
+            return 0.0;
+        }
+        return payload_.score(agent.key().id());
+    }
+
+    size_t NgramPredictor::getCount(int order) const {
+        if (order < 1 || order > MAX_ORDER) {
+            return 0;
+        }
+        return counts_[order - 1];
+    }
+
+    std::string NgramPredictor::getInfo() const {
+        std::string info = "=== Ngram Predictor Info ===\n";
+        if (!isLoaded()) {
+            info += "Status: Not loaded\n";
+            return info;
+        }
+        info += "Unigrams: " + std::to_string(counts_[0]) + "\n";
+        info += "Bigrams: " + std::to_string(counts_[1]) + "\n";
+        info += "Trigrams: " + std::to_string(counts_[2]) + "\n";
+        info += "Size: " + std::to_string(trie_.io_size() + payload_.io_size()) + " bytes\n";
+        return info;
+    }
+
+    bool NgramPredictor::isLoaded() const {
+        return loaded_;
+    }
+
+    void NgramPredictor::clear() {
+        trie_.clear();
+        payload_.clear();
+        loaded_ = false;
+        for (size_t& count : counts_) count = 0;
+        topWords_.clear();
+    }
+
+} // namespace marisa
@@ -0,0 +1,201 @@
+#include "marisa/Transliterator.h"
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
+namespace marisa {
+
+    namespace {
+
+        // UTF-8首字节对应的字符长度，非法字节按1个字节处理
+        size_t utf8Length(unsigned char c) {
+            if ((c & 0xE0) == 0xC0) return 2;
+            if ((c & 0xF0) == 0xE0) return 3;
+            if ((c & 0xF8) == 0xF0) return 4;
+            return 1;
+        }
+
+    } // namespace
+
+    Transliterator::Transliterator() {
+        std::fill(std::begin(rootEdges_), std::end(rootEdges_), NO_STATE);
+        states_.emplace_back();
+    }
+
+    Transliterator::~Transliterator() = default;
+
+    void Transliterator::build(const std::vector<Rule>& rules) {
+        // 先建普通的字典树，再压平成按标签排序的边数组
+        std::vector<std::map<uint8_t, uint32_t>> children(1);
+        std::vector<int32_t> stateRules(1, -1);
+        std::vector<std::string> outputs;
+        std::unordered_map<std::string, int32_t> ruleIds;
+
+        for (const Rule& rule : rules) {
+            if (rule.first.empty()) continue;
+            auto inserted = ruleIds.emplace(rule.first, static_cast<int32_t>(outputs.size()));
+            if (!inserted.second) {
+                outputs[inserted.first->second] = rule.second;
+                continue;
+            }
+            outputs.push_back(rule.second);
+
+            uint32_t state = 0;
+            for (char c : rule.first) {
+                uint8_t label = static_cast<uint8_t>(c);
+                auto it = children[state].find(label);
+                if (it == children[state].end()) {
+                    uint32_t next = static_cast<uint32_t>(children.size());
+                    children[state].emplace(label, next);
+                    children.emplace_back();
+                    stateRules.push_back(-1);
+                    state = next;
+                } else {
+                    state = it->second;
+                }
+            }
+            stateRules[state] = inserted.first->second;
+        }
+
+        std::vector<State> states(children.size());
+        std::vector<Edge> edges;
+        for (size_t i = 0; i < children.size(); i++) {
+            states[i].firstEdge = static_cast<uint32_t>(edges.size());
+            states[i].numEdges = static_cast<uint32_t>(children[i].size());
+            states[i].rule = stateRules[i];
+            for (const auto& child : children[i]) {
+                edges.push_back(Edge{child.first, child.second});
+            }
+        }
+
+        std::fill(std::begin(rootEdges_), std::end(rootEdges_), NO_STATE);
+        for (const auto& child : children[0]) {
+            rootEdges_[child.first] = child.second;
+        }
+        states_.swap(states);
+        edges_.swap(edges);
+        outputs_.swap(outputs);
+        numRules_ = outputs_.size();
+    }
+
+    uint32_t Transliterator::step(uint32_t state, uint8_t byte) const {
+        if (state == 0) {
+            return rootEdges_[byte];
+        }
+        const State& s = states_[state];
+        auto begin = edges_.begin() + s.firstEdge;
+        auto end = begin + s.numEdges;
+        auto it = std::lower_bound(begin, end, byte, [](const Edge& edge, uint8_t label) {
+            return edge.label < label;
+        });
+        return (it != end && it->label == byte) ? it->target : NO_STATE;
+    }
+
+    size_t Transliterator::resolve(std::string_view pending, size_t matchLength,
+                                   int32_t matchRule, std::string& out) const {
+        if (matchLength > 0) {
+            out.append(outputs_[matchRule]);
+            return matchLength;
+        }
+        size_t length = std::min(utf8Length(static_cast<unsigned char>(pending[0])), pending.size());
+        out.append(pending.data(), length);
+        return length;
+    }
+
+    std::string Transliterator::convert(std::string_view text) const {
+        std::string out;
+        out.reserve(text.size() * 2);
+        Stream stream(*this);
+        stream.feed(text, out);
+        stream.finish(out);
+        return out;
+    }
+
+    Transliterator::Stream::Stream(const Transliterator& transliterator)
+            : transliterator_(&transliterator), state_(0) {}
+
+    void Transliterator::Stream::feed(std::string_view text, std::string& out) {
+        for (char c : text) {
+            pending_.push_back(c);
+            advance(out);
+        }
+    }
+
+    // 新字节能延长当前匹配就只走一步；否则从头重新解析未确定的几个字节
+    void Transliterator::Stream::advance(std::string& out) {
+        const Transliterator& t = *transliterator_;
+        uint32_t next = t.step(state_, static_cast<uint8_t>(pending_.back()));
+        if (next != NO_STATE) {
+            state_ = next;
+            if (t.states_[next].rule >= 0) {
+                matchLength_ = pending_.size();
+                matchRule_ = t.states_[next].rule;
+            }
+            if (t.states_[next].numEdges > 0) {
+                return;
+            }
+        }
+        restart(out);
+    }
+
+    // 输出pending_开头所有已经确定的部分，剩下的字节都在自动机的一条路径上
+    void Transliterator::Stream::restart(std::string& out) {
+        const Transliterator& t = *transliterator_;
+        while (!pending_.empty()) {
+            state_ = 0;
+            matchLength_ = 0;
+            matchRule_ = -1;
+            size_t i = 0;
+            for (; i < pending_.size(); i++) {
+                uint32_t next = t.step(state_, static_cast<uint8_t>(pending_[i]));
+                if (next == NO_STATE) break;
+                state_ = next;
+                if (t.states_[next].rule >= 0) {
+                    matchLength_ = i + 1;
+                    matchRule_ = t.states_[next].rule;
+                }
+            }
+            if (i == pending_.size() && t.states_[state_].numEdges > 0) {
+                return;
+            }
+            pending_.erase(0, t.resolve(pending_, matchLength_, matchRule_, out));
+        }
+        reset();
+    }
+
+    void Transliterator::Stream::finish(std::string& out) {
+        const Transliterator& t = *transliterator_;
+        while (!pending_.empty()) {
+            // 没有更多输入，取pending_开头的最长匹配
+            uint32_t state = 0;
+            size_t matchLength = 0;
+            int32_t matchRule = -1;
+            for (size_t i = 0; i < pending_.size(); i++) {
+                state = t.step(state, static_cast<uint8_t>(pending_[i]));
+                if (state == NO_STATE) break;
+                if (t.states_[state].rule >= 0) {
+                    matchLength = i + 1;
+                    matchRule = t.states_[state].rule;
+                }
+            }
+            pending_.erase(0, t.resolve(pending_, matchLength, matchRule, out));
+        }
+        reset();
+    }
+
+    std::string Transliterator::Stream::preview() const {
+        std::string out;
+        Stream copy(*this);
+        copy.finish(out);
+        return out;
+    }
+
+    void Transliterator::Stream::reset() {
+        pending_.clear();
+        state_ = 0;
+        matchLength_ = 0;
+        matchRule_ = -1;
+    }
+
+} // namespace marisa
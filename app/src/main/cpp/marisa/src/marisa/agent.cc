@@ -85,6 +85,14 @@ void Agent::init_state() {
   state_.reset(new grimoire::State);
 }
 
+void Agent::reset() noexcept {
+  query_.clear();
+  key_.clear();
+  if (state_ != nullptr) {
+    state_->reset();
+  }
+}
+
 void Agent::clear() noexcept {
   Agent().swap(*this);
 }
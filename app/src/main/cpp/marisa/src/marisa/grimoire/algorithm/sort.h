@@ -2,6 +2,8 @@
 #define MARISA_GRIMOIRE_ALGORITHM_SORT_H_
 
 #include <cassert>
+#include <future>
+#include <vector>
 
 #include "marisa/base.h"
 
@@ -9,7 +11,8 @@ namespace marisa::grimoire::algorithm {
 namespace details {
 
 enum {
-  MARISA_INSERTION_SORT_THRESHOLD = 10
+  MARISA_INSERTION_SORT_THRESHOLD = 10,
+  MARISA_PARALLEL_SORT_THRESHOLD = 1 << 14
 };
 
 template <typename T>
@@ -77,10 +80,34 @@ std::size_t insertion_sort(Iterator l, Iterator r, std::size_t depth) {
 }
 
 template <typename Iterator>
-std::size_t sort(Iterator l, Iterator r, std::size_t depth) {
+std::size_t sort(Iterator l, Iterator r, std::size_t depth,
+                 std::size_t num_threads);
+
+// Sorts [l, r) in place, or hands it to a new thread if it is large and
+// threads are left. Either way it is sorted exactly as sort() does, because
+// the ranges given to sort_range() never overlap.
+template <typename Iterator>
+std::size_t sort_range(Iterator l, Iterator r, std::size_t depth,
+                       std::size_t &num_threads,
+                       std::vector<std::future<std::size_t>> &tasks) {
+  if ((num_threads > 1) && ((r - l) >= MARISA_PARALLEL_SORT_THRESHOLD)) {
+    const std::size_t task_threads = num_threads / 2;
+    num_threads -= task_threads;
+    tasks.push_back(std::async(std::launch::async, [l, r, depth, task_threads] {
+      return sort(l, r, depth, task_threads);
+    }));
+    return 0;
+  }
+  return sort(l, r, depth, num_threads);
+}
+
+template <typename Iterator>
+std::size_t sort(Iterator l, Iterator r, std::size_t depth,
+                 std::size_t num_threads) {
   assert(l <= r);
 
   std::size_t count = 0;
+  std::vector<std::future<std::size_t>> tasks;
   while ((r - l) > MARISA_INSERTION_SORT_THRESHOLD) {
     Iterator pl = l;
     Iterator pr = r;
@@ -129,7 +156,7 @@ std::size_t sort(Iterator l, Iterator r, std::size_t depth) {
         if (pivot == -1) {
           ++count;
         } else {
-          count += sort(pl, pr, depth + 1);
+          count += sort_range(pl, pr, depth + 1, num_threads, tasks);
         }
       }
 
@@ -137,14 +164,14 @@ std::size_t sort(Iterator l, Iterator r, std::size_t depth) {
         if ((pl - l) == 1) {
           ++count;
         } else if ((pl - l) > 1) {
-          count += sort(l, pl, depth);
+          count += sort_range(l, pl, depth, num_threads, tasks);
         }
         l = pr;
       } else {
         if ((r - pr) == 1) {
           ++count;
         } else if ((r - pr) > 1) {
-          count += sort(pr, r, depth);
+          count += sort_range(pr, r, depth, num_threads, tasks);
         }
         r = pl;
       }
@@ -152,13 +179,13 @@ std::size_t sort(Iterator l, Iterator r, std::size_t depth) {
       if ((pl - l) == 1) {
         ++count;
       } else if ((pl - l) > 1) {
-        count += sort(l, pl, depth);
+        count += sort_range(l, pl, depth, num_threads, tasks);
       }
 
       if ((r - pr) == 1) {
         ++count;
       } else if ((r - pr) > 1) {
-        count += sort(pr, r, depth);
+        count += sort_range(pr, r, depth, num_threads, tasks);
       }
 
       l = pl, r = pr;
@@ -178,15 +205,20 @@ std::size_t sort(Iterator l, Iterator r, std::size_t depth) {
   if ((r - l) > 1) {
     count += insertion_sort(l, r, depth);
   }
+  for (std::size_t i = 0; i < tasks.size(); ++i) {
+    count += tasks[i].get();
+  }
   return count;
 }
 
 }  // namespace details
 
+// sort() returns the number of unique keys. Given num_threads > 1, large
+// subranges are sorted on up to num_threads threads with the same result.
 template <typename Iterator>
-std::size_t sort(Iterator begin, Iterator end) {
+std::size_t sort(Iterator begin, Iterator end, std::size_t num_threads = 1) {
   assert(begin <= end);
-  return details::sort(begin, end, 0);
+  return details::sort(begin, end, 0, num_threads);
 }
 
 }  // namespace marisa::grimoire::algorithm
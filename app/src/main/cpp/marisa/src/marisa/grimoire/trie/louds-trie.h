@@ -21,17 +21,27 @@ class LoudsTrie {
   LoudsTrie(const LoudsTrie &) = delete;
   LoudsTrie &operator=(const LoudsTrie &) = delete;
 
-  void build(Keyset &keyset, int flags);
+  // Given a query log, the cache of the first trie is refilled with the
+  // transitions that its queries take most often. See tune_cache().
+  void build(Keyset &keyset, int flags, std::size_t num_threads = 1,
+             const Keyset *query_log = nullptr);
 
   void map(Mapper &mapper);
   void read(Reader &reader);
   void write(Writer &writer) const;
 
   bool lookup(Agent &agent) const;
+  std::size_t lookup_batch(const std::string_view *keys, std::size_t num_keys,
+                           std::size_t *key_ids) const;
   void reverse_lookup(Agent &agent) const;
   bool common_prefix_search(Agent &agent) const;
   bool predictive_search(Agent &agent) const;
 
+  // Walks the first trie as predictive_search() does for each query and
+  // adds the weights of the transitions that hit or miss the cache.
+  void count_cache_hits(const Keyset &queries, double *num_hits,
+                        double *num_misses) const;
+
   std::size_t num_tries() const {
     return config_.num_tries();
   }
@@ -78,17 +88,20 @@ class LoudsTrie {
   Config config_;
   Mapper mapper_;
 
-  void build_(Keyset &keyset, const Config &config);
+  void build_(Keyset &keyset, const Config &config, std::size_t num_threads);
 
   template <typename T>
   void build_trie(Vector<T> &keys, Vector<uint32_t> *terminals,
-                  const Config &config, std::size_t trie_id);
+                  const Config &config, std::size_t trie_id,
+                  std::size_t num_threads);
   template <typename T>
   void build_current_trie(Vector<T> &keys, Vector<uint32_t> *terminals,
-                          const Config &config, std::size_t trie_id);
+                          const Config &config, std::size_t trie_id,
+                          std::size_t num_threads);
   template <typename T>
   void build_next_trie(Vector<T> &keys, Vector<uint32_t> *terminals,
-                       const Config &config, std::size_t trie_id);
+                       const Config &config, std::size_t trie_id,
+                       std::size_t num_threads);
   template <typename T>
   void build_terminals(const Vector<T> &keys,
                        Vector<uint32_t> *terminals) const;
@@ -98,6 +111,10 @@ class LoudsTrie {
   template <typename T>
   void cache(std::size_t parent, std::size_t child, float weight, char label);
   void fill_cache();
+  void fill_cache(Cache &entry, std::size_t node_id) const;
+  void tune_cache(const Keyset &query_log);
+  template <typename Callback>
+  void replay(const Keyset &queries, Callback callback) const;
 
   void map_(Mapper &mapper);
   void read_(Reader &reader);
@@ -0,0 +1,242 @@
+#include "marisa/grimoire/trie/payload.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace marisa::grimoire::trie {
+namespace {
+
+const char *get_header() {
+  static const char buf[Payload::HEADER_SIZE] = "Marisa payload.";
+  return buf;
+}
+
+bool test_header(const char *ptr) {
+  for (std::size_t i = 0; i < Payload::HEADER_SIZE; ++i) {
+    if (ptr[i] != get_header()[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+Payload::Payload() = default;
+
+Payload::~Payload() = default;
+
+void Payload::build(std::size_t num_keys, std::size_t num_columns,
+                    const uint32_t *values, const float *scores,
+                    std::size_t num_levels) {
+  MARISA_THROW_IF((values == nullptr) && (num_keys != 0) && (num_columns != 0),
+                  std::invalid_argument);
+  MARISA_THROW_IF(num_columns > MAX_NUM_COLUMNS, std::invalid_argument);
+  MARISA_THROW_IF((num_levels == 0) || (num_levels > MAX_NUM_LEVELS),
+                  std::invalid_argument);
+  MARISA_THROW_IF(num_keys > UINT32_MAX, std::length_error);
+
+  Payload temp;
+  temp.num_keys_ = num_keys;
+  temp.num_columns_ = num_columns;
+  temp.columns_.reset(new FlatVector[num_columns]);
+
+  Vector<uint32_t> column;
+  column.resize(num_keys);
+  for (std::size_t i = 0; i < num_columns; ++i) {
+    for (std::size_t j = 0; j < num_keys; ++j) {
+      column[j] = values[(j * num_columns) + i];
+    }
+    temp.columns_[i].build(column);
+  }
+  if (scores != nullptr) {
+    temp.build_scores(scores, num_levels);
+  }
+  swap(temp);
+}
+
+void Payload::map(Mapper &mapper) {
+  const char *ptr;
+  mapper.map(&ptr, HEADER_SIZE);
+  MARISA_THROW_IF(!test_header(ptr), std::runtime_error);
+
+  Payload temp;
+  temp.map_(mapper);
+  temp.mapper_.swap(mapper);
+  swap(temp);
+}
+
+void Payload::read(Reader &reader) {
+  char buf[HEADER_SIZE];
+  reader.read(buf, HEADER_SIZE);
+  MARISA_THROW_IF(!test_header(buf), std::runtime_error);
+
+  Payload temp;
+  temp.read_(reader);
+  swap(temp);
+}
+
+void Payload::write(Writer &writer) const {
+  writer.write(get_header(), HEADER_SIZE);
+
+  write_(writer);
+}
+
+std::size_t Payload::total_size() const {
+  std::size_t total_size = codes_.total_size() + codebook_.total_size();
+  for (std::size_t i = 0; i < num_columns_; ++i) {
+    total_size += columns_[i].total_size();
+  }
+  return total_size;
+}
+
+std::size_t Payload::io_size() const {
+  std::size_t io_size = HEADER_SIZE + (sizeof(uint64_t) * 2) +
+                        codes_.io_size() + codebook_.io_size();
+  for (std::size_t i = 0; i < num_columns_; ++i) {
+    io_size += columns_[i].io_size();
+  }
+  return io_size;
+}
+
+void Payload::clear() noexcept {
+  Payload().swap(*this);
+}
+
+void Payload::swap(Payload &rhs) noexcept {
+  columns_.swap(rhs.columns_);
+  codes_.swap(rhs.codes_);
+  codebook_.swap(rhs.codebook_);
+  std::swap(num_keys_, rhs.num_keys_);
+  std::swap(num_columns_, rhs.num_columns_);
+  mapper_.swap(rhs.mapper_);
+}
+
+// Scores are sorted and cut into num_levels intervals of the same width, and
+// the keys in each used interval get the mean of their scores. Equal scores
+// never straddle two intervals, so the codes are in the same order as the
+// scores. Given at most num_levels distinct scores, each gets its own code
+// and the codebook is exact.
+void Payload::build_scores(const float *scores, std::size_t num_levels) {
+  std::vector<uint32_t> order(num_keys_);
+  for (std::size_t i = 0; i < num_keys_; ++i) {
+    MARISA_THROW_IF(!std::isfinite(scores[i]), std::invalid_argument);
+    order[i] = static_cast<uint32_t>(i);
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [scores](uint32_t lhs, uint32_t rhs) {
+                     return scores[lhs] < scores[rhs];
+                   });
+
+  std::size_t num_values = 0;
+  for (std::size_t i = 0; i < num_keys_; ++i) {
+    if ((i == 0) || (scores[order[i]] != scores[order[i - 1]])) {
+      ++num_values;
+    }
+  }
+  const double min_score = (num_keys_ != 0) ? scores[order.front()] : 0.0;
+  const double max_score = (num_keys_ != 0) ? scores[order.back()] : 0.0;
+
+  Vector<uint32_t> codes;
+  codes.resize(num_keys_);
+  Vector<float> codebook;
+  double sum = 0.0;
+  std::size_t count = 0;
+  std::size_t level = 0;
+  for (std::size_t i = 0; i < num_keys_; ++i) {
+    const float score = scores[order[i]];
+    if ((i != 0) && (score != scores[order[i - 1]])) {
+      std::size_t next_level = level + 1;
+      if (num_values > num_levels) {
+        next_level = static_cast<std::size_t>(
+            (score - min_score) / (max_score - min_score) * num_levels);
+        next_level = std::min(next_level, num_levels - 1);
+      }
+      if (next_level != level) {
+        codebook.push_back(static_cast<float>(sum / count));
+        sum = 0.0;
+        count = 0;
+        level = next_level;
+      }
+    }
+    codes[order[i]] = static_cast<uint32_t>(codebook.size());
+    sum += score;
+    ++count;
+  }
+  if (count != 0) {
+    codebook.push_back(static_cast<float>(sum / count));
+  }
+
+  codes_.build(codes);
+  // Every value the packed codes can hold has an entry, so that score() is
+  // safe on a mapped file without checking each code.
+  while (!codebook.empty() && (codebook.size() <= codes_.mask())) {
+    codebook.push_back(codebook.back());
+  }
+  codebook.shrink();
+  codebook_.swap(codebook);
+}
+
+void Payload::map_(Mapper &mapper) {
+  {
+    uint64_t temp_num_keys;
+    mapper.map(&temp_num_keys);
+    MARISA_THROW_IF(temp_num_keys > UINT32_MAX, std::runtime_error);
+    num_keys_ = static_cast<std::size_t>(temp_num_keys);
+  }
+  {
+    uint64_t temp_num_columns;
+    mapper.map(&temp_num_columns);
+    MARISA_THROW_IF(temp_num_columns > MAX_NUM_COLUMNS, std::runtime_error);
+    num_columns_ = static_cast<std::size_t>(temp_num_columns);
+  }
+  columns_.reset(new FlatVector[num_columns_]);
+  for (std::size_t i = 0; i < num_columns_; ++i) {
+    columns_[i].map(mapper);
+    MARISA_THROW_IF(columns_[i].size() != num_keys_, std::runtime_error);
+  }
+  codes_.map(mapper);
+  codebook_.map(mapper);
+  MARISA_THROW_IF(!codebook_.empty() && ((codes_.size() != num_keys_) ||
+                                         (codebook_.size() <= codes_.mask())),
+                  std::runtime_error);
+}
+
+void Payload::read_(Reader &reader) {
+  {
+    uint64_t temp_num_keys;
+    reader.read(&temp_num_keys);
+    MARISA_THROW_IF(temp_num_keys > UINT32_MAX, std::runtime_error);
+    num_keys_ = static_cast<std::size_t>(temp_num_keys);
+  }
+  {
+    uint64_t temp_num_columns;
+    reader.read(&temp_num_columns);
+    MARISA_THROW_IF(temp_num_columns > MAX_NUM_COLUMNS, std::runtime_error);
+    num_columns_ = static_cast<std::size_t>(temp_num_columns);
+  }
+  columns_.reset(new FlatVector[num_columns_]);
+  for (std::size_t i = 0; i < num_columns_; ++i) {
+    columns_[i].read(reader);
+    MARISA_THROW_IF(columns_[i].size() != num_keys_, std::runtime_error);
+  }
+  codes_.read(reader);
+  codebook_.read(reader);
+  MARISA_THROW_IF(!codebook_.empty() && ((codes_.size() != num_keys_) ||
+                                         (codebook_.size() <= codes_.mask())),
+                  std::runtime_error);
+}
+
+void Payload::write_(Writer &writer) const {
+  writer.write(static_cast<uint64_t>(num_keys_));
+  writer.write(static_cast<uint64_t>(num_columns_));
+  for (std::size_t i = 0; i < num_columns_; ++i) {
+    columns_[i].write(writer);
+  }
+  codes_.write(writer);
+  codebook_.write(writer);
+}
+
+}  // namespace marisa::grimoire::trie
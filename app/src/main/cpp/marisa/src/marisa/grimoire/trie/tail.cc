@@ -1,8 +1,10 @@
 #include "marisa/grimoire/trie/tail.h"
 
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 
+#include "marisa/grimoire/algorithm/parallel.h"
 #include "marisa/grimoire/algorithm/sort.h"
 #include "marisa/grimoire/trie/state.h"
 
@@ -11,7 +13,7 @@ namespace marisa::grimoire::trie {
 Tail::Tail() = default;
 
 void Tail::build(Vector<Entry> &entries, Vector<uint32_t> *offsets,
-                 TailMode mode) {
+                 TailMode mode, std::size_t num_threads) {
   MARISA_THROW_IF(offsets == nullptr, std::invalid_argument);
 
   switch (mode) {
@@ -40,7 +42,7 @@ void Tail::build(Vector<Entry> &entries, Vector<uint32_t> *offsets,
   }
 
   Tail temp;
-  temp.build_(entries, offsets, mode);
+  temp.build_(entries, offsets, mode, num_threads);
   swap(temp);
 }
 
@@ -155,46 +157,84 @@ void Tail::swap(Tail &rhs) noexcept {
 }
 
 void Tail::build_(Vector<Entry> &entries, Vector<uint32_t> *offsets,
-                  TailMode mode) {
+                  TailMode mode, std::size_t num_threads) {
   for (std::size_t i = 0; i < entries.size(); ++i) {
     entries[i].set_id(i);
   }
-  algorithm::sort(entries.begin(), entries.end());
+  algorithm::sort(entries.begin(), entries.end(), num_threads);
 
-  Vector<uint32_t> temp_offsets;
-  temp_offsets.resize(entries.size(), 0);
+  // Entries are merged from the last one. An entry which is a prefix of the
+  // next one shares its bytes, otherwise it gets its own bytes in buf_.
+  const std::size_t num_entries = entries.size();
+  const std::size_t num_blocks =
+      std::max(std::size_t{1}, std::min(num_threads, num_entries / 65536));
+  Vector<char> shared;
+  shared.resize(num_entries, 0);
+  algorithm::parallel_for(
+      num_entries, num_blocks,
+      [&entries, &shared, num_entries](std::size_t, std::size_t begin,
+                                       std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+          const Entry &current = entries[i];
+          MARISA_THROW_IF(current.length() == 0, std::out_of_range);
+          if (i + 1 == num_entries) {
+            continue;
+          }
+          const Entry &last = entries[i + 1];
+          std::size_t match = 0;
+          while ((match < current.length()) && (match < last.length()) &&
+                 (last[match] == current[match])) {
+            ++match;
+          }
+          shared[i] = (match == current.length()) && (last.length() != 0);
+        }
+      });
 
-  const Entry dummy;
-  const Entry *last = &dummy;
-  for (std::size_t i = entries.size(); i > 0; --i) {
+  // A shared entry ends where the last entry with its own bytes ends.
+  Vector<uint32_t> temp_offsets;
+  temp_offsets.resize(num_entries, 0);
+  Vector<uint32_t> own_offsets;
+  own_offsets.resize(num_entries, 0);
+  const std::size_t tail_size = (mode == MARISA_TEXT_TAIL) ? 1 : 0;
+  std::size_t buf_size = 0;
+  std::size_t owner = 0;
+  for (std::size_t i = num_entries; i > 0; --i) {
     const Entry &current = entries[i - 1];
-    MARISA_THROW_IF(current.length() == 0, std::out_of_range);
-    std::size_t match = 0;
-    while ((match < current.length()) && (match < last->length()) &&
-           ((*last)[match] == current[match])) {
-      ++match;
-    }
-    if ((match == current.length()) && (last->length() != 0)) {
+    if (shared[i - 1]) {
+      const Entry &owner_entry = entries[owner];
       temp_offsets[current.id()] = static_cast<uint32_t>(
-          temp_offsets[last->id()] + (last->length() - match));
+          own_offsets[owner] + (owner_entry.length() - current.length()));
     } else {
-      temp_offsets[current.id()] = static_cast<uint32_t>(buf_.size());
-      for (std::size_t j = 1; j <= current.length(); ++j) {
-        buf_.push_back(current[current.length() - j]);
-      }
-      if (mode == MARISA_TEXT_TAIL) {
-        buf_.push_back('\0');
-      } else {
+      own_offsets[i - 1] = static_cast<uint32_t>(buf_size);
+      temp_offsets[current.id()] = static_cast<uint32_t>(buf_size);
+      buf_size += current.length() + tail_size;
+      MARISA_THROW_IF(buf_size > UINT32_MAX, std::length_error);
+      owner = i - 1;
+      if (mode == MARISA_BINARY_TAIL) {
         for (std::size_t j = 1; j < current.length(); ++j) {
           end_flags_.push_back(false);
         }
         end_flags_.push_back(true);
       }
-      MARISA_THROW_IF(buf_.size() > UINT32_MAX, std::length_error);
     }
-    last = &current;
   }
-  buf_.shrink();
+
+  buf_.resize(buf_size, '\0');
+  algorithm::parallel_for(
+      num_entries, num_blocks,
+      [this, &entries, &shared, &own_offsets](std::size_t, std::size_t begin,
+                                              std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+          if (shared[i]) {
+            continue;
+          }
+          const Entry &current = entries[i];
+          char *const ptr = &buf_[own_offsets[i]];
+          for (std::size_t j = 1; j <= current.length(); ++j) {
+            ptr[j - 1] = current[current.length() - j];
+          }
+        }
+      });
 
   offsets->swap(temp_offsets);
 }
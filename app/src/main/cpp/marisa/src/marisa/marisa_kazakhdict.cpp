@@ -1,6 +1,7 @@
 #include "marisa/marisa_kazakhdict.h"  // 关键修复：包含正确的路径
 #include "marisa/trie.h"
 #include "marisa/agent.h"
+#include "marisa/agent-pool.h"
 #include "marisa/iostream.h"
 #include <iostream>
 #include <fstream>
@@ -15,6 +16,8 @@ class MarisaKazakhDict::Impl {
 public:
     Trie trie;
     bool loaded = false;
+    // 每次查询借用一个Agent，多个线程可以同时查询，Agent的State缓冲区留着再用
+    AgentPool agentPool;
 
     bool loadFromFd(int fd, long startOffset, long length) {
         try {
@@ -31,27 +34,21 @@ public:
     std::vector<std::string> prefixSearch(const std::string& prefix, int maxResults) {
         std::vector<std::string> results;
 
-        if (!loaded || trie.empty()) {
+        if (!loaded || trie.empty() || maxResults <= 0) {
             return results;
         }
 
         try {
-            Agent agent;
-            agent.set_query(prefix.c_str(), prefix.length());
-
-            while (trie.predictive_search(agent)) {
-                const Key& key = agent.key();
-                std::string word(key.ptr(), key.length());
+            auto lease = agentPool.acquire();
+            lease.agent().set_query(prefix.c_str(), prefix.length());
 
+            trie.predictive_search(lease.agent(), [&](const Key& key) {
                 // 过滤掉与前缀完全相同的词
-                if (word != prefix) {
-                    results.push_back(word);
-
-                    if (results.size() >= static_cast<size_t>(maxResults)) {
-                        break;
-                    }
+                if (key.length() != prefix.length()) {
+                    results.emplace_back(key.str());
                 }
-            }
+                return results.size() < static_cast<size_t>(maxResults);
+            });
         } catch (const std::exception& e) {
             std::cerr << "Error in prefix search: " << e.what() << std::endl;
         }
@@ -65,9 +62,9 @@ public:
         }
 
         try {
-            Agent agent;
-            agent.set_query(word.c_str(), word.length());
-            return trie.lookup(agent);
+            auto lease = agentPool.acquire();
+            lease.agent().set_query(word.c_str(), word.length());
+            return trie.lookup(lease.agent());
         } catch (const std::exception& e) {
             std::cerr << "Error in exact match: " << e.what() << std::endl;
             return false;
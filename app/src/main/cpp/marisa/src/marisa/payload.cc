@@ -0,0 +1,162 @@
+#include "marisa/payload.h"
+
+#include <memory>
+#include <stdexcept>
+
+#include "marisa/grimoire/io.h"
+#include "marisa/grimoire/trie/payload.h"
+
+namespace marisa {
+
+Payload::Payload() = default;
+
+Payload::~Payload() = default;
+
+Payload::Payload(Payload &&other) noexcept = default;
+
+Payload &Payload::operator=(Payload &&other) noexcept = default;
+
+void Payload::build(std::size_t num_keys, std::size_t num_columns,
+                    const uint32_t *values, const float *scores,
+                    std::size_t num_levels) {
+  std::unique_ptr<grimoire::trie::Payload> temp(new grimoire::trie::Payload);
+
+  temp->build(num_keys, num_columns, values, scores, num_levels);
+  payload_.swap(temp);
+}
+
+void Payload::mmap(const char *filename, int flags, std::size_t offset) {
+  MARISA_THROW_IF(filename == nullptr, std::invalid_argument);
+
+  std::unique_ptr<grimoire::trie::Payload> temp(new grimoire::trie::Payload);
+
+  grimoire::Mapper mapper;
+  mapper.open(filename, flags);
+  mapper.seek(offset);
+  temp->map(mapper);
+  payload_.swap(temp);
+}
+
+void Payload::map(const void *ptr, std::size_t size) {
+  MARISA_THROW_IF((ptr == nullptr) && (size != 0), std::invalid_argument);
+
+  std::unique_ptr<grimoire::trie::Payload> temp(new grimoire::trie::Payload);
+
+  grimoire::Mapper mapper;
+  mapper.open(ptr, size);
+  temp->map(mapper);
+  payload_.swap(temp);
+}
+
+void Payload::load(const char *filename, std::size_t offset) {
+  MARISA_THROW_IF(filename == nullptr, std::invalid_argument);
+
+  std::unique_ptr<grimoire::trie::Payload> temp(new grimoire::trie::Payload);
+
+  grimoire::Reader reader;
+  reader.open(filename);
+  reader.seek(offset);
+  temp->read(reader);
+  payload_.swap(temp);
+}
+
+void Payload::read(int fd) {
+  MARISA_THROW_IF(fd == -1, std::invalid_argument);
+
+  std::unique_ptr<grimoire::trie::Payload> temp(new grimoire::trie::Payload);
+
+  grimoire::Reader reader;
+  reader.open(fd);
+  temp->read(reader);
+  payload_.swap(temp);
+}
+
+void Payload::save(const char *filename) const {
+  MARISA_THROW_IF(payload_ == nullptr, std::logic_error);
+  MARISA_THROW_IF(filename == nullptr, std::invalid_argument);
+
+  grimoire::Writer writer;
+  writer.open(filename);
+  payload_->write(writer);
+}
+
+void Payload::write(int fd) const {
+  MARISA_THROW_IF(payload_ == nullptr, std::logic_error);
+  MARISA_THROW_IF(fd == -1, std::invalid_argument);
+
+  grimoire::Writer writer;
+  writer.open(fd);
+  payload_->write(writer);
+}
+
+uint32_t Payload::value(std::size_t key_id, std::size_t column) const {
+  MARISA_THROW_IF(payload_ == nullptr, std::logic_error);
+  MARISA_THROW_IF((key_id >= payload_->num_keys()) ||
+                      (column >= payload_->num_columns()),
+                  std::out_of_range);
+  return payload_->value(key_id, column);
+}
+
+uint32_t Payload::score_code(std::size_t key_id) const {
+  MARISA_THROW_IF(payload_ == nullptr, std::logic_error);
+  MARISA_THROW_IF(!payload_->has_scores(), std::logic_error);
+  MARISA_THROW_IF(key_id >= payload_->num_keys(), std::out_of_range);
+  return payload_->score_code(key_id);
+}
+
+float Payload::score(std::size_t key_id) const {
+  MARISA_THROW_IF(payload_ == nullptr, std::logic_error);
+  MARISA_THROW_IF(!payload_->has_scores(), std::logic_error);
+  MARISA_THROW_IF(key_id >= payload_->num_keys(), std::out_of_range);
+  return payload_->score(key_id);
+}
+
+std::size_t Payload::num_keys() const {
+  MARISA_THROW_IF(payload_ == nullptr, std::logic_error);
+  return payload_->num_keys();
+}
+
+std::size_t Payload::num_columns() const {
+  MARISA_THROW_IF(payload_ == nullptr, std::logic_error);
+  return payload_->num_columns();
+}
+
+std::size_t Payload::num_levels() const {
+  MARISA_THROW_IF(payload_ == nullptr, std::logic_error);
+  return payload_->num_levels();
+}
+
+bool Payload::has_scores() const {
+  MARISA_THROW_IF(payload_ == nullptr, std::logic_error);
+  return payload_->has_scores();
+}
+
+bool Payload::empty() const {
+  MARISA_THROW_IF(payload_ == nullptr, std::logic_error);
+  return payload_->empty();
+}
+
+std::size_t Payload::size() const {
+  MARISA_THROW_IF(payload_ == nullptr, std::logic_error);
+  return payload_->size();
+}
+
+std::size_t Payload::total_size() const {
+  MARISA_THROW_IF(payload_ == nullptr, std::logic_error);
+  return payload_->total_size();
+}
+
+std::size_t Payload::io_size() const {
+  MARISA_THROW_IF(payload_ == nullptr, std::logic_error);
+  return payload_->io_size();
+}
+
+void Payload::clear() noexcept {
+  Payload().swap(*this);
+}
+
+void Payload::swap(Payload &rhs) noexcept {
+  payload_.swap(rhs.payload_);
+}
+
+}  // namespace marisa
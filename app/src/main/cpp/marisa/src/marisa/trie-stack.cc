@@ -0,0 +1,301 @@
+#include "marisa/trie-stack.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_set>
+
+namespace marisa {
+namespace {
+
+// Payload column that holds the tombstone flags.
+constexpr std::size_t TOMBSTONE_COLUMN = 0;
+
+}  // namespace
+
+TrieLevel::TrieLevel() = default;
+
+TrieLevel::~TrieLevel() = default;
+
+TrieLevel::TrieLevel(TrieLevel &&other) noexcept = default;
+
+TrieLevel &TrieLevel::operator=(TrieLevel &&other) noexcept = default;
+
+void TrieLevel::build(Keyset &keyset, Keyset *tombstones, int config_flags) {
+  const std::size_t num_tombstones =
+      (tombstones != nullptr) ? tombstones->size() : 0;
+
+  Keyset all_keys;
+  std::vector<float> weights(keyset.size());
+  for (std::size_t i = 0; i < keyset.size(); ++i) {
+    weights[i] = keyset[i].weight();
+    all_keys.push_back(keyset[i].str(), weights[i]);
+  }
+  for (std::size_t i = 0; i < num_tombstones; ++i) {
+    all_keys.push_back((*tombstones)[i].str(), 0.0F);
+  }
+
+  TrieLevel temp;
+  temp.trie_.build(all_keys, config_flags);
+
+  // A key given more than once gets its largest weight, and a tombstone
+  // only counts for keys that the level does not keep.
+  const std::size_t num_keys = temp.trie_.num_keys();
+  std::vector<float> scores(num_keys, 0.0F);
+  std::vector<uint32_t> flags(num_keys, 1);
+  for (std::size_t i = 0; i < keyset.size(); ++i) {
+    const std::size_t key_id = all_keys[i].id();
+    if ((flags[key_id] != 0) || (weights[i] > scores[key_id])) {
+      scores[key_id] = weights[i];
+    }
+    flags[key_id] = 0;
+    keyset[i].set_id(key_id);
+  }
+  for (std::size_t i = 0; i < num_tombstones; ++i) {
+    (*tombstones)[i].set_id(all_keys[keyset.size() + i].id());
+  }
+  temp.payload_.build(num_keys, 1, flags.data(), scores.data());
+  temp.has_payload_ = true;
+  swap(temp);
+}
+
+void TrieLevel::mmap(const char *filename, int flags) {
+  TrieLevel temp;
+  temp.trie_.mmap(filename, flags);
+  temp.load_payload(filename, true, flags);
+  swap(temp);
+}
+
+void TrieLevel::load(const char *filename) {
+  TrieLevel temp;
+  temp.trie_.load(filename);
+  temp.load_payload(filename, false, 0);
+  swap(temp);
+}
+
+void TrieLevel::save(const char *filename) const {
+  MARISA_THROW_IF(filename == nullptr, std::invalid_argument);
+
+  const int fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  MARISA_THROW_SYSTEM_ERROR_IF(fd == -1, errno, std::generic_category(),
+                               "open");
+  try {
+    trie_.write(fd);
+    if (has_payload_) {
+      payload_.write(fd);
+    }
+  } catch (...) {
+    ::close(fd);
+    throw;
+  }
+  ::close(fd);
+}
+
+bool TrieLevel::lookup(Agent &agent, bool *tombstone) const {
+  if (!trie_.lookup(agent)) {
+    return false;
+  }
+  if (tombstone != nullptr) {
+    *tombstone = is_tombstone(agent.key().id());
+  }
+  return true;
+}
+
+float TrieLevel::weight(std::size_t key_id) const {
+  return has_payload_ ? payload_.score(key_id) : 0.0F;
+}
+
+bool TrieLevel::is_tombstone(std::size_t key_id) const {
+  return has_payload_ && (payload_.value(key_id, TOMBSTONE_COLUMN) != 0);
+}
+
+void TrieLevel::clear() noexcept {
+  TrieLevel().swap(*this);
+}
+
+void TrieLevel::swap(TrieLevel &rhs) noexcept {
+  trie_.swap(rhs.trie_);
+  payload_.swap(rhs.payload_);
+  std::swap(has_payload_, rhs.has_payload_);
+}
+
+// A trie saved without a payload is still a level, so a missing or
+// mismatching payload is not an error.
+void TrieLevel::load_payload(const char *filename, bool mapped, int flags) {
+  Payload payload;
+  try {
+    if (mapped) {
+      payload.mmap(filename, flags, trie_.io_size());
+    } else {
+      payload.load(filename, trie_.io_size());
+    }
+  } catch (const std::exception &) {
+    return;
+  }
+  if ((payload.num_keys() == trie_.num_keys()) &&
+      (payload.num_columns() > TOMBSTONE_COLUMN) && payload.has_scores()) {
+    payload_.swap(payload);
+    has_payload_ = true;
+  }
+}
+
+TrieStack::TrieStack() : levels_(std::make_shared<const Levels>()) {}
+
+TrieStack::~TrieStack() = default;
+
+void TrieStack::push(Level level) {
+  MARISA_THROW_IF(level == nullptr, std::invalid_argument);
+
+  std::lock_guard<std::mutex> lock(levels_mutex_);
+  auto levels = std::make_shared<Levels>(*levels_);
+  levels->push_back(std::move(level));
+  levels_ = std::move(levels);
+}
+
+std::vector<TrieStack::Level> TrieStack::levels() const {
+  return *snapshot();
+}
+
+std::size_t TrieStack::num_levels() const {
+  return snapshot()->size();
+}
+
+int TrieStack::find(std::string_view key, float *weight) const {
+  const std::shared_ptr<const Levels> levels = snapshot();
+  Agent agent;
+  agent.set_query(key);
+  for (std::size_t i = levels->size(); i > 0; --i) {
+    const TrieLevel &level = *(*levels)[i - 1];
+    bool tombstone;
+    if (level.lookup(agent, &tombstone)) {
+      if (tombstone) {
+        return -1;
+      }
+      if (weight != nullptr) {
+        *weight = level.weight(agent.key().id());
+      }
+      return 1;
+    }
+  }
+  return 0;
+}
+
+std::size_t TrieStack::predictive_search(std::string_view prefix,
+                                         std::size_t max_results,
+                                         std::vector<Result> *results,
+                                         std::size_t scan_limit) const {
+  MARISA_THROW_IF(results == nullptr, std::invalid_argument);
+  results->clear();
+  if (max_results == 0) {
+    return 0;
+  }
+  if (scan_limit == 0) {
+    scan_limit = max_results * 8;
+  }
+
+  // Levels are scanned from the top, so the first level that yields a key
+  // is its topmost one unless a level above holds it beyond its scan limit,
+  // which the lookups in the levels above catch.
+  const std::shared_ptr<const Levels> levels = snapshot();
+  std::unordered_set<std::string> seen;
+  Agent agent;
+  Agent upper_agent;
+  for (std::size_t i = levels->size(); i > 0; --i) {
+    const TrieLevel &level = *(*levels)[i - 1];
+    std::size_t num_scanned = 0;
+    agent.set_query(prefix);
+    level.trie().predictive_search(agent, [&](const Key &key) {
+      if (!seen.insert(std::string(key.str())).second) {
+        return ++num_scanned < scan_limit;
+      }
+      const TrieLevel *owner = &level;
+      std::size_t key_id = key.id();
+      upper_agent.set_query(key.str());
+      for (std::size_t j = levels->size(); j > i; --j) {
+        if ((*levels)[j - 1]->lookup(upper_agent)) {
+          owner = (*levels)[j - 1].get();
+          key_id = upper_agent.key().id();
+          break;
+        }
+      }
+      if (!owner->is_tombstone(key_id)) {
+        results->push_back(Result{std::string(key.str()),
+                                  owner->weight(key_id)});
+      }
+      return ++num_scanned < scan_limit;
+    });
+  }
+
+  std::stable_sort(results->begin(), results->end(),
+                   [](const Result &lhs, const Result &rhs) {
+                     return lhs.weight > rhs.weight;
+                   });
+  if (results->size() > max_results) {
+    results->resize(max_results);
+  }
+  return results->size();
+}
+
+void TrieStack::compact(std::size_t first, bool drop_tombstones,
+                        int config_flags) {
+  std::lock_guard<std::mutex> compact_lock(compact_mutex_);
+
+  const std::shared_ptr<const Levels> levels = snapshot();
+  const std::size_t last = levels->size();
+  MARISA_THROW_IF(first > last, std::out_of_range);
+  if ((first == last) || ((last - first == 1) && !drop_tombstones)) {
+    return;
+  }
+
+  Keyset keyset;
+  Keyset tombstones;
+  std::unordered_set<std::string> seen;
+  Agent agent;
+  for (std::size_t i = last; i > first; --i) {
+    const TrieLevel &level = *(*levels)[i - 1];
+    agent.set_query("");
+    level.trie().predictive_search(agent, [&](const Key &key) {
+      if (seen.insert(std::string(key.str())).second) {
+        if (!level.is_tombstone(key.id())) {
+          keyset.push_back(key.str(), level.weight(key.id()));
+        } else if (!drop_tombstones) {
+          tombstones.push_back(key.str());
+        }
+      }
+      return true;
+    });
+  }
+  seen.clear();
+
+  auto merged = std::make_shared<TrieLevel>();
+  merged->build(keyset, &tombstones, config_flags);
+
+  std::lock_guard<std::mutex> lock(levels_mutex_);
+  // clear() may have run meanwhile, and then the merged levels are gone.
+  if ((levels_->size() < last) ||
+      !std::equal(levels->begin(), levels->end(), levels_->begin())) {
+    return;
+  }
+  auto compacted = std::make_shared<Levels>(levels_->begin(),
+                                            levels_->begin() + first);
+  compacted->push_back(std::move(merged));
+  compacted->insert(compacted->end(), levels_->begin() + last, levels_->end());
+  levels_ = std::move(compacted);
+}
+
+void TrieStack::clear() {
+  auto empty = std::make_shared<const Levels>();
+  std::lock_guard<std::mutex> lock(levels_mutex_);
+  levels_.swap(empty);
+}
+
+std::shared_ptr<const TrieStack::Levels> TrieStack::snapshot() const {
+  std::lock_guard<std::mutex> lock(levels_mutex_);
+  return levels_;
+}
+
+}  // namespace marisa
@@ -17,10 +17,18 @@ Trie::Trie(Trie &&other) noexcept = default;
 
 Trie &Trie::operator=(Trie &&other) noexcept = default;
 
-void Trie::build(Keyset &keyset, int config_flags) {
+void Trie::build(Keyset &keyset, int config_flags, std::size_t num_threads) {
   std::unique_ptr<grimoire::LoudsTrie> temp(new grimoire::LoudsTrie);
 
-  temp->build(keyset, config_flags);
+  temp->build(keyset, config_flags, num_threads);
+  trie_.swap(temp);
+}
+
+void Trie::build(Keyset &keyset, const Keyset &query_log, int config_flags,
+                 std::size_t num_threads) {
+  std::unique_ptr<grimoire::LoudsTrie> temp(new grimoire::LoudsTrie);
+
+  temp->build(keyset, config_flags, num_threads, &query_log);
   trie_.swap(temp);
 }
 
@@ -94,6 +102,16 @@ bool Trie::lookup(Agent &agent) const {
   return trie_->lookup(agent);
 }
 
+std::size_t Trie::lookup_batch(const std::string_view *keys,
+                               std::size_t num_keys,
+                               std::size_t *key_ids) const {
+  MARISA_THROW_IF(trie_ == nullptr, std::logic_error);
+  MARISA_THROW_IF((keys == nullptr) && (num_keys != 0), std::invalid_argument);
+  MARISA_THROW_IF((key_ids == nullptr) && (num_keys != 0),
+                  std::invalid_argument);
+  return trie_->lookup_batch(keys, num_keys, key_ids);
+}
+
 void Trie::reverse_lookup(Agent &agent) const {
   MARISA_THROW_IF(trie_ == nullptr, std::logic_error);
   if (!agent.has_state()) {
@@ -118,6 +136,12 @@ bool Trie::predictive_search(Agent &agent) const {
   return trie_->predictive_search(agent);
 }
 
+void Trie::count_cache_hits(const Keyset &queries, double *num_hits,
+                            double *num_misses) const {
+  MARISA_THROW_IF(trie_ == nullptr, std::logic_error);
+  trie_->count_cache_hits(queries, num_hits, num_misses);
+}
+
 std::size_t Trie::num_tries() const {
   MARISA_THROW_IF(trie_ == nullptr, std::logic_error);
   return trie_->num_tries();
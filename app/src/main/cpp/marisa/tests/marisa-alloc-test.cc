@@ -0,0 +1,237 @@
+// Counts the heap allocations of KazakhContextPredictor::pureContextPredict()
+// and contextPredict() per key stroke.
+//
+// A bigram dictionary of Kazakh words, some long enough that std::string
+// keeps them on the heap, is built both in UTF-8 and with KazakhAlphabet.
+// Each key stroke predicts the words after a previous word into the same
+// result buffer, with pureContextPredict(), or with contextPredict() and the
+// first one or two letters of the next word. After the first round has grown
+// the agent pool, the buffer and the cache of contextPredict(), no key stroke
+// may allocate, and the results must equal the ones returned by the
+// std::vector overloads.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "marisa/KazakhAlphabet.h"
+#include "marisa/KazakhContextPredictor.h"
+#include "marisa/keyset.h"
+#include "marisa/trie.h"
+
+namespace {
+
+// Only the allocations of the thread that counts are counted, not the ones
+// of the worker threads of the predictor.
+thread_local bool counting = false;
+std::atomic<std::size_t> num_allocs(0);
+
+const char *const WORDS[] = {
+    "мен",
+    "сен",
+    "ол",
+    "біз",
+    "қазақ",
+    "тілі",
+    "мектеп",
+    "оқушы",
+    "кітапхана",
+    "университет",
+    "қазақстандықтар",
+    "ынтымақтастығымыздың",
+    "жауапкершіліктеріміздің",
+    "мемлекеттендірілгендіктен",
+};
+
+constexpr std::size_t NUM_WORDS = sizeof(WORDS) / sizeof(WORDS[0]);
+constexpr int MAX_RESULTS = 10;
+constexpr std::size_t ROUNDS = 50;
+// contextPredict() prints a line per call, so it is run fewer rounds.
+constexpr std::size_t CONTEXT_ROUNDS = 5;
+
+// Every word is followed by every other word.
+void build_bigrams(const char *filename, bool encoded) {
+  marisa::Keyset keyset;
+  for (std::size_t i = 0; i < NUM_WORDS; ++i) {
+    for (std::size_t j = 0; j < NUM_WORDS; ++j) {
+      if (i != j) {
+        const std::string key = std::string(WORDS[i]) + " " + WORDS[j];
+        keyset.push_back(key.c_str(), key.length());
+      }
+    }
+  }
+  marisa::Trie trie;
+  if (encoded) {
+    marisa::KazakhAlphabet::buildTrie(keyset, trie);
+  } else {
+    trie.build(keyset);
+  }
+  trie.save(filename);
+}
+
+// The first num letters of word in UTF-8.
+std::string first_letters(const char *word, std::size_t num) {
+  std::size_t length = 0;
+  for (std::size_t i = 0; (i < num) && (word[length] != '\0'); ++i) {
+    ++length;
+    while ((static_cast<unsigned char>(word[length]) & 0xC0) == 0x80) {
+      ++length;
+    }
+  }
+  return std::string(word, length);
+}
+
+// Returns the number of failures.
+std::size_t test_context_predict(marisa::KazakhContextPredictor &predictor,
+                                 const char *name) {
+  std::vector<std::string> prefixes;
+  for (const char *word : WORDS) {
+    for (std::size_t num = 1; num <= 2; ++num) {
+      const std::string prefix = first_letters(word, num);
+      if (std::find(prefixes.begin(), prefixes.end(), prefix) ==
+          prefixes.end()) {
+        prefixes.push_back(prefix);
+      }
+    }
+  }
+
+  const std::vector<std::string> previous_words(WORDS, WORDS + NUM_WORDS);
+  std::size_t failures = 0;
+  std::size_t num_results = 0;
+  std::vector<std::string> results;
+  for (const std::string &previous_word : previous_words) {
+    for (const std::string &prefix : prefixes) {
+      const std::size_t count =
+          predictor.contextPredict(previous_word, prefix, MAX_RESULTS, results);
+      const std::vector<std::string> expected =
+          predictor.contextPredict(previous_word, prefix, MAX_RESULTS);
+      if ((count != expected.size()) ||
+          !std::equal(expected.begin(), expected.end(), results.begin())) {
+        std::fprintf(stderr, "%s: context results after \"%s\" for \"%s\" "
+                     "differ\n", name, previous_word.c_str(), prefix.c_str());
+        failures++;
+      }
+      num_results += count;
+    }
+  }
+  if (num_results == 0) {
+    std::fprintf(stderr, "%s: no context results\n", name);
+    failures++;
+  }
+
+  // The check above swapped the results of the cache misses into the
+  // buffer, so its strings grow to the longest results in one more round.
+  for (const std::string &previous_word : previous_words) {
+    for (const std::string &prefix : prefixes) {
+      predictor.contextPredict(previous_word, prefix, MAX_RESULTS, results);
+    }
+  }
+
+  std::size_t key_strokes = 0;
+  num_allocs = 0;
+  counting = true;
+  for (std::size_t r = 0; r < CONTEXT_ROUNDS; ++r) {
+    for (const std::string &previous_word : previous_words) {
+      for (const std::string &prefix : prefixes) {
+        predictor.contextPredict(previous_word, prefix, MAX_RESULTS, results);
+        key_strokes++;
+      }
+    }
+  }
+  counting = false;
+
+  std::printf("%s: %zu context key strokes, %zu allocations\n", name,
+              key_strokes, num_allocs.load());
+  if (num_allocs != 0) {
+    failures++;
+  }
+  return failures;
+}
+
+// Returns the number of failures.
+std::size_t run(const char *filename, bool encoded) {
+  const char *name = encoded ? "encoded" : "utf-8";
+  build_bigrams(filename, encoded);
+  marisa::KazakhContextPredictor predictor;
+  if (!predictor.loadBigramFromFile(filename)) {
+    std::fprintf(stderr, "%s: failed to load %s\n", name, filename);
+    return 1;
+  }
+
+  std::vector<std::string> previous_words(WORDS, WORDS + NUM_WORDS);
+  std::size_t failures = 0;
+  std::vector<std::string> results;
+  for (const std::string &previous_word : previous_words) {
+    const std::size_t count =
+        predictor.pureContextPredict(previous_word, MAX_RESULTS, results);
+    const std::vector<std::string> expected =
+        predictor.pureContextPredict(previous_word, MAX_RESULTS);
+    if ((count != expected.size()) || (count == 0) ||
+        !std::equal(expected.begin(), expected.end(), results.begin())) {
+      std::fprintf(stderr, "%s: results after \"%s\" differ\n", name,
+                   previous_word.c_str());
+      failures++;
+    }
+  }
+
+  std::size_t key_strokes = 0;
+  num_allocs = 0;
+  counting = true;
+  for (std::size_t r = 0; r < ROUNDS; ++r) {
+    for (const std::string &previous_word : previous_words) {
+      predictor.pureContextPredict(previous_word, MAX_RESULTS, results);
+      key_strokes++;
+    }
+  }
+  counting = false;
+
+  std::printf("%s: %zu key strokes, %zu allocations\n", name, key_strokes,
+              num_allocs.load());
+  if (num_allocs != 0) {
+    failures++;
+  }
+  failures += test_context_predict(predictor, name);
+  std::remove(filename);
+  return failures;
+}
+
+}  // namespace
+
+void *operator new(std::size_t size) {
+  if (counting) {
+    num_allocs++;
+  }
+  if (size == 0) {
+    size = 1;
+  }
+  if (void *ptr = std::malloc(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+int main(int argc, char *argv[]) {
+  const char *filename = (argc > 1) ? argv[1] : "marisa-alloc-test.dic";
+  std::size_t failures = 0;
+  try {
+    failures += run(filename, false);
+    failures += run(filename, true);
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "error: %s\n", e.what());
+    return 1;
+  }
+  return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+// Checks the order of KazakhContextPredictor::prefixSearch() while words are
+// added to and removed from the user word delta.
+//
+// A unigram dictionary is written with the frequency of each word as its
+// score, and once more without scores. A word added by the user ranks by its
+// weight among the words of the dictionary. A word of the dictionary which
+// the user removes goes back to where it was before the user added it, not
+// to the top, and a word which only the user had added is gone.
+
+#include <cstdio>
+#include <exception>
+#include <stdexcept>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "marisa/KazakhContextPredictor.h"
+#include "marisa/agent.h"
+#include "marisa/keyset.h"
+#include "marisa/payload.h"
+#include "marisa/trie.h"
+
+namespace {
+
+struct Word {
+  const char *word;
+  float frequency;
+};
+
+const Word WORDS[] = {
+    {"қазақ", 100.0f},
+    {"қазір", 80.0f},
+    {"қазан", 50.0f},
+    {"қазына", 10.0f},
+    {"мектеп", 70.0f},
+};
+
+const char PREFIX[] = "қаз";
+constexpr int MAX_RESULTS = 10;
+
+// Writes the trie and, if with_scores, the frequencies right after it.
+void build_unigrams(const char *filename, bool with_scores) {
+  marisa::Keyset keyset;
+  for (const Word &w : WORDS) {
+    keyset.push_back(w.word);
+  }
+  marisa::Trie trie;
+  trie.build(keyset);
+
+  const int fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    throw std::runtime_error(std::string("failed to open ") + filename);
+  }
+  trie.write(fd);
+  if (with_scores) {
+    std::vector<float> scores(trie.num_keys());
+    for (const Word &w : WORDS) {
+      marisa::Agent agent;
+      agent.set_query(w.word);
+      trie.lookup(agent);
+      scores[agent.key().id()] = w.frequency;
+    }
+    marisa::Payload payload;
+    payload.build(scores.size(), 0, nullptr, scores.data());
+    payload.write(fd);
+  }
+  ::close(fd);
+}
+
+std::string join(const std::vector<std::string> &words) {
+  std::string joined;
+  for (const std::string &word : words) {
+    if (!joined.empty()) {
+      joined += ' ';
+    }
+    joined += word;
+  }
+  return joined;
+}
+
+// Returns 1 if the results for PREFIX are not expected.
+std::size_t check(const char *name, const char *step,
+                  marisa::KazakhContextPredictor &predictor,
+                  const std::vector<std::string> &expected) {
+  const std::vector<std::string> results =
+      predictor.prefixSearch(PREFIX, MAX_RESULTS);
+  if (results != expected) {
+    std::fprintf(stderr, "%s: %s: got \"%s\", expected \"%s\"\n", name, step,
+                 join(results).c_str(), join(expected).c_str());
+    return 1;
+  }
+  return 0;
+}
+
+// Returns the number of failures.
+std::size_t run(const char *filename, bool with_scores) {
+  const char *name = with_scores ? "scores" : "trie order";
+  build_unigrams(filename, with_scores);
+  marisa::KazakhContextPredictor predictor;
+  if (!predictor.loadUnigramFromFile(filename)) {
+    std::fprintf(stderr, "%s: failed to load %s\n", name, filename);
+    return 1;
+  }
+
+  const std::vector<std::string> base = predictor.prefixSearch(PREFIX, MAX_RESULTS);
+  std::size_t failures = 0;
+  if (with_scores) {
+    failures += check(name, "dictionary", predictor,
+                      {"қазақ", "қазір", "қазан", "қазына"});
+  } else if (base.size() != 4) {
+    std::fprintf(stderr, "%s: got \"%s\"\n", name, join(base).c_str());
+    failures++;
+  }
+
+  // The user learns a new word and a word of the dictionary.
+  predictor.addUserWordDelta({"қазандық", "қазына"}, {60.0f, 90.0f}, {});
+  if (with_scores) {
+    failures += check(name, "added", predictor,
+                      {"қазақ", "қазына", "қазір", "қазандық", "қазан"});
+  } else {
+    std::vector<std::string> expected = {"қазына", "қазандық"};
+    for (const std::string &word : base) {
+      if (word != "қазына") {
+        expected.push_back(word);
+      }
+    }
+    failures += check(name, "added", predictor, expected);
+  }
+
+  // Both are removed from the user dictionary again.
+  predictor.addUserWordDelta({}, {}, {"қазына", "қазандық"});
+  failures += check(name, "removed", predictor,
+                    with_scores ? std::vector<std::string>{"қазақ", "қазір",
+                                                           "қазан", "қазына"}
+                                : base);
+  if (!predictor.exactMatch("қазына") || predictor.exactMatch("қазандық")) {
+    std::fprintf(stderr, "%s: removed words are not matched as expected\n",
+                 name);
+    failures++;
+  }
+
+  std::printf("%s: %zu failures\n", name, failures);
+  std::remove(filename);
+  return failures;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  const char *filename = (argc > 1) ? argv[1] : "marisa-delta-test.dic";
+  std::size_t failures = 0;
+  try {
+    failures += run(filename, true);
+    failures += run(filename, false);
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "error: %s\n", e.what());
+    return 1;
+  }
+  return (failures == 0) ? 0 : 1;
+}
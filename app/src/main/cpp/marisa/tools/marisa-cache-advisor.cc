@@ -0,0 +1,254 @@
+// Replays a query log against a dictionary and recommends a cache level.
+//
+// The keys of DIC are rebuilt at each cache level, once with the static
+// cache and once with the cache tuned by the log, and the log is replayed on
+// both to count how many transitions of the first trie miss the cache.
+//
+// LOG has one typed prefix per line, optionally followed by a tab and the
+// number of times it was typed. Prefixes are UTF-8; they are encoded when
+// DIC uses the single-byte Kazakh alphabet.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "marisa/KazakhAlphabet.h"
+#include "marisa/trie.h"
+
+namespace {
+
+struct Level {
+  const char *name;
+  int flag;
+};
+
+const Level LEVELS[] = {
+    {"tiny", MARISA_TINY_CACHE},     {"small", MARISA_SMALL_CACHE},
+    {"normal", MARISA_NORMAL_CACHE}, {"large", MARISA_LARGE_CACHE},
+    {"huge", MARISA_HUGE_CACHE},
+};
+constexpr std::size_t NUM_LEVELS = sizeof(LEVELS) / sizeof(LEVELS[0]);
+
+// A level is good enough when its tuned miss rate is within this many
+// percentage points of the best level.
+constexpr double MISS_RATE_SLACK = 1.0;
+
+struct Result {
+  std::size_t io_size;
+  double static_miss_rate;
+  double tuned_miss_rate;
+  double static_ns;
+  double tuned_ns;
+};
+
+void print_usage(const char *cmd) {
+  std::fprintf(stderr,
+               "Usage: %s [OPTION]... DIC LOG\n\n"
+               "Options:\n"
+               "  -o, --output=FILE   write DIC rebuilt with the recommended"
+               " level and the tuned cache\n"
+               "  -t, --threads=N     build on N threads (default: 1)\n"
+               "  -h, --help          print this help\n",
+               cmd);
+}
+
+bool read_log(const char *filename, bool encoded, marisa::Keyset &log) {
+  std::ifstream file(filename);
+  if (!file) {
+    return false;
+  }
+  std::string line;
+  std::string query;
+  while (std::getline(file, line)) {
+    float count = 1.0F;
+    const std::size_t tab = line.find('\t');
+    if (tab != std::string::npos) {
+      count = std::strtof(line.c_str() + tab + 1, nullptr);
+      line.resize(tab);
+    }
+    if (line.empty() || !(count > 0.0F)) {
+      continue;
+    }
+    query.clear();
+    if (encoded) {
+      marisa::KazakhAlphabet::encode(line, query);
+    } else {
+      query = line;
+    }
+    log.push_back(query, count);
+  }
+  return true;
+}
+
+double miss_rate(const marisa::Trie &trie, const marisa::Keyset &log) {
+  double num_hits = 0.0;
+  double num_misses = 0.0;
+  trie.count_cache_hits(log, &num_hits, &num_misses);
+  const double total = num_hits + num_misses;
+  return (total != 0.0) ? (100.0 * num_misses / total) : 0.0;
+}
+
+// Nanoseconds per keystroke: the first prediction for each logged prefix,
+// best of three runs.
+double replay_ns(const marisa::Trie &trie, const marisa::Keyset &log) {
+  marisa::Agent agent;
+  double best = 0.0;
+  for (int run = 0; run < 3; ++run) {
+    const auto begin = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < log.size(); ++i) {
+      agent.set_query(log[i].str());
+      trie.predictive_search(agent);
+    }
+    const auto end = std::chrono::steady_clock::now();
+    const double ns =
+        std::chrono::duration<double, std::nano>(end - begin).count() /
+        static_cast<double>(std::max<std::size_t>(log.size(), 1));
+    best = (run == 0) ? ns : std::min(best, ns);
+  }
+  return best;
+}
+
+// Trie::build() overwrites the weights of a keyset with key IDs, so each
+// build gets a fresh keyset.
+void build(const std::vector<std::string> &keys, const marisa::Keyset *log,
+           int config_flags, std::size_t num_threads, marisa::Trie &trie) {
+  marisa::Keyset keyset;
+  for (const std::string &key : keys) {
+    keyset.push_back(key);
+  }
+  if (log != nullptr) {
+    trie.build(keyset, *log, config_flags, num_threads);
+  } else {
+    trie.build(keyset, config_flags, num_threads);
+  }
+}
+
+// Rebuilt keys get uniform weights, which keeps key IDs only if DIC was
+// built that way too. Payloads are indexed by key ID, so check.
+bool same_key_ids(const marisa::Trie &lhs, const marisa::Trie &rhs) {
+  marisa::Agent agent;
+  for (std::size_t i = 0; i < lhs.num_keys(); ++i) {
+    agent.set_query(i);
+    lhs.reverse_lookup(agent);
+    const std::string key(agent.key().str());
+    agent.set_query(key);
+    if (!rhs.lookup(agent) || (agent.key().id() != i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  const char *output = nullptr;
+  std::size_t num_threads = 1;
+  const char *args[2];
+  std::size_t num_args = 0;
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if ((std::strcmp(arg, "-h") == 0) || (std::strcmp(arg, "--help") == 0)) {
+      print_usage(argv[0]);
+      return 0;
+    } else if ((std::strcmp(arg, "-o") == 0) && (i + 1 < argc)) {
+      output = argv[++i];
+    } else if (std::strncmp(arg, "--output=", 9) == 0) {
+      output = arg + 9;
+    } else if ((std::strcmp(arg, "-t") == 0) && (i + 1 < argc)) {
+      num_threads = std::strtoul(argv[++i], nullptr, 10);
+    } else if (std::strncmp(arg, "--threads=", 10) == 0) {
+      num_threads = std::strtoul(arg + 10, nullptr, 10);
+    } else if ((arg[0] != '-') && (num_args < 2)) {
+      args[num_args++] = arg;
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (num_args != 2) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  try {
+    marisa::Trie dic;
+    dic.load(args[0]);
+    const bool encoded = marisa::KazakhAlphabet::isEncoded(dic);
+
+    std::vector<std::string> keys;
+    marisa::Agent agent;
+    agent.set_query("");
+    while (dic.predictive_search(agent)) {
+      keys.emplace_back(agent.key().str());
+    }
+
+    marisa::Keyset log;
+    if (!read_log(args[1], encoded, log)) {
+      std::fprintf(stderr, "error: failed to read %s\n", args[1]);
+      return 1;
+    }
+    std::fprintf(stderr, "%zu keys, %zu logged prefixes%s\n", keys.size(),
+                 log.size(), encoded ? ", Kazakh alphabet" : "");
+
+    const int config_flags = static_cast<int>(dic.num_tries()) |
+                             dic.tail_mode() | dic.node_order();
+
+    Result results[NUM_LEVELS];
+    std::printf("%-8s %10s %12s %12s %10s %10s\n", "level", "bytes",
+                "static miss%", "tuned miss%", "static ns", "tuned ns");
+    for (std::size_t i = 0; i < NUM_LEVELS; ++i) {
+      marisa::Trie static_trie;
+      build(keys, nullptr, config_flags | LEVELS[i].flag, num_threads,
+            static_trie);
+      marisa::Trie tuned_trie;
+      build(keys, &log, config_flags | LEVELS[i].flag, num_threads,
+            tuned_trie);
+
+      Result &result = results[i];
+      result.io_size = tuned_trie.io_size();
+      result.static_miss_rate = miss_rate(static_trie, log);
+      result.tuned_miss_rate = miss_rate(tuned_trie, log);
+      result.static_ns = replay_ns(static_trie, log);
+      result.tuned_ns = replay_ns(tuned_trie, log);
+      std::printf("%-8s %10zu %12.2f %12.2f %10.1f %10.1f\n", LEVELS[i].name,
+                  result.io_size, result.static_miss_rate,
+                  result.tuned_miss_rate, result.static_ns, result.tuned_ns);
+    }
+
+    double best_miss_rate = results[0].tuned_miss_rate;
+    for (std::size_t i = 1; i < NUM_LEVELS; ++i) {
+      best_miss_rate = std::min(best_miss_rate, results[i].tuned_miss_rate);
+    }
+    std::size_t recommended = 0;
+    while (results[recommended].tuned_miss_rate >
+           best_miss_rate + MISS_RATE_SLACK) {
+      ++recommended;
+    }
+    std::printf("recommended: %s\n", LEVELS[recommended].name);
+
+    if (output != nullptr) {
+      marisa::Trie tuned_trie;
+      build(keys, &log, config_flags | LEVELS[recommended].flag, num_threads,
+            tuned_trie);
+      if (!same_key_ids(dic, tuned_trie)) {
+        std::fprintf(stderr,
+                     "error: key IDs of %s depend on weights that the trie"
+                     " does not keep; %s not written\n",
+                     args[0], output);
+        return 1;
+      }
+      tuned_trie.save(output);
+    }
+  } catch (const std::exception &ex) {
+    std::fprintf(stderr, "error: %s\n", ex.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,135 @@
+// Compiles emoji keyword files into the keyword index that EmojiIndex maps
+// from a file.
+//
+// Each FILE has the format of assets/emoji_en.txt: "[category]" lines and
+// "emoji;name;keyword|keyword|..." lines, where indented lines are skin tone
+// variants and '#' starts a comment. Variants are not indexed, as search
+// only shows base emojis. Emojis are ranked by their first appearance, so
+// the first FILE sets the order; later files, e.g. another language, only
+// add keywords.
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "marisa/EmojiIndex.h"
+
+namespace {
+
+void print_usage(const char *cmd) {
+  std::fprintf(stderr,
+               "Usage: %s [OPTION]... FILE...\n\n"
+               "Options:\n"
+               "  -o, --output=FILE   write the index to FILE (required)\n"
+               "  -h, --help          print this help\n",
+               cmd);
+}
+
+void split(const std::string &line, char delimiter,
+           std::vector<std::string> &fields) {
+  fields.clear();
+  std::size_t begin = 0;
+  for (;;) {
+    const std::size_t end = line.find(delimiter, begin);
+    fields.push_back(line.substr(begin, end - begin));
+    if (end == std::string::npos) {
+      break;
+    }
+    begin = end + 1;
+  }
+}
+
+// Merges the emojis of a keyword file into entries and returns the number
+// of emojis read, or -1 if the file could not be opened.
+long read_file(const char *filename,
+               std::vector<marisa::EmojiIndex::Entry> &entries,
+               std::unordered_map<std::string, std::size_t> &indices) {
+  std::ifstream file(filename);
+  if (!file) {
+    std::fprintf(stderr, "error: failed to open %s\n", filename);
+    return -1;
+  }
+  long num_emojis = 0;
+  std::string line;
+  std::vector<std::string> fields;
+  std::vector<std::string> keywords;
+  while (std::getline(file, line)) {
+    if (line.empty() || (line[0] == '#') || (line[0] == '[') ||
+        (line[0] == ' ') || (line[0] == '\t')) {
+      continue;
+    }
+    split(line, ';', fields);
+    if ((fields.size() < 2) || fields[0].empty()) {
+      continue;
+    }
+    auto inserted = indices.emplace(fields[0], entries.size());
+    if (inserted.second) {
+      entries.push_back(marisa::EmojiIndex::Entry{fields[0], {}});
+    }
+    marisa::EmojiIndex::Entry &entry = entries[inserted.first->second];
+    entry.keywords.push_back(fields[1]);
+    if (fields.size() > 2) {
+      split(fields[2], '|', keywords);
+      entry.keywords.insert(entry.keywords.end(), keywords.begin(),
+                            keywords.end());
+    }
+    ++num_emojis;
+  }
+  return num_emojis;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  const char *output = nullptr;
+  std::vector<const char *> inputs;
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if ((std::strcmp(arg, "-h") == 0) || (std::strcmp(arg, "--help") == 0)) {
+      print_usage(argv[0]);
+      return 0;
+    } else if ((std::strcmp(arg, "-o") == 0) && (i + 1 < argc)) {
+      output = argv[++i];
+    } else if (std::strncmp(arg, "--output=", 9) == 0) {
+      output = arg + 9;
+    } else if (arg[0] != '-') {
+      inputs.push_back(arg);
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (inputs.empty() || (output == nullptr)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<marisa::EmojiIndex::Entry> entries;
+  std::unordered_map<std::string, std::size_t> indices;
+  for (const char *input : inputs) {
+    const long num_emojis = read_file(input, entries, indices);
+    if (num_emojis < 0) {
+      return 1;
+    }
+    std::fprintf(stderr, "%s: %ld emojis\n", input, num_emojis);
+  }
+
+  try {
+    marisa::EmojiIndex::build(entries, output);
+
+    marisa::EmojiIndex index;
+    if (!index.loadFromFile(output)) {
+      std::fprintf(stderr, "error: failed to reopen %s\n", output);
+      return 1;
+    }
+    std::fputs(index.getInfo().c_str(), stderr);
+  } catch (const std::exception &ex) {
+    std::fprintf(stderr, "error: %s\n", ex.what());
+    return 1;
+  }
+  return 0;
+}
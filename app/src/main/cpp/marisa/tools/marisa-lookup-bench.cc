@@ -0,0 +1,184 @@
+// Times Trie::lookup_batch() against one Trie::lookup() per key.
+//
+// The queries look like the spelling candidates of KazakhContextPredictor:
+// for random keys of DIC, the key itself and the keys one edit away, made
+// position by position (a deletion, a swap of neighbouring bytes and an
+// insertion at each position), so that neighbouring queries share long
+// prefixes. They are taken in batches in the order they were made. Each
+// batch size is timed on the same queries with both lookups, best of the
+// runs, and the key IDs of both must be the same.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "marisa/agent.h"
+#include "marisa/trie.h"
+
+namespace {
+
+void print_usage(const char *cmd) {
+  std::fprintf(stderr,
+               "Usage: %s [OPTION]... DIC\n\n"
+               "Options:\n"
+               "  -b, --batch=N       time batches of N keys, may be given "
+               "more than once\n"
+               "                      (default: 8, 64 and 512)\n"
+               "  -q, --queries=N     look up N keys per run "
+               "(default: 200000)\n"
+               "  -r, --runs=N        keep the best of N runs (default: 5)\n"
+               "  -h, --help          print this help\n",
+               cmd);
+}
+
+std::vector<std::string> make_queries(const marisa::Trie &trie,
+                                      std::size_t num_queries) {
+  std::vector<std::string> keys;
+  marisa::Agent agent;
+  agent.set_query("");
+  while (trie.predictive_search(agent)) {
+    keys.emplace_back(agent.key().ptr(), agent.key().length());
+  }
+
+  std::vector<std::string> queries;
+  queries.reserve(num_queries);
+  std::mt19937 random(1);
+  while ((queries.size() < num_queries) && !keys.empty()) {
+    const std::string &key = keys[random() % keys.size()];
+    queries.push_back(key);
+    for (std::size_t pos = 0; pos < key.length(); ++pos) {
+      std::string query = key;
+      queries.push_back(query.erase(pos, 1));
+      if (pos + 1 < key.length()) {
+        query = key;
+        std::swap(query[pos], query[pos + 1]);
+        queries.push_back(query);
+      }
+      query = key;
+      queries.push_back(query.insert(pos, 1, key[random() % key.length()]));
+    }
+  }
+  queries.resize(std::min(queries.size(), num_queries));
+  return queries;
+}
+
+double elapsed_ns(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now() - begin)
+      .count();
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  std::vector<std::size_t> batch_sizes;
+  std::size_t num_queries = 200000;
+  std::size_t num_runs = 5;
+  const char *dic = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if ((std::strcmp(arg, "-h") == 0) || (std::strcmp(arg, "--help") == 0)) {
+      print_usage(argv[0]);
+      return 0;
+    } else if ((std::strcmp(arg, "-b") == 0) && (i + 1 < argc)) {
+      batch_sizes.push_back(std::strtoul(argv[++i], nullptr, 10));
+    } else if (std::strncmp(arg, "--batch=", 8) == 0) {
+      batch_sizes.push_back(std::strtoul(arg + 8, nullptr, 10));
+    } else if ((std::strcmp(arg, "-q") == 0) && (i + 1 < argc)) {
+      num_queries = std::strtoul(argv[++i], nullptr, 10);
+    } else if (std::strncmp(arg, "--queries=", 10) == 0) {
+      num_queries = std::strtoul(arg + 10, nullptr, 10);
+    } else if ((std::strcmp(arg, "-r") == 0) && (i + 1 < argc)) {
+      num_runs = std::strtoul(argv[++i], nullptr, 10);
+    } else if (std::strncmp(arg, "--runs=", 7) == 0) {
+      num_runs = std::strtoul(arg + 7, nullptr, 10);
+    } else if ((arg[0] != '-') && (dic == nullptr)) {
+      dic = arg;
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (batch_sizes.empty()) {
+    batch_sizes = {8, 64, 512};
+  }
+  if ((dic == nullptr) || (num_queries == 0) || (num_runs == 0) ||
+      (std::find(batch_sizes.begin(), batch_sizes.end(), 0) !=
+       batch_sizes.end())) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  try {
+    marisa::Trie trie;
+    trie.load(dic);
+    const std::vector<std::string> queries = make_queries(trie, num_queries);
+    const std::vector<std::string_view> views(queries.begin(), queries.end());
+    std::fprintf(stderr, "%s: %zu keys, %zu queries\n", dic, trie.num_keys(),
+                 views.size());
+
+    std::size_t num_mismatches = 0;
+    std::printf("%8s %14s %14s %8s %8s\n", "batch", "lookup ns/key",
+                "batch ns/key", "speedup", "found%");
+    for (const std::size_t batch_size : batch_sizes) {
+      const std::size_t num_batches = views.size() / batch_size;
+      const std::size_t num_keys = num_batches * batch_size;
+      if (num_keys == 0) {
+        continue;
+      }
+      std::vector<std::size_t> lookup_ids(num_keys);
+      std::vector<std::size_t> batch_ids(num_keys);
+      std::size_t num_found = 0;
+      double lookup_ns = 0.0;
+      double batch_ns = 0.0;
+      marisa::Agent agent;
+      for (std::size_t run = 0; run < num_runs; ++run) {
+        auto begin = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < num_keys; ++i) {
+          agent.set_query(views[i].data(), views[i].length());
+          lookup_ids[i] =
+              trie.lookup(agent) ? agent.key().id() : MARISA_INVALID_KEY_ID;
+        }
+        const double run_lookup_ns = elapsed_ns(begin);
+
+        begin = std::chrono::steady_clock::now();
+        num_found = 0;
+        for (std::size_t b = 0; b < num_batches; ++b) {
+          num_found += trie.lookup_batch(&views[b * batch_size], batch_size,
+                                         &batch_ids[b * batch_size]);
+        }
+        const double run_batch_ns = elapsed_ns(begin);
+
+        lookup_ns = (run == 0) ? run_lookup_ns
+                               : std::min(lookup_ns, run_lookup_ns);
+        batch_ns = (run == 0) ? run_batch_ns : std::min(batch_ns, run_batch_ns);
+      }
+
+      for (std::size_t i = 0; i < num_keys; ++i) {
+        if (lookup_ids[i] != batch_ids[i]) {
+          ++num_mismatches;
+        }
+      }
+      std::printf("%8zu %14.1f %14.1f %7.2fx %8.1f\n", batch_size,
+                  lookup_ns / num_keys, batch_ns / num_keys,
+                  lookup_ns / batch_ns, 100.0 * num_found / num_keys);
+    }
+    if (num_mismatches != 0) {
+      std::fprintf(stderr, "error: %zu key IDs differ from lookup()\n",
+                   num_mismatches);
+      return 1;
+    }
+  } catch (const std::exception &ex) {
+    std::fprintf(stderr, "error: %s\n", ex.what());
+    return 1;
+  }
+  return 0;
+}
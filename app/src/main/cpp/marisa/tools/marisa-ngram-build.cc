@@ -0,0 +1,144 @@
+// Compiles the unigram, bigram and trigram tables of an SQLite dictionary
+// into an n-gram dictionary that NgramPredictor maps from a file.
+//
+// DB has the tables unigram(ngram, freq), bigram(w1, w2, freq) and
+// trigram(w1, w2, w3, freq). Rows are read in id order, which breaks ties
+// between equal frequencies. Words with spaces or empty words are skipped.
+
+#include <sqlite3.h>
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "marisa/NgramPredictor.h"
+
+namespace {
+
+struct Table {
+  const char *name;
+  const char *query;
+  int num_words;
+};
+
+const Table TABLES[] = {
+    {"unigram", "SELECT ngram, freq FROM unigram ORDER BY id", 1},
+    {"bigram", "SELECT w1, w2, freq FROM bigram ORDER BY id", 2},
+    {"trigram", "SELECT w1, w2, w3, freq FROM trigram ORDER BY id", 3},
+};
+
+void print_usage(const char *cmd) {
+  std::fprintf(stderr,
+               "Usage: %s [OPTION]... DB\n\n"
+               "Options:\n"
+               "  -o, --output=FILE   write the dictionary to FILE (required)\n"
+               "  -h, --help          print this help\n",
+               cmd);
+}
+
+// Appends the rows of table to entries and returns the number of rows
+// skipped, or -1 if the table could not be read.
+long read_table(sqlite3 *db, const Table &table,
+                std::vector<marisa::NgramPredictor::Entry> &entries) {
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db, table.query, -1, &stmt, nullptr) != SQLITE_OK) {
+    std::fprintf(stderr, "error: %s: %s\n", table.name, sqlite3_errmsg(db));
+    return -1;
+  }
+  long num_skipped = 0;
+  int status;
+  while ((status = sqlite3_step(stmt)) == SQLITE_ROW) {
+    marisa::NgramPredictor::Entry entry;
+    bool valid = true;
+    for (int i = 0; i < table.num_words; ++i) {
+      const char *word =
+          reinterpret_cast<const char *>(sqlite3_column_text(stmt, i));
+      if ((word == nullptr) || (*word == '\0') ||
+          (std::strchr(word, ' ') != nullptr)) {
+        valid = false;
+        break;
+      }
+      if (i != 0) {
+        entry.words.push_back(' ');
+      }
+      entry.words.append(word);
+    }
+    entry.frequency = sqlite3_column_double(stmt, table.num_words);
+    if (valid) {
+      entries.push_back(std::move(entry));
+    } else {
+      ++num_skipped;
+    }
+  }
+  sqlite3_finalize(stmt);
+  if (status != SQLITE_DONE) {
+    std::fprintf(stderr, "error: %s: %s\n", table.name, sqlite3_errmsg(db));
+    return -1;
+  }
+  return num_skipped;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  const char *output = nullptr;
+  const char *input = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if ((std::strcmp(arg, "-h") == 0) || (std::strcmp(arg, "--help") == 0)) {
+      print_usage(argv[0]);
+      return 0;
+    } else if ((std::strcmp(arg, "-o") == 0) && (i + 1 < argc)) {
+      output = argv[++i];
+    } else if (std::strncmp(arg, "--output=", 9) == 0) {
+      output = arg + 9;
+    } else if ((arg[0] != '-') && (input == nullptr)) {
+      input = arg;
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if ((input == nullptr) || (output == nullptr)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  sqlite3 *db = nullptr;
+  if (sqlite3_open_v2(input, &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+    std::fprintf(stderr, "error: failed to open %s: %s\n", input,
+                 sqlite3_errmsg(db));
+    sqlite3_close(db);
+    return 1;
+  }
+
+  std::vector<marisa::NgramPredictor::Entry> entries;
+  for (const Table &table : TABLES) {
+    const std::size_t begin = entries.size();
+    const long num_skipped = read_table(db, table, entries);
+    if (num_skipped < 0) {
+      sqlite3_close(db);
+      return 1;
+    }
+    std::fprintf(stderr, "%s: %zu rows, %ld skipped\n", table.name,
+                 entries.size() - begin, num_skipped);
+  }
+  sqlite3_close(db);
+
+  try {
+    marisa::NgramPredictor::build(entries, output);
+
+    marisa::NgramPredictor predictor;
+    if (!predictor.loadFromFile(output)) {
+      std::fprintf(stderr, "error: failed to reopen %s\n", output);
+      return 1;
+    }
+    std::fputs(predictor.getInfo().c_str(), stderr);
+  } catch (const std::exception &ex) {
+    std::fprintf(stderr, "error: %s\n", ex.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,161 @@
+// Appends word frequencies to a unigram dictionary as a payload, which
+// KazakhContextPredictor uses to rank prefix search results and spelling
+// corrections.
+//
+// DICT is a trie, in UTF-8 or encoded with KazakhAlphabet; a payload it
+// already has is replaced. FREQ has one "word<TAB>frequency" line per word,
+// where '#' starts a comment. Words of FREQ which DICT does not have are
+// skipped, and words of DICT which FREQ does not have get frequency 0. The
+// trie is written unchanged, so key IDs and results without the payload
+// stay the same.
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "marisa/KazakhAlphabet.h"
+#include "marisa/agent.h"
+#include "marisa/payload.h"
+#include "marisa/trie.h"
+
+namespace {
+
+void print_usage(const char *cmd) {
+  std::fprintf(stderr,
+               "Usage: %s [OPTION]... DICT FREQ\n\n"
+               "Options:\n"
+               "  -o, --output=FILE   write the dictionary to FILE (required)\n"
+               "  -l, --levels=N      quantize frequencies to N levels "
+               "(default: 256)\n"
+               "  -h, --help          print this help\n",
+               cmd);
+}
+
+// Reads the frequencies of the words of trie into scores and returns the
+// number of lines skipped, or -1 if the file could not be opened.
+long read_frequencies(const char *filename, const marisa::Trie &trie,
+                      std::vector<float> &scores) {
+  std::ifstream file(filename);
+  if (!file) {
+    std::fprintf(stderr, "error: failed to open %s\n", filename);
+    return -1;
+  }
+  const bool encoded = marisa::KazakhAlphabet::isEncoded(trie);
+  long num_skipped = 0;
+  std::string line;
+  std::string key;
+  marisa::Agent agent;
+  while (std::getline(file, line)) {
+    if (!line.empty() && (line.back() == '\r')) {
+      line.pop_back();
+    }
+    if (line.empty() || (line[0] == '#')) {
+      continue;
+    }
+    const std::size_t tab = line.find('\t');
+    char *end = nullptr;
+    const float frequency =
+        (tab == std::string::npos) ? 0.0f
+                                   : std::strtof(line.c_str() + tab + 1, &end);
+    if ((tab == 0) || (tab == std::string::npos) ||
+        (end == line.c_str() + tab + 1) || (frequency < 0.0f)) {
+      ++num_skipped;
+      continue;
+    }
+    key.clear();
+    if (encoded) {
+      marisa::KazakhAlphabet::encode(std::string_view(line.data(), tab), key);
+    } else {
+      key.assign(line, 0, tab);
+    }
+    agent.set_query(key.c_str(), key.length());
+    if (!trie.lookup(agent)) {
+      ++num_skipped;
+      continue;
+    }
+    scores[agent.key().id()] = frequency;
+  }
+  return num_skipped;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  const char *output = nullptr;
+  std::size_t num_levels = 256;
+  std::vector<const char *> inputs;
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if ((std::strcmp(arg, "-h") == 0) || (std::strcmp(arg, "--help") == 0)) {
+      print_usage(argv[0]);
+      return 0;
+    } else if ((std::strcmp(arg, "-o") == 0) && (i + 1 < argc)) {
+      output = argv[++i];
+    } else if (std::strncmp(arg, "--output=", 9) == 0) {
+      output = arg + 9;
+    } else if ((std::strcmp(arg, "-l") == 0) && (i + 1 < argc)) {
+      num_levels = std::strtoul(argv[++i], nullptr, 10);
+    } else if (std::strncmp(arg, "--levels=", 9) == 0) {
+      num_levels = std::strtoul(arg + 9, nullptr, 10);
+    } else if (arg[0] != '-') {
+      inputs.push_back(arg);
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if ((inputs.size() != 2) || (output == nullptr) || (num_levels == 0)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  try {
+    marisa::Trie trie;
+    trie.load(inputs[0]);
+    std::vector<float> scores(trie.num_keys(), 0.0f);
+    const long num_skipped = read_frequencies(inputs[1], trie, scores);
+    if (num_skipped < 0) {
+      return 1;
+    }
+    std::size_t num_scored = 0;
+    for (float score : scores) {
+      if (score > 0.0f) {
+        ++num_scored;
+      }
+    }
+    std::fprintf(stderr, "%s: %zu of %zu words, %ld lines skipped\n",
+                 inputs[1], num_scored, scores.size(), num_skipped);
+
+    marisa::Payload payload;
+    payload.build(scores.size(), 0, nullptr, scores.data(), num_levels);
+
+    // The trie is read into memory, so DICT may also be the output.
+    const int fd = ::open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+      std::fprintf(stderr, "error: failed to open %s\n", output);
+      return 1;
+    }
+    trie.write(fd);
+    payload.write(fd);
+    if (::close(fd) != 0) {
+      std::fprintf(stderr, "error: failed to write %s\n", output);
+      return 1;
+    }
+
+    marisa::Payload reopened;
+    reopened.load(output, trie.io_size());
+    std::fprintf(stderr, "%s: %zu keys, %zu levels\n", output,
+                 reopened.num_keys(), reopened.num_levels());
+  } catch (const std::exception &ex) {
+    std::fprintf(stderr, "error: %s\n", ex.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PINYINIME_INCLUDE_ASSOCINDEX_H__
+#define PINYINIME_INCLUDE_ASSOCINDEX_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "dictdef.h"
+#include "dictimage.h"
+#include "dictlist.h"
+#include "searchutility.h"
+
+namespace ime_pinyin {
+
+// The association index maps a history of 1 to kMaxHisLen Chinese characters
+// to the system lemmas which start with it and are longer than it, ranked by
+// their unigram scores. It is built when the system dictionary is saved and
+// is stored at the end of the image, so that a prediction for a short history
+// is one binary search plus a copy of the top items, instead of a search per
+// lemma length in DictList.
+class AssocIndex {
+ public:
+  // Longest history which has a list in the index.
+  static const uint16 kMaxHisLen = 3;
+
+  // At most this many lemmas are kept for each history.
+  static const uint16 kMaxItemsPerHis = 128;
+
+ private:
+  // A history and its list. Keys are sorted by hzs, and a shorter history is
+  // padded with 0, so it comes before the longer ones it prefixes.
+  struct AssocKey {
+    char16 hzs[kMaxHisLen];
+    uint16 item_num;
+    // Position of the first item in ids_, counted in items.
+    uint32 item_start;
+  };
+
+  AssocKey *keys_;
+  size_t key_num_;
+
+  // Lemma ids of all lists, kLemmaIdSize bytes each.
+  unsigned char *ids_;
+  size_t item_num_;
+
+  // Whether keys_ and ids_ point into a dictionary image.
+  bool in_image_;
+
+  inline LemmaIdType get_lemma_id(size_t pos);
+
+  // Find the key of the given history, NULL if there is none.
+  const AssocKey* find_key(const char16 hzs[], uint16 hzs_len);
+
+ public:
+  AssocIndex();
+  ~AssocIndex();
+
+  void free_resource();
+
+  bool load_index(DictImage *image);
+
+#ifdef ___BUILD_MODEL___
+  // Build the index from all lemmas in dict_list. NGram must be ready, because
+  // the lists are ranked by unigram scores.
+  bool build_index(DictList *dict_list);
+
+  bool save_index(FILE *fp);
+#endif
+
+  // Same as DictList::predict(), but only for a history not longer than
+  // kMaxHisLen, and only the top kMaxItemsPerHis lemmas are returned, in the
+  // order of their scores.
+  size_t predict(DictList *dict_list, const char16 last_hzs[], uint16 hzs_len,
+                 NPredictItem *npre_items, size_t npre_max, size_t b4_used);
+};
+}
+
+#endif  // PINYINIME_INCLUDE_ASSOCINDEX_H__
@@ -240,6 +240,16 @@ class AtomDictBase {
    * if necessary.
    */
   virtual void flush_cache() = 0;
+
+  /**
+   * Get the version of the contents of this atom dictionary. The version
+   * changes whenever the result of get_lpis() or the scores of the lemmas may
+   * change, so that the callers can tell whether the results they cached are
+   * still valid.
+   *
+   * @return The version of the contents.
+   */
+  virtual uint32 get_version() = 0;
 };
 }
 
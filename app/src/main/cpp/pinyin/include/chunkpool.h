@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PINYINIME_INCLUDE_CHUNKPOOL_H__
+#define PINYINIME_INCLUDE_CHUNKPOOL_H__
+
+#include <assert.h>
+#include <stdlib.h>
+#include "searchutility.h"
+
+namespace ime_pinyin {
+
+// A node pool addressed by PoolPosType, which grows in chunks of
+// (1 << kChunkBits) items.
+//
+// Chunks are never moved, so both the position and the address of an item
+// are stable when the pool grows. The pool does not count the used items;
+// its user keeps the count and rewinds it, and the chunks are kept for reuse
+// until free_chunks() is called.
+//
+// The first chunk is given by the user, e.g. a part of a shared buffer, and
+// it is not freed by the pool.
+template <typename T, size_t kChunkBits>
+class ChunkPool {
+ public:
+  static const size_t kChunkSize = static_cast<size_t>(1) << kChunkBits;
+
+  // (PoolPosType)-1 means no item, so it is never used as a position.
+  static const size_t kMaxItems = static_cast<PoolPosType>(-1);
+
+  static const size_t kMaxChunks = (kMaxItems + kChunkSize - 1) / kChunkSize;
+
+  ChunkPool() {
+    chunk_num_ = 0;
+  }
+
+  ~ChunkPool() {
+    free_chunks();
+  }
+
+  // Use first_chunk, which holds kChunkSize items, as the first chunk. The
+  // chunks allocated before are freed.
+  void init(T *first_chunk) {
+    free_chunks();
+    if (NULL != first_chunk) {
+      chunks_[0] = first_chunk;
+      chunk_num_ = 1;
+    }
+  }
+
+  // Free the chunks allocated by the pool. The pool is empty after that.
+  void free_chunks() {
+    for (size_t i = 1; i < chunk_num_; i++)
+      delete [] chunks_[i];
+    chunk_num_ = 0;
+  }
+
+  // Make sure that the items before pos_end can be used. Return false if
+  // pos_end is more than kMaxItems or the memory is used up.
+  bool reserve(size_t pos_end) {
+    if (pos_end > kMaxItems || 0 == chunk_num_)
+      return false;
+
+    while (chunk_num_ * kChunkSize < pos_end) {
+      T *chunk = new T[kChunkSize];
+      if (NULL == chunk)
+        return false;
+      chunks_[chunk_num_++] = chunk;
+    }
+    return true;
+  }
+
+  // Get the first position from pos, where num continuous items are in the
+  // same chunk, so that they can be accessed with pointer arithmetic.
+  static size_t align(size_t pos, size_t num) {
+    assert(num <= kChunkSize);
+    if ((pos & (kChunkSize - 1)) + num > kChunkSize)
+      pos = (pos | (kChunkSize - 1)) + 1;
+    return pos;
+  }
+
+  T* at(size_t pos) const {
+    assert(pos < chunk_num_ * kChunkSize);
+    return chunks_[pos >> kChunkBits] + (pos & (kChunkSize - 1));
+  }
+
+  T& operator[](size_t pos) const {
+    return *at(pos);
+  }
+
+  // The number of items which can be used without allocation.
+  size_t capacity() const {
+    return chunk_num_ * kChunkSize;
+  }
+
+ private:
+  // Not copyable, as the chunks are owned by the pool.
+  ChunkPool(const ChunkPool&);
+  ChunkPool& operator=(const ChunkPool&);
+
+  T *chunks_[kMaxChunks];
+  size_t chunk_num_;
+};
+}
+
+#endif  // PINYINIME_INCLUDE_CHUNKPOOL_H__
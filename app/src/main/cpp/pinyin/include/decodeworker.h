@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PINYINIME_INCLUDE_DECODEWORKER_H__
+#define PINYINIME_INCLUDE_DECODEWORKER_H__
+
+#include <pthread.h>
+#include <atomic>
+#include "dictdef.h"
+#include "matrixsearch.h"
+
+namespace ime_pinyin {
+
+// The first candidates of one decoded input, published by DecodeWorker.
+struct DecodePage {
+  // The maximum number of candidates in a page.
+  static const size_t kMaxCands = 32;
+
+  // The maximum length of a candidate, counted in char16. A candidate has
+  // at most one Chinese character for each letter of the input.
+  static const size_t kMaxCandLen = kMaxRowNum;
+
+  // The version returned by DecodeWorker::post_search() for the input.
+  uint32 version;
+
+  // The input, and how many of its letters were decoded.
+  char sps[kMaxRowNum];
+  size_t sps_len;
+  size_t decoded_len;
+
+  // The number of candidates of the whole search, and of this page.
+  size_t total_num;
+  size_t cand_num;
+
+  char16 cands[kMaxCands][kMaxCandLen + 1];
+  uint16 cand_lens[kMaxCands];
+};
+
+// Receives the pages of a DecodeWorker. Both functions are called on the
+// worker thread.
+class DecodeListener {
+ public:
+  virtual ~DecodeListener() {}
+
+  // A page is only published if no newer input was posted while it was
+  // decoded. The page is only valid during the call.
+  virtual void on_page(const DecodePage *page) = 0;
+
+  // Called once before the worker thread exits.
+  virtual void on_exit() {}
+};
+
+// Decodes spelling strings on its own thread, so that the thread which
+// handles key strokes never waits for MatrixSearch::search().
+//
+// The worker owns a decoder session (see MatrixSearch::init_session()). The
+// caller posts the whole spelling string after each key stroke; inputs that
+// are posted while the worker is busy replace each other, so only the newest
+// one is decoded. A search in progress is aborted between two letters when a
+// newer input is posted, and the letters decoded so far are kept, so the next
+// search only continues from the common prefix, the same as typing on a
+// synchronous decoder.
+//
+// post_search() and post_reset() can be called from any thread, but not at
+// the same time as start() or stop().
+class DecodeWorker {
+ public:
+  DecodeWorker();
+  ~DecodeWorker();
+
+  // Start the worker thread with a session of owner. Each page holds up to
+  // page_size candidates. listener is not owned by the worker, and it must
+  // be valid until stop() returns.
+  bool start(const MatrixSearch *owner, size_t page_size,
+             DecodeListener *listener);
+
+  // Stop the worker thread and close the session. Inputs which are not
+  // decoded yet are dropped.
+  void stop();
+
+  // Post the spelling string to decode. It replaces the input which is not
+  // decoded yet. Return the version of the input, which increases with
+  // every post, or 0 if the worker is not started.
+  uint32 post_search(const char *sps, size_t sps_len);
+
+  // Post a reset of the search space, e.g. after the input is committed.
+  // It also replaces the input which is not decoded yet. Return the version.
+  uint32 post_reset();
+
+  // Get the number of inputs posted, and of the pages published. The
+  // difference is the number of inputs which were replaced or aborted.
+  void get_stat(size_t *posted_num, size_t *published_num);
+
+ private:
+  static void* thread_main(void *arg);
+  static bool is_stale(void *arg);
+
+  void run();
+
+  uint32 post(const char *sps, size_t sps_len, bool reset);
+
+  MatrixSearch *matrix_search_;
+  DecodeListener *listener_;
+  size_t page_size_;
+
+  pthread_t thread_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t cond_;
+  bool started_;
+
+  // The following members are guarded by mutex_.
+  bool stopping_;
+  bool has_pending_;
+  bool pending_reset_;
+  char pending_sps_[kMaxRowNum];
+  size_t pending_len_;
+  size_t posted_num_;
+
+  // The newest posted version. It is also read without mutex_ by the worker
+  // thread to abort stale searches.
+  std::atomic<uint32> version_;
+
+  // The version being decoded. Only used by the worker thread.
+  uint32 working_version_;
+  std::atomic<size_t> published_num_;
+
+  DecodePage page_;
+};
+}
+
+#endif  // PINYINIME_INCLUDE_DECODEWORKER_H__
@@ -69,6 +69,49 @@ class DictBuilder {
   SpellingTable *spl_table_;
   SpellingParser *spl_parser_;
 
+  // The subtree under a son of the root, whose nodes and homophonies' ids
+  // have been reserved, so that it can be built on its own thread.
+  struct SubsetTask {
+    LmaNodeLE0 *parent;
+    size_t item_start;
+    size_t item_end;
+    // The first node and the first homophony id of the subtree.
+    size_t nds_used_num_ge1;
+    size_t homo_idx_num;
+  };
+  SubsetTask *subset_tasks_;
+  size_t subset_task_num_;
+
+  // The result of parsing a line of the raw dictionary. The spellings are
+  // put to the spelling table later, in the order of the lines.
+  enum RawLineState {
+    kRawLineOk,
+    kRawLineSkipped,
+    kRawLineBroken
+  };
+  struct RawLine {
+    LemmaEntry lemma;
+    RawLineState state;
+    // Number of spellings found. If it is less than the number of Hanzis, the
+    // line is broken after them.
+    size_t spl_num;
+    // Whether there are more tokens after the spellings.
+    bool has_more;
+  };
+
+  // The result of parsing a line of the raw bigram list: the lemmas with
+  // each of the two Hanzi strings, given by their first positions in
+  // lemma_arr_ and their numbers.
+  struct RawBigramLine {
+    size_t lma_pos[2];
+    size_t lma_num[2];
+    float freq;
+    RawLineState state;
+  };
+
+  // Number of threads to build the dictionary.
+  size_t thread_num_;
+
 #ifdef ___DO_STATISTICS___
   size_t max_sonbuf_len_[kMaxLemmaSize];
   size_t max_homobuf_len_[kMaxLemmaSize];
@@ -87,6 +130,8 @@ class DictBuilder {
 
   void stat_init();
   void stat_print();
+  // Add the statistics of a builder which has built a part of the tree.
+  void stat_merge(const DictBuilder &other);
 #endif
 
  public:
@@ -96,9 +141,18 @@ class DictBuilder {
 
   // Build dictionary trie from the file fn_raw. File fn_validhzs provides
   // valid chars. If fn_validhzs is NULL, only chars in GB2312 will be
-  // included.
+  // included. The work is done on up to thread_num threads, and the result
+  // is the same for any number of threads.
+  // If fn_bigram is not NULL, the bigrams are built from it. It is a UTF-16
+  // file like fn_raw, with one pair of lemmas per line:
+  //   Hanzis1 Hanzis2 frequency
+  // where frequency is how often Hanzis2 follows Hanzis1. A pair is used for
+  // all the lemmas with these Hanzis, and the frequency is shared by the
+  // lemmas of Hanzis2 by their own frequencies. Pairs with Hanzis which are
+  // not in the dictionary are ignored.
   bool build_dict(const char* fn_raw, const char* fn_validhzs,
-                  DictTrie *dict_trie);
+                  const char *fn_bigram, DictTrie *dict_trie,
+                  size_t thread_num);
 
  private:
   // Fill in the buffer with id. The caller guarantees that the paramters are
@@ -132,9 +186,41 @@ class DictBuilder {
   // item_star to item_end)
   // parent is the parent node to update the necessary information
   // parent can be a member of LmaNodeLE0 or LmaNodeGE1
+  // For the root (level 0), the subtrees under its sons are only reserved by
+  // reserve_subset(), and construct_reserved_subsets() builds them.
   bool construct_subset(void* parent, LemmaEntry* lemma_arr,
                         size_t item_start, size_t item_end, size_t level);
 
+  // Reserve the nodes and the homophonies' ids for the subtree under parent,
+  // a son of the root, from item_start to item_end.
+  void reserve_subset(LmaNodeLE0 *parent, size_t item_start, size_t item_end);
+
+  // Number of nodes in the subtree from item_start to item_end, under a son
+  // of the root.
+  size_t count_ge1_nodes(size_t item_start, size_t item_end);
+
+  // Build the reserved subtrees on several threads. Each is built by a
+  // builder of its own, which shares the node and homophony buffers.
+  bool construct_reserved_subsets();
+
+  // Parse a line of the raw dictionary. It can be called on any thread.
+  void parse_raw_line(char16 *line, const char16 *valid_hzs,
+                      size_t valid_hzs_num, RawLine *raw_line);
+
+  // Find the lemmas with the given Hanzis in lemma_arr_, which must be
+  // sorted by sort_lemmas_by_hz(). Return the position of the first one, and
+  // their number in num.
+  size_t find_lemmas_by_hzs(const char16 *hzs, size_t *num);
+
+  // Parse a line of the raw bigram list. It can be called on any thread.
+  void parse_bigram_line(char16 *line, RawBigramLine *bigram_line);
+
+  // Read the raw bigram list, see build_dict(). lemma_arr_ must be sorted by
+  // sort_lemmas_by_hz(). Return the bigrams, which the caller needs to free,
+  // and their number in num, or NULL if the file can not be read or has a
+  // broken line.
+  BigramEntry* read_raw_bigrams(const char *fn_bigram, size_t *num);
+
 
   // Read valid Chinese Hanzis from the given file.
   // num is used to return number of chars.
@@ -150,6 +150,13 @@ struct LemmaEntry {
   unsigned char hz_str_len;
   float freq;
 };
+
+// Two lemmas which are seen one after the other, and how often.
+struct BigramEntry {
+  LemmaIdType id1;
+  LemmaIdType id2;
+  float freq;
+};
 #endif  // ___BUILD_MODEL___
 
 }  //  namespace ime_pinyin
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PINYINIME_INCLUDE_DICTIMAGE_H__
+#define PINYINIME_INCLUDE_DICTIMAGE_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "dictdef.h"
+
+namespace ime_pinyin {
+
+// An aligned dictionary image starts with this magic number and a version.
+// A legacy image starts directly with the spelling table, whose first field
+// (the size of a spelling item) is a small number, so the two layouts can be
+// told apart by the first 4 bytes.
+// Version 2 appends the association index (see AssocIndex) to the sections of
+// version 1, and version 3 appends the bigrams (see NGram), which may be
+// empty. Images of older versions are still loaded.
+static const uint32 kDictImageMagic = 0x4d495950;  // "PYIM"
+static const uint32 kDictImageVersion = 3;
+
+// In an aligned image, every array section starts at a multiple of this value
+// counted from the beginning of the image. Assets stored uncompressed in an
+// APK are aligned to 4 bytes by zipalign, so the arrays are also aligned in
+// memory when the image is mapped from the APK.
+static const size_t kDictImageAlign = 4;
+
+// A read-only memory mapping of a system dictionary image (dict_pinyin.dat).
+// The loaders of SpellingTrie, DictList, DictTrie and NGram read their fixed
+// size fields from the image in order, and point their large arrays directly
+// into the mapping, so the arrays are clean pages shared with the page cache
+// instead of private dirty memory.
+//
+// If an array is not suitably aligned in memory (legacy images have no
+// padding), it is copied into a buffer owned by the image, so the caller
+// always gets a valid pointer which lives as long as the image.
+class DictImage {
+ private:
+  static const size_t kMaxCopiedArrays = 16;
+
+  void *map_base_;
+  size_t map_len_;
+
+  // Beginning of the dictionary image in the mapping.
+  const unsigned char *data_;
+  size_t length_;
+  size_t pos_;
+
+  // Whether the image uses the aligned layout.
+  bool aligned_;
+
+  // Version of an aligned image, 0 for a legacy image.
+  uint32 version_;
+
+  // Buffers for those arrays which can not be used in place.
+  void *copied_arrays_[kMaxCopiedArrays];
+  size_t copied_num_;
+  size_t copied_bytes_;
+
+  // Move pos_ to the next array boundary for aligned images.
+  bool skip_padding();
+
+ public:
+  DictImage();
+  ~DictImage();
+
+  // Map length bytes from sys_fd, starting at start_offset. The caller still
+  // owns sys_fd, and can close it after this call.
+  bool open(int sys_fd, long start_offset, long length);
+
+  void close();
+
+  bool is_aligned() { return aligned_; }
+
+  uint32 get_version() { return version_; }
+
+  // Number of bytes consumed from the beginning of the image.
+  size_t get_pos() { return pos_; }
+
+  // Number of bytes copied out of the mapping because of misalignment.
+  size_t get_copied_bytes() { return copied_bytes_; }
+
+  // Copy a fixed size field out of the image.
+  bool read(void *buf, size_t size);
+
+  // Get an array of num items, each of elem_size bytes, which requires the
+  // given alignment in memory. Returns NULL if the image is too short.
+  const void* get_array(size_t elem_size, size_t num, size_t align);
+
+#ifdef ___BUILD_MODEL___
+  // Write the magic number and version of an aligned image. The image must
+  // start at the beginning of the file.
+  static bool write_header(FILE *fp);
+
+  // Pad the file to the next array boundary.
+  static bool write_padding(FILE *fp);
+#endif  // ___BUILD_MODEL___
+};
+}
+
+#endif  // PINYINIME_INCLUDE_DICTIMAGE_H__
@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "dictdef.h"
+#include "dictimage.h"
 #include "searchutility.h"
 #include "spellingtrie.h"
 #include "utf16char.h"
@@ -40,6 +41,9 @@ class DictList {
   // The large memory block to store the word list.
   char16 *buf_;
 
+  // Whether buf_, scis_hz_ and scis_splid_ point into a dictionary image.
+  bool buf_in_image_;
+
   // Starting position of those words whose lengths are i+1, counted in
   // char16
   uint32 start_pos_[kMaxLemmaSize + 1];
@@ -80,7 +84,7 @@ class DictList {
   ~DictList();
 
   bool save_list(FILE *fp);
-  bool load_list(FILE *fp);
+  bool load_list(DictImage *image);
 
 #ifdef ___BUILD_MODEL___
   // Init the list from the LemmaEntry array.
@@ -20,11 +20,15 @@
 #include <stdlib.h>
 #include "atomdictbase.h"
 #include "dictdef.h"
+#include "dictimage.h"
 #include "dictlist.h"
 #include "searchutility.h"
 
 namespace ime_pinyin {
 
+class AssocIndex;
+class LpiCache;
+
 class DictTrie : AtomDictBase {
  private:
   struct ParsingMark {
@@ -57,6 +61,27 @@ class DictTrie : AtomDictBase {
 
   DictList* dict_list_;
 
+  // The mapped system dictionary. root_, nodes_ge1_ and lma_idx_buf_ point
+  // into it when the dictionary is loaded from an image. NULL when the trie
+  // is built by DictBuilder.
+  DictImage* image_;
+
+  // Ranked lemma lists for short prediction histories, loaded from images of
+  // version 2 or later. NULL if the image has none.
+  AssocIndex* assoc_index_;
+
+  // Whether the dictionary data (everything except the parsing marks and mile
+  // stones) is borrowed from another DictTrie through attach_dict().
+  bool dict_shared_;
+
+  // Cache of the lemma lists for half spelling ids, owned by the decoder which
+  // uses this trie. NULL if there is no cache.
+  LpiCache *lpi_cache_;
+
+  // The full ids matched by each spelling id with fuzzy Pinyin, owned by the
+  // decoder which uses this trie. NULL if fuzzy Pinyin is off.
+  const SplIdSet *fuzzy_sets_;
+
   const SpellingTrie *spl_trie_;
 
   LmaNodeLE0* root_;        // Nodes for root and the first layer.
@@ -103,9 +128,27 @@ class DictTrie : AtomDictBase {
   // Get the lemma id by the offset.
   inline LemmaIdType get_lemma_id(size_t id_offset);
 
+  // Get the fuzzy set of splid if it matches more full ids than its own
+  // id_num ones, otherwise NULL, and only [id_start, id_start + id_num) is
+  // matched.
+  inline const SplIdSet* get_fuzzy_set(uint16 splid, uint16 id_num) const {
+    if (NULL == fuzzy_sets_ || fuzzy_sets_[splid].id_num <= id_num)
+      return NULL;
+    return fuzzy_sets_ + splid;
+  }
+
+  // Test if a node with spelling id spl_idx is matched by the full ids
+  // [id_start, id_start + id_num), or by id_set if it is not NULL.
+  inline static bool match_spl_idx(uint16 spl_idx, uint16 id_start,
+                                   uint16 id_num, const SplIdSet *id_set) {
+    if (NULL != id_set)
+      return id_set->has(spl_idx);
+    return spl_idx >= id_start && spl_idx < id_start + id_num;
+  }
+
   void free_resource(bool free_dict_list);
 
-  bool load_dict(FILE *fp);
+  bool load_dict(DictImage *image);
 
   // Given a LmaNodeLE0 node, extract the lemmas specified by it, and fill
   // them into the lpi_items buffer.
@@ -145,8 +188,11 @@ class DictTrie : AtomDictBase {
   bool save_dict(FILE *fp);
 #endif  // ___BUILD_MODEL___
 
-  static const int kMaxMileStone = 100;
-  static const int kMaxParsingMark = 600;
+  // Large enough for the many spellings of T9 digits, whose rows are limited
+  // by MatrixSearch::kMaxDmiARowT9. If they run out, the remaining extensions
+  // are dropped, and the input is not decoded to its end.
+  static const int kMaxMileStone = 4000;
+  static const int kMaxParsingMark = 16000;
   static const MileStoneHandle kFirstValidMileStoneHandle = 1;
 
   friend class DictParser;
@@ -161,7 +207,12 @@ class DictTrie : AtomDictBase {
   // Construct the tree from the file fn_raw.
   // fn_validhzs provide the valid hanzi list. If fn_validhzs is
   // NULL, only chars in GB2312 will be included.
-  bool build_dict(const char *fn_raw, const char *fn_validhzs);
+  // fn_bigram provides the bigrams, see DictBuilder::build_dict(). It can be
+  // NULL.
+  // The dictionary is built on up to thread_num threads; the result does not
+  // depend on the number of threads.
+  bool build_dict(const char *fn_raw, const char *fn_validhzs,
+                  const char *fn_bigram, size_t thread_num);
 
   // Save the binary dictionary
   // Actually, the SpellingTrie/DictList instance will be also saved.
@@ -173,7 +224,8 @@ class DictTrie : AtomDictBase {
   void convert_to_scis_ids(char16 *str, uint16 str_len);
 
   // Load a binary dictionary
-  // The SpellingTrie instance/DictList will be also loaded
+  // The SpellingTrie instance/DictList will be also loaded. The dictionary
+  // file is mapped read-only, and the large arrays are used in place.
   bool load_dict(const char *filename, LemmaIdType start_id,
                  LemmaIdType end_id);
   bool load_dict_fd(int sys_fd, long start_offset, long length,
@@ -181,6 +233,22 @@ class DictTrie : AtomDictBase {
   bool close_dict() {return true;}
   size_t number_of_lemmas() {return 0;}
 
+  // Share the loaded dictionary of owner. The nodes, lemma ids, dictionary
+  // list and spelling index are used read-only by both tries; only the
+  // parsing marks and mile stones, which record the search state, are
+  // allocated for this trie. So several decoders can search the same system
+  // dictionary at the same time. The owner must not be closed or destroyed
+  // before this trie.
+  bool attach_dict(const DictTrie *owner);
+
+  void set_lpi_cache(LpiCache *lpi_cache);
+
+  // Set the fuzzy sets built by SpellingTrie::build_fuzzy_sets(), which must
+  // be kept until they are replaced, or NULL to turn fuzzy Pinyin off. The
+  // given spelling ids then match the nodes of all the full ids in their
+  // sets, so no extra lookups are needed.
+  void set_fuzzy_sets(const SplIdSet *fuzzy_sets);
+
   void reset_milestones(uint16 from_step, MileStoneHandle from_handle);
 
   MileStoneHandle extend_dict(MileStoneHandle from_handle,
@@ -221,6 +289,9 @@ class DictTrie : AtomDictBase {
 
   void flush_cache() {}
 
+  // The system dictionary is never changed after loading.
+  uint32 get_version() {return 0;}
+
   LemmaIdType get_lemma_id(const char16 lemma_str[], uint16 lemma_len);
 
   // Fill the lemmas with highest scores to the prediction buffer.
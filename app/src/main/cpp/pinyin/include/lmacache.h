@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PINYINIME_INCLUDE_LMACACHE_H__
+#define PINYINIME_INCLUDE_LMACACHE_H__
+
+#include <stdlib.h>
+#include "dictdef.h"
+#include "searchutility.h"
+
+namespace ime_pinyin {
+
+// Used to cache the candidate lemma lists of MatrixSearch::get_lpis() for
+// spelling id strings, so that the candidates of the same spellings are not
+// searched, merged and sorted again on every key stroke.
+//
+// LpiCache only caches the raw lists for single half ids, while this cache is
+// keyed by the whole spelling id string (full or half ids, up to
+// kMaxLemmaSize ids), together with the other arguments which change the
+// result: the string to exclude, and whether the list is sorted by score.
+//
+// The items are kept in a fixed size ring buffer. A new list is appended after
+// the last one, and the entries whose items are overwritten are dropped, so
+// the memory is bounded by kItemBufSize. When there is no free entry, the
+// least recently used one is replaced.
+//
+// The cached lists contain user lemmas and scores, so every list is tagged
+// with the version of the user dictionary. When the version changes, the
+// whole cache is dropped.
+class LmaCache {
+ public:
+  // Size of the item buffer in bytes.
+  static const size_t kItemBufSize = 64 * 1024;
+
+  // Maximum number of cached lists.
+  static const size_t kMaxEntries = 128;
+
+  // Lists longer than this are not cached, so that one list can not push out
+  // most of the others.
+  static const size_t kMaxItemsPerEntry =
+      kItemBufSize / sizeof(LmaPsbItem) / 4;
+
+  LmaCache();
+  ~LmaCache();
+
+  // Drop all cached lists. The statistics are kept.
+  void reset();
+
+  // Get the cached list for the given arguments. excl_str can be NULL.
+  // A list is only returned if searching the dictionaries with a buffer of
+  // lpi_max items would give the same list, i.e. if lpi_max is the buffer
+  // size used when the list was put, or not smaller than its min_lpi_max.
+  // Return true and the list length in lpi_num if found.
+  bool get_cache(const uint16 *splid_str, uint16 splid_str_len,
+                 const char16 *excl_str, bool sorted, uint32 version,
+                 LmaPsbItem lpi_items[], size_t lpi_max, size_t *lpi_num);
+
+  // Put a list got with a buffer of lpi_max items to the cache. min_lpi_max
+  // is the smallest buffer size with which the list is not truncated; it can
+  // be larger than lpi_max.
+  void put_cache(const uint16 *splid_str, uint16 splid_str_len,
+                 const char16 *excl_str, bool sorted, uint32 version,
+                 const LmaPsbItem lpi_items[], size_t lpi_num,
+                 size_t lpi_max, size_t min_lpi_max);
+
+  size_t get_hit_num() { return hit_num_; }
+
+  size_t get_miss_num() { return miss_num_; }
+
+ private:
+  struct CacheEntry {
+    uint16 splids[kMaxLemmaSize];
+    uint16 splid_num;   // 0 means the entry is not used.
+    char16 excl_str[kMaxLemmaSize + 1];
+    bool sorted;
+    size_t lpi_max;
+    size_t min_lpi_max;
+    size_t item_start;  // Position in items_.
+    size_t item_num;
+    size_t last_used;   // Value of tick_ when it was last used.
+  };
+
+  static const size_t kMaxItems = kItemBufSize / sizeof(LmaPsbItem);
+
+  LmaPsbItem *items_;
+  // The position to append the next list.
+  size_t items_pos_;
+
+  CacheEntry *entries_;
+  // Hash values of the entries, kept apart from the entries so that looking
+  // up a key only touches a few cache lines.
+  uint32 *hashes_;
+  size_t tick_;
+
+  // The user dictionary version of all cached lists.
+  uint32 version_;
+
+  size_t hit_num_;
+  size_t miss_num_;
+
+  static uint32 get_hash(const uint16 *splid_str, uint16 splid_str_len,
+                         const char16 *excl_str, bool sorted);
+
+  // Find the entry for the key, NULL if not found.
+  CacheEntry* find_entry(const uint16 *splid_str, uint16 splid_str_len,
+                         const char16 *excl_str, bool sorted, uint32 hash);
+
+  // Check the version, and drop all lists if it has changed.
+  void check_version(uint32 version);
+};
+
+}  // namespace
+
+#endif  // PINYINIME_INCLUDE_LMACACHE_H__
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PINYINIME_INCLUDE_LOCKEDDICT_H__
+#define PINYINIME_INCLUDE_LOCKEDDICT_H__
+
+#include <pthread.h>
+#include "atomdictbase.h"
+
+namespace ime_pinyin {
+
+// An atom dictionary which serializes all calls to another atom dictionary,
+// so that several decoders can share it from different threads.
+// The wrapped dictionary is owned by this object.
+//
+// Only stateless dictionaries can be shared in this way. UserDict does not
+// keep any mile stone state between calls to extend_dict(), so it is safe;
+// DictTrie keeps per-search mile stones, and it is shared through
+// DictTrie::attach_dict() instead.
+class LockedDict : public AtomDictBase {
+ public:
+  explicit LockedDict(AtomDictBase *dict);
+  ~LockedDict();
+
+  bool load_dict(const char *file_name, LemmaIdType start_id,
+                 LemmaIdType end_id);
+
+  bool close_dict();
+
+  size_t number_of_lemmas();
+
+  void reset_milestones(uint16 from_step, MileStoneHandle from_handle);
+
+  MileStoneHandle extend_dict(MileStoneHandle from_handle,
+                              const DictExtPara *dep, LmaPsbItem *lpi_items,
+                              size_t lpi_max, size_t *lpi_num);
+
+  size_t get_lpis(const uint16 *splid_str, uint16 splid_str_len,
+                  LmaPsbItem *lpi_items, size_t lpi_max);
+
+  uint16 get_lemma_str(LemmaIdType id_lemma, char16* str_buf,
+                       uint16 str_max);
+
+  uint16 get_lemma_splids(LemmaIdType id_lemma, uint16 *splids,
+                          uint16 splids_max, bool arg_valid);
+
+  size_t predict(const char16 last_hzs[], uint16 hzs_len,
+                 NPredictItem *npre_items, size_t npre_max,
+                 size_t b4_used);
+
+  LemmaIdType put_lemma(char16 lemma_str[], uint16 splids[],
+                        uint16 lemma_len, uint16 count);
+
+  LemmaIdType update_lemma(LemmaIdType lemma_id, int16 delta_count,
+                           bool selected);
+
+  LemmaIdType get_lemma_id(char16 lemma_str[], uint16 splids[],
+                           uint16 lemma_len);
+
+  LmaScoreType get_lemma_score(LemmaIdType lemma_id);
+
+  LmaScoreType get_lemma_score(char16 lemma_str[], uint16 splids[],
+                        uint16 lemma_len);
+
+  bool remove_lemma(LemmaIdType lemma_id);
+
+  size_t get_total_lemma_count();
+
+  void set_total_lemma_count_of_others(size_t count);
+
+  void flush_cache();
+
+  uint32 get_version();
+
+ private:
+  // Locks the dictionary in the constructor and unlocks it in the destructor.
+  class AutoLock {
+   public:
+    explicit AutoLock(pthread_mutex_t *mutex) : mutex_(mutex) {
+      pthread_mutex_lock(mutex_);
+    }
+    ~AutoLock() {
+      pthread_mutex_unlock(mutex_);
+    }
+
+   private:
+    pthread_mutex_t *mutex_;
+  };
+
+  AtomDictBase *dict_;
+  pthread_mutex_t mutex_;
+};
+}
+
+#endif  // PINYINIME_INCLUDE_LOCKEDDICT_H__
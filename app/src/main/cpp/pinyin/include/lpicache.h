@@ -8,9 +8,11 @@
 namespace ime_pinyin {
 
 // Used to cache LmaPsbItem list for half spelling ids.
+// Each MatrixSearch owns one cache, because the cached lists also contain
+// items from the user dictionary, and decoders on different threads must not
+// write into the same cache.
 class LpiCache {
  private:
-  static LpiCache *instance_;
   static const int kMaxLpiCachePerId = 15;
 
   LmaPsbItem *lpi_cache_;
@@ -20,8 +22,6 @@ class LpiCache {
   LpiCache();
   ~LpiCache();
 
-  static LpiCache& get_instance();
-
   // Test if the LPI list of the given splid  has been cached.
   // If splid is a full spelling id, it returns false, because we only cache
   // list for half ids.
@@ -39,6 +39,9 @@ class LpiCache {
   // Note: splid must be a half id, and lpi_items must be not NULL. The
   // caller of this function should guarantee this.
   size_t get_cache(uint16 splid, LmaPsbItem lpi_items[], size_t lpi_max);
+
+  // Drop all cached lists.
+  void reset();
 };
 
 }  // namespace
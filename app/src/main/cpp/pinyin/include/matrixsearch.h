@@ -19,7 +19,10 @@
 
 #include <stdlib.h>
 #include "atomdictbase.h"
+#include "chunkpool.h"
 #include "dicttrie.h"
+#include "lmacache.h"
+#include "lpicache.h"
 #include "searchutility.h"
 #include "spellingtrie.h"
 #include "splparser.h"
@@ -123,6 +126,9 @@ typedef struct {
 } ComposingPhrase, *TComposingPhrase;
 
 class MatrixSearch {
+ public:
+  typedef bool (*AbortCheck)(void *arg);
+
  private:
   // If it is true, prediction list by string whose length is greater than 1
   // will be limited to a reasonable number.
@@ -143,15 +149,30 @@ class MatrixSearch {
   // How many rows for each step.
   static const size_t kMaxNodeARow = 5;
 
+  // The maximum number of spelling ids typed by one string, which is more
+  // than one only for T9 digits.
+  static const uint16 kMaxSplIdsOfStr = 16;
+
+  // In T9 mode, a row stops extending the DMI nodes of older rows once it has
+  // this many DMI nodes. Extending from the root is not limited, so a word
+  // can still start at every row.
+  static const uint16 kMaxDmiARowT9 = 64;
+
+  // How many candidates are sorted at least when one which is not sorted yet
+  // is fetched, about a page of the candidate bar.
+  static const size_t kCandSortStep = 32;
+
   // The maximum length of the sentence candidates counted in chinese
   // characters
   static const size_t kMaxSentenceLength = 16;
 
-  // The size of the matrix node pool.
-  static const size_t kMtrxNdPoolSize = 200;
+  // The size of a chunk of the matrix node pool is (1 << kMtrxNdChunkBits).
+  // The first chunk holds the nodes of kMaxRowNum rows, so an input only
+  // needs more chunks in the composing phrase mode.
+  static const size_t kMtrxNdChunkBits = 8;
 
-  // The size of the DMI node pool.
-  static const size_t kDmiPoolSize = 800;
+  // The size of a chunk of the DMI node pool is (1 << kDmiChunkBits).
+  static const size_t kDmiChunkBits = 10;
 
   // Used to indicate whether this object has been initialized.
   bool inited_;
@@ -167,12 +188,33 @@ class MatrixSearch {
   // split into "d a", because "d" is not a full spelling id.
   bool xi_an_enabled_;
 
+  // The enabled fuzzy Pinyin pairs, kFuzzyXxx ORed together, and the sets of
+  // full ids they make each spelling id match, given to dict_trie_. The sets
+  // are NULL if no pair is enabled.
+  uint16 fuzzy_flags_;
+  SplIdSet *fuzzy_sets_;
+
+  // Whether the input is T9 digits instead of letters. Default is false.
+  bool t9_enabled_;
+
   // System dictionary.
   DictTrie* dict_trie_;
 
-  // User dictionary.
+  // User dictionary. It is wrapped by a LockedDict, so that decoder sessions
+  // can share it.
   AtomDictBase* user_dict_;
 
+  // Whether dict_trie_ and user_dict_ share the dictionaries of another
+  // MatrixSearch, see init_session().
+  bool user_dict_shared_;
+
+  // Cache of the lemma lists for half spelling ids, used by this decoder and
+  // its system dictionary trie.
+  LpiCache* lpi_cache_;
+
+  // Cache of the lemma lists for spelling id strings, used by get_lpis().
+  LmaCache* lma_cache_;
+
   // Spelling parser.
   SpellingParser* spl_parser_;
 
@@ -191,9 +233,14 @@ class MatrixSearch {
   // Shared buffer for multiple purposes.
   size_t *share_buf_;
 
-  MatrixNode *mtrx_nd_pool_;
+  // The pools grow in chunks when a long input needs more nodes, and the
+  // first chunks are based on share_buf_. The nodes of a matrix row are in
+  // the same chunk, see prepare_add_char().
+  typedef ChunkPool<MatrixNode, kMtrxNdChunkBits> MtrxNdPool;
+  typedef ChunkPool<DictMatchInfo, kDmiChunkBits> DmiPool;
+  MtrxNdPool mtrx_nd_pool_;
   PoolPosType mtrx_nd_pool_used_;    // How many nodes used in the pool
-  DictMatchInfo *dmi_pool_;
+  DmiPool dmi_pool_;
   PoolPosType dmi_pool_used_;        // How many items used in the pool
 
   MatrixRow *matrix_;                // The first row is for starting
@@ -233,6 +280,10 @@ class MatrixSearch {
   // Used to remember the last fixed position, counted in Hanzi.
   size_t fixed_hzs_;
 
+  // Checked by search() before each letter, see set_abort_check().
+  AbortCheck abort_check_;
+  void *abort_arg_;
+
   // Lemma Items with possibility score, two purposes:
   // 1. In Viterbi decoding, this buffer is used to get all possible candidates
   // for current step;
@@ -240,6 +291,9 @@ class MatrixSearch {
   // first un-fixed step and show them to the user.
   LmaPsbItem lpi_items_[kMaxLmaPsbItems];
   size_t lpi_total_;
+  // For the second purpose, the candidates before lpi_sorted_ are in order.
+  // The others are only sorted when they are fetched.
+  size_t lpi_sorted_;
 
   // Assign the pointers with NULL. The caller makes sure that all pointers are
   // not valid before calling it. This function only will be called in the
@@ -250,6 +304,10 @@ class MatrixSearch {
 
   void free_resource();
 
+  // Build fuzzy_sets_ for fuzzy_flags_ and give them to dict_trie_. The
+  // cached lemma lists are dropped, because they depend on the sets.
+  void update_fuzzy_sets();
+
   // Reset the search space totally.
   bool reset_search0();
 
@@ -309,16 +367,19 @@ class MatrixSearch {
   // lpi_items_ is used to get the LmaPsbItem list, lpi_total_ returns the size.
   // The function's returned value has no relation with the value of lpi_num.
   //
-  // If dmi == NULL, this function will extend the root node of DictTrie
+  // If dmi == NULL, this function will extend the root node of DictTrie.
+  // Otherwise dmi_s_pos is the position of dmi_s in the pool.
   //
   // This function will not change dmi_nd_pool_used_. Please change it after
   // calling this function if necessary.
   //
   // The caller should guarantees that NULL != dep.
-  size_t extend_dmi(DictExtPara *dep, DictMatchInfo *dmi_s);
+  size_t extend_dmi(DictExtPara *dep, DictMatchInfo *dmi_s,
+                    PoolPosType dmi_s_pos);
 
   // Extend dmi for the composing phrase.
-  size_t extend_dmi_c(DictExtPara *dep, DictMatchInfo *dmi_s);
+  size_t extend_dmi_c(DictExtPara *dep, DictMatchInfo *dmi_s,
+                      PoolPosType dmi_s_pos);
 
   // Extend a MatrixNode with the give LmaPsbItem list.
   // res_row is the destination row number.
@@ -337,11 +398,20 @@ class MatrixSearch {
   bool prepare_add_char(char ch);
 
   // Called after prepare_add_char, so the input char has been saved.
-  bool add_char_qwerty();
+  // Extend the search by the spellings which end at the new char; in T9
+  // mode, all the spellings typed by each digit string.
+  bool add_char_spellings();
+
+  // Test if the char is a spelling char of the current input mode, letters
+  // for QWERTY or digits for T9.
+  bool is_valid_to_parse(char ch);
 
   // Prepare candidates from the last fixed hanzi position.
   void prepare_candidates();
 
+  // Make sure that the candidates in lpi_items_ before cand_end are sorted.
+  void sort_candidates(size_t cand_end);
+
   // Is the character in step pos a splitter character?
   // The caller guarantees that the position is valid.
   bool is_split_at(uint16 pos);
@@ -380,8 +450,32 @@ class MatrixSearch {
   bool init_fd(int sys_fd, long start_offset, long length,
                const char *fn_usr_dict);
 
+  // Initialize a decoder session which searches the dictionaries of owner.
+  // The session has its own search pools and state, the read-only system
+  // dictionary data is shared, and the user dictionary is shared with
+  // synchronized access. So sessions can be used on different threads, but
+  // one session must only be used by one thread at a time. owner must be
+  // initialized, and it must be closed after all its sessions.
+  bool init_session(const MatrixSearch *owner);
+
   void set_max_lens(size_t max_sps_len, size_t max_hzs_len);
 
+  // Let search() stop early, e.g. when the string it decodes is stale. Before
+  // each letter, search() calls check(arg), and if it returns true, search()
+  // keeps the letters decoded so far as the decoded part of the Pinyin string
+  // and returns without preparing the candidates. The next search() with
+  // the same prefix continues from there. check can be NULL.
+  void set_abort_check(AbortCheck check, void *arg);
+
+  // Get the number of get_lpis() lookups answered by the lemma list cache,
+  // and the number of those which had to search the dictionaries.
+  void get_lma_cache_stat(size_t *hit_num, size_t *miss_num);
+
+  // Get the number of matrix nodes and DMI nodes used by the current search,
+  // and the capacities of their pools, which grow with long inputs.
+  void get_pool_stat(size_t *mtrx_nd_used, size_t *mtrx_nd_capacity,
+                     size_t *dmi_used, size_t *dmi_capacity);
+
   void close();
 
   void flush_cache();
@@ -390,6 +484,22 @@ class MatrixSearch {
 
   bool get_xi_an_switch();
 
+  // Enable the given fuzzy Pinyin pairs, kFuzzyXxx ORed together, or turn
+  // fuzzy Pinyin off with 0. Only the system dictionary is matched fuzzily.
+  // The search is reset if the pairs change. Sessions opened by
+  // init_session() start with the pairs of their owner.
+  void set_fuzzy(uint16 fuzzy_flags);
+
+  uint16 get_fuzzy();
+
+  // Take the input as T9 digits, '2' to '9', or as letters. A digit string
+  // is decoded into all the spellings it can type, and they are searched
+  // together in the same matrix. The search is reset if the mode changes.
+  // Sessions opened by init_session() start in the mode of their owner.
+  void set_t9(bool t9_enabled);
+
+  bool get_t9();
+
   // Reset the search space. Equivalent to reset_search(0).
   // If inited, always return true;
   bool reset_search();
@@ -432,6 +542,14 @@ class MatrixSearch {
   // be the first one.
   char16* get_candidate(size_t cand_id, char16 *cand_str, size_t max_len);
 
+  // Get at most count candidates from start_id on, packed into buf one after
+  // another, each ended with '\0'. The candidates are only sorted as far as
+  // the last one fetched. It stops before the first candidate which can not
+  // be fetched or does not fit into the rest of buf. The number of candidates
+  // fetched is returned.
+  size_t get_candidates(size_t start_id, size_t count, char16 *buf,
+                        size_t buf_len);
+
   // Get the first candiate, which is a "full sentence".
   // retstr_len is not NULL, it will be used to return the string length.
   // If only_unfixed is true, only unfixed part will be fetched.
@@ -18,6 +18,7 @@
 #define PINYINIME_INCLUDE_MYSTDLIB_H__
 
 #include <stdlib.h>
+#include <algorithm>
 
 namespace ime_pinyin {
 
@@ -27,6 +28,129 @@ void myqsort(void *p, size_t n, size_t es,
 void *mybsearch(const void *key, const void *base,
                 size_t nmemb, size_t size,
                 int (*compar)(const void *, const void *));
+
+// Sort p[0..n) with less, a "less than" function object, which is inlined
+// unlike the comparator of myqsort(). Equal items keep their order, so the
+// result is the same on all platforms.
+template <typename T, typename Less>
+inline void mysort(T *p, size_t n, Less less) {
+  std::stable_sort(p, p + n, less);
+}
+
+// Move the k smallest items of p[0..n) to p[0..k), in the order mysort()
+// gives them. The other items are left after them, and equal ones keep
+// their order, so the rest can be selected later, a part at a time, with the
+// same result as sorting all the items at once. It takes O(n * log(k))
+// instead of O(n * log(n)).
+template <typename T, typename Less>
+void mypartial_sort(T *p, size_t n, size_t k, Less less) {
+  if (k >= n / 2) {
+    mysort(p, n, less);
+    return;
+  }
+  if (0 == k)
+    return;
+
+  // Equal items are ordered by their positions, as mysort() keeps them.
+  auto before = [p, &less](size_t i, size_t j) {
+    if (less(p[i], p[j]))
+      return true;
+    return !less(p[j], p[i]) && i < j;
+  };
+
+  size_t *heap = new size_t[k];
+  T *selected = new T[k];
+
+  // A max-heap of the positions of the k smallest items seen so far.
+  for (size_t pos = 0; pos < k; pos++)
+    heap[pos] = pos;
+  std::make_heap(heap, heap + k, before);
+  for (size_t pos = k; pos < n; pos++) {
+    if (before(pos, heap[0])) {
+      std::pop_heap(heap, heap + k, before);
+      heap[k - 1] = pos;
+      std::push_heap(heap, heap + k, before);
+    }
+  }
+  std::sort_heap(heap, heap + k, before);
+  for (size_t pos = 0; pos < k; pos++)
+    selected[pos] = p[heap[pos]];
+
+  // Move the other items to the end, from the last one.
+  std::sort(heap, heap + k);
+  size_t to = n;
+  size_t sel = k;
+  for (size_t pos = n; pos-- > 0;) {
+    if (sel > 0 && heap[sel - 1] == pos) {
+      sel--;
+      continue;
+    }
+    p[--to] = p[pos];
+  }
+  std::copy(selected, selected + k, p);
+
+  delete [] selected;
+  delete [] heap;
+}
+
+// Call func(arg, part) for each part in [0, part_num) on up to thread_num
+// threads, the calling one included. The parts are handed out in order, and
+// the call returns when all of them are done. The parts must not write to
+// the same memory, so that the result does not depend on the number of
+// threads.
+void myparallel_run(size_t part_num, size_t thread_num,
+                    void (*func)(void *arg, size_t part), void *arg);
+
+// The same as myparallel_run(), with func a function object.
+template <typename Func>
+void myparallel_for(size_t part_num, size_t thread_num, Func func) {
+  myparallel_run(part_num, thread_num,
+                 [](void *arg, size_t part) {
+                   (*static_cast<Func*>(arg))(part);
+                 },
+                 &func);
+}
+
+// Sort p[0..n) on up to thread_num threads. The parts are sorted by mysort()
+// on their own, and then merged two by two; equal items keep their order in
+// both steps, so the result is exactly the one of mysort(), whatever
+// thread_num is.
+template <typename T, typename Less>
+void myparallel_sort(T *p, size_t n, Less less, size_t thread_num) {
+  // Small arrays are not worth the threads.
+  const size_t kMinPartLen = 4096;
+  size_t part_num = std::min(thread_num, n / kMinPartLen);
+  if (part_num <= 1) {
+    mysort(p, n, less);
+    return;
+  }
+
+  size_t part_len = (n + part_num - 1) / part_num;
+  myparallel_for(part_num, thread_num, [=](size_t part) {
+    size_t begin = part * part_len;
+    size_t end = std::min(n, begin + part_len);
+    mysort(p + begin, end - begin, less);
+  });
+
+  T *buf = new T[n];
+  T *from = p;
+  T *to = buf;
+  for (size_t run_len = part_len; run_len < n; run_len *= 2) {
+    size_t merge_num = (n + 2 * run_len - 1) / (2 * run_len);
+    myparallel_for(merge_num, thread_num, [=](size_t merge) {
+      size_t begin = merge * 2 * run_len;
+      size_t mid = std::min(n, begin + run_len);
+      size_t end = std::min(n, mid + run_len);
+      std::merge(from + begin, from + mid, from + mid, from + end,
+                 to + begin, less);
+    });
+    std::swap(from, to);
+  }
+  if (from != p)
+    std::copy(from, from + n, p);
+
+  delete [] buf;
+}
 }
 
 #endif  // PINYINIME_INCLUDE_MYSTDLIB_H__
@@ -19,7 +19,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <atomic>
 #include "dictdef.h"
+#include "dictimage.h"
 
 namespace ime_pinyin {
 
@@ -37,6 +39,10 @@ class NGram {
   // After this process, an item with a lower score has a higher frequency.
   static const int kLogValueAmplifier = -800;
 
+  // At most this many lemmas are kept to follow each lemma in the bigrams,
+  // so a lookup is a binary search of a few steps.
+  static const size_t kMaxBigramsPerLemma = 64;
+
   // System words' total frequency. It is not the real total frequency, instead,
   // It is only used to adjust system lemmas' scores when the user dictionary's
   // total frequency changes.
@@ -51,12 +57,14 @@ class NGram {
   bool initialized_;
   size_t idx_num_;
 
-  size_t total_freq_none_sys_;
+  std::atomic<size_t> total_freq_none_sys_;
 
   // Score compensation for system dictionary lemmas.
   // Because after user adds some user lemmas, the total frequency changes, and
   // we use this value to normalize the score.
-  float sys_score_compensation_;
+  // Decoder sessions on different threads update and read it concurrently, so
+  // it is atomic. Relaxed ordering is enough because it is a standalone value.
+  std::atomic<float> sys_score_compensation_;
 
 #ifdef ___BUILD_MODEL___
   double *freq_codes_df_;
@@ -64,6 +72,26 @@ class NGram {
   LmaScoreType *freq_codes_;
   CODEBOOK_TYPE *lma_freq_idx_;
 
+  // Whether freq_codes_ and lma_freq_idx_ point into a dictionary image.
+  bool codes_in_image_;
+
+  // The bigrams, loaded from images of version 3 or later, empty if the
+  // image has none. They only keep the pairs whose second lemma is more
+  // likely after the first one than on its own, and the score of such a
+  // pair replaces the unigram score of the second lemma.
+  // The bigrams of lemma id1 are bi_items_[bi_starts_[id1]] to
+  // bi_items_[bi_starts_[id1 + 1] - 1], and each item is
+  // (id2 << 8) | code, sorted by id2. bi_starts_ has idx_num_ + 1 items.
+  LmaScoreType *bi_codes_;
+  uint32 *bi_starts_;
+  uint32 *bi_items_;
+  size_t bi_num_;
+
+  // Whether the bigram tables point into a dictionary image.
+  bool bigrams_in_image_;
+
+  void free_bigrams();
+
  public:
   NGram();
   ~NGram();
@@ -71,13 +99,54 @@ class NGram {
   static NGram& get_instance();
 
   bool save_ngram(FILE *fp);
-  bool load_ngram(FILE *fp);
+  bool load_ngram(DictImage *image);
+
+  // The bigrams are stored after the other sections of the image, and an
+  // image without them stores an empty table. load_ngram() must be called
+  // first.
+  bool save_bigram(FILE *fp);
+  bool load_bigram(DictImage *image);
+
+  // Release the tables. It must be called before the dictionary image which
+  // the tables were loaded from is closed.
+  void free_resource();
 
   // Set the total frequency of all none system dictionaries.
   void set_total_freq_none_sys(size_t freq_none_sys);
 
   float get_uni_psb(LemmaIdType lma_id);
 
+  bool has_bigram() { return bi_num_ > 0; }
+
+  // Get the bigrams which start with lma_id for get_bi_psb(), and return
+  // their number.
+  inline size_t get_bigrams(LemmaIdType lma_id, const uint32 **bigrams) {
+    if (0 == bi_num_ || lma_id >= idx_num_)
+      return 0;
+    *bigrams = bi_items_ + bi_starts_[lma_id];
+    return bi_starts_[lma_id + 1] - bi_starts_[lma_id];
+  }
+
+  // Get the score of lma_id after the lemma of the given bigrams, or uni_psb,
+  // its unigram score, if it is not in them.
+  inline float get_bi_psb(const uint32 *bigrams, size_t bigram_num,
+                          LemmaIdType lma_id, float uni_psb) {
+    size_t begin = 0;
+    size_t end = bigram_num;
+    while (begin < end) {
+      size_t middle = (begin + end) >> 1;
+      LemmaIdType id = bigrams[middle] >> 8;
+      if (id == lma_id)
+        return static_cast<float>(bi_codes_[bigrams[middle] & 0xff]) +
+            sys_score_compensation_.load(std::memory_order_relaxed);
+      if (id < lma_id)
+        begin = middle + 1;
+      else
+        end = middle;
+    }
+    return uni_psb;
+  }
+
   // Convert a probability to score. Actually, the score will be limited to
   // kMaxScore, but at runtime, we also need float expression to get accurate
   // value of the score.
@@ -86,9 +155,15 @@ class NGram {
   static float convert_psb_to_score(double psb);
 
 #ifdef ___BUILD_MODEL___
-  // For constructing the unigram mode model.
+  // For constructing the unigram mode model. The code book is fitted on up
+  // to thread_num threads, with the same result for any number of threads.
   bool build_unigram(LemmaEntry *lemma_arr, size_t num,
-                     LemmaIdType next_idx_unused);
+                     LemmaIdType next_idx_unused, size_t thread_num);
+
+  // For constructing the bigrams, after the unigram model is built. The
+  // frequencies of the pairs which start with the same lemma give the
+  // probabilities of the lemmas after it. bigram_arr is sorted in place.
+  bool build_bigram(BigramEntry *bigram_arr, size_t num, size_t thread_num);
 #endif
 };
 }
@@ -45,6 +45,8 @@ extern "C" {
    * file sys_fd.
    * @param length The length of the system dictionary in the file sys_fd,
    * counted in byte.
+   * The system dictionary is mapped read-only from sys_fd, and the caller
+   * still owns sys_fd; it can be closed once this function returns.
    * @return true if succeed.
    */
   bool im_open_decoder_fd(int sys_fd, long start_offset, long length,
@@ -74,6 +76,32 @@ extern "C" {
    */
   void im_flush_cache();
 
+  /**
+   * Get the statistics of the lemma list cache of the decoder, which caches
+   * the candidate lemmas of spelling id strings between key strokes.
+   *
+   * @param hit_num Used to return the number of lookups found in the cache.
+   * @param miss_num Used to return the number of lookups which searched the
+   * dictionaries.
+   */
+  void im_get_lma_cache_stat(size_t *hit_num, size_t *miss_num);
+
+  /**
+   * Get the usage of the node pools of the decoder. The pools grow in chunks
+   * for long inputs, and the chunks are kept until the decoder is closed.
+   *
+   * @param mtrx_nd_used Used to return the number of matrix nodes used by the
+   * current search.
+   * @param mtrx_nd_capacity Used to return the capacity of the matrix node
+   * pool.
+   * @param dmi_used Used to return the number of dictionary match nodes used
+   * by the current search.
+   * @param dmi_capacity Used to return the capacity of the dictionary match
+   * node pool.
+   */
+  void im_get_pool_stat(size_t *mtrx_nd_used, size_t *mtrx_nd_capacity,
+                        size_t *dmi_used, size_t *dmi_capacity);
+
   /**
    * Use a spelling string(Pinyin string) to search. The engine will try to do
    * an incremental search based on its previous search result, so if the new
@@ -138,6 +166,22 @@ extern "C" {
   char16* im_get_candidate(size_t cand_id, char16* cand_str,
                            size_t max_len);
 
+  /**
+   * Get a page of candidate strings in one call. The candidates are only
+   * sorted as far as the page, so later pages cost nothing until they are
+   * requested.
+   *
+   * @param start_id The id of the first candidate of the page.
+   * @param count The maximum number of candidates to get.
+   * @param cand_buf The buffer to store the candidates. They are packed one
+   * after another, each ended with '\0'.
+   * @param buf_len The length of the buffer, in char16.
+   * @return The number of candidates stored. It is less than count if the
+   * search has fewer candidates, or the next one does not fit into the buffer.
+   */
+  size_t im_get_candidates(size_t start_id, size_t count, char16* cand_buf,
+                           size_t buf_len);
+
   /**
    * Get the segmentation information(the starting positions) of the spelling
    * string.
@@ -202,6 +246,134 @@ extern "C" {
    * Enable Yunmus in ShouZiMu mode.
    */
   void im_enable_ym_as_szm(bool enable);
+
+  /**
+   * Enable fuzzy Pinyin pairs, such as z/zh and an/ang, for the system
+   * dictionary. The search is reset if the pairs change.
+   *
+   * @param fuzzy_flags The pairs, kFuzzyXxx in spellingtrie.h ORed together,
+   * or 0 to turn fuzzy Pinyin off.
+   */
+  void im_set_fuzzy(uint16 fuzzy_flags);
+
+  /**
+   * Enable or disable T9 input. When it is enabled, the spelling strings given
+   * to im_search() and the other functions are digits '2' to '9' (with '\''
+   * as the splitter) from a numeric keypad, and each digit string is decoded
+   * into all the spellings it can type. The search is reset if the mode
+   * changes.
+   */
+  void im_set_t9(bool enable);
+
+  /**
+   * A decoder session. Each session has its own search space and prediction
+   * buffer, and shares the dictionaries of the decoder opened by
+   * im_open_decoder() or im_open_decoder_fd(). The system dictionary is
+   * shared read-only, and the user dictionary is shared with synchronized
+   * access, so different sessions can be used on different threads at the
+   * same time, for example to decode speculatively in the background. A
+   * session must only be used by one thread at a time.
+   */
+  typedef struct ImSession ImSession;
+
+  /**
+   * Open a decoder session on the opened decoder. The session uses the
+   * maximum lengths set by im_set_max_lens(), the fuzzy pairs set by
+   * im_set_fuzzy() and the mode set by im_set_t9() at the time it is opened.
+   *
+   * @return The session, or NULL if the decoder is not opened. All sessions
+   * must be closed before im_close_decoder() is called, or before the decoder
+   * is opened again.
+   */
+  ImSession* im_open_session();
+
+  /**
+   * Close a session opened by im_open_session().
+   */
+  void im_close_session(ImSession *session);
+
+  /**
+   * Same as im_search(), but in the given session.
+   */
+  size_t im_session_search(ImSession *session, const char* sps_buf,
+                           size_t sps_len);
+
+  /**
+   * Same as im_delsearch(), but in the given session.
+   */
+  size_t im_session_delsearch(ImSession *session, size_t pos,
+                              bool is_pos_in_splid, bool clear_fixed_this_step);
+
+  /**
+   * Same as im_reset_search(), but in the given session.
+   */
+  void im_session_reset_search(ImSession *session);
+
+  /**
+   * Same as im_get_sps_str(), but in the given session.
+   */
+  const char *im_session_get_sps_str(ImSession *session, size_t *decoded_len);
+
+  /**
+   * Same as im_get_candidate(), but in the given session.
+   */
+  char16* im_session_get_candidate(ImSession *session, size_t cand_id,
+                                   char16* cand_str, size_t max_len);
+
+  /**
+   * Same as im_get_candidates(), but in the given session.
+   */
+  size_t im_session_get_candidates(ImSession *session, size_t start_id,
+                                   size_t count, char16* cand_buf,
+                                   size_t buf_len);
+
+  /**
+   * Same as im_get_spl_start_pos(), but in the given session.
+   */
+  size_t im_session_get_spl_start_pos(ImSession *session,
+                                      const uint16 *&spl_start);
+
+  /**
+   * Same as im_choose(), but in the given session.
+   */
+  size_t im_session_choose(ImSession *session, size_t cand_id);
+
+  /**
+   * Same as im_cancel_last_choice(), but in the given session.
+   */
+  size_t im_session_cancel_last_choice(ImSession *session);
+
+  /**
+   * Same as im_get_fixed_len(), but in the given session.
+   */
+  size_t im_session_get_fixed_len(ImSession *session);
+
+  /**
+   * Same as im_get_predicts(), but in the given session. pre_buf points to the
+   * prediction buffer of the session.
+   */
+  size_t im_session_get_predicts(ImSession *session, const char16 *his_buf,
+                                 char16 (*&pre_buf)[kMaxPredictSize + 1]);
+
+  class DecodeWorker;
+  class DecodeListener;
+
+  /**
+   * Start a decode worker on the opened decoder. The worker decodes the
+   * spelling strings posted to it on its own thread, in its own session, and
+   * publishes the first page_size candidates of each to the listener. See
+   * decodeworker.h.
+   *
+   * @return The worker, or NULL if the decoder is not opened or the thread
+   * can not be started. Like a session, a worker must be closed before the
+   * decoder is closed or opened again.
+   */
+  DecodeWorker* im_open_worker(size_t page_size, DecodeListener *listener);
+
+  /**
+   * Stop and delete a worker opened by im_open_worker().
+   */
+  void im_close_worker(DecodeWorker *worker);
 }
 
 #ifdef __cplusplus
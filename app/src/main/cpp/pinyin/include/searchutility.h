@@ -19,6 +19,7 @@
 
 #include <stdlib.h>
 #include "spellingtrie.h"
+#include "utf16char.h"
 
 namespace ime_pinyin {
 
@@ -112,12 +113,7 @@ bool is_system_lemma(LemmaIdType lma_id);
 bool is_user_lemma(LemmaIdType lma_id);
 bool is_composing_lemma(LemmaIdType lma_id);
 
-int cmp_lpi_with_psb(const void *p1, const void *p2);
-int cmp_lpi_with_unified_psb(const void *p1, const void *p2);
 int cmp_lpi_with_id(const void *p1, const void *p2);
-int cmp_lpi_with_hanzi(const void *p1, const void *p2);
-
-int cmp_lpsi_with_str(const void *p1, const void *p2);
 
 int cmp_hanzis_1(const void *p1, const void *p2);
 int cmp_hanzis_2(const void *p1, const void *p2);
@@ -128,13 +124,71 @@ int cmp_hanzis_6(const void *p1, const void *p2);
 int cmp_hanzis_7(const void *p1, const void *p2);
 int cmp_hanzis_8(const void *p1, const void *p2);
 
-int cmp_npre_by_score(const void *p1, const void *p2);
-int cmp_npre_by_hislen_score(const void *p1, const void *p2);
-int cmp_npre_by_hanzi_score(const void *p1, const void *p2);
+// The orders below are "less than" function objects for mysort() and
+// mypartial_sort(), so that the comparisons are inlined.
+
+struct LpiLessByPsb {
+  bool operator()(const LmaPsbItem &item1, const LmaPsbItem &item2) const {
+    return item1.psb < item2.psb;
+  }
+};
+
+struct LpiLessByUnifiedPsb {
+  bool operator()(const LmaPsbItem &item1, const LmaPsbItem &item2) const {
+    // The real unified psb is psb1 / lma_len1 and psb2 * lma_len2
+    // But we use psb1 * lma_len2 and psb2 * lma_len1 to get better
+    // precision.
+    size_t up1 = item1.psb * (item2.lma_len);
+    size_t up2 = item2.psb * (item1.lma_len);
+    return up1 < up2;
+  }
+};
+
+struct LpiLessByHanzi {
+  bool operator()(const LmaPsbItem &item1, const LmaPsbItem &item2) const {
+    return item1.hanzi < item2.hanzi;
+  }
+};
+
+struct LpsiLessByStr {
+  bool operator()(const LmaPsbStrItem &item1,
+                  const LmaPsbStrItem &item2) const {
+    return utf16_strcmp(item1.str, item2.str) < 0;
+  }
+};
+
+struct NpreLessByScore {
+  bool operator()(const NPredictItem &item1, const NPredictItem &item2) const {
+    return item1.psb < item2.psb;
+  }
+};
+
+// Longer history first, then by the score.
+struct NpreLessByHislenScore {
+  bool operator()(const NPredictItem &item1, const NPredictItem &item2) const {
+    if (item1.his_len != item2.his_len)
+      return item1.his_len > item2.his_len;
+    return item1.psb < item2.psb;
+  }
+};
+
+struct NpreLessByHanziScore {
+  bool operator()(const NPredictItem &item1, const NPredictItem &item2) const {
+    int ret_v = utf16_strncmp(item1.pre_hzs, item2.pre_hzs, kMaxPredictSize);
+    if (0 != ret_v)
+      return ret_v < 0;
+    return item1.psb < item2.psb;
+  }
+};
 
 
 size_t remove_duplicate_npre(NPredictItem *npre_items, size_t npre_num);
 
+// Remove the items whose predicted strings are already among the b4_used
+// items before npre_items. Returns the number of items left.
+size_t remove_used_npre(NPredictItem *npre_items, size_t npre_num,
+                        size_t b4_used);
+
 size_t align_to_size_t(size_t size);
 
 }  // namespace
@@ -20,11 +20,51 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "dictdef.h"
+#include "dictimage.h"
 
 namespace ime_pinyin {
 
 static const unsigned short kFullSplIdStart = kHalfSpellingIdNum + 1;
 
+// Fuzzy Pinyin pairs, which can be ORed together. With a pair enabled, a
+// spelling also matches the spellings obtained by swapping the two sides of
+// the pair; for example, with kFuzzyZZh and kFuzzyAnAng, "zan" also matches
+// "zang", "zhan" and "zhang".
+static const uint16 kFuzzyZZh = 0x01;
+static const uint16 kFuzzyCCh = 0x02;
+static const uint16 kFuzzySSh = 0x04;
+static const uint16 kFuzzyNL = 0x08;
+static const uint16 kFuzzyAnAng = 0x10;
+static const uint16 kFuzzyEnEng = 0x20;
+static const uint16 kFuzzyInIng = 0x40;
+
+// Number of spelling ids, both half and full, including the unused id 0.
+static const size_t kSplIdNum = kFullSplIdStart + kMaxSpellingNum;
+
+// A set of full spelling ids, kept as a bitmap over all spelling ids, with
+// its range to bound the searches which use it.
+struct SplIdSet {
+  uint16 id_min;
+  uint16 id_max;
+  uint16 id_num;
+  uint32 bits[(kSplIdNum + 31) / 32];
+
+  inline bool has(uint16 splid) const {
+    return 0 != (bits[splid >> 5] & (1u << (splid & 0x1f)));
+  }
+
+  inline void add(uint16 splid) {
+    if (has(splid))
+      return;
+    bits[splid >> 5] |= 1u << (splid & 0x1f);
+    if (0 == id_num || splid < id_min)
+      id_min = splid;
+    if (0 == id_num || splid > id_max)
+      id_max = splid;
+    id_num++;
+  }
+};
+
 // Node used for the trie of spellings
 struct SpellingNode {
   SpellingNode *first_son;
@@ -38,6 +78,12 @@ struct SpellingNode {
 
 class SpellingTrie {
  private:
+  // A spelling in the T9 index, with the digits which type it.
+  struct T9Item {
+    char code[kMaxPinyinSize + 1];
+    uint16 splid;
+  };
+
   static const int kMaxYmNum = 64;
   static const size_t kValidSplCharNum = 26;
 
@@ -114,6 +160,13 @@ class SpellingTrie {
   // Map from full id to half id.
   uint16 *f2h_;
 
+  // The T9 index, sorted by the digit strings. It has the half ids which
+  // have full ids, and the full ids of the spellings longer than one char;
+  // single-char spellings are typed through their half ids, as in
+  // SpellingParser::get_splid_by_str().
+  T9Item *t9_items_;
+  size_t t9_num_;
+
 #ifdef ___BUILD_MODEL___
   // How many node used to build the trie.
   size_t node_num_;
@@ -131,6 +184,12 @@ class SpellingTrie {
                                            size_t level, SpellingNode *parent);
   bool build_f2h();
 
+  // Build the T9 index from the spelling table.
+  bool build_t9_index();
+
+  // Compare two T9Items by their codes, then by their ids.
+  static int compare_t9_items(const void *p1, const void *p2);
+
   // The caller should guarantee ch >= 'A' && ch <= 'Z'
   bool is_shengmu_char(char ch) const;
 
@@ -225,6 +284,12 @@ class SpellingTrie {
   // with a full id like "Zhe". (Fussy mode is not ready).
   bool half_full_compatible(uint16 half_id, uint16 full_id) const;
 
+  // Fill sets, which has kSplIdNum items, so that sets[splid] holds the full
+  // ids matched by splid with the given fuzzy pairs (kFuzzyXxx ORed
+  // together). For a full id, these are the id itself and its fuzzy
+  // variants; for a half id, the full ids it covers and their variants.
+  void build_fuzzy_sets(uint16 fuzzy_flags, SplIdSet *sets) const;
+
   static const SpellingTrie* get_cpinstance();
 
   static SpellingTrie& get_instance();
@@ -232,12 +297,19 @@ class SpellingTrie {
   // Save to the file stream
   bool save_spl_trie(FILE *fp);
 
-  // Load from the file stream
-  bool load_spl_trie(FILE *fp);
+  // Load from the dictionary image
+  bool load_spl_trie(DictImage *image);
 
   // Get the number of spellings
   size_t get_spelling_num();
 
+  // Get the spelling ids typed by the T9 digits ('2' to '9') of the given
+  // string, at most max_num of them. Half ids are returned as they are, so
+  // the caller should check them with if_valid_id_update(). *is_pre returns
+  // whether the digits also begin the digits of a longer spelling.
+  uint16 t9_to_splids(const char *digits, uint16 digits_len, uint16 *splids,
+                      uint16 max_num, bool *is_pre) const;
+
   // Return the Yunmu id for the given Yunmu string.
   // If the string is not valid, return 0;
   uint8 get_ym_id(const char* ym_str);
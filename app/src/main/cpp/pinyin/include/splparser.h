@@ -77,6 +77,19 @@ class SpellingParser {
   // Splitter chars are not included.
   bool is_valid_to_parse(char ch);
 
+  // Similar to is_valid_to_parse(), but for T9 input, whose valid chars are
+  // the digits '2' to '9'.
+  bool is_valid_to_parse_t9(char ch);
+
+  // Similar to get_splid_by_str(), but the string is T9 digits. Because a
+  // digit string can type several spellings, for example, "64" types "mi"
+  // and "ni", all of them are returned in splidx, at most max_size, through
+  // the T9 index of SpellingTrie.
+  // *is_pre returns whether the digits are the prefix of the digits of a
+  // longer spelling.
+  uint16 get_splids_t9(const char *splstr, uint16 str_len, uint16 splidx[],
+                       uint16 max_size, bool *is_pre);
+
   // When auto-correction is not enabled, get_splid_by_str() will be called to
   // return the single result. When auto-correction is enabled, this function
   // will be called to get the results. Auto-correction is not ready.
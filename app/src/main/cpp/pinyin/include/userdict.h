@@ -17,7 +17,6 @@
 #ifndef PINYINIME_INCLUDE_USERDICT_H__
 #define PINYINIME_INCLUDE_USERDICT_H__
 
-#define ___CACHE_ENABLED___
 #define ___SYNC_ENABLED___
 #define ___PREDICT_ENABLED___
 
@@ -26,6 +25,7 @@
 
 #include <pthread.h>
 #include "atomdictbase.h"
+#include "userdictjournal.h"
 
 namespace ime_pinyin {
 
@@ -82,11 +82,20 @@ class UserDict : public AtomDictBase {
 
   void flush_cache();
 
+  uint32 get_version();
+
   void set_limit(uint32 max_lemma_count, uint32 max_lemma_size,
                  uint32 reclaim_ratio);
 
+  // Remove reclaim_ratio percent of the lemmas in use, those with the lowest
+  // scores, at once. When a limit is reached while putting a lemma, the same
+  // is done a bounded step at a time instead, see reclaim_step().
   void reclaim();
 
+  // Drop the removed lemmas from memory, and renumber the lemma ids from
+  // start_id_. Searches may hold lemma ids, so it is only done by
+  // close_dict(). While the dictionary is in use, compact() drops the removed
+  // lemmas instead.
   void defragment();
 
 #ifdef ___SYNC_ENABLED___
@@ -136,6 +145,10 @@ class UserDict : public AtomDictBase {
     uint32 reclaim_ratio;
     uint32 limit_lemma_count;
     uint32 limit_lemma_size;
+    // Bytes of the journal, including the records not written yet
+    uint32 journal_size;
+    // The longest time a reclaim step or a defragment took, in microseconds
+    uint32 max_pause_us;
   };
 
   bool state(UserDictStat * stat);
@@ -143,8 +156,17 @@ class UserDict : public AtomDictBase {
  private:
   uint32 total_other_nfreq_;
   struct timeval load_time_;
+  // When the dictionary was loaded, or last written by this object, to find
+  // out whether others wrote it since. The journal thread updates it with
+  // g_mutex_ held.
+  struct timeval sync_time_;
   LemmaIdType start_id_;
+  // Bumped whenever the lemmas or their scores change, including loading and
+  // closing, so that the lookup results cached by the decoder can be
+  // invalidated. It is never reset.
   uint32 version_;
+  // See UserDictStat::max_pause_us. It is never reset.
+  uint32 max_pause_us_;
   uint8 * lemmas_;
 
   // In-Memory-Only flag for each lemma
@@ -189,6 +211,14 @@ class UserDict : public AtomDictBase {
   size_t lemma_count_left_;
   size_t lemma_size_left_;
 
+  // The number of lemma ids handed out since the lemmas were loaded or
+  // renumbered, including those of the removed lemmas, and the room left for
+  // more in offsets_by_id_. The ids of lemmas dropped by compact() are not
+  // used again, and their offsets_by_id_ have kUserDictOffsetFlagRemove set.
+  uint32 id_count_;
+  size_t id_count_left_;
+  LemmaIdType end_id_;
+
   const char * dict_file_;
 
   // Be sure size is 4xN
@@ -235,59 +265,42 @@ class UserDict : public AtomDictBase {
     USER_DICT_DEFRAGMENTED,
   } state_;
 
+  // Changes of lemmas are written to the journal as they happen. When it is
+  // open, state_ only tracks the other changes, e.g. of the sync list, which
+  // are written back on close.
+  UserDictJournal journal_;
+
   struct UserDictSearchable {
     uint16 splids_len;
     uint16 splid_start[kMaxLemmaSize];
     uint16 splid_count[kMaxLemmaSize];
-    // Compact inital letters for both FuzzyCompareSpellId and cache system
+    // Compact inital letters for FuzzyCompareSpellId
     uint32 signature[kMaxLemmaSize / 4];
   };
 
-#ifdef ___CACHE_ENABLED___
-  enum UserDictCacheType {
-    USER_DICT_CACHE,
-    USER_DICT_MISS_CACHE,
+  // Positions in offsets_, ordered by the full spelling ids of the lemmas,
+  // and a shorter lemma comes before the longer ones it prefixes. So the
+  // lemmas sharing a spelling id prefix form a contiguous block, and the
+  // blocks of the next spelling id are nested in it. It lives only in memory,
+  // and has the same capacity as offsets_.
+  uint32 * splid_index_;
+
+  // State of a search over splid_index_.
+  struct UserDictIndexQuery {
+    const UserDictSearchable *searchable;
+    // If not NULL, locate this lemma string, otherwise collect lemma items.
+    const char16 *lemma_str;
+    // Position in offsets_ of the located lemma, -1 if not found.
+    int32 located;
+    LmaPsbItem *lpi_items;
+    size_t lpi_max;
+    size_t lpi_num;
+    // Whether any lemma has the searched spelling ids as a prefix. Removed
+    // lemmas are counted until the next defragment.
+    bool prefix_found;
   };
 
-  static const int kUserDictCacheSize = 4;
-  static const int kUserDictMissCacheSize = kMaxLemmaSize - 1;
-
-  struct UserDictMissCache {
-    uint32 signatures[kUserDictMissCacheSize][kMaxLemmaSize / 4];
-    uint16 head, tail;
-  } miss_caches_[kMaxLemmaSize];
-
-  struct UserDictCache {
-    uint32 signatures[kUserDictCacheSize][kMaxLemmaSize / 4];
-    uint32 offsets[kUserDictCacheSize];
-    uint32 lengths[kUserDictCacheSize];
-    // Ring buffer
-    uint16 head, tail;
-  } caches_[kMaxLemmaSize];
-
-  void cache_init();
-
-  void cache_push(UserDictCacheType type,
-                 UserDictSearchable *searchable,
-                 uint32 offset, uint32 length);
-
-  bool cache_hit(UserDictSearchable *searchable,
-                 uint32 *offset, uint32 *length);
-
-  bool load_cache(UserDictSearchable *searchable,
-                  uint32 *offset, uint32 *length);
-
-  void save_cache(UserDictSearchable *searchable,
-                  uint32 offset, uint32 length);
-
-  void reset_cache();
-
-  bool load_miss_cache(UserDictSearchable *searchable);
-
-  void save_miss_cache(UserDictSearchable *searchable);
-
-  void reset_miss_cache();
-#endif
+  typedef int (UserDict::*UserDictCompare)(uint32 a, uint32 b);
 
   LmaScoreType translate_score(int f);
 
@@ -311,12 +324,6 @@ class UserDict : public AtomDictBase {
 
   int _get_lemma_score(LemmaIdType lemma_id);
 
-  int is_fuzzy_prefix_spell_id(const uint16 * id1, uint16 len1,
-                               const UserDictSearchable *searchable);
-
-  bool is_prefix_spell_id(const uint16 * fullids,
-                          uint16 fulllen, const UserDictSearchable *searchable);
-
   uint32 get_dict_file_size(UserDictInfo * info);
 
   bool reset(const char *file);
@@ -349,13 +356,40 @@ class UserDict : public AtomDictBase {
   int32 fuzzy_compare_spell_id(const uint16 * id1, uint16 len1,
                                const UserDictSearchable *searchable);
 
-  // Compare exactly two spell ids
-  // First argument must be a full id spell id
-  bool equal_spell_id(const uint16 * fullids,
-                      uint16 fulllen, const UserDictSearchable *searchable);
+  // Find where to insert a lemma into offsets_ by initial letters
+  uint32 locate_where_to_insert_in_offsets(const UserDictSearchable *searchable,
+                                           uint32 count);
+
+  // Spelling id at pos of the lemma referred by splid_index_[index],
+  // 0 if the lemma has no more than pos spelling ids.
+  inline uint16 get_index_splid(uint32 index, uint16 pos);
+
+  // Find the first item in [begin, end) of splid_index_ whose spelling id at
+  // pos is not less than splid. Items in the range must share the spelling
+  // ids before pos.
+  uint32 locate_in_index(uint32 begin, uint32 end, uint16 pos, uint16 splid);
+
+  // Visit the lemmas in [begin, end) of splid_index_ matching the spelling
+  // ids of the query from pos on.
+  void search_index(UserDictIndexQuery *query, uint32 begin, uint32 end,
+                    uint16 pos);
 
-  // Find first item by initial letters
-  int32 locate_first_in_offsets(const UserDictSearchable *searchable);
+  // Compare two lemmas by spelling ids, given their positions in offsets_
+  int compare_splids_at(uint32 a, uint32 b);
+
+  // Compare two lemmas by words, given their offsets
+  int compare_words_at(uint32 a, uint32 b);
+
+  // Heap sort an array of offsets or positions
+  void sort_by(uint32 * array, uint32 n, UserDictCompare cmp);
+
+  void sift_down_by(uint32 * array, uint32 i, uint32 n, UserDictCompare cmp);
+
+  // Build splid_index_ for the offsets_ just loaded
+  void build_index();
+
+  // Fix up splid_index_ after a lemma was inserted at pos of offsets_
+  void insert_to_index(uint32 pos);
 
   LemmaIdType append_a_lemma(char16 lemma_str[], uint16 splids[],
                            uint16 lemma_len, uint16 count, uint64 lmt);
@@ -366,6 +400,8 @@ class UserDict : public AtomDictBase {
 
   bool remove_lemma_by_offset_index(int offset_index);
 #ifdef ___PREDICT_ENABLED___
+  // predicts_ is ordered by words. The lemma to insert is the last one, and
+  // is not counted in the search.
   uint32 locate_where_to_insert_in_predicts(const uint16 * words,
                                             int lemma_len);
 
@@ -386,14 +422,74 @@ class UserDict : public AtomDictBase {
   void write_back_all(int fd);
   void write_back();
 
-  struct UserDictScoreOffsetPair {
+  // Make room for more lemmas in memory. Only used with the journal, as
+  // write_back_lemma() relies on the preallocated size.
+  bool grow_buffers();
+
+  // Build the whole dictionary file in memory, in the layout written by
+  // write_back_all(). The caller frees it.
+  uint8 * build_image(size_t *size);
+
+  // Raise state_ for a change of lemmas, unless the journal keeps it.
+  inline void mark_lemmas_dirty(UserDictState state);
+
+  // Write the lemma at offset to the journal, and hand over an image of the
+  // dictionary if the journal needs to be compacted.
+  void log_lemma(uint8 op, uint32 offset, uint32 score, uint8 flags);
+
+  // Apply the records of the journal after the dictionary file is loaded.
+  void replay_journal();
+
+  struct UserDictScoreIdPair {
     int score;
-    uint32 offset_index;
+    LemmaIdType id;
   };
 
-  inline void swap(UserDictScoreOffsetPair * sop, int i, int j);
+  inline void swap(UserDictScoreIdPair * sip, int i, int j);
+
+  void shift_down(UserDictScoreIdPair * sip, int i, int n);
+
+  // How many lemmas a step of reclaim looks at, or removes.
+  static const uint32 kUserDictReclaimScanStep = 256;
+  static const uint32 kUserDictReclaimRemoveStep = 8;
+
+  // A reclaim in progress. The lemmas with the lowest scores found so far are
+  // kept by id in a max-heap, as positions in offsets_ move when lemmas are
+  // put. reclaim_heap_ is NULL if there is no reclaim in progress.
+  UserDictScoreIdPair * reclaim_heap_;
+  uint32 reclaim_num_;
+  uint32 reclaim_heap_size_;
+  // The next position in offsets_ to look at.
+  uint32 reclaim_pos_;
+
+  // Whether a new lemma of lemma_len characters would exceed the limits.
+  // Removed lemmas are not counted.
+  inline bool is_limit_reached(uint16 lemma_len);
+
+  // Start a reclaim if there is none in progress, and do one step of it: look
+  // at the next kUserDictReclaimScanStep lemmas, or if all of them have been
+  // looked at, remove up to kUserDictReclaimRemoveStep of those found.
+  // Return whether the reclaim is still in progress.
+  bool reclaim_step();
+
+  void end_reclaim();
+
+  // Update max_pause_us_ with the time since begin.
+  void record_pause(const struct timeval *begin);
+
+  // Drop the removed lemmas from memory. If renumber_ids is false, the other
+  // lemmas keep their ids, so that the ids held by searches stay valid.
+  void compact(bool renumber_ids);
+
+  // A run of lemmas in use which compact() moved down by shift bytes.
+  struct UserDictMovedRun {
+    uint32 begin;
+    uint32 end;
+    uint32 shift;
+  };
 
-  void shift_down(UserDictScoreOffsetPair * sop, int i, int n);
+  static uint32 move_offset(const UserDictMovedRun * runs, uint32 run_num,
+                            uint32 offset);
 
   // On-disk format for each lemma
   // +-------------+
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PINYINIME_INCLUDE_USERDICTJOURNAL_H__
+#define PINYINIME_INCLUDE_USERDICTJOURNAL_H__
+
+#include <pthread.h>
+#include <sys/time.h>
+#include "dictdef.h"
+
+namespace ime_pinyin {
+
+// An append-only journal of the lemma changes of a user dictionary, kept in
+// the file "<dict file>.journal" next to the dictionary file.
+//
+// A record keeps the state of a lemma after a change, not the change itself,
+// so replaying a record which is already in the dictionary file does not
+// change anything. That is why the dictionary file and the journal do not
+// need to be switched atomically during compaction.
+//
+// Records are collected in memory and written by a thread in groups, at most
+// kCommitDelayMs after the first one, with one fdatasync() for each group.
+// When the journal grows over kCompactSize, the owner hands over an image of
+// the whole dictionary file. The thread writes it to a temporary file, renames
+// it over the dictionary file, and cuts the records before the image off the
+// journal. The caller never waits for the disk.
+//
+// All functions are called by the owner from one thread at a time.
+class UserDictJournal {
+ public:
+  // The record keeps the score of the lemma after it was put or updated.
+  static const uint8 kOpPut = 1;
+  static const uint8 kOpRemove = 2;
+
+  // The lemma was queued for sync.
+  static const uint8 kFlagSync = 1;
+
+  struct Record {
+    uint8 op;
+    uint8 flags;
+    uint8 nchar;
+    uint8 spare;
+    uint32 score;
+    // UserDictInfo::total_nfreq after the change.
+    int32 total_nfreq;
+    // Checksum of the record and the payload, with this field as 0.
+    uint32 checksum;
+    // Followed by nchar spelling ids and nchar characters.
+  };
+
+  // How many records are written together.
+  static const size_t kGroupSize = 16;
+
+  // How long a record may wait to be written, in milliseconds.
+  static const uint32 kCommitDelayMs = 1000;
+
+  // The journal size which triggers a compaction, in bytes.
+  static const size_t kCompactSize = 64 * 1024;
+
+  UserDictJournal();
+  ~UserDictJournal();
+
+  // Open or create the journal of dict_file, and read its records into
+  // memory. A record which was not completely written, e.g. because the
+  // process was killed, is cut off with the records after it. The caller
+  // must hold the lock of the dictionary file.
+  bool open(const char *dict_file);
+
+  // The number of put records read by open(), and the bytes their lemmas
+  // take in the dictionary, so that the caller can reserve space for them.
+  void get_replay_size(size_t *put_num, size_t *lemma_size);
+
+  // Get the next record read by open(), or NULL after the last one.
+  const Record* next_record();
+
+  // Start the thread which writes the records. file_mutex guards the
+  // dictionary file and last_update, which is the time the file was last
+  // written by anyone; sync_time is the owner's. Both times are updated
+  // after the journal is written, see UserDict::sync_time_.
+  bool start(pthread_mutex_t *file_mutex, struct timeval *last_update,
+             struct timeval *sync_time);
+
+  // Stop the thread after the records are written and the compaction in
+  // progress is done. If image is not NULL, it is written as the new
+  // dictionary file and the journal is emptied. The journal is closed.
+  void close(uint8 *image, size_t image_size);
+
+  bool is_open() { return fd_ >= 0; }
+
+  // Queue a record. The spelling ids and characters are copied.
+  void append(uint8 op, uint8 flags, uint32 score, int32 total_nfreq,
+              uint16 nchar, const uint16 *splids, const char16 *lemma);
+
+  // Whether the journal is large enough to be compacted, and no compaction
+  // is in progress.
+  bool need_compact();
+
+  // Hand over image, the dictionary file with all queued records applied,
+  // which was allocated by malloc(). It is written in the background.
+  void compact(uint8 *image, size_t image_size);
+
+  // The size of the journal file and the queued records, in bytes.
+  size_t size();
+
+  static const uint16* get_splids(const Record *record) {
+    return reinterpret_cast<const uint16*>(record + 1);
+  }
+
+  static const char16* get_lemma(const Record *record) {
+    return reinterpret_cast<const char16*>(record + 1) + record->nchar;
+  }
+
+ private:
+  static const uint32 kJournalVersion = 0x0ABCDEF1;
+
+  static size_t get_record_size(uint16 nchar) {
+    return sizeof(Record) + (nchar << 2);
+  }
+
+  static uint32 get_checksum(const uint8 *buf, size_t size);
+
+  static void* thread_main(void *arg);
+
+  void run();
+
+  // Append buf to the journal file and sync it.
+  bool write_records(const uint8 *buf, size_t size);
+
+  // Replace the dictionary file with image, and cut the records before
+  // image_pos off the journal file.
+  bool write_image(const uint8 *image, size_t image_size, size_t image_pos);
+
+  // Whether the dictionary file was written by other UserDict objects since
+  // it was loaded. Called with file_mutex_ held.
+  bool is_stale();
+
+  // Update the times after the files are written. Called with file_mutex_
+  // held.
+  void mark_written();
+
+  void reset();
+
+  char *journal_file_;
+  char *dict_file_;
+  int fd_;
+
+  // The records read by open().
+  uint8 *replay_buf_;
+  size_t replay_size_;
+  size_t replay_pos_;
+
+  pthread_mutex_t *file_mutex_;
+  struct timeval *last_update_;
+  struct timeval *sync_time_;
+
+  // The size of the journal file. Only used by the thread after start().
+  size_t file_size_;
+
+  pthread_t thread_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t cond_;
+  bool started_;
+
+  // The following members are guarded by mutex_.
+  bool stopping_;
+  uint8 *pending_buf_;
+  size_t pending_size_;
+  size_t pending_capacity_;
+  size_t pending_num_;
+  struct timespec pending_deadline_;
+  uint8 *image_;
+  size_t image_size_;
+  // The journal position which image_ includes.
+  size_t image_pos_;
+  bool compacting_;
+  // The size of the journal file after the queued records are written.
+  size_t queued_end_;
+};
+}
+
+#endif  // PINYINIME_INCLUDE_USERDICTJOURNAL_H__
@@ -19,8 +19,6 @@
 
 namespace ime_pinyin {
 
-LpiCache* LpiCache::instance_ = NULL;
-
 LpiCache::LpiCache() {
   lpi_cache_ = new LmaPsbItem[kFullSplIdStart * kMaxLpiCachePerId];
   lpi_cache_len_ = new uint16[kFullSplIdStart];
@@ -38,14 +36,6 @@ LpiCache::~LpiCache() {
     delete [] lpi_cache_len_;
 }
 
-LpiCache& LpiCache::get_instance() {
-  if (NULL == instance_) {
-    instance_ = new LpiCache();
-    assert(NULL != instance_);
-  }
-  return *instance_;
-}
-
 bool LpiCache::is_cached(uint16 splid) {
   if (splid >= kFullSplIdStart)
     return false;
@@ -78,4 +68,9 @@ size_t LpiCache::get_cache(uint16 splid, LmaPsbItem lpi_items[],
   return lpi_max;
 }
 
+void LpiCache::reset() {
+  for (uint16 id = 0; id < kFullSplIdStart; id++)
+    lpi_cache_len_[id] = 0;
+}
+
 }  // namespace ime_pinyin
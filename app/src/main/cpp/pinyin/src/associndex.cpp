@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "associndex.h"
+#include "mystdlib.h"
+#include "ngram.h"
+#include "utf16char.h"
+
+namespace ime_pinyin {
+
+#ifdef ___BUILD_MODEL___
+// A lemma in the list of a history, used to build the index.
+struct AssocEntry {
+  char16 hzs[AssocIndex::kMaxHisLen];
+  float psb;
+  LemmaIdType id;
+};
+
+static int cmp_assoc_entry(const void *p1, const void *p2) {
+  const AssocEntry *e1 = static_cast<const AssocEntry*>(p1);
+  const AssocEntry *e2 = static_cast<const AssocEntry*>(p2);
+
+  for (uint16 pos = 0; pos < AssocIndex::kMaxHisLen; pos++) {
+    if (e1->hzs[pos] != e2->hzs[pos])
+      return e1->hzs[pos] < e2->hzs[pos] ? -1 : 1;
+  }
+
+  if (e1->psb != e2->psb)
+    return e1->psb < e2->psb ? -1 : 1;
+
+  if (e1->id != e2->id)
+    return e1->id < e2->id ? -1 : 1;
+
+  return 0;
+}
+#endif  // ___BUILD_MODEL___
+
+AssocIndex::AssocIndex() {
+  keys_ = NULL;
+  key_num_ = 0;
+  ids_ = NULL;
+  item_num_ = 0;
+  in_image_ = false;
+}
+
+AssocIndex::~AssocIndex() {
+  free_resource();
+}
+
+void AssocIndex::free_resource() {
+  if (!in_image_) {
+    if (NULL != keys_)
+      free(keys_);
+
+    if (NULL != ids_)
+      free(ids_);
+  }
+  keys_ = NULL;
+  key_num_ = 0;
+  ids_ = NULL;
+  item_num_ = 0;
+  in_image_ = false;
+}
+
+inline LemmaIdType AssocIndex::get_lemma_id(size_t pos) {
+  LemmaIdType id = 0;
+  for (uint16 byte = kLemmaIdSize; byte > 0; byte--)
+    id = (id << 8) + ids_[pos * kLemmaIdSize + byte - 1];
+  return id;
+}
+
+const AssocIndex::AssocKey* AssocIndex::find_key(const char16 hzs[],
+                                                 uint16 hzs_len) {
+  assert(hzs_len > 0 && hzs_len <= kMaxHisLen);
+
+  char16 key_hzs[kMaxHisLen];
+  for (uint16 pos = 0; pos < kMaxHisLen; pos++)
+    key_hzs[pos] = pos < hzs_len ? hzs[pos] : 0;
+
+  size_t begin = 0;
+  size_t end = key_num_;
+  while (begin < end) {
+    size_t middle = (begin + end) >> 1;
+    int cmp = 0;
+    for (uint16 pos = 0; pos < kMaxHisLen && 0 == cmp; pos++) {
+      if (keys_[middle].hzs[pos] != key_hzs[pos])
+        cmp = keys_[middle].hzs[pos] < key_hzs[pos] ? -1 : 1;
+    }
+    if (0 == cmp)
+      return keys_ + middle;
+    if (cmp < 0)
+      begin = middle + 1;
+    else
+      end = middle;
+  }
+  return NULL;
+}
+
+bool AssocIndex::load_index(DictImage *image) {
+  if (NULL == image)
+    return false;
+
+  free_resource();
+
+  uint32 key_num;
+  uint32 item_num;
+  if (!image->read(&key_num, sizeof(uint32)) ||
+      !image->read(&item_num, sizeof(uint32)))
+    return false;
+
+  keys_ = static_cast<AssocKey*>(const_cast<void*>(
+      image->get_array(sizeof(AssocKey), key_num, sizeof(uint32))));
+  ids_ = static_cast<unsigned char*>(const_cast<void*>(
+      image->get_array(kLemmaIdSize, item_num, sizeof(unsigned char))));
+  in_image_ = true;
+
+  if (NULL == keys_ || NULL == ids_) {
+    free_resource();
+    return false;
+  }
+
+  key_num_ = key_num;
+  item_num_ = item_num;
+
+  // The last list must end within the id buffer.
+  if (key_num_ > 0 &&
+      keys_[key_num_ - 1].item_start + keys_[key_num_ - 1].item_num >
+      item_num_) {
+    free_resource();
+    return false;
+  }
+
+  return true;
+}
+
+#ifdef ___BUILD_MODEL___
+bool AssocIndex::build_index(DictList *dict_list) {
+  if (NULL == dict_list)
+    return false;
+
+  free_resource();
+
+  NGram &ngram = NGram::get_instance();
+
+  // Every lemma is in the lists of its first 1 to kMaxHisLen characters.
+  size_t entry_num = 0;
+  char16 lma_str[kMaxLemmaSize + 1];
+  LemmaIdType id;
+  for (id = 1; dict_list->get_lemma_str(id, lma_str, kMaxLemmaSize + 1) > 0;
+       id++) {
+    uint16 lma_len = utf16_strlen(lma_str);
+    entry_num += lma_len - 1 < kMaxHisLen ? lma_len - 1 : kMaxHisLen;
+  }
+
+  AssocEntry *entries = static_cast<AssocEntry*>(
+      malloc((entry_num > 0 ? entry_num : 1) * sizeof(AssocEntry)));
+  if (NULL == entries)
+    return false;
+
+  size_t entry_pos = 0;
+  for (id = 1; dict_list->get_lemma_str(id, lma_str, kMaxLemmaSize + 1) > 0;
+       id++) {
+    uint16 lma_len = utf16_strlen(lma_str);
+    for (uint16 his_len = 1; his_len < lma_len && his_len <= kMaxHisLen;
+         his_len++) {
+      AssocEntry *entry = entries + entry_pos;
+      for (uint16 pos = 0; pos < kMaxHisLen; pos++)
+        entry->hzs[pos] = pos < his_len ? lma_str[pos] : 0;
+      entry->psb = ngram.get_uni_psb(id);
+      entry->id = id;
+      entry_pos++;
+    }
+  }
+  assert(entry_pos == entry_num);
+
+  myqsort(entries, entry_num, sizeof(AssocEntry), cmp_assoc_entry);
+
+  // Count the keys and the items kept.
+  size_t key_num = 0;
+  size_t item_num = 0;
+  size_t his_items = 0;
+  for (size_t pos = 0; pos < entry_num; pos++) {
+    if (0 == pos || 0 != memcmp(entries[pos].hzs, entries[pos - 1].hzs,
+                                sizeof(entries[pos].hzs))) {
+      key_num++;
+      his_items = 0;
+    }
+    if (his_items < kMaxItemsPerHis) {
+      item_num++;
+      his_items++;
+    }
+  }
+
+  keys_ = static_cast<AssocKey*>(
+      malloc((key_num > 0 ? key_num : 1) * sizeof(AssocKey)));
+  ids_ = static_cast<unsigned char*>(
+      malloc((item_num > 0 ? item_num : 1) * kLemmaIdSize));
+  if (NULL == keys_ || NULL == ids_) {
+    free(entries);
+    free_resource();
+    return false;
+  }
+
+  key_num_ = 0;
+  item_num_ = 0;
+  for (size_t pos = 0; pos < entry_num; pos++) {
+    if (0 == pos || 0 != memcmp(entries[pos].hzs, entries[pos - 1].hzs,
+                                sizeof(entries[pos].hzs))) {
+      AssocKey *key = keys_ + key_num_;
+      memcpy(key->hzs, entries[pos].hzs, sizeof(key->hzs));
+      key->item_num = 0;
+      key->item_start = static_cast<uint32>(item_num_);
+      key_num_++;
+    }
+
+    AssocKey *key = keys_ + key_num_ - 1;
+    if (key->item_num < kMaxItemsPerHis) {
+      for (uint16 byte = 0; byte < kLemmaIdSize; byte++)
+        ids_[item_num_ * kLemmaIdSize + byte] =
+            static_cast<unsigned char>(entries[pos].id >> (byte * 8));
+      key->item_num++;
+      item_num_++;
+    }
+  }
+  assert(key_num_ == key_num && item_num_ == item_num);
+
+  free(entries);
+  return true;
+}
+
+bool AssocIndex::save_index(FILE *fp) {
+  if (NULL == fp || NULL == keys_ || NULL == ids_)
+    return false;
+
+  uint32 key_num = static_cast<uint32>(key_num_);
+  uint32 item_num = static_cast<uint32>(item_num_);
+  if (fwrite(&key_num, sizeof(uint32), 1, fp) != 1)
+    return false;
+
+  if (fwrite(&item_num, sizeof(uint32), 1, fp) != 1)
+    return false;
+
+  if (!DictImage::write_padding(fp) ||
+      fwrite(keys_, sizeof(AssocKey), key_num_, fp) != key_num_)
+    return false;
+
+  if (!DictImage::write_padding(fp) ||
+      fwrite(ids_, kLemmaIdSize, item_num_, fp) != item_num_)
+    return false;
+
+  return true;
+}
+#endif  // ___BUILD_MODEL___
+
+size_t AssocIndex::predict(DictList *dict_list, const char16 last_hzs[],
+                           uint16 hzs_len, NPredictItem *npre_items,
+                           size_t npre_max, size_t b4_used) {
+  if (NULL == keys_ || NULL == dict_list || 0 == hzs_len ||
+      hzs_len > kMaxHisLen)
+    return 0;
+
+  const AssocKey *key = find_key(last_hzs, hzs_len);
+  if (NULL == key)
+    return 0;
+
+  NGram& ngram = NGram::get_instance();
+
+  size_t item_num = 0;
+  char16 lma_str[kMaxLemmaSize + 1];
+  for (size_t pos = key->item_start;
+       pos < key->item_start + key->item_num && item_num < npre_max; pos++) {
+    LemmaIdType id = get_lemma_id(pos);
+    uint16 lma_len = dict_list->get_lemma_str(id, lma_str, kMaxLemmaSize + 1);
+    if (lma_len <= hzs_len)
+      continue;
+
+    memset(npre_items + item_num, 0, sizeof(NPredictItem));
+    utf16_strncpy(npre_items[item_num].pre_hzs, lma_str + hzs_len,
+                  lma_len - hzs_len);
+    npre_items[item_num].psb = ngram.get_uni_psb(id);
+    npre_items[item_num].his_len = hzs_len;
+    item_num++;
+  }
+
+  return remove_used_npre(npre_items, item_num, b4_used);
+}
+
+}  // namespace ime_pinyin
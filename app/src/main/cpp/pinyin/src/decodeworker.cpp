@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "decodeworker.h"
+
+namespace ime_pinyin {
+
+DecodeWorker::DecodeWorker() {
+  matrix_search_ = NULL;
+  listener_ = NULL;
+  page_size_ = 0;
+  started_ = false;
+  stopping_ = false;
+  has_pending_ = false;
+  pending_reset_ = false;
+  pending_len_ = 0;
+  posted_num_ = 0;
+  version_ = 0;
+  working_version_ = 0;
+  published_num_ = 0;
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&cond_, NULL);
+}
+
+DecodeWorker::~DecodeWorker() {
+  stop();
+  pthread_cond_destroy(&cond_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+bool DecodeWorker::start(const MatrixSearch *owner, size_t page_size,
+                         DecodeListener *listener) {
+  if (started_ || NULL == owner || NULL == listener || 0 == page_size)
+    return false;
+
+  matrix_search_ = new MatrixSearch();
+  if (NULL == matrix_search_)
+    return false;
+
+  if (!matrix_search_->init_session(owner)) {
+    delete matrix_search_;
+    matrix_search_ = NULL;
+    return false;
+  }
+  matrix_search_->set_abort_check(is_stale, this);
+
+  listener_ = listener;
+  page_size_ = page_size < DecodePage::kMaxCands ?
+      page_size : DecodePage::kMaxCands;
+  stopping_ = false;
+  has_pending_ = false;
+
+  if (0 != pthread_create(&thread_, NULL, thread_main, this)) {
+    matrix_search_->close();
+    delete matrix_search_;
+    matrix_search_ = NULL;
+    return false;
+  }
+  started_ = true;
+  return true;
+}
+
+void DecodeWorker::stop() {
+  if (!started_)
+    return;
+
+  pthread_mutex_lock(&mutex_);
+  stopping_ = true;
+  has_pending_ = false;
+  // Abort the search in progress.
+  version_++;
+  pthread_cond_signal(&cond_);
+  pthread_mutex_unlock(&mutex_);
+
+  pthread_join(thread_, NULL);
+  started_ = false;
+
+  matrix_search_->close();
+  delete matrix_search_;
+  matrix_search_ = NULL;
+  listener_ = NULL;
+}
+
+uint32 DecodeWorker::post_search(const char *sps, size_t sps_len) {
+  if (NULL == sps)
+    return 0;
+  return post(sps, sps_len, false);
+}
+
+uint32 DecodeWorker::post_reset() {
+  return post(NULL, 0, true);
+}
+
+uint32 DecodeWorker::post(const char *sps, size_t sps_len, bool reset) {
+  if (!started_)
+    return 0;
+
+  // The same truncation as MatrixSearch::search().
+  if (sps_len > kMaxRowNum - 1)
+    sps_len = kMaxRowNum - 1;
+
+  pthread_mutex_lock(&mutex_);
+  pending_reset_ = reset;
+  pending_len_ = sps_len;
+  if (sps_len > 0)
+    memcpy(pending_sps_, sps, sps_len);
+  pending_sps_[sps_len] = '\0';
+  has_pending_ = true;
+  posted_num_++;
+
+  // Skip 0, which means that the worker is not started.
+  uint32 version = version_ + 1;
+  if (0 == version)
+    version = 1;
+  version_ = version;
+
+  pthread_cond_signal(&cond_);
+  pthread_mutex_unlock(&mutex_);
+  return version;
+}
+
+void DecodeWorker::get_stat(size_t *posted_num, size_t *published_num) {
+  pthread_mutex_lock(&mutex_);
+  if (NULL != posted_num)
+    *posted_num = posted_num_;
+  pthread_mutex_unlock(&mutex_);
+  if (NULL != published_num)
+    *published_num = published_num_;
+}
+
+void* DecodeWorker::thread_main(void *arg) {
+  static_cast<DecodeWorker*>(arg)->run();
+  return NULL;
+}
+
+bool DecodeWorker::is_stale(void *arg) {
+  DecodeWorker *worker = static_cast<DecodeWorker*>(arg);
+  return worker->version_.load(std::memory_order_relaxed) !=
+      worker->working_version_;
+}
+
+void DecodeWorker::run() {
+  pthread_mutex_lock(&mutex_);
+  for (;;) {
+    while (!stopping_ && !has_pending_)
+      pthread_cond_wait(&cond_, &mutex_);
+    if (stopping_)
+      break;
+
+    // Take the newest input. The ones posted before it were replaced.
+    bool reset = pending_reset_;
+    size_t sps_len = pending_len_;
+    memcpy(page_.sps, pending_sps_, sps_len + 1);
+    working_version_ = version_;
+    has_pending_ = false;
+    pthread_mutex_unlock(&mutex_);
+
+    if (reset) {
+      matrix_search_->reset_search();
+    } else {
+      matrix_search_->search(page_.sps, sps_len);
+
+      // Fetching the candidates can take as long as the search, so check
+      // again before each one.
+      page_.version = working_version_;
+      page_.sps_len = sps_len;
+      matrix_search_->get_pystr(&page_.decoded_len);
+      page_.total_num = matrix_search_->get_candidate_num();
+      page_.cand_num = 0;
+      while (page_.cand_num < page_.total_num &&
+             page_.cand_num < page_size_ && !is_stale(this)) {
+        char16 *cand = page_.cands[page_.cand_num];
+        if (NULL == matrix_search_->get_candidate(page_.cand_num, cand,
+                                                  DecodePage::kMaxCandLen + 1))
+          break;
+        page_.cand_lens[page_.cand_num] = utf16_strlen(cand);
+        page_.cand_num++;
+      }
+
+      if (!is_stale(this)) {
+        listener_->on_page(&page_);
+        published_num_++;
+      }
+    }
+
+    pthread_mutex_lock(&mutex_);
+  }
+  pthread_mutex_unlock(&mutex_);
+
+  listener_->on_exit();
+}
+
+}  // namespace ime_pinyin
@@ -36,6 +36,13 @@ namespace ime_pinyin {
 static const size_t kReadBufLen = 512;
 static const size_t kSplTableHashLen = 2000;
 
+// Number of raw dictionary lines which are parsed together.
+static const size_t kParseLineNum = 4096;
+
+// The lemmas are split into this many parts to work on them on several
+// threads.
+static const size_t kLemmaPartNum = 64;
+
 // Compare a SingleCharItem, first by Hanzis, then by spelling ids, then by
 // frequencies.
 int cmp_scis_hz_splid_freq(const void* p1, const void* p2) {
@@ -144,6 +151,37 @@ int compare_splid2(const void* p1, const void* p2) {
   return ret;
 }
 
+// The orders above as "less than" function objects for myparallel_sort().
+
+struct ScisLessByHzSplidFreq {
+  bool operator()(const SingleCharItem &s1, const SingleCharItem &s2) const {
+    return cmp_scis_hz_splid_freq(&s1, &s2) < 0;
+  }
+};
+
+struct LemmaLessByHzs {
+  bool operator()(const LemmaEntry &lma1, const LemmaEntry &lma2) const {
+    return cmp_lemma_entry_hzs(&lma1, &lma2) < 0;
+  }
+};
+
+struct LemmaLessByPy {
+  bool operator()(const LemmaEntry &lma1, const LemmaEntry &lma2) const {
+    return compare_py(&lma1, &lma2) < 0;
+  }
+};
+
+// Call func(begin, end) for the parts of [0, num) on several threads.
+template <typename Func>
+static void for_lemma_parts(size_t num, size_t thread_num, Func func) {
+  size_t part_len = (num + kLemmaPartNum - 1) / kLemmaPartNum;
+  myparallel_for(kLemmaPartNum, thread_num, [&](size_t part) {
+    size_t begin = std::min(num, part * part_len);
+    size_t end = std::min(num, begin + part_len);
+    func(begin, end);
+  });
+}
+
 DictBuilder::DictBuilder() {
   lemma_arr_ = NULL;
   lemma_num_ = 0;
@@ -166,6 +204,11 @@ DictBuilder::DictBuilder() {
 
   spl_table_ = NULL;
   spl_parser_ = NULL;
+
+  subset_tasks_ = NULL;
+  subset_task_num_ = 0;
+
+  thread_num_ = 1;
 }
 
 DictBuilder::~DictBuilder() {
@@ -200,10 +243,15 @@ bool DictBuilder::alloc_resource(size_t lma_num) {
   spl_table_ = new SpellingTable();
   spl_parser_ = new SpellingParser();
 
+  // A subtree for each son of the root at most.
+  subset_task_num_ = 0;
+  subset_tasks_ = new SubsetTask[kMaxSpellingNum + 1];
+
   if (NULL == lemma_arr_ || NULL == top_lmas_ ||
       NULL == scis_ || NULL == spl_table_ ||
       NULL == spl_parser_ || NULL == lma_nodes_le0_ ||
-      NULL == lma_nodes_ge1_ || NULL == homo_idx_buf_) {
+      NULL == lma_nodes_ge1_ || NULL == homo_idx_buf_ ||
+      NULL == subset_tasks_) {
     free_resource();
     return false;
   }
@@ -344,25 +392,114 @@ void DictBuilder::free_resource() {
   if (NULL != homo_idx_buf_)
     delete [] homo_idx_buf_;
 
+  if (NULL != top_lmas_)
+    delete [] top_lmas_;
+
   if (NULL != spl_table_)
     delete spl_table_;
 
   if (NULL != spl_parser_)
     delete spl_parser_;
 
+  if (NULL != subset_tasks_)
+    delete [] subset_tasks_;
+
   lemma_arr_ = NULL;
   scis_ = NULL;
   lma_nodes_le0_ = NULL;
   lma_nodes_ge1_ = NULL;
   homo_idx_buf_ = NULL;
+  top_lmas_ = NULL;
   spl_table_ = NULL;
   spl_parser_ = NULL;
+  subset_tasks_ = NULL;
 
   lemma_num_ = 0;
   lma_nds_used_num_le0_ = 0;
   lma_nds_used_num_ge1_ = 0;
   homo_idx_num_eq1_ = 0;
   homo_idx_num_gt1_ = 0;
+  subset_task_num_ = 0;
+}
+
+void DictBuilder::parse_raw_line(char16 *line, const char16 *valid_hzs,
+                                 size_t valid_hzs_num, RawLine *raw_line) {
+  LemmaEntry *lemma = &raw_line->lemma;
+  memset(lemma, 0, sizeof(LemmaEntry));
+  raw_line->state = kRawLineSkipped;
+  raw_line->spl_num = 0;
+  raw_line->has_more = false;
+
+  size_t token_size;
+  char16 *token;
+  char16 *to_tokenize = line;
+
+  // Get the Hanzi string
+  token = utf16_strtok(to_tokenize, &token_size, &to_tokenize);
+  if (NULL == token) {
+    raw_line->state = kRawLineBroken;
+    return;
+  }
+
+  size_t lemma_size = utf16_strlen(token);
+
+  if (lemma_size > kMaxLemmaSize)
+    return;
+
+  if (lemma_size > 4)
+    return;
+
+  // Copy to the lemma entry
+  utf16_strcpy(lemma->hanzi_str, token);
+
+  lemma->hz_str_len = token_size;
+
+  // Get the freq string
+  token = utf16_strtok(to_tokenize, &token_size, &to_tokenize);
+  if (NULL == token) {
+    raw_line->state = kRawLineBroken;
+    return;
+  }
+  lemma->freq = utf16_atof(token);
+
+  if (lemma_size > 1 && lemma->freq < 60)
+    return;
+
+  // Get GBK mark, if no valid Hanzi list available, all items which contains
+  // GBK characters will be discarded. Otherwise, all items which contains
+  // characters outside of the valid Hanzi list will be discarded.
+  token = utf16_strtok(to_tokenize, &token_size, &to_tokenize);
+  assert(NULL != token);
+  int gbk_flag = utf16_atoi(token);
+  if (NULL == valid_hzs || 0 == valid_hzs_num) {
+    if (0 != gbk_flag)
+      return;
+  } else {
+    if (!str_in_hanzis_list(valid_hzs, valid_hzs_num,
+        lemma->hanzi_str, lemma->hz_str_len))
+      return;
+  }
+
+  // Get spelling String
+  for (size_t hz_pos = 0; hz_pos < (size_t)lemma->hz_str_len; hz_pos++) {
+    // Get a Pinyin
+    token = utf16_strtok(to_tokenize, &token_size, &to_tokenize);
+    if (NULL == token) {
+      raw_line->state = kRawLineOk;
+      return;
+    }
+
+    assert(utf16_strlen(token) <= kMaxPinyinSize);
+
+    utf16_strcpy_tochar(lemma->pinyin_str[hz_pos], token);
+
+    format_spelling_str(lemma->pinyin_str[hz_pos]);
+    raw_line->spl_num++;
+  }
+
+  token = utf16_strtok(to_tokenize, &token_size, &to_tokenize);
+  raw_line->has_more = (NULL != token);
+  raw_line->state = kRawLineOk;
 }
 
 size_t DictBuilder::read_raw_dict(const char* fn_raw,
@@ -374,8 +511,6 @@ size_t DictBuilder::read_raw_dict(const char* fn_raw,
   if (!utf16_reader.open(fn_raw, kReadBufLen * 10))
     return false;
 
-  char16 read_buf[kReadBufLen];
-
   // Read the number of lemmas in the file
   size_t lemma_num = 240000;
 
@@ -389,124 +524,242 @@ size_t DictBuilder::read_raw_dict(const char* fn_raw,
   size_t valid_hzs_num = 0;
   valid_hzs = read_valid_hanzis(fn_validhzs, &valid_hzs_num);
 
-  // Begin reading the lemma entries
-  for (size_t i = 0; i < max_item; i++) {
-    // read next entry
-    if (!utf16_reader.readline(read_buf, kReadBufLen)) {
-      lemma_num = i;
-      break;
-    }
+  char16 (*lines)[kReadBufLen] = new char16[kParseLineNum][kReadBufLen];
+  RawLine *raw_lines = new RawLine[kParseLineNum];
+
+  // Begin reading the lemma entries. The lines are read and parsed a batch
+  // at a time; the parsing is done on several threads, but the lemmas are
+  // taken in the order of the lines, and so is the spelling table updated.
+  size_t i = 0;
+  bool file_end = false;
+  bool broken = false;
+  while (i < max_item && !file_end && !broken) {
+    size_t line_num = 0;
+    while (line_num < kParseLineNum &&
+           utf16_reader.readline(lines[line_num], kReadBufLen))
+      line_num++;
+    if (line_num < kParseLineNum)
+      file_end = true;
+
+    myparallel_for(line_num, thread_num_, [&](size_t line) {
+      parse_raw_line(lines[line], valid_hzs, valid_hzs_num, raw_lines + line);
+    });
+
+    for (size_t line = 0; line < line_num && i < max_item; line++) {
+      RawLine *raw_line = raw_lines + line;
+      if (kRawLineBroken == raw_line->state) {
+        broken = true;
+        break;
+      }
+      if (kRawLineSkipped == raw_line->state)
+        continue;
 
-    size_t token_size;
-    char16 *token;
-    char16 *to_tokenize = read_buf;
+      // Put the pinyins to the spelling table
+      LemmaEntry *lemma = &raw_line->lemma;
+      bool spelling_not_support = false;
+      for (size_t hz_pos = 0; hz_pos < (size_t)lemma->hz_str_len; hz_pos++) {
+        if (hz_pos == raw_line->spl_num) {
+          broken = true;
+          break;
+        }
+        if (!spl_table_->put_spelling(lemma->pinyin_str[hz_pos],
+                                      lemma->freq)) {
+          spelling_not_support = true;
+          break;
+        }
+      }
+      if (broken)
+        break;
 
-    // Get the Hanzi string
-    token = utf16_strtok(to_tokenize, &token_size, &to_tokenize);
-    if (NULL == token) {
-      free_resource();
-      utf16_reader.close();
-      return false;
+      // The whole line must have been parsed fully, otherwise discard this
+      // one.
+      if (spelling_not_support || raw_line->has_more)
+        continue;
+
+      lemma_arr_[i] = *lemma;
+      i++;
     }
+  }
+  lemma_num = i;
 
-    size_t lemma_size = utf16_strlen(token);
+  delete [] raw_lines;
+  delete [] lines;
+  delete [] valid_hzs;
+  utf16_reader.close();
 
-    if (lemma_size > kMaxLemmaSize) {
-      i--;
-      continue;
-    }
+  if (broken) {
+    free_resource();
+    return false;
+  }
 
-    if (lemma_size > 4) {
-      i--;
-      continue;
-    }
+  printf("read succesfully, lemma num: %d\n", lemma_num);
 
-    // Copy to the lemma entry
-    utf16_strcpy(lemma_arr_[i].hanzi_str, token);
+  return lemma_num;
+}
 
-    lemma_arr_[i].hz_str_len = token_size;
+size_t DictBuilder::find_lemmas_by_hzs(const char16 *hzs, size_t *num) {
+  size_t hzs_len = utf16_strlen(hzs);
+
+  // Find the first lemma which is not less than hzs, in the order of
+  // cmp_lemma_entry_hzs().
+  size_t begin = 0;
+  size_t end = lemma_num_;
+  while (begin < end) {
+    size_t middle = (begin + end) >> 1;
+    const LemmaEntry *lemma = lemma_arr_ + middle;
+    if (lemma->hz_str_len < hzs_len || (lemma->hz_str_len == hzs_len &&
+        utf16_strcmp(lemma->hanzi_str, hzs) < 0))
+      begin = middle + 1;
+    else
+      end = middle;
+  }
 
-    // Get the freq string
-    token = utf16_strtok(to_tokenize, &token_size, &to_tokenize);
-    if (NULL == token) {
-      free_resource();
-      utf16_reader.close();
-      return false;
-    }
-    lemma_arr_[i].freq = utf16_atof(token);
+  size_t pos = begin;
+  while (pos < lemma_num_ && 0 == utf16_strcmp(lemma_arr_[pos].hanzi_str, hzs))
+    pos++;
+  *num = pos - begin;
+  return begin;
+}
 
-    if (lemma_size > 1 && lemma_arr_[i].freq < 60) {
-      i--;
-      continue;
-    }
+void DictBuilder::parse_bigram_line(char16 *line,
+                                    RawBigramLine *bigram_line) {
+  bigram_line->state = kRawLineBroken;
+
+  size_t token_size;
+  char16 *token;
+  char16 *to_tokenize = line;
 
-    // Get GBK mark, if no valid Hanzi list available, all items which contains
-    // GBK characters will be discarded. Otherwise, all items which contains
-    // characters outside of the valid Hanzi list will be discarded.
+  // Get the two Hanzi strings
+  for (size_t lma = 0; lma < 2; lma++) {
     token = utf16_strtok(to_tokenize, &token_size, &to_tokenize);
-    assert(NULL != token);
-    int gbk_flag = utf16_atoi(token);
-    if (NULL == valid_hzs || 0 == valid_hzs_num) {
-      if (0 != gbk_flag) {
-        i--;
-        continue;
-      }
-    } else {
-      if (!str_in_hanzis_list(valid_hzs, valid_hzs_num,
-          lemma_arr_[i].hanzi_str, lemma_arr_[i].hz_str_len)) {
-        i--;
-        continue;
-      }
+    if (NULL == token)
+      return;
+
+    bigram_line->lma_pos[lma] = 0;
+    bigram_line->lma_num[lma] = 0;
+    if (token_size <= kMaxLemmaSize) {
+      bigram_line->lma_pos[lma] =
+          find_lemmas_by_hzs(token, bigram_line->lma_num + lma);
     }
+  }
 
-    // Get spelling String
-    bool spelling_not_support = false;
-    for (size_t hz_pos = 0; hz_pos < (size_t)lemma_arr_[i].hz_str_len;
-         hz_pos++) {
-      // Get a Pinyin
-      token = utf16_strtok(to_tokenize, &token_size, &to_tokenize);
-      if (NULL == token) {
-        free_resource();
-        utf16_reader.close();
-        return false;
-      }
+  // Get the freq string
+  token = utf16_strtok(to_tokenize, &token_size, &to_tokenize);
+  if (NULL == token)
+    return;
+  bigram_line->freq = utf16_atof(token);
 
-      assert(utf16_strlen(token) <= kMaxPinyinSize);
+  if (0 == bigram_line->lma_num[0] || 0 == bigram_line->lma_num[1])
+    bigram_line->state = kRawLineSkipped;
+  else
+    bigram_line->state = kRawLineOk;
+}
 
-      utf16_strcpy_tochar(lemma_arr_[i].pinyin_str[hz_pos], token);
+BigramEntry* DictBuilder::read_raw_bigrams(const char *fn_bigram,
+                                           size_t *num) {
+  *num = 0;
+  if (NULL == fn_bigram)
+    return NULL;
 
-      format_spelling_str(lemma_arr_[i].pinyin_str[hz_pos]);
+  Utf16Reader utf16_reader;
+  if (!utf16_reader.open(fn_bigram, kReadBufLen * 10))
+    return NULL;
 
-      // Put the pinyin to the spelling table
-      if (!spl_table_->put_spelling(lemma_arr_[i].pinyin_str[hz_pos],
-                                    lemma_arr_[i].freq)) {
-        spelling_not_support = true;
+  size_t bigram_max = kParseLineNum;
+  BigramEntry *bigram_arr = static_cast<BigramEntry*>(
+      malloc(bigram_max * sizeof(BigramEntry)));
+
+  char16 (*lines)[kReadBufLen] = new char16[kParseLineNum][kReadBufLen];
+  RawBigramLine *bigram_lines = new RawBigramLine[kParseLineNum];
+
+  // As in read_raw_dict(), the lines are parsed a batch at a time on several
+  // threads, and the bigrams are taken in the order of the lines.
+  size_t bigram_num = 0;
+  bool file_end = false;
+  bool broken = false;
+  while (NULL != bigram_arr && !file_end && !broken) {
+    size_t line_num = 0;
+    while (line_num < kParseLineNum &&
+           utf16_reader.readline(lines[line_num], kReadBufLen))
+      line_num++;
+    if (line_num < kParseLineNum)
+      file_end = true;
+
+    myparallel_for(line_num, thread_num_, [&](size_t line) {
+      parse_bigram_line(lines[line], bigram_lines + line);
+    });
+
+    for (size_t line = 0; line < line_num; line++) {
+      RawBigramLine *bigram_line = bigram_lines + line;
+      if (kRawLineBroken == bigram_line->state) {
+        broken = true;
         break;
       }
-    }
+      if (kRawLineSkipped == bigram_line->state)
+        continue;
 
-    // The whole line must have been parsed fully, otherwise discard this one.
-    token = utf16_strtok(to_tokenize, &token_size, &to_tokenize);
-    if (spelling_not_support || NULL != token) {
-      i--;
-      continue;
+      size_t pair_num = bigram_line->lma_num[0] * bigram_line->lma_num[1];
+      if (bigram_num + pair_num > bigram_max) {
+        while (bigram_num + pair_num > bigram_max)
+          bigram_max *= 2;
+        BigramEntry *new_arr = static_cast<BigramEntry*>(
+            realloc(bigram_arr, bigram_max * sizeof(BigramEntry)));
+        if (NULL == new_arr) {
+          free(bigram_arr);
+          bigram_arr = NULL;
+          break;
+        }
+        bigram_arr = new_arr;
+      }
+
+      // The lemmas of the second Hanzis share the frequency.
+      size_t pos2_start = bigram_line->lma_pos[1];
+      size_t pos2_end = pos2_start + bigram_line->lma_num[1];
+      double freq2_total = 0;
+      for (size_t pos2 = pos2_start; pos2 < pos2_end; pos2++)
+        freq2_total += lemma_arr_[pos2].freq;
+
+      for (size_t pos1 = bigram_line->lma_pos[0];
+           pos1 < bigram_line->lma_pos[0] + bigram_line->lma_num[0]; pos1++) {
+        for (size_t pos2 = pos2_start; pos2 < pos2_end; pos2++) {
+          BigramEntry *entry = bigram_arr + bigram_num;
+          entry->id1 = lemma_arr_[pos1].idx_by_hz;
+          entry->id2 = lemma_arr_[pos2].idx_by_hz;
+          if (freq2_total > 0)
+            entry->freq = bigram_line->freq * lemma_arr_[pos2].freq /
+                freq2_total;
+          else
+            entry->freq = bigram_line->freq / bigram_line->lma_num[1];
+          bigram_num++;
+        }
+      }
     }
   }
 
-  delete [] valid_hzs;
+  delete [] bigram_lines;
+  delete [] lines;
   utf16_reader.close();
 
-  printf("read succesfully, lemma num: %d\n", lemma_num);
+  if (broken || NULL == bigram_arr) {
+    free(bigram_arr);
+    return NULL;
+  }
 
-  return lemma_num;
+  printf("bigrams read succesfully, bigram num: %zu\n", bigram_num);
+
+  *num = bigram_num;
+  return bigram_arr;
 }
 
 bool DictBuilder::build_dict(const char *fn_raw,
                              const char *fn_validhzs,
-                             DictTrie *dict_trie) {
+                             const char *fn_bigram,
+                             DictTrie *dict_trie, size_t thread_num) {
   if (NULL == fn_raw || NULL == dict_trie)
     return false;
 
+  thread_num_ = thread_num > 0 ? thread_num : 1;
+
   lemma_num_ = read_raw_dict(fn_raw, fn_validhzs, 240000);
   if (0 == lemma_num_)
     return false;
@@ -536,25 +789,27 @@ bool DictBuilder::build_dict(const char *fn_raw,
   printf("spelling tree construct successfully.\n");
 
   // Convert the spelling string to idxs
-  for (size_t i = 0; i < lemma_num_; i++) {
-    for (size_t hz_pos = 0; hz_pos < (size_t)lemma_arr_[i].hz_str_len;
-         hz_pos++) {
-      uint16 spl_idxs[2];
-      uint16 spl_start_pos[3];
-      bool is_pre = true;
-      int spl_idx_num =
-        spl_parser_->splstr_to_idxs(lemma_arr_[i].pinyin_str[hz_pos],
-                                    strlen(lemma_arr_[i].pinyin_str[hz_pos]),
-                                    spl_idxs, spl_start_pos, 2, is_pre);
-      assert(1 == spl_idx_num);
-
-      if (spl_trie.is_half_id(spl_idxs[0])) {
-        uint16 num = spl_trie.half_to_full(spl_idxs[0], spl_idxs);
-        assert(0 != num);
+  for_lemma_parts(lemma_num_, thread_num_, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      for (size_t hz_pos = 0; hz_pos < (size_t)lemma_arr_[i].hz_str_len;
+           hz_pos++) {
+        uint16 spl_idxs[2];
+        uint16 spl_start_pos[3];
+        bool is_pre = true;
+        int spl_idx_num =
+          spl_parser_->splstr_to_idxs(lemma_arr_[i].pinyin_str[hz_pos],
+                                      strlen(lemma_arr_[i].pinyin_str[hz_pos]),
+                                      spl_idxs, spl_start_pos, 2, is_pre);
+        assert(1 == spl_idx_num);
+
+        if (spl_trie.is_half_id(spl_idxs[0])) {
+          uint16 num = spl_trie.half_to_full(spl_idxs[0], spl_idxs);
+          assert(0 != num);
+        }
+        lemma_arr_[i].spl_idx_arr[hz_pos] = spl_idxs[0];
       }
-      lemma_arr_[i].spl_idx_arr[hz_pos] = spl_idxs[0];
     }
-  }
+  });
 
   // Sort the lemma items according to the hanzi, and give each unique item a
   // id
@@ -571,10 +826,23 @@ bool DictBuilder::build_dict(const char *fn_raw,
   // Construct the NGram information
   NGram& ngram = NGram::get_instance();
   ngram.build_unigram(lemma_arr_, lemma_num_,
-                      lemma_arr_[lemma_num_ - 1].idx_by_hz + 1);
+                      lemma_arr_[lemma_num_ - 1].idx_by_hz + 1, thread_num_);
+
+  // The bigrams are read while the lemmas are still sorted by Hanzis.
+  if (NULL != fn_bigram) {
+    size_t bigram_num;
+    BigramEntry *bigram_arr = read_raw_bigrams(fn_bigram, &bigram_num);
+    bool bi_success = NULL != bigram_arr &&
+        ngram.build_bigram(bigram_arr, bigram_num, thread_num_);
+    free(bigram_arr);
+    if (!bi_success) {
+      free_resource();
+      return false;
+    }
+  }
 
   // sort the lemma items according to the spelling idx string
-  myqsort(lemma_arr_, lemma_num_, sizeof(LemmaEntry), compare_py);
+  myparallel_sort(lemma_arr_, lemma_num_, LemmaLessByPy(), thread_num_);
 
   get_top_lemmas();
 
@@ -584,7 +852,8 @@ bool DictBuilder::build_dict(const char *fn_raw,
 
   lma_nds_used_num_le0_ = 1;  // The root node
   bool dt_success = construct_subset(static_cast<void*>(lma_nodes_le0_),
-                                     lemma_arr_, 0, lemma_num_, 0);
+                                     lemma_arr_, 0, lemma_num_, 0) &&
+                    construct_reserved_subsets();
   if (!dt_success) {
     free_resource();
     return false;
@@ -680,7 +949,7 @@ LemmaIdType DictBuilder::sort_lemmas_by_hz() {
   if (NULL == lemma_arr_ || 0 == lemma_num_)
     return 0;
 
-  myqsort(lemma_arr_, lemma_num_, sizeof(LemmaEntry), cmp_lemma_entry_hzs);
+  myparallel_sort(lemma_arr_, lemma_num_, LemmaLessByHzs(), thread_num_);
 
   lemma_arr_[0].idx_by_hz = 1;
   LemmaIdType idx_max = 1;
@@ -725,7 +994,7 @@ size_t DictBuilder::build_scis() {
     }
   }
 
-  myqsort(scis_, scis_num_, sizeof(SingleCharItem), cmp_scis_hz_splid_freq);
+  myparallel_sort(scis_, scis_num_, ScisLessByHzSplidFreq(), thread_num_);
 
   // Remove repeated items
   size_t unique_scis_num = 1;
@@ -742,27 +1011,29 @@ size_t DictBuilder::build_scis() {
   scis_num_ = unique_scis_num;
 
   // Update the lemma list.
-  for (size_t pos = 0; pos < lemma_num_; pos++) {
-    size_t hz_num = lemma_arr_[pos].hz_str_len;
-    for (size_t hzpos = 0; hzpos < hz_num; hzpos++) {
-      SingleCharItem key;
-      key.hz = lemma_arr_[pos].hanzi_str[hzpos];
-      key.splid.full_splid = lemma_arr_[pos].spl_idx_arr[hzpos];
-      key.splid.half_splid = spl_trie.full_to_half(key.splid.full_splid);
-
-      SingleCharItem *found;
-      found = static_cast<SingleCharItem*>(mybsearch(&key, scis_,
-                                                     unique_scis_num,
-                                                     sizeof(SingleCharItem),
-                                                     cmp_scis_hz_splid));
-
-      assert(found);
-
-      lemma_arr_[pos].hanzi_scis_ids[hzpos] =
-          static_cast<uint16>(found - scis_);
-      lemma_arr_[pos].spl_idx_arr[hzpos] = found->splid.full_splid;
+  for_lemma_parts(lemma_num_, thread_num_, [&](size_t begin, size_t end) {
+    for (size_t pos = begin; pos < end; pos++) {
+      size_t hz_num = lemma_arr_[pos].hz_str_len;
+      for (size_t hzpos = 0; hzpos < hz_num; hzpos++) {
+        SingleCharItem key;
+        key.hz = lemma_arr_[pos].hanzi_str[hzpos];
+        key.splid.full_splid = lemma_arr_[pos].spl_idx_arr[hzpos];
+        key.splid.half_splid = spl_trie.full_to_half(key.splid.full_splid);
+
+        SingleCharItem *found;
+        found = static_cast<SingleCharItem*>(mybsearch(&key, scis_,
+                                                       unique_scis_num,
+                                                       sizeof(SingleCharItem),
+                                                       cmp_scis_hz_splid));
+
+        assert(found);
+
+        lemma_arr_[pos].hanzi_scis_ids[hzpos] =
+            static_cast<uint16>(found - scis_);
+        lemma_arr_[pos].spl_idx_arr[hzpos] = found->splid.full_splid;
+      }
     }
-  }
+  });
 
   return scis_num_;
 }
@@ -906,13 +1177,12 @@ bool DictBuilder::construct_subset(void* parent, LemmaEntry* lemma_arr,
       }
 
       if (i - item_start_next > homo_num) {
-        void *next_parent;
-        if (0 == level)
-          next_parent = static_cast<void*>(node_cur_le0);
-        else
-          next_parent = static_cast<void*>(node_cur_ge1);
-        construct_subset(next_parent, lemma_arr,
-                         item_start_next + homo_num, i, level + 1);
+        if (0 == level) {
+          reserve_subset(node_cur_le0, item_start_next + homo_num, i);
+        } else {
+          construct_subset(static_cast<void*>(node_cur_ge1), lemma_arr,
+                           item_start_next + homo_num, i, level + 1);
+        }
 #ifdef ___DO_STATISTICS___
 
         total_node_hasson_[level] += 1;
@@ -975,13 +1245,12 @@ bool DictBuilder::construct_subset(void* parent, LemmaEntry* lemma_arr,
   }
 
   if (item_end - item_start_next > homo_num) {
-    void *next_parent;
-    if (0 == level)
-      next_parent = static_cast<void*>(node_cur_le0);
-    else
-      next_parent = static_cast<void*>(node_cur_ge1);
-    construct_subset(next_parent, lemma_arr,
-                     item_start_next + homo_num, item_end, level + 1);
+    if (0 == level) {
+      reserve_subset(node_cur_le0, item_start_next + homo_num, item_end);
+    } else {
+      construct_subset(static_cast<void*>(node_cur_ge1), lemma_arr,
+                       item_start_next + homo_num, item_end, level + 1);
+    }
 #ifdef ___DO_STATISTICS___
 
     total_node_hasson_[level] += 1;
@@ -1000,6 +1269,92 @@ bool DictBuilder::construct_subset(void* parent, LemmaEntry* lemma_arr,
   return true;
 }
 
+void DictBuilder::reserve_subset(LmaNodeLE0 *parent, size_t item_start,
+                                 size_t item_end) {
+  assert(subset_task_num_ < kMaxSpellingNum + 1);
+  SubsetTask *task = subset_tasks_ + subset_task_num_;
+  subset_task_num_++;
+
+  task->parent = parent;
+  task->item_start = item_start;
+  task->item_end = item_end;
+  task->nds_used_num_ge1 = lma_nds_used_num_ge1_;
+  task->homo_idx_num = homo_idx_num_eq1_ + homo_idx_num_gt1_;
+
+  // Each lemma in the subtree is a homophony of one of its nodes.
+  lma_nds_used_num_ge1_ += count_ge1_nodes(item_start, item_end);
+  homo_idx_num_gt1_ += item_end - item_start;
+}
+
+size_t DictBuilder::count_ge1_nodes(size_t item_start, size_t item_end) {
+  // A node stands for a spelling id string shared by the lemmas under it.
+  // The lemmas are sorted, so a lemma adds the nodes for its spelling ids
+  // after those it shares with the lemma before it. All of them share the
+  // first one, which is the parent's.
+  size_t node_num = 0;
+  for (size_t pos = item_start; pos < item_end; pos++) {
+    const uint16 *spl_idxs = lemma_arr_[pos].spl_idx_arr;
+    size_t spl_num = utf16_strlen(spl_idxs);
+    size_t shared_num = 1;
+    if (pos > item_start) {
+      const uint16 *spl_idxs_last = lemma_arr_[pos - 1].spl_idx_arr;
+      while (shared_num < spl_num &&
+             spl_idxs[shared_num] == spl_idxs_last[shared_num])
+        shared_num++;
+    }
+    assert(spl_num >= shared_num);
+    node_num += spl_num - shared_num;
+  }
+  return node_num;
+}
+
+bool DictBuilder::construct_reserved_subsets() {
+  DictBuilder *builders = new DictBuilder[subset_task_num_];
+  if (NULL == builders)
+    return false;
+
+  myparallel_for(subset_task_num_, thread_num_, [&](size_t task_pos) {
+    const SubsetTask &task = subset_tasks_[task_pos];
+    DictBuilder &builder = builders[task_pos];
+    builder.lemma_arr_ = lemma_arr_;
+    builder.lma_nodes_ge1_ = lma_nodes_ge1_;
+    builder.homo_idx_buf_ = homo_idx_buf_;
+    builder.lma_nds_used_num_ge1_ = task.nds_used_num_ge1;
+    builder.homo_idx_num_gt1_ = task.homo_idx_num;
+#ifdef ___DO_STATISTICS___
+    builder.stat_init();
+#endif
+    builder.construct_subset(static_cast<void*>(task.parent), lemma_arr_,
+                             task.item_start, task.item_end, 1);
+  });
+
+  // Each subtree must have used exactly what was reserved for it.
+  bool success = true;
+  for (size_t task_pos = 0; task_pos < subset_task_num_; task_pos++) {
+    const SubsetTask &task = subset_tasks_[task_pos];
+    DictBuilder &builder = builders[task_pos];
+    size_t nds_end = lma_nds_used_num_ge1_;
+    if (task_pos + 1 < subset_task_num_)
+      nds_end = subset_tasks_[task_pos + 1].nds_used_num_ge1;
+    if (builder.lma_nds_used_num_ge1_ != nds_end ||
+        builder.homo_idx_num_gt1_ !=
+        task.homo_idx_num + task.item_end - task.item_start)
+      success = false;
+#ifdef ___DO_STATISTICS___
+    stat_merge(builder);
+#endif
+
+    // The buffers belong to this builder.
+    builder.lemma_arr_ = NULL;
+    builder.lma_nodes_ge1_ = NULL;
+    builder.homo_idx_buf_ = NULL;
+  }
+  delete [] builders;
+
+  assert(success);
+  return success;
+}
+
 #ifdef ___DO_STATISTICS___
 void DictBuilder::stat_init() {
   memset(max_sonbuf_len_, 0, sizeof(size_t) * kMaxLemmaSize);
@@ -1016,6 +1371,27 @@ void DictBuilder::stat_init() {
   total_lma_node_num_ = 0;
 }
 
+void DictBuilder::stat_merge(const DictBuilder &other) {
+  for (size_t i = 0; i < kMaxLemmaSize; i++) {
+    if (other.max_sonbuf_len_[i] > max_sonbuf_len_[i])
+      max_sonbuf_len_[i] = other.max_sonbuf_len_[i];
+    if (other.max_homobuf_len_[i] > max_homobuf_len_[i])
+      max_homobuf_len_[i] = other.max_homobuf_len_[i];
+
+    total_son_num_[i] += other.total_son_num_[i];
+    total_node_hasson_[i] += other.total_node_hasson_[i];
+    total_sonbuf_num_[i] += other.total_sonbuf_num_[i];
+    total_sonbuf_allnoson_[i] += other.total_sonbuf_allnoson_[i];
+    total_node_in_sonbuf_allnoson_[i] +=
+        other.total_node_in_sonbuf_allnoson_[i];
+    total_homo_num_[i] += other.total_homo_num_[i];
+  }
+
+  sonbufs_num1_ += other.sonbufs_num1_;
+  sonbufs_numgt1_ += other.sonbufs_numgt1_;
+  total_lma_node_num_ += other.total_lma_node_num_;
+}
+
 void DictBuilder::stat_print() {
   printf("\n------------STAT INFO-------------\n");
   printf("[root is layer -1]\n");
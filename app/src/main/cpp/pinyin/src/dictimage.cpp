@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "dictimage.h"
+
+namespace ime_pinyin {
+
+DictImage::DictImage() {
+  map_base_ = NULL;
+  map_len_ = 0;
+  data_ = NULL;
+  length_ = 0;
+  pos_ = 0;
+  aligned_ = false;
+  version_ = 0;
+  copied_num_ = 0;
+  copied_bytes_ = 0;
+}
+
+DictImage::~DictImage() {
+  close();
+}
+
+bool DictImage::open(int sys_fd, long start_offset, long length) {
+  close();
+
+  if (sys_fd < 0 || start_offset < 0 || length <= 0)
+    return false;
+
+  // mmap() requires a page aligned file offset.
+  long page_size = sysconf(_SC_PAGESIZE);
+  if (page_size <= 0)
+    return false;
+  long map_offset = start_offset - start_offset % page_size;
+  size_t delta = static_cast<size_t>(start_offset - map_offset);
+
+  map_len_ = delta + static_cast<size_t>(length);
+  void *base = mmap(NULL, map_len_, PROT_READ, MAP_PRIVATE, sys_fd,
+                    map_offset);
+  if (MAP_FAILED == base) {
+    map_len_ = 0;
+    return false;
+  }
+  map_base_ = base;
+
+  data_ = static_cast<const unsigned char*>(map_base_) + delta;
+  length_ = static_cast<size_t>(length);
+  pos_ = 0;
+
+  uint32 magic;
+  uint32 version;
+  if (!read(&magic, sizeof(uint32))) {
+    close();
+    return false;
+  }
+  if (kDictImageMagic == magic) {
+    if (!read(&version, sizeof(uint32)) || version < 1 ||
+        version > kDictImageVersion) {
+      close();
+      return false;
+    }
+    aligned_ = true;
+    version_ = version;
+  } else {
+    pos_ = 0;
+    aligned_ = false;
+  }
+
+  return true;
+}
+
+void DictImage::close() {
+  for (size_t pos = 0; pos < copied_num_; pos++)
+    free(copied_arrays_[pos]);
+  copied_num_ = 0;
+  copied_bytes_ = 0;
+
+  if (NULL != map_base_)
+    munmap(map_base_, map_len_);
+  map_base_ = NULL;
+  map_len_ = 0;
+
+  data_ = NULL;
+  length_ = 0;
+  pos_ = 0;
+  aligned_ = false;
+  version_ = 0;
+}
+
+bool DictImage::skip_padding() {
+  if (!aligned_)
+    return true;
+
+  size_t pad = (kDictImageAlign - pos_ % kDictImageAlign) % kDictImageAlign;
+  if (pos_ + pad > length_)
+    return false;
+  pos_ += pad;
+  return true;
+}
+
+bool DictImage::read(void *buf, size_t size) {
+  if (NULL == data_ || NULL == buf || size > length_ - pos_)
+    return false;
+
+  memcpy(buf, data_ + pos_, size);
+  pos_ += size;
+  return true;
+}
+
+const void* DictImage::get_array(size_t elem_size, size_t num, size_t align) {
+  if (NULL == data_ || 0 == elem_size || !skip_padding())
+    return NULL;
+
+  size_t size = elem_size * num;
+  if (num > (length_ - pos_) / elem_size)
+    return NULL;
+
+  const unsigned char *array = data_ + pos_;
+  pos_ += size;
+
+  assert(align > 0);
+  if (0 == reinterpret_cast<uintptr_t>(array) % align)
+    return array;
+
+  // Misaligned, fall back to a private copy. malloc() returns memory suitable
+  // for any basic type.
+  if (copied_num_ >= kMaxCopiedArrays)
+    return NULL;
+
+  void *copy = malloc(size > 0 ? size : 1);
+  if (NULL == copy)
+    return NULL;
+  memcpy(copy, array, size);
+  copied_arrays_[copied_num_] = copy;
+  copied_num_++;
+  copied_bytes_ += size;
+  return copy;
+}
+
+#ifdef ___BUILD_MODEL___
+bool DictImage::write_header(FILE *fp) {
+  if (NULL == fp || 0 != ftell(fp))
+    return false;
+
+  if (fwrite(&kDictImageMagic, sizeof(uint32), 1, fp) != 1)
+    return false;
+
+  if (fwrite(&kDictImageVersion, sizeof(uint32), 1, fp) != 1)
+    return false;
+
+  return true;
+}
+
+bool DictImage::write_padding(FILE *fp) {
+  if (NULL == fp)
+    return false;
+
+  long pos = ftell(fp);
+  if (pos < 0)
+    return false;
+
+  static const unsigned char zeros[kDictImageAlign] = {0};
+  size_t pad = (kDictImageAlign - static_cast<size_t>(pos) % kDictImageAlign)
+               % kDictImageAlign;
+  return fwrite(zeros, 1, pad, fp) == pad;
+}
+#endif  // ___BUILD_MODEL___
+
+}  // namespace ime_pinyin
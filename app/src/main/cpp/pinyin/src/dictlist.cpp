@@ -30,6 +30,7 @@ DictList::DictList() {
   scis_hz_ = NULL;
   scis_splid_ = NULL;
   buf_ = NULL;
+  buf_in_image_ = false;
   spl_trie_ = SpellingTrie::get_cpinstance();
 
   assert(kMaxLemmaSize == 8);
@@ -69,6 +70,14 @@ bool DictList::alloc_resource(size_t buf_size, size_t scis_num) {
 }
 
 void DictList::free_resource() {
+  if (buf_in_image_) {
+    buf_ = NULL;
+    scis_hz_ = NULL;
+    scis_splid_ = NULL;
+    buf_in_image_ = false;
+    return;
+  }
+
   if (NULL != buf_)
     free(buf_);
   buf_ = NULL;
@@ -90,8 +99,7 @@ bool DictList::init_list(const SingleCharItem *scis, size_t scis_num,
 
   initialized_ = false;
 
-  if (NULL != buf_)
-    free(buf_);
+  free_resource();
 
   // calculate the size
   size_t buf_size = calculate_size(lemma_arr, lemma_num);
@@ -263,37 +271,22 @@ size_t DictList::predict(const char16 last_hzs[], uint16 hzs_len,
     }
   }
 
-  size_t new_num = 0;
-  for (size_t i = 0; i < item_num; i++) {
-    // Try to find it in the existing items
-    size_t e_pos;
-    for (e_pos = 1; e_pos <= b4_used; e_pos++) {
-      if (utf16_strncmp((*(npre_items - e_pos)).pre_hzs, npre_items[i].pre_hzs,
-                        kMaxPredictSize) == 0)
-        break;
-    }
-    if (e_pos <= b4_used)
-      continue;
-
-    // If not found, append it to the buffer
-    npre_items[new_num] = npre_items[i];
-    new_num++;
-  }
-
-  return new_num;
+  return remove_used_npre(npre_items, item_num, b4_used);
 }
 
 uint16 DictList::get_lemma_str(LemmaIdType id_lemma, char16 *str_buf,
                                uint16 str_max) {
-  if (!initialized_ || id_lemma >= start_id_[kMaxLemmaSize] || NULL == str_buf
+  if (!initialized_ || id_lemma > start_id_[kMaxLemmaSize] || NULL == str_buf
       || str_max <= 1)
     return 0;
 
-  // Find the range
+  // Find the range. start_id_[kMaxLemmaSize] is the id of the last lemma, not
+  // the one after it, so the ranges are bounded by their lemma numbers.
   for (uint16 i = 0; i < kMaxLemmaSize; i++) {
     if (i + 1 > str_max - 1)
       return 0;
-    if (start_id_[i] <= id_lemma && start_id_[i + 1] > id_lemma) {
+    size_t id_num = (start_pos_[i + 1] - start_pos_[i]) / (i + 1);
+    if (start_id_[i] <= id_lemma && id_lemma - start_id_[i] < id_num) {
       size_t id_span = id_lemma - start_id_[i];
 
       uint16 *buf = buf_ + start_pos_[i] + id_span * (i + 1);
@@ -384,61 +377,67 @@ bool DictList::save_list(FILE *fp) {
       NULL == scis_hz_ || NULL == scis_splid_ || 0 == scis_num_)
     return false;
 
-  if (fwrite(&scis_num_, sizeof(size_t), 1, fp) != 1)
+  uint32 scis_num = static_cast<uint32>(scis_num_);
+  if (fwrite(&scis_num, sizeof(uint32), 1, fp) != 1)
     return false;
 
-  if (fwrite(start_pos_, sizeof(size_t), kMaxLemmaSize + 1, fp) !=
+  if (fwrite(start_pos_, sizeof(uint32), kMaxLemmaSize + 1, fp) !=
       kMaxLemmaSize + 1)
     return false;
 
-  if (fwrite(start_id_, sizeof(size_t), kMaxLemmaSize + 1, fp) !=
+  if (fwrite(start_id_, sizeof(uint32), kMaxLemmaSize + 1, fp) !=
       kMaxLemmaSize + 1)
     return false;
 
-  if (fwrite(scis_hz_, sizeof(char16), scis_num_, fp) != scis_num_)
+  if (!DictImage::write_padding(fp) ||
+      fwrite(scis_hz_, sizeof(char16), scis_num_, fp) != scis_num_)
     return false;
 
-  if (fwrite(scis_splid_, sizeof(SpellingId), scis_num_, fp) != scis_num_)
+  if (!DictImage::write_padding(fp) ||
+      fwrite(scis_splid_, sizeof(SpellingId), scis_num_, fp) != scis_num_)
     return false;
 
-  if (fwrite(buf_, sizeof(char16), start_pos_[kMaxLemmaSize], fp) !=
+  if (!DictImage::write_padding(fp) ||
+      fwrite(buf_, sizeof(char16), start_pos_[kMaxLemmaSize], fp) !=
       start_pos_[kMaxLemmaSize])
     return false;
 
   return true;
 }
 
-bool DictList::load_list(FILE *fp) {
-  if (NULL == fp)
+bool DictList::load_list(DictImage *image) {
+  if (NULL == image)
     return false;
 
   initialized_ = false;
 
-  if (fread(&scis_num_, sizeof(uint32), 1, fp) != 1)
+  uint32 scis_num;
+  if (!image->read(&scis_num, sizeof(uint32)))
     return false;
 
-  if (fread(start_pos_, sizeof(uint32), kMaxLemmaSize + 1, fp) !=
-      kMaxLemmaSize + 1)
+  if (!image->read(start_pos_, sizeof(uint32) * (kMaxLemmaSize + 1)))
     return false;
 
-  if (fread(start_id_, sizeof(uint32), kMaxLemmaSize + 1, fp) !=
-      kMaxLemmaSize + 1)
+  if (!image->read(start_id_, sizeof(uint32) * (kMaxLemmaSize + 1)))
     return false;
 
   free_resource();
 
-  if (!alloc_resource(start_pos_[kMaxLemmaSize], scis_num_))
+  // The arrays are owned by the image, and they are never modified.
+  const void *scis_hz = image->get_array(sizeof(char16), scis_num,
+                                         sizeof(char16));
+  const void *scis_splid = image->get_array(sizeof(SpellingId), scis_num,
+                                            sizeof(uint16));
+  const void *buf = image->get_array(sizeof(char16), start_pos_[kMaxLemmaSize],
+                                     sizeof(char16));
+  if (NULL == scis_hz || NULL == scis_splid || NULL == buf)
     return false;
 
-  if (fread(scis_hz_, sizeof(char16), scis_num_, fp) != scis_num_)
-    return false;
-
-  if (fread(scis_splid_, sizeof(SpellingId), scis_num_, fp) != scis_num_)
-    return false;
-
-  if (fread(buf_, sizeof(char16), start_pos_[kMaxLemmaSize], fp) !=
-      start_pos_[kMaxLemmaSize])
-    return false;
+  scis_num_ = scis_num;
+  scis_hz_ = static_cast<char16*>(const_cast<void*>(scis_hz));
+  scis_splid_ = static_cast<SpellingId*>(const_cast<void*>(scis_splid));
+  buf_ = static_cast<char16*>(const_cast<void*>(buf));
+  buf_in_image_ = true;
 
   initialized_ = true;
   return true;
@@ -15,8 +15,12 @@
  */
 
 #include <assert.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "associndex.h"
 #include "dicttrie.h"
 #include "dictbuilder.h"
 #include "lpicache.h"
@@ -38,6 +42,11 @@ DictTrie::DictTrie() {
   total_lma_num_ = 0;
   top_lmas_num_ = 0;
   dict_list_ = NULL;
+  image_ = NULL;
+  assoc_index_ = NULL;
+  dict_shared_ = false;
+  lpi_cache_ = NULL;
+  fuzzy_sets_ = NULL;
 
   parsing_marks_ = NULL;
   mile_stones_ = NULL;
@@ -49,27 +58,53 @@ DictTrie::~DictTrie() {
 }
 
 void DictTrie::free_resource(bool free_dict_list) {
-  if (NULL != root_)
-    free(root_);
+  // A shared dictionary is released by its owner.
+  if (dict_shared_) {
+    root_ = NULL;
+    nodes_ge1_ = NULL;
+    lma_idx_buf_ = NULL;
+    splid_le0_index_ = NULL;
+    dict_list_ = NULL;
+    image_ = NULL;
+    assoc_index_ = NULL;
+    dict_shared_ = false;
+  }
+
+  // Nodes and lemma ids loaded from an image are owned by the image, which is
+  // released together with the dictionary list.
+  if (NULL == image_) {
+    if (NULL != root_)
+      free(root_);
+
+    if (NULL != nodes_ge1_)
+      free(nodes_ge1_);
+
+    if (NULL != lma_idx_buf_)
+      free(lma_idx_buf_);
+  }
   root_ = NULL;
+  nodes_ge1_ = NULL;
+  lma_idx_buf_ = NULL;
 
   if (NULL != splid_le0_index_)
     free(splid_le0_index_);
   splid_le0_index_ = NULL;
 
-  if (NULL != nodes_ge1_)
-    free(nodes_ge1_);
-  nodes_ge1_ = NULL;
-
-  if (NULL != nodes_ge1_)
-    free(nodes_ge1_);
-  nodes_ge1_ = NULL;
-
   if (free_dict_list) {
     if (NULL != dict_list_) {
       delete dict_list_;
     }
     dict_list_ = NULL;
+
+    if (NULL != assoc_index_)
+      delete assoc_index_;
+    assoc_index_ = NULL;
+
+    if (NULL != image_) {
+      NGram::get_instance().free_resource();
+      delete image_;
+    }
+    image_ = NULL;
   }
 
   if (parsing_marks_)
@@ -101,12 +136,16 @@ inline LemmaIdType DictTrie::get_lemma_id(size_t id_offset) {
 }
 
 #ifdef ___BUILD_MODEL___
-bool DictTrie::build_dict(const char* fn_raw, const char* fn_validhzs) {
+bool DictTrie::build_dict(const char* fn_raw, const char* fn_validhzs,
+                          const char *fn_bigram, size_t thread_num) {
   DictBuilder* dict_builder = new DictBuilder();
 
   free_resource(true);
 
-  return dict_builder->build_dict(fn_raw, fn_validhzs, this);
+  bool success = dict_builder->build_dict(fn_raw, fn_validhzs, fn_bigram,
+                                          this, thread_num);
+  delete dict_builder;
+  return success;
 }
 
 bool DictTrie::save_dict(FILE *fp) {
@@ -125,15 +164,18 @@ bool DictTrie::save_dict(FILE *fp) {
   if (fwrite(&top_lmas_num_, sizeof(uint32), 1, fp) != 1)
     return false;
 
-  if (fwrite(root_, sizeof(LmaNodeLE0), lma_node_num_le0_, fp)
+  if (!DictImage::write_padding(fp) ||
+      fwrite(root_, sizeof(LmaNodeLE0), lma_node_num_le0_, fp)
       != lma_node_num_le0_)
     return false;
 
-  if (fwrite(nodes_ge1_, sizeof(LmaNodeGE1), lma_node_num_ge1_, fp)
+  if (!DictImage::write_padding(fp) ||
+      fwrite(nodes_ge1_, sizeof(LmaNodeGE1), lma_node_num_ge1_, fp)
       != lma_node_num_ge1_)
     return false;
 
-  if (fwrite(lma_idx_buf_, sizeof(unsigned char), lma_idx_buf_len_, fp) !=
+  if (!DictImage::write_padding(fp) ||
+      fwrite(lma_idx_buf_, sizeof(unsigned char), lma_idx_buf_len_, fp) !=
       lma_idx_buf_len_)
     return false;
 
@@ -150,12 +192,19 @@ bool DictTrie::save_dict(const char *filename) {
   SpellingTrie &spl_trie = SpellingTrie::get_instance();
   NGram &ngram = NGram::get_instance();
 
+  // The association index is always rebuilt from the lemma list.
+  AssocIndex assoc_index;
+  if (!assoc_index.build_index(dict_list_))
+    return false;
+
   FILE *fp = fopen(filename, "wb");
   if (NULL == fp)
     return false;
 
-  if (!spl_trie.save_spl_trie(fp) || !dict_list_->save_list(fp) ||
-      !save_dict(fp) || !ngram.save_ngram(fp)) {
+  if (!DictImage::write_header(fp) ||
+      !spl_trie.save_spl_trie(fp) || !dict_list_->save_list(fp) ||
+      !save_dict(fp) || !ngram.save_ngram(fp) ||
+      !assoc_index.save_index(fp) || !ngram.save_bigram(fp)) {
     fclose(fp);
     return false;
   }
@@ -165,29 +214,45 @@ bool DictTrie::save_dict(const char *filename) {
 }
 #endif  // ___BUILD_MODEL___
 
-bool DictTrie::load_dict(FILE *fp) {
-  if (NULL == fp)
+bool DictTrie::load_dict(DictImage *image) {
+  if (NULL == image)
     return false;
-  if (fread(&lma_node_num_le0_, sizeof(uint32), 1, fp) != 1)
+
+  uint32 lma_node_num_le0;
+  uint32 lma_node_num_ge1;
+  uint32 lma_idx_buf_len;
+  uint32 top_lmas_num;
+  if (!image->read(&lma_node_num_le0, sizeof(uint32)))
     return false;
 
-  if (fread(&lma_node_num_ge1_, sizeof(uint32), 1, fp) != 1)
+  if (!image->read(&lma_node_num_ge1, sizeof(uint32)))
     return false;
 
-  if (fread(&lma_idx_buf_len_, sizeof(uint32), 1, fp) != 1)
+  if (!image->read(&lma_idx_buf_len, sizeof(uint32)))
     return false;
 
-  if (fread(&top_lmas_num_, sizeof(uint32), 1, fp) != 1 ||
-     top_lmas_num_ >= lma_idx_buf_len_)
+  if (!image->read(&top_lmas_num, sizeof(uint32)) ||
+     top_lmas_num >= lma_idx_buf_len)
      return false;
 
   free_resource(false);
 
-  root_ = static_cast<LmaNodeLE0*>
-          (malloc(lma_node_num_le0_ * sizeof(LmaNodeLE0)));
-  nodes_ge1_ = static_cast<LmaNodeGE1*>
-               (malloc(lma_node_num_ge1_ * sizeof(LmaNodeGE1)));
-  lma_idx_buf_ = (unsigned char*)malloc(lma_idx_buf_len_);
+  lma_node_num_le0_ = lma_node_num_le0;
+  lma_node_num_ge1_ = lma_node_num_ge1;
+  lma_idx_buf_len_ = lma_idx_buf_len;
+  top_lmas_num_ = top_lmas_num;
+
+  // The nodes and lemma ids are used in place; they are never modified after
+  // loading.
+  root_ = static_cast<LmaNodeLE0*>(const_cast<void*>(
+      image->get_array(sizeof(LmaNodeLE0), lma_node_num_le0_,
+                       sizeof(uint32))));
+  nodes_ge1_ = static_cast<LmaNodeGE1*>(const_cast<void*>(
+      image->get_array(sizeof(LmaNodeGE1), lma_node_num_ge1_,
+                       sizeof(uint16))));
+  lma_idx_buf_ = static_cast<unsigned char*>(const_cast<void*>(
+      image->get_array(sizeof(unsigned char), lma_idx_buf_len_,
+                       sizeof(unsigned char))));
   total_lma_num_ = lma_idx_buf_len_ / kLemmaIdSize;
 
   size_t buf_size = SpellingTrie::get_instance().get_spelling_num() + 1;
@@ -206,18 +271,6 @@ bool DictTrie::load_dict(FILE *fp) {
     return false;
   }
 
-  if (fread(root_, sizeof(LmaNodeLE0), lma_node_num_le0_, fp)
-      != lma_node_num_le0_)
-    return false;
-
-  if (fread(nodes_ge1_, sizeof(LmaNodeGE1), lma_node_num_ge1_, fp)
-      != lma_node_num_ge1_)
-    return false;
-
-  if (fread(lma_idx_buf_, sizeof(unsigned char), lma_idx_buf_len_, fp) !=
-      lma_idx_buf_len_)
-    return false;
-
   // The quick index for the first level sons
   uint16 last_splid = kFullSplIdStart;
   size_t last_pos = 0;
@@ -245,72 +298,114 @@ bool DictTrie::load_dict(const char *filename, LemmaIdType start_id,
   if (NULL == filename || end_id <= start_id)
     return false;
 
-  FILE *fp = fopen(filename, "rb");
-  if (NULL == fp)
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+
+  // The mapping stays valid after the file is closed.
+  bool ret = load_dict_fd(fd, 0, static_cast<long>(st.st_size),
+                          start_id, end_id);
+  close(fd);
+  return ret;
+}
+
+bool DictTrie::load_dict_fd(int sys_fd, long start_offset,
+                            long length, LemmaIdType start_id,
+                            LemmaIdType end_id) {
+  if (start_offset < 0 || length <= 0 || end_id <= start_id)
     return false;
 
   free_resource(true);
 
+  image_ = new DictImage();
   dict_list_ = new DictList();
-  if (NULL == dict_list_) {
-    fclose(fp);
+  if (NULL == image_ || NULL == dict_list_) {
+    free_resource(true);
+    return false;
+  }
+
+  if (!image_->open(sys_fd, start_offset, length)) {
+    free_resource(true);
     return false;
   }
 
   SpellingTrie &spl_trie = SpellingTrie::get_instance();
   NGram &ngram = NGram::get_instance();
 
-  if (!spl_trie.load_spl_trie(fp) || !dict_list_->load_list(fp) ||
-      !load_dict(fp) || !ngram.load_ngram(fp) ||
-      total_lma_num_ > end_id - start_id + 1) {
+  if (!spl_trie.load_spl_trie(image_) || !dict_list_->load_list(image_) ||
+      !load_dict(image_) || !ngram.load_ngram(image_)) {
     free_resource(true);
-    fclose(fp);
     return false;
   }
 
-  fclose(fp);
-  return true;
-}
-
-bool DictTrie::load_dict_fd(int sys_fd, long start_offset,
-                            long length, LemmaIdType start_id,
-                            LemmaIdType end_id) {
-  if (start_offset < 0 || length <= 0 || end_id <= start_id)
-    return false;
+  if (image_->get_version() >= 2) {
+    assoc_index_ = new AssocIndex();
+    if (NULL == assoc_index_ || !assoc_index_->load_index(image_)) {
+      free_resource(true);
+      return false;
+    }
+  }
 
-  FILE *fp = fdopen(sys_fd, "rb");
-  if (NULL == fp)
+  if (image_->get_version() >= 3 && !ngram.load_bigram(image_)) {
+    free_resource(true);
     return false;
+  }
 
-  if (-1 == fseek(fp, start_offset, SEEK_SET)) {
-    fclose(fp);
+  if (image_->get_pos() < static_cast<size_t>(length) ||
+      total_lma_num_ > end_id - start_id + 1) {
+    free_resource(true);
     return false;
   }
 
-  free_resource(true);
+  return true;
+}
 
-  dict_list_ = new DictList();
-  if (NULL == dict_list_) {
-    fclose(fp);
+bool DictTrie::attach_dict(const DictTrie *owner) {
+  if (NULL == owner || owner == this || NULL == owner->root_ ||
+      NULL == owner->dict_list_)
     return false;
-  }
 
-  SpellingTrie &spl_trie = SpellingTrie::get_instance();
-  NGram &ngram = NGram::get_instance();
+  free_resource(true);
 
-  if (!spl_trie.load_spl_trie(fp) || !dict_list_->load_list(fp) ||
-      !load_dict(fp) || !ngram.load_ngram(fp) ||
-      ftell(fp) < start_offset + length ||
-      total_lma_num_ > end_id - start_id + 1) {
+  dict_shared_ = true;
+  dict_list_ = owner->dict_list_;
+  image_ = owner->image_;
+  assoc_index_ = owner->assoc_index_;
+  root_ = owner->root_;
+  nodes_ge1_ = owner->nodes_ge1_;
+  splid_le0_index_ = owner->splid_le0_index_;
+  lma_node_num_le0_ = owner->lma_node_num_le0_;
+  lma_node_num_ge1_ = owner->lma_node_num_ge1_;
+  lma_idx_buf_ = owner->lma_idx_buf_;
+  lma_idx_buf_len_ = owner->lma_idx_buf_len_;
+  total_lma_num_ = owner->total_lma_num_;
+  top_lmas_num_ = owner->top_lmas_num_;
+
+  parsing_marks_ = new ParsingMark[kMaxParsingMark];
+  mile_stones_ = new MileStone[kMaxMileStone];
+  if (NULL == parsing_marks_ || NULL == mile_stones_) {
     free_resource(true);
-    fclose(fp);
     return false;
   }
+  reset_milestones(0, kFirstValidMileStoneHandle);
 
-  fclose(fp);
   return true;
 }
 
+void DictTrie::set_lpi_cache(LpiCache *lpi_cache) {
+  lpi_cache_ = lpi_cache;
+}
+
+void DictTrie::set_fuzzy_sets(const SplIdSet *fuzzy_sets) {
+  fuzzy_sets_ = fuzzy_sets;
+}
+
 size_t DictTrie::fill_lpi_buffer(LmaPsbItem lpi_items[], size_t lpi_max,
                                  LmaNodeLE0 *node) {
   size_t lpi_num = 0;
@@ -393,19 +488,26 @@ MileStoneHandle DictTrie::extend_dict0(MileStoneHandle from_handle,
   uint16 splid = dep->splids[dep->splids_extended];
   uint16 id_start = dep->id_start;
   uint16 id_num = dep->id_num;
+  const SplIdSet *id_set = get_fuzzy_set(splid, id_num);
+  uint16 id_first = NULL == id_set ? id_start : id_set->id_min;
+  uint16 id_last = NULL == id_set ? id_start + id_num - 1 : id_set->id_max;
 
-  LpiCache& lpi_cache = LpiCache::get_instance();
-  bool cached = lpi_cache.is_cached(splid);
+  bool cached = NULL != lpi_cache_ && lpi_cache_->is_cached(splid);
 
   // 2. Begin exgtending
   // 2.1 Get the LmaPsbItem list
   LmaNodeLE0 *node = root_;
-  size_t son_start = splid_le0_index_[id_start - kFullSplIdStart];
-  size_t son_end = splid_le0_index_[id_start + id_num - kFullSplIdStart];
+  size_t son_start = splid_le0_index_[id_first - kFullSplIdStart];
+  size_t son_end = splid_le0_index_[id_last + 1 - kFullSplIdStart];
+  // The position after the last son of the latest parsing mark. With fuzzy
+  // Pinyin, the matched sons may be apart, and each run of them gets its own
+  // parsing mark in the mile stone.
+  size_t mark_end = 0;
   for (size_t son_pos = son_start; son_pos < son_end; son_pos++) {
     assert(1 == node->son_1st_off);
     LmaNodeLE0 *son = root_ + son_pos;
-    assert(son->spl_idx >= id_start && son->spl_idx < id_start + id_num);
+    if (!match_spl_idx(son->spl_idx, id_start, id_num, id_set))
+      continue;
 
     if (!cached && *lpi_num < lpi_max) {
       bool need_lpi = true;
@@ -418,20 +520,27 @@ MileStoneHandle DictTrie::extend_dict0(MileStoneHandle from_handle,
     }
 
     // If necessary, fill in a new mile stone.
-    if (son->spl_idx == id_start) {
-      if (mile_stones_pos_ < kMaxMileStone &&
-          parsing_marks_pos_ < kMaxParsingMark) {
-        parsing_marks_[parsing_marks_pos_].node_offset = son_pos;
-        parsing_marks_[parsing_marks_pos_].node_num = id_num;
+    if (0 != ret_handle && son_pos == mark_end) {
+      parsing_marks_[parsing_marks_pos_ - 1].node_num++;
+      mark_end++;
+    } else if ((0 != ret_handle || mile_stones_pos_ < kMaxMileStone) &&
+               parsing_marks_pos_ < kMaxParsingMark) {
+      parsing_marks_[parsing_marks_pos_].node_offset = son_pos;
+      parsing_marks_[parsing_marks_pos_].node_num = 1;
+      if (0 == ret_handle) {
         mile_stones_[mile_stones_pos_].mark_start = parsing_marks_pos_;
-        mile_stones_[mile_stones_pos_].mark_num = 1;
+        mile_stones_[mile_stones_pos_].mark_num = 0;
         ret_handle = mile_stones_pos_;
-        parsing_marks_pos_++;
         mile_stones_pos_++;
       }
+      mile_stones_[ret_handle].mark_num++;
+      parsing_marks_pos_++;
+      mark_end = son_pos + 1;
+    } else {
+      mark_end = 0;
     }
 
-    if (son->spl_idx >= id_start + id_num -1)
+    if (son->spl_idx >= id_last)
       break;
   }
 
@@ -454,6 +563,9 @@ MileStoneHandle DictTrie::extend_dict1(MileStoneHandle from_handle,
 
   uint16 id_start = dep->id_start;
   uint16 id_num = dep->id_num;
+  const SplIdSet *id_set =
+      get_fuzzy_set(dep->splids[dep->splids_extended], id_num);
+  uint16 id_last = NULL == id_set ? id_start + id_num - 1 : id_set->id_max;
 
   // 2. Begin extending.
   MileStone *mile_stone = mile_stones_ + from_handle;
@@ -468,8 +580,8 @@ MileStoneHandle DictTrie::extend_dict1(MileStoneHandle from_handle,
       for (size_t son_pos = 0; son_pos < (size_t)node->num_of_son; son_pos++) {
         assert(node->son_1st_off <= lma_node_num_ge1_);
         LmaNodeGE1 *son = nodes_ge1_ + node->son_1st_off + son_pos;
-        if (son->spl_idx >= id_start
-            && son->spl_idx < id_start + id_num) {
+        bool matched = match_spl_idx(son->spl_idx, id_start, id_num, id_set);
+        if (matched) {
           if (*lpi_num < lpi_max) {
             size_t homo_buf_off = get_homo_idx_buf_offset(son);
             *lpi_num += fill_lpi_buffer(lpi_items + (*lpi_num),
@@ -483,27 +595,29 @@ MileStoneHandle DictTrie::extend_dict1(MileStoneHandle from_handle,
           }
           found_num++;
         }
-        if (son->spl_idx >= id_start + id_num - 1 || son_pos ==
-            (size_t)node->num_of_son - 1) {
-          if (found_num > 0) {
-            if (mile_stones_pos_ < kMaxMileStone &&
-                parsing_marks_pos_ < kMaxParsingMark) {
-              parsing_marks_[parsing_marks_pos_].node_offset =
-                node->son_1st_off + found_start;
-              parsing_marks_[parsing_marks_pos_].node_num = found_num;
-              if (0 == ret_val)
-                mile_stones_[mile_stones_pos_].mark_start =
-                  parsing_marks_pos_;
-              parsing_marks_pos_++;
-            }
-
+        // With fuzzy Pinyin, the matched sons may be apart, and each run of
+        // them gets its own parsing mark.
+        bool last = son->spl_idx >= id_last ||
+            son_pos == (size_t)node->num_of_son - 1;
+        if (found_num > 0 && (!matched || last)) {
+          if (mile_stones_pos_ < kMaxMileStone &&
+              parsing_marks_pos_ < kMaxParsingMark) {
+            parsing_marks_[parsing_marks_pos_].node_offset =
+              node->son_1st_off + found_start;
+            parsing_marks_[parsing_marks_pos_].node_num = found_num;
+            if (0 == ret_val)
+              mile_stones_[mile_stones_pos_].mark_start =
+                parsing_marks_pos_;
+            parsing_marks_pos_++;
             ret_val++;
           }
+          found_num = 0;
+        }
+        if (last)
           break;
-        }  // for son_pos
-      }  // for ext_pos
-    }  // for h_pos
-  }
+      }  // for son_pos
+    }  // for ext_pos
+  }  // for h_pos
 
   if (ret_val > 0) {
     mile_stones_[mile_stones_pos_].mark_num = ret_val;
@@ -531,6 +645,9 @@ MileStoneHandle DictTrie::extend_dict2(MileStoneHandle from_handle,
 
   uint16 id_start = dep->id_start;
   uint16 id_num = dep->id_num;
+  const SplIdSet *id_set =
+      get_fuzzy_set(dep->splids[dep->splids_extended], id_num);
+  uint16 id_last = NULL == id_set ? id_start + id_num - 1 : id_set->id_max;
 
   // 2. Begin extending.
   MileStone *mile_stone = mile_stones_ + from_handle;
@@ -546,8 +663,8 @@ MileStoneHandle DictTrie::extend_dict2(MileStoneHandle from_handle,
       for (size_t son_pos = 0; son_pos < (size_t)node->num_of_son; son_pos++) {
         assert(node->son_1st_off_l > 0 || node->son_1st_off_h > 0);
         LmaNodeGE1 *son = nodes_ge1_ + get_son_offset(node) + son_pos;
-        if (son->spl_idx >= id_start
-            && son->spl_idx < id_start + id_num) {
+        bool matched = match_spl_idx(son->spl_idx, id_start, id_num, id_set);
+        if (matched) {
           if (*lpi_num < lpi_max) {
             size_t homo_buf_off = get_homo_idx_buf_offset(son);
             *lpi_num += fill_lpi_buffer(lpi_items + (*lpi_num),
@@ -561,24 +678,26 @@ MileStoneHandle DictTrie::extend_dict2(MileStoneHandle from_handle,
           }
           found_num++;
         }
-        if (son->spl_idx >= id_start + id_num - 1 || son_pos ==
-            (size_t)node->num_of_son - 1) {
-          if (found_num > 0) {
-            if (mile_stones_pos_ < kMaxMileStone &&
-                parsing_marks_pos_ < kMaxParsingMark) {
-              parsing_marks_[parsing_marks_pos_].node_offset =
-                get_son_offset(node) + found_start;
-              parsing_marks_[parsing_marks_pos_].node_num = found_num;
-              if (0 == ret_val)
-                mile_stones_[mile_stones_pos_].mark_start =
-                  parsing_marks_pos_;
-              parsing_marks_pos_++;
-            }
-
+        // With fuzzy Pinyin, the matched sons may be apart, and each run of
+        // them gets its own parsing mark.
+        bool last = son->spl_idx >= id_last ||
+            son_pos == (size_t)node->num_of_son - 1;
+        if (found_num > 0 && (!matched || last)) {
+          if (mile_stones_pos_ < kMaxMileStone &&
+              parsing_marks_pos_ < kMaxParsingMark) {
+            parsing_marks_[parsing_marks_pos_].node_offset =
+              get_son_offset(node) + found_start;
+            parsing_marks_[parsing_marks_pos_].node_num = found_num;
+            if (0 == ret_val)
+              mile_stones_[mile_stones_pos_].mark_start =
+                parsing_marks_pos_;
+            parsing_marks_pos_++;
             ret_val++;
           }
-          break;
+          found_num = 0;
         }
+        if (last)
+          break;
       }  // for son_pos
     }  // for ext_pos
   }  // for h_pos
@@ -690,27 +809,28 @@ size_t DictTrie::get_lpis(const uint16* splid_str, uint16 splid_str_len,
       id_num = spl_trie_->half_to_full(splid_str[spl_pos], &id_start);
       assert(id_num > 0);
     }
+    const SplIdSet *id_set = get_fuzzy_set(splid_str[spl_pos], id_num);
+    uint16 id_first = NULL == id_set ? id_start : id_set->id_min;
+    uint16 id_last = NULL == id_set ? id_start + id_num - 1 : id_set->id_max;
 
     // Extend the nodes
     if (0 == spl_pos) {  // From LmaNodeLE0 (root) to LmaNodeLE0 nodes
       for (size_t node_fr_pos = 0; node_fr_pos < node_fr_num; node_fr_pos++) {
         LmaNodeLE0 *node = node_fr_le0[node_fr_pos];
         assert(node == root_ && 1 == node_fr_num);
-        size_t son_start = splid_le0_index_[id_start - kFullSplIdStart];
-        size_t son_end =
-            splid_le0_index_[id_start + id_num - kFullSplIdStart];
+        size_t son_start = splid_le0_index_[id_first - kFullSplIdStart];
+        size_t son_end = splid_le0_index_[id_last + 1 - kFullSplIdStart];
         for (size_t son_pos = son_start; son_pos < son_end; son_pos++) {
           assert(1 == node->son_1st_off);
           LmaNodeLE0 *node_son = root_ + son_pos;
-          assert(node_son->spl_idx >= id_start
-                 && node_son->spl_idx < id_start + id_num);
+          if (!match_spl_idx(node_son->spl_idx, id_start, id_num, id_set))
+            continue;
           if (node_to_num < MAX_EXTENDBUF_LEN) {
             node_to_le0[node_to_num] = node_son;
             node_to_num++;
           }
-          // id_start + id_num - 1 is the last one, which has just been
-          // recorded.
-          if (node_son->spl_idx >= id_start + id_num - 1)
+          // id_last is the last one, which has just been recorded.
+          if (node_son->spl_idx >= id_last)
             break;
         }
       }
@@ -732,16 +852,14 @@ size_t DictTrie::get_lpis(const uint16* splid_str, uint16 splid_str_len,
           assert(node->son_1st_off <= lma_node_num_ge1_);
           LmaNodeGE1 *node_son = nodes_ge1_ + node->son_1st_off
                                   + son_pos;
-          if (node_son->spl_idx >= id_start
-              && node_son->spl_idx < id_start + id_num) {
+          if (match_spl_idx(node_son->spl_idx, id_start, id_num, id_set)) {
             if (node_to_num < MAX_EXTENDBUF_LEN) {
               node_to_ge1[node_to_num] = node_son;
               node_to_num++;
             }
           }
-          // id_start + id_num - 1 is the last one, which has just been
-          // recorded.
-          if (node_son->spl_idx >= id_start + id_num - 1)
+          // id_last is the last one, which has just been recorded.
+          if (node_son->spl_idx >= id_last)
             break;
         }
       }
@@ -763,16 +881,14 @@ size_t DictTrie::get_lpis(const uint16* splid_str, uint16 splid_str_len,
           assert(node->son_1st_off_l > 0 || node->son_1st_off_h > 0);
           LmaNodeGE1 *node_son = nodes_ge1_
                                   + get_son_offset(node) + son_pos;
-          if (node_son->spl_idx >= id_start
-              && node_son->spl_idx < id_start + id_num) {
+          if (match_spl_idx(node_son->spl_idx, id_start, id_num, id_set)) {
             if (node_to_num < MAX_EXTENDBUF_LEN) {
               node_to_ge1[node_to_num] = node_son;
               node_to_num++;
             }
           }
-          // id_start + id_num - 1 is the last one, which has just been
-          // recorded.
-          if (node_son->spl_idx >= id_start + id_num - 1)
+          // id_last is the last one, which has just been recorded.
+          if (node_son->spl_idx >= id_last)
             break;
         }
       }
@@ -862,7 +978,24 @@ uint16 DictTrie::get_lemma_splids(LemmaIdType id_lemma, uint16 *splids,
 
   for (uint16 pos = 0; pos < lma_len; pos++) {
     uint16 cand_splids_this = 0;
-    if (arg_valid && spl_trie_->is_full_id(splids[pos])) {
+    const SplIdSet *id_set = NULL;
+    if (arg_valid) {
+      id_set = get_fuzzy_set(splids[pos], spl_trie_->is_full_id(splids[pos]) ?
+                             1 : spl_trie_->half2full_num(splids[pos]));
+    }
+    if (NULL != id_set) {
+      // The lemma may have been matched through a fuzzy pair, so the given id
+      // only picks out the spellings of the Hanzi in its fuzzy set.
+      uint16 *cands = spl_mtrx + spl_start[pos];
+      uint16 all_num = dict_list_->get_splids_for_hanzi(lma_str[pos], 0,
+          cands, kMaxLemmaSize * 5 - spl_start[pos]);
+      for (uint16 cand = 0; cand < all_num; cand++) {
+        if (id_set->has(cands[cand]))
+          cands[cand_splids_this++] = cands[cand];
+      }
+      if (0 == cand_splids_this)
+        return 0;
+    } else if (arg_valid && spl_trie_->is_full_id(splids[pos])) {
       spl_mtrx[spl_start[pos]] = splids[pos];
       cand_splids_this = 1;
     } else {
@@ -936,6 +1069,10 @@ size_t DictTrie::predict_top_lmas(size_t his_len, NPredictItem *npre_items,
 size_t DictTrie::predict(const char16 *last_hzs, uint16 hzs_len,
                          NPredictItem *npre_items, size_t npre_max,
                          size_t b4_used) {
+  if (NULL != assoc_index_ && hzs_len <= AssocIndex::kMaxHisLen)
+    return assoc_index_->predict(dict_list_, last_hzs, hzs_len, npre_items,
+                                 npre_max, b4_used);
+
   return dict_list_->predict(last_hzs, hzs_len, npre_items, npre_max, b4_used);
 }
 }  // namespace ime_pinyin
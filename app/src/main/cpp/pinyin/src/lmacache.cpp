@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "lmacache.h"
+#include "utf16char.h"
+
+namespace ime_pinyin {
+
+LmaCache::LmaCache() {
+  items_ = new LmaPsbItem[kMaxItems];
+  entries_ = new CacheEntry[kMaxEntries];
+  hashes_ = new uint32[kMaxEntries];
+  assert(NULL != items_);
+  assert(NULL != entries_);
+  assert(NULL != hashes_);
+
+  version_ = 0;
+  hit_num_ = 0;
+  miss_num_ = 0;
+  reset();
+}
+
+LmaCache::~LmaCache() {
+  if (NULL != items_)
+    delete [] items_;
+
+  if (NULL != entries_)
+    delete [] entries_;
+
+  if (NULL != hashes_)
+    delete [] hashes_;
+}
+
+void LmaCache::reset() {
+  for (size_t pos = 0; pos < kMaxEntries; pos++) {
+    entries_[pos].splid_num = 0;
+    hashes_[pos] = 0;
+  }
+  items_pos_ = 0;
+  tick_ = 0;
+}
+
+uint32 LmaCache::get_hash(const uint16 *splid_str, uint16 splid_str_len,
+                          const char16 *excl_str, bool sorted) {
+  uint32 hash = splid_str_len;
+  for (uint16 pos = 0; pos < splid_str_len; pos++)
+    hash = hash * 31 + splid_str[pos];
+  if (NULL != excl_str) {
+    for (const char16 *p = excl_str; static_cast<char16>('\0') != *p; p++)
+      hash = hash * 31 + *p;
+  }
+  hash = hash * 2 + (sorted ? 1 : 0);
+
+  // 0 is used for empty entries.
+  return 0 == hash ? 1 : hash;
+}
+
+LmaCache::CacheEntry* LmaCache::find_entry(const uint16 *splid_str,
+                                           uint16 splid_str_len,
+                                           const char16 *excl_str, bool sorted,
+                                           uint32 hash) {
+  for (size_t pos = 0; pos < kMaxEntries; pos++) {
+    if (hashes_[pos] != hash)
+      continue;
+
+    CacheEntry *entry = entries_ + pos;
+    if (entry->splid_num != splid_str_len || entry->sorted != sorted ||
+        memcmp(entry->splids, splid_str, splid_str_len * sizeof(uint16)) != 0)
+      continue;
+
+    if (NULL == excl_str) {
+      if (static_cast<char16>('\0') != entry->excl_str[0])
+        continue;
+    } else if (utf16_strcmp(entry->excl_str, excl_str) != 0) {
+      continue;
+    }
+    return entry;
+  }
+  return NULL;
+}
+
+void LmaCache::check_version(uint32 version) {
+  if (version != version_) {
+    reset();
+    version_ = version;
+  }
+}
+
+bool LmaCache::get_cache(const uint16 *splid_str, uint16 splid_str_len,
+                         const char16 *excl_str, bool sorted, uint32 version,
+                         LmaPsbItem lpi_items[], size_t lpi_max,
+                         size_t *lpi_num) {
+  assert(NULL != splid_str && NULL != lpi_items && NULL != lpi_num);
+  check_version(version);
+
+  CacheEntry *entry = NULL;
+  if (splid_str_len > 0 && splid_str_len <= kMaxLemmaSize &&
+      (NULL == excl_str || utf16_strlen(excl_str) <= kMaxLemmaSize)) {
+    entry = find_entry(splid_str, splid_str_len, excl_str, sorted,
+                       get_hash(splid_str, splid_str_len, excl_str, sorted));
+  }
+  if (NULL == entry ||
+      (lpi_max != entry->lpi_max && lpi_max < entry->min_lpi_max)) {
+    miss_num_++;
+    return false;
+  }
+
+  memcpy(lpi_items, items_ + entry->item_start,
+         entry->item_num * sizeof(LmaPsbItem));
+  *lpi_num = entry->item_num;
+
+  entry->last_used = ++tick_;
+  hit_num_++;
+  return true;
+}
+
+void LmaCache::put_cache(const uint16 *splid_str, uint16 splid_str_len,
+                         const char16 *excl_str, bool sorted, uint32 version,
+                         const LmaPsbItem lpi_items[], size_t lpi_num,
+                         size_t lpi_max, size_t min_lpi_max) {
+  assert(NULL != splid_str && NULL != lpi_items);
+  check_version(version);
+
+  if (0 == splid_str_len || splid_str_len > kMaxLemmaSize ||
+      lpi_num > kMaxItemsPerEntry)
+    return;
+
+  if (NULL != excl_str && utf16_strlen(excl_str) > kMaxLemmaSize)
+    return;
+
+  uint32 hash = get_hash(splid_str, splid_str_len, excl_str, sorted);
+  CacheEntry *entry = find_entry(splid_str, splid_str_len, excl_str, sorted,
+                                 hash);
+  // The cached list was got with another buffer size, replace it.
+  if (NULL != entry) {
+    entry->splid_num = 0;
+    hashes_[entry - entries_] = 0;
+  }
+
+  // Allocate the items from the ring buffer.
+  if (items_pos_ + lpi_num > kMaxItems)
+    items_pos_ = 0;
+  size_t item_start = items_pos_;
+  size_t item_end = item_start + lpi_num;
+  items_pos_ = item_end;
+
+  // Drop the lists overwritten by the new one, and find the entry to use.
+  entry = NULL;
+  CacheEntry *lru_entry = NULL;
+  for (size_t pos = 0; pos < kMaxEntries; pos++) {
+    CacheEntry *this_entry = entries_ + pos;
+    if (0 != this_entry->splid_num && this_entry->item_num > 0 &&
+        this_entry->item_start < item_end &&
+        item_start < this_entry->item_start + this_entry->item_num) {
+      this_entry->splid_num = 0;
+      hashes_[pos] = 0;
+    }
+
+    if (0 == this_entry->splid_num) {
+      if (NULL == entry)
+        entry = this_entry;
+    } else if (NULL == lru_entry ||
+               this_entry->last_used < lru_entry->last_used) {
+      lru_entry = this_entry;
+    }
+  }
+  if (NULL == entry)
+    entry = lru_entry;
+  assert(NULL != entry);
+
+  memcpy(entry->splids, splid_str, splid_str_len * sizeof(uint16));
+  entry->splid_num = splid_str_len;
+  if (NULL == excl_str)
+    entry->excl_str[0] = static_cast<char16>('\0');
+  else
+    utf16_strcpy(entry->excl_str, excl_str);
+  entry->sorted = sorted;
+  entry->lpi_max = lpi_max;
+  entry->min_lpi_max = min_lpi_max;
+  entry->item_start = item_start;
+  entry->item_num = lpi_num;
+  entry->last_used = ++tick_;
+  hashes_[entry - entries_] = hash;
+  memcpy(items_ + item_start, lpi_items, lpi_num * sizeof(LmaPsbItem));
+}
+
+}  // namespace ime_pinyin
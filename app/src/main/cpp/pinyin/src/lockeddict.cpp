@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include "lockeddict.h"
+
+namespace ime_pinyin {
+
+LockedDict::LockedDict(AtomDictBase *dict) {
+  assert(NULL != dict);
+  dict_ = dict;
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+LockedDict::~LockedDict() {
+  delete dict_;
+  pthread_mutex_destroy(&mutex_);
+}
+
+bool LockedDict::load_dict(const char *file_name, LemmaIdType start_id,
+                           LemmaIdType end_id) {
+  AutoLock lock(&mutex_);
+  return dict_->load_dict(file_name, start_id, end_id);
+}
+
+bool LockedDict::close_dict() {
+  AutoLock lock(&mutex_);
+  return dict_->close_dict();
+}
+
+size_t LockedDict::number_of_lemmas() {
+  AutoLock lock(&mutex_);
+  return dict_->number_of_lemmas();
+}
+
+void LockedDict::reset_milestones(uint16 from_step,
+                                  MileStoneHandle from_handle) {
+  AutoLock lock(&mutex_);
+  dict_->reset_milestones(from_step, from_handle);
+}
+
+MileStoneHandle LockedDict::extend_dict(MileStoneHandle from_handle,
+                                        const DictExtPara *dep,
+                                        LmaPsbItem *lpi_items, size_t lpi_max,
+                                        size_t *lpi_num) {
+  AutoLock lock(&mutex_);
+  return dict_->extend_dict(from_handle, dep, lpi_items, lpi_max, lpi_num);
+}
+
+size_t LockedDict::get_lpis(const uint16 *splid_str, uint16 splid_str_len,
+                            LmaPsbItem *lpi_items, size_t lpi_max) {
+  AutoLock lock(&mutex_);
+  return dict_->get_lpis(splid_str, splid_str_len, lpi_items, lpi_max);
+}
+
+uint16 LockedDict::get_lemma_str(LemmaIdType id_lemma, char16* str_buf,
+                                 uint16 str_max) {
+  AutoLock lock(&mutex_);
+  return dict_->get_lemma_str(id_lemma, str_buf, str_max);
+}
+
+uint16 LockedDict::get_lemma_splids(LemmaIdType id_lemma, uint16 *splids,
+                                    uint16 splids_max, bool arg_valid) {
+  AutoLock lock(&mutex_);
+  return dict_->get_lemma_splids(id_lemma, splids, splids_max, arg_valid);
+}
+
+size_t LockedDict::predict(const char16 last_hzs[], uint16 hzs_len,
+                           NPredictItem *npre_items, size_t npre_max,
+                           size_t b4_used) {
+  AutoLock lock(&mutex_);
+  return dict_->predict(last_hzs, hzs_len, npre_items, npre_max, b4_used);
+}
+
+LemmaIdType LockedDict::put_lemma(char16 lemma_str[], uint16 splids[],
+                                  uint16 lemma_len, uint16 count) {
+  AutoLock lock(&mutex_);
+  return dict_->put_lemma(lemma_str, splids, lemma_len, count);
+}
+
+LemmaIdType LockedDict::update_lemma(LemmaIdType lemma_id, int16 delta_count,
+                                     bool selected) {
+  AutoLock lock(&mutex_);
+  return dict_->update_lemma(lemma_id, delta_count, selected);
+}
+
+LemmaIdType LockedDict::get_lemma_id(char16 lemma_str[], uint16 splids[],
+                                     uint16 lemma_len) {
+  AutoLock lock(&mutex_);
+  return dict_->get_lemma_id(lemma_str, splids, lemma_len);
+}
+
+LmaScoreType LockedDict::get_lemma_score(LemmaIdType lemma_id) {
+  AutoLock lock(&mutex_);
+  return dict_->get_lemma_score(lemma_id);
+}
+
+LmaScoreType LockedDict::get_lemma_score(char16 lemma_str[], uint16 splids[],
+                                         uint16 lemma_len) {
+  AutoLock lock(&mutex_);
+  return dict_->get_lemma_score(lemma_str, splids, lemma_len);
+}
+
+bool LockedDict::remove_lemma(LemmaIdType lemma_id) {
+  AutoLock lock(&mutex_);
+  return dict_->remove_lemma(lemma_id);
+}
+
+size_t LockedDict::get_total_lemma_count() {
+  AutoLock lock(&mutex_);
+  return dict_->get_total_lemma_count();
+}
+
+void LockedDict::set_total_lemma_count_of_others(size_t count) {
+  AutoLock lock(&mutex_);
+  dict_->set_total_lemma_count_of_others(count);
+}
+
+void LockedDict::flush_cache() {
+  AutoLock lock(&mutex_);
+  dict_->flush_cache();
+}
+
+uint32 LockedDict::get_version() {
+  AutoLock lock(&mutex_);
+  return dict_->get_version();
+}
+
+}  // namespace ime_pinyin
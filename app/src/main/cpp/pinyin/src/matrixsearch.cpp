@@ -18,7 +18,7 @@
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
-#include "lpicache.h"
+#include "lockeddict.h"
 #include "matrixsearch.h"
 #include "mystdlib.h"
 #include "ngram.h"
@@ -38,7 +38,13 @@ MatrixSearch::MatrixSearch() {
   mtrx_nd_pool_used_ = 0;
   dmi_pool_used_ = 0;
   xi_an_enabled_ = false;
+  fuzzy_flags_ = 0;
+  t9_enabled_ = false;
   dmi_c_phrase_ = false;
+  abort_check_ = NULL;
+  abort_arg_ = NULL;
+  lpi_total_ = 0;
+  lpi_sorted_ = 0;
 
   assert(kMaxSearchSteps > 0);
   max_sps_len_ = kMaxSearchSteps - 1;
@@ -52,14 +58,19 @@ MatrixSearch::~MatrixSearch() {
 void MatrixSearch::reset_pointers_to_null() {
   dict_trie_ = NULL;
   user_dict_ = NULL;
+  user_dict_shared_ = false;
+  lpi_cache_ = NULL;
+  lma_cache_ = NULL;
+  fuzzy_sets_ = NULL;
   spl_parser_ = NULL;
 
   share_buf_ = NULL;
 
   // The following four buffers are used for decoding, and they are based on
-  // share_buf_, no need to delete them.
-  mtrx_nd_pool_ = NULL;
-  dmi_pool_ = NULL;
+  // share_buf_, no need to delete them. The pools only own the chunks after
+  // the first one, which are freed by free_resource().
+  mtrx_nd_pool_.init(NULL);
+  dmi_pool_.init(NULL);
   matrix_ = NULL;
   dep_ = NULL;
 
@@ -70,13 +81,17 @@ void MatrixSearch::reset_pointers_to_null() {
 bool MatrixSearch::alloc_resource() {
   free_resource();
 
+  // The user dictionary is created by init() or init_fd(), or shared by
+  // init_session().
   dict_trie_ = new DictTrie();
-  user_dict_ = static_cast<AtomDictBase*>(new UserDict());
+  lpi_cache_ = new LpiCache();
+  lma_cache_ = new LmaCache();
   spl_parser_ = new SpellingParser();
 
-  size_t mtrx_nd_size = sizeof(MatrixNode) * kMtrxNdPoolSize;
+  // The first chunks of the pools.
+  size_t mtrx_nd_size = sizeof(MatrixNode) * MtrxNdPool::kChunkSize;
   mtrx_nd_size = align_to_size_t(mtrx_nd_size) / sizeof(size_t);
-  size_t dmi_size = sizeof(DictMatchInfo) * kDmiPoolSize;
+  size_t dmi_size = sizeof(DictMatchInfo) * DmiPool::kChunkSize;
   dmi_size = align_to_size_t(dmi_size) / sizeof(size_t);
   size_t matrix_size = sizeof(MatrixRow) * kMaxRowNum;
   matrix_size = align_to_size_t(matrix_size) / sizeof(size_t);
@@ -86,13 +101,15 @@ bool MatrixSearch::alloc_resource() {
   // share_buf's size is determined by the buffers for search.
   share_buf_ = new size_t[mtrx_nd_size + dmi_size + matrix_size + dep_size];
 
-  if (NULL == dict_trie_ || NULL == user_dict_ || NULL == spl_parser_ ||
-      NULL == share_buf_)
+  if (NULL == dict_trie_ || NULL == lpi_cache_ || NULL == lma_cache_ ||
+      NULL == spl_parser_ || NULL == share_buf_)
     return false;
 
+  dict_trie_->set_lpi_cache(lpi_cache_);
+
   // The buffers for search are based on the src buffer
-  mtrx_nd_pool_ = reinterpret_cast<MatrixNode*>(share_buf_);
-  dmi_pool_ = reinterpret_cast<DictMatchInfo*>(share_buf_ + mtrx_nd_size);
+  mtrx_nd_pool_.init(reinterpret_cast<MatrixNode*>(share_buf_));
+  dmi_pool_.init(reinterpret_cast<DictMatchInfo*>(share_buf_ + mtrx_nd_size));
   matrix_ = reinterpret_cast<MatrixRow*>(share_buf_ + mtrx_nd_size + dmi_size);
   dep_ = reinterpret_cast<DictExtPara*>
       (share_buf_ + mtrx_nd_size + dmi_size + matrix_size);
@@ -108,12 +125,24 @@ void MatrixSearch::free_resource() {
   if (NULL != dict_trie_)
     delete dict_trie_;
 
-  if (NULL != user_dict_)
+  if (NULL != user_dict_ && !user_dict_shared_)
     delete user_dict_;
 
+  if (NULL != lpi_cache_)
+    delete lpi_cache_;
+
+  if (NULL != lma_cache_)
+    delete lma_cache_;
+
+  if (NULL != fuzzy_sets_)
+    delete [] fuzzy_sets_;
+
   if (NULL != spl_parser_)
     delete spl_parser_;
 
+  mtrx_nd_pool_.free_chunks();
+  dmi_pool_.free_chunks();
+
   if (NULL != share_buf_)
     delete [] share_buf_;
 
@@ -130,6 +159,8 @@ bool MatrixSearch::init(const char *fn_sys_dict, const char *fn_usr_dict) {
   if (!dict_trie_->load_dict(fn_sys_dict, 1, kSysDictIdEnd))
     return false;
 
+  user_dict_ = new LockedDict(new UserDict());
+
   // If engine fails to load the user dictionary, reset the user dictionary
   // to NULL.
   if (!user_dict_->load_dict(fn_usr_dict, kUserDictIdStart, kUserDictIdEnd)) {
@@ -139,6 +170,7 @@ bool MatrixSearch::init(const char *fn_sys_dict, const char *fn_usr_dict) {
     user_dict_->set_total_lemma_count_of_others(NGram::kSysDictTotalFreq);
   }
 
+  update_fuzzy_sets();
   reset_search0();
 
   inited_ = true;
@@ -156,6 +188,8 @@ bool MatrixSearch::init_fd(int sys_fd, long start_offset, long length,
   if (!dict_trie_->load_dict_fd(sys_fd, start_offset, length, 1, kSysDictIdEnd))
     return false;
 
+  user_dict_ = new LockedDict(new UserDict());
+
   if (!user_dict_->load_dict(fn_usr_dict, kUserDictIdStart, kUserDictIdEnd)) {
     delete user_dict_;
     user_dict_ = NULL;
@@ -163,12 +197,58 @@ bool MatrixSearch::init_fd(int sys_fd, long start_offset, long length,
     user_dict_->set_total_lemma_count_of_others(NGram::kSysDictTotalFreq);
   }
 
+  update_fuzzy_sets();
+  reset_search0();
+
+  inited_ = true;
+  return true;
+}
+
+bool MatrixSearch::init_session(const MatrixSearch *owner) {
+  if (NULL == owner || owner == this || !owner->inited_)
+    return false;
+
+  if (!alloc_resource())
+    return false;
+
+  if (!dict_trie_->attach_dict(owner->dict_trie_))
+    return false;
+
+  user_dict_ = owner->user_dict_;
+  user_dict_shared_ = true;
+
+  max_sps_len_ = owner->max_sps_len_;
+  max_hzs_len_ = owner->max_hzs_len_;
+  xi_an_enabled_ = owner->xi_an_enabled_;
+  fuzzy_flags_ = owner->fuzzy_flags_;
+  t9_enabled_ = owner->t9_enabled_;
+
+  update_fuzzy_sets();
   reset_search0();
 
   inited_ = true;
   return true;
 }
 
+void MatrixSearch::get_lma_cache_stat(size_t *hit_num, size_t *miss_num) {
+  if (NULL == lma_cache_) {
+    *hit_num = 0;
+    *miss_num = 0;
+    return;
+  }
+  *hit_num = lma_cache_->get_hit_num();
+  *miss_num = lma_cache_->get_miss_num();
+}
+
+void MatrixSearch::get_pool_stat(size_t *mtrx_nd_used,
+                                 size_t *mtrx_nd_capacity,
+                                 size_t *dmi_used, size_t *dmi_capacity) {
+  *mtrx_nd_used = mtrx_nd_pool_used_;
+  *mtrx_nd_capacity = mtrx_nd_pool_.capacity();
+  *dmi_used = dmi_pool_used_;
+  *dmi_capacity = dmi_pool_.capacity();
+}
+
 void MatrixSearch::set_max_lens(size_t max_sps_len, size_t max_hzs_len) {
   if (0 != max_sps_len)
     max_sps_len_ = max_sps_len;
@@ -176,8 +256,15 @@ void MatrixSearch::set_max_lens(size_t max_sps_len, size_t max_hzs_len) {
     max_hzs_len_ = max_hzs_len;
 }
 
+void MatrixSearch::set_abort_check(AbortCheck check, void *arg) {
+  abort_check_ = check;
+  abort_arg_ = arg;
+}
+
 void MatrixSearch::close() {
-  flush_cache();
+  // The owner of a shared user dictionary flushes it.
+  if (!user_dict_shared_)
+    flush_cache();
   free_resource();
   inited_ = false;
 }
@@ -195,6 +282,50 @@ bool MatrixSearch::get_xi_an_switch() {
   return xi_an_enabled_;
 }
 
+void MatrixSearch::set_fuzzy(uint16 fuzzy_flags) {
+  if (fuzzy_flags == fuzzy_flags_)
+    return;
+
+  fuzzy_flags_ = fuzzy_flags;
+  if (inited_) {
+    update_fuzzy_sets();
+    reset_search0();
+  }
+}
+
+uint16 MatrixSearch::get_fuzzy() {
+  return fuzzy_flags_;
+}
+
+void MatrixSearch::set_t9(bool t9_enabled) {
+  if (t9_enabled == t9_enabled_)
+    return;
+
+  t9_enabled_ = t9_enabled;
+  if (inited_)
+    reset_search0();
+}
+
+bool MatrixSearch::get_t9() {
+  return t9_enabled_;
+}
+
+void MatrixSearch::update_fuzzy_sets() {
+  if (0 != fuzzy_flags_) {
+    if (NULL == fuzzy_sets_)
+      fuzzy_sets_ = new SplIdSet[kSplIdNum];
+    spl_trie_->build_fuzzy_sets(fuzzy_flags_, fuzzy_sets_);
+  } else if (NULL != fuzzy_sets_) {
+    delete [] fuzzy_sets_;
+    fuzzy_sets_ = NULL;
+  }
+  dict_trie_->set_fuzzy_sets(fuzzy_sets_);
+
+  // The cached lists were found with the former pairs.
+  lpi_cache_->reset();
+  lma_cache_->reset();
+}
+
 bool MatrixSearch::reset_search() {
   if (!inited_)
     return false;
@@ -215,7 +346,7 @@ bool MatrixSearch::reset_search0() {
     mtrx_nd_pool_used_ += 1;
 
     // Update the node, and make it to be a starting node
-    MatrixNode *node = mtrx_nd_pool_ + matrix_[0].mtrx_nd_pos;
+    MatrixNode *node = mtrx_nd_pool_.at(matrix_[0].mtrx_nd_pos);
     node->id = 0;
     node->score = 0;
     node->from = NULL;
@@ -401,8 +532,8 @@ bool MatrixSearch::reset_search(size_t ch_pos, bool clear_fixed_this_step,
       fixed_hzs_ = c_phrase_.length;
       lma_start_[1] = fixed_hzs_;
       lma_id_[0] = kLemmaIdComposing;
-      matrix_[spl_start_[fixed_hzs_]].mtrx_nd_fixed = mtrx_nd_pool_ +
-          matrix_[spl_start_[fixed_hzs_]].mtrx_nd_pos;
+      matrix_[spl_start_[fixed_hzs_]].mtrx_nd_fixed =
+          mtrx_nd_pool_.at(matrix_[spl_start_[fixed_hzs_]].mtrx_nd_pos);
     }
   }
 
@@ -442,6 +573,12 @@ size_t MatrixSearch::search(const char *py, size_t py_len) {
   pys_[py_len] = '\0';
 
   while ('\0' != pys_[ch_pos]) {
+    if (NULL != abort_check_ && abort_check_(abort_arg_)) {
+      pys_decoded_len_ = ch_pos;
+      get_spl_start_id();
+      lpi_total_ = 0;
+      return ch_pos;
+    }
     if (!add_char(py[ch_pos])) {
       pys_decoded_len_ = ch_pos;
       break;
@@ -449,18 +586,10 @@ size_t MatrixSearch::search(const char *py, size_t py_len) {
     ch_pos++;
   }
 
-  // Get spelling ids and starting positions.
+  // Get spelling ids and starting positions. The whole input is kept; it has
+  // at most kMaxRowNum - 1 letters, so it has at most as many spellings.
   get_spl_start_id();
 
-  // If there are too many spellings, remove the last letter until the spelling
-  // number is acceptable.
-  while (spl_id_num_ > 9) {
-    py_len--;
-    reset_search(py_len, false, false, false);
-    pys_[py_len] = '\0';
-    get_spl_start_id();
-  }
-
   prepare_candidates();
 
   if (kPrintDebug0) {
@@ -572,8 +701,8 @@ size_t MatrixSearch::delsearch(size_t pos, bool is_pos_in_splid,
     fixed_hzs_ = c_phrase_.length;
     lma_start_[1] = fixed_hzs_;
     lma_id_[0] = kLemmaIdComposing;
-    matrix_[spl_start_[fixed_hzs_]].mtrx_nd_fixed = mtrx_nd_pool_ +
-        matrix_[spl_start_[fixed_hzs_]].mtrx_nd_pos;
+    matrix_[spl_start_[fixed_hzs_]].mtrx_nd_fixed =
+        mtrx_nd_pool_.at(matrix_[spl_start_[fixed_hzs_]].mtrx_nd_pos);
   } else {
     // Reseting search only clear pys_decoded_len_, but the string is kept.
     reset_search(reset_pos, clear_fixed_this_step, false, false);
@@ -619,6 +748,8 @@ char16* MatrixSearch::get_candidate(size_t cand_id, char16 *cand_str,
     return get_candidate0(cand_str, max_len, NULL, false);
   }
 
+  sort_candidates(cand_id + 1);
+
   LemmaIdType id = lpi_items_[cand_id].id;
   char16 s[kMaxLemmaSize + 1];
 
@@ -640,6 +771,30 @@ char16* MatrixSearch::get_candidate(size_t cand_id, char16 *cand_str,
   return NULL;
 }
 
+size_t MatrixSearch::get_candidates(size_t start_id, size_t count,
+                                    char16 *buf, size_t buf_len) {
+  size_t cand_num = get_candidate_num();
+  if (NULL == buf || start_id >= cand_num)
+    return 0;
+
+  if (count > cand_num - start_id)
+    count = cand_num - start_id;
+
+  // Sort the whole page at once. Candidate i > 0 is lpi_items_[i - 1].
+  if (start_id + count > 1)
+    sort_candidates(start_id + count - 1);
+
+  size_t pos = 0;
+  size_t num = 0;
+  while (num < count && pos < buf_len) {
+    if (NULL == get_candidate(start_id + num, buf + pos, buf_len - pos))
+      break;
+    pos += utf16_strlen(buf + pos) + 1;
+    num++;
+  }
+  return num;
+}
+
 void MatrixSearch::update_dict_freq() {
   if (NULL != user_dict_) {
     // Update the total frequency of all lemmas, including system lemmas and
@@ -688,7 +843,7 @@ bool MatrixSearch::add_lma_to_userdict(uint16 lma_fr, uint16 lma_to,
 void MatrixSearch::debug_print_dmi(PoolPosType dmi_pos, uint16 nest_level) {
   if (dmi_pos >= dmi_pool_used_) return;
 
-  DictMatchInfo *dmi = dmi_pool_ + dmi_pos;
+  DictMatchInfo *dmi = dmi_pool_.at(dmi_pos);
 
   if (1 == nest_level) {
     printf("-----------------%d\'th DMI node begin----------->\n", dmi_pos);
@@ -777,8 +932,8 @@ size_t MatrixSearch::choose(size_t cand_id) {
 
   if (0 == cand_id) {
     fixed_hzs_ = spl_id_num_;
-    matrix_[spl_start_[fixed_hzs_]].mtrx_nd_fixed = mtrx_nd_pool_ +
-        matrix_[spl_start_[fixed_hzs_]].mtrx_nd_pos;
+    matrix_[spl_start_[fixed_hzs_]].mtrx_nd_fixed =
+        mtrx_nd_pool_.at(matrix_[spl_start_[fixed_hzs_]].mtrx_nd_pos);
     for (size_t pos = fixed_lmas_; pos < lma_id_num_; pos++) {
       fixed_lmas_no1_[pos] = 1;
     }
@@ -812,6 +967,7 @@ size_t MatrixSearch::choose(size_t cand_id) {
 
   // 2. It is not the full sentence candidate.
   // Find the length of the candidate.
+  sort_candidates(cand_id + 1);
   LemmaIdType id_chosen = lpi_items_[cand_id].id;
   LmaScoreType score_chosen = lpi_items_[cand_id].psb;
   size_t cand_len = lpi_items_[cand_id].lma_len;
@@ -853,7 +1009,8 @@ size_t MatrixSearch::choose(size_t cand_id) {
   extend_mtrx_nd(matrix_[step_fr].mtrx_nd_fixed, &lpi_item, 1,
                  step_to_dmi_fr, step_to);
 
-  matrix_[step_to].mtrx_nd_fixed = mtrx_nd_pool_ + matrix_[step_to].mtrx_nd_pos;
+  matrix_[step_to].mtrx_nd_fixed =
+      mtrx_nd_pool_.at(matrix_[step_to].mtrx_nd_pos);
   mtrx_nd_pool_used_ = matrix_[step_to].mtrx_nd_pos +
                        matrix_[step_to].mtrx_nd_num;
 
@@ -897,7 +1054,7 @@ size_t MatrixSearch::cancel_last_choice() {
     step_start = end_node->from->step;
 
     if (step_start > 0) {
-      DictMatchInfo *dmi = dmi_pool_ + end_node->dmi_fr;
+      DictMatchInfo *dmi = dmi_pool_.at(end_node->dmi_fr);
       fixed_hzs_ -= dmi->dict_level;
     } else {
       fixed_hzs_ = 0;
@@ -924,26 +1081,40 @@ size_t MatrixSearch::get_fixedlen() {
 
 bool MatrixSearch::prepare_add_char(char ch) {
   if (pys_decoded_len_ >= kMaxRowNum - 1 ||
-      (!spl_parser_->is_valid_to_parse(ch) && ch != '\''))
+      (!is_valid_to_parse(ch) && ch != '\''))
     return false;
 
-  if (dmi_pool_used_ >= kDmiPoolSize) return false;
+  // A row has at most kMaxNodeARow matrix nodes. They are kept in the same
+  // chunk, because extend_mtrx_nd() sorts them with pointers.
+  size_t mtrx_nd_pos = MtrxNdPool::align(mtrx_nd_pool_used_, kMaxNodeARow);
+  if (!mtrx_nd_pool_.reserve(mtrx_nd_pos + kMaxNodeARow) ||
+      !dmi_pool_.reserve(dmi_pool_used_ + 1))
+    return false;
 
   pys_[pys_decoded_len_] = ch;
   pys_decoded_len_++;
 
   MatrixRow *mtrx_this_row = matrix_ + pys_decoded_len_;
-  mtrx_this_row->mtrx_nd_pos = mtrx_nd_pool_used_;
+  mtrx_this_row->mtrx_nd_pos = mtrx_nd_pos;
   mtrx_this_row->mtrx_nd_num = 0;
   mtrx_this_row->dmi_pos = dmi_pool_used_;
   mtrx_this_row->dmi_num = 0;
   mtrx_this_row->dmi_has_full_id = 0;
+  // The row may hold a stale pointer from an earlier search, or from the
+  // prediction buffer which shares the memory, and no node is fixed yet.
+  mtrx_this_row->mtrx_nd_fixed = NULL;
 
   return true;
 }
 
 bool MatrixSearch::is_split_at(uint16 pos) {
-  return !spl_parser_->is_valid_to_parse(pys_[pos - 1]);
+  return !is_valid_to_parse(pys_[pos - 1]);
+}
+
+bool MatrixSearch::is_valid_to_parse(char ch) {
+  if (t9_enabled_)
+    return spl_parser_->is_valid_to_parse_t9(ch);
+  return spl_parser_->is_valid_to_parse(ch);
 }
 
 void MatrixSearch::fill_dmi(DictMatchInfo *dmi, MileStoneHandle *handles,
@@ -965,10 +1136,10 @@ void MatrixSearch::fill_dmi(DictMatchInfo *dmi, MileStoneHandle *handles,
 bool MatrixSearch::add_char(char ch) {
   if (!prepare_add_char(ch))
     return false;
-  return add_char_qwerty();
+  return add_char_spellings();
 }
 
-bool MatrixSearch::add_char_qwerty() {
+bool MatrixSearch::add_char_spellings() {
   matrix_[pys_decoded_len_].mtrx_nd_num = 0;
 
   bool spl_matched = false;
@@ -1003,124 +1174,146 @@ bool MatrixSearch::add_char_qwerty() {
     if (0 == matrix_[oldrow].mtrx_nd_num && !dmi_c_phrase_)
       continue;
 
-    // 2. Get spelling id(s) for the last ext_len chars.
-    uint16 spl_idx;
+    // 2. Get spelling id(s) for the last ext_len chars. A string of T9
+    // digits can type several spellings, and each of them is extended.
+    uint16 spl_ids[kMaxSplIdsOfStr];
+    uint16 spl_id_num = 0;
     bool is_pre = false;
-    spl_idx = spl_parser_->get_splid_by_str(pys_ + oldrow,
-                                            ext_len, &is_pre);
+    if (t9_enabled_) {
+      spl_id_num = spl_parser_->get_splids_t9(pys_ + oldrow, ext_len, spl_ids,
+                                              kMaxSplIdsOfStr, &is_pre);
+    } else {
+      spl_ids[0] = spl_parser_->get_splid_by_str(pys_ + oldrow,
+                                                 ext_len, &is_pre);
+      if (0 != spl_ids[0])
+        spl_id_num = 1;
+    }
     if (is_pre)
       spl_matched = true;
 
-    if (0 == spl_idx)
+    if (0 == spl_id_num)
       continue;
 
     bool splid_end_split = is_split_at(oldrow + ext_len);
 
-    // 3. Extend the DMI nodes of that old row
-    // + 1 is to extend an extra node from the root
-    for (PoolPosType dmi_pos = matrix_[oldrow].dmi_pos;
-         dmi_pos < matrix_[oldrow].dmi_pos + matrix_[oldrow].dmi_num + 1;
-         dmi_pos++) {
-      DictMatchInfo *dmi = dmi_pool_ + dmi_pos;
-      if (dmi_pos == matrix_[oldrow].dmi_pos + matrix_[oldrow].dmi_num) {
-        dmi = NULL;  // The last one, NULL means extending from the root.
-      } else {
-        // If the dmi is covered by the fixed arrange, ignore it.
-        if (fixed_hzs_ > 0 &&
-            pys_decoded_len_ - ext_len - dmi->splstr_len <
-            spl_start_[fixed_hzs_]) {
-          continue;
-        }
-        // If it is not in mode for composing phrase, and the source DMI node
-        // is marked for composing phrase, ignore this node.
-        if (dmi->c_phrase != 0 && !dmi_c_phrase_) {
-          continue;
+    for (uint16 id_pos = 0; id_pos < spl_id_num; id_pos++) {
+      uint16 spl_idx = spl_ids[id_pos];
+
+      // 3. Extend the DMI nodes of that old row
+      // + 1 is to extend an extra node from the root
+      for (PoolPosType dmi_pos = matrix_[oldrow].dmi_pos;
+           dmi_pos < matrix_[oldrow].dmi_pos + matrix_[oldrow].dmi_num + 1;
+           dmi_pos++) {
+        DictMatchInfo *dmi = NULL;
+        if (dmi_pos == matrix_[oldrow].dmi_pos + matrix_[oldrow].dmi_num) {
+          dmi = NULL;  // The last one, NULL means extending from the root.
+        } else {
+          dmi = dmi_pool_.at(dmi_pos);
+          // If the dmi is covered by the fixed arrange, ignore it.
+          if (fixed_hzs_ > 0 &&
+              pys_decoded_len_ - ext_len - dmi->splstr_len <
+              spl_start_[fixed_hzs_]) {
+            continue;
+          }
+          // If it is not in mode for composing phrase, and the source DMI node
+          // is marked for composing phrase, ignore this node.
+          if (dmi->c_phrase != 0 && !dmi_c_phrase_) {
+            continue;
+          }
+          // T9 digits type many spellings, and each of them extends every
+          // DMI node of the old row. Stop once the row has enough of them.
+          if (t9_enabled_ &&
+              matrix_[pys_decoded_len_].dmi_num >= kMaxDmiARowT9) {
+            continue;
+          }
         }
-      }
 
-      // For example, if "gao" is extended, "g ao" is not allowed.
-      // or "zh" has been passed, "z h" is not allowed.
-      // Both word and word-connection will be prevented.
-      if (longest_ext > ext_len) {
-        if (NULL == dmi && 0 == matrix_[oldrow].dmi_has_full_id) {
-          continue;
-        }
+        // For example, if "gao" is extended, "g ao" is not allowed.
+        // or "zh" has been passed, "z h" is not allowed.
+        // Both word and word-connection will be prevented.
+        if (longest_ext > ext_len) {
+          if (NULL == dmi && 0 == matrix_[oldrow].dmi_has_full_id) {
+            continue;
+          }
 
-        // "z h" is not allowed.
-        if (NULL != dmi && spl_trie_->is_half_id(dmi->spl_id)) {
-          continue;
+          // "z h" is not allowed.
+          if (NULL != dmi && spl_trie_->is_half_id(dmi->spl_id)) {
+            continue;
+          }
         }
-      }
 
-      dep_->splids_extended = 0;
-      if (NULL != dmi) {
-        uint16 prev_ids_num = dmi->dict_level;
-        if ((!dmi_c_phrase_ && prev_ids_num >= kMaxLemmaSize) ||
-            (dmi_c_phrase_ && prev_ids_num >=  kMaxRowNum)) {
-          continue;
-        }
+        dep_->splids_extended = 0;
+        if (NULL != dmi) {
+          uint16 prev_ids_num = dmi->dict_level;
+          if ((!dmi_c_phrase_ && prev_ids_num >= kMaxLemmaSize) ||
+              (dmi_c_phrase_ && prev_ids_num >=  kMaxRowNum)) {
+            continue;
+          }
 
-        DictMatchInfo *d = dmi;
-        while (d) {
-          dep_->splids[--prev_ids_num] = d->spl_id;
-          if ((PoolPosType)-1 == d->dmi_fr)
-            break;
-          d = dmi_pool_ + d->dmi_fr;
+          DictMatchInfo *d = dmi;
+          while (d) {
+            dep_->splids[--prev_ids_num] = d->spl_id;
+            if ((PoolPosType)-1 == d->dmi_fr)
+              break;
+            d = dmi_pool_.at(d->dmi_fr);
+          }
+          assert(0 == prev_ids_num);
+          dep_->splids_extended = dmi->dict_level;
+        }
+        dep_->splids[dep_->splids_extended] = spl_idx;
+        dep_->ext_len = ext_len;
+        dep_->splid_end_split = splid_end_split;
+
+        dep_->id_num = 1;
+        dep_->id_start = spl_idx;
+        if (spl_trie_->is_half_id(spl_idx)) {
+          // Get the full id list
+          dep_->id_num = spl_trie_->half_to_full(spl_idx, &(dep_->id_start));
+          assert(dep_->id_num > 0);
         }
-        assert(0 == prev_ids_num);
-        dep_->splids_extended = dmi->dict_level;
-      }
-      dep_->splids[dep_->splids_extended] = spl_idx;
-      dep_->ext_len = ext_len;
-      dep_->splid_end_split = splid_end_split;
-
-      dep_->id_num = 1;
-      dep_->id_start = spl_idx;
-      if (spl_trie_->is_half_id(spl_idx)) {
-        // Get the full id list
-        dep_->id_num = spl_trie_->half_to_full(spl_idx, &(dep_->id_start));
-        assert(dep_->id_num > 0);
-      }
-
-      uint16 new_dmi_num;
 
-      new_dmi_num = extend_dmi(dep_, dmi);
+        uint16 new_dmi_num;
 
-      if (new_dmi_num > 0) {
-        if (dmi_c_phrase_) {
-          dmi_pool_[dmi_pool_used_].c_phrase = 1;
-        }
-        matrix_[pys_decoded_len_].dmi_num += new_dmi_num;
-        dmi_pool_used_ += new_dmi_num;
+        new_dmi_num = extend_dmi(dep_, dmi, dmi_pos);
 
-        if (!spl_trie_->is_half_id(spl_idx))
-          matrix_[pys_decoded_len_].dmi_has_full_id = 1;
-      }
+        if (new_dmi_num > 0) {
+          if (dmi_c_phrase_) {
+            dmi_pool_[dmi_pool_used_].c_phrase = 1;
+          }
+          matrix_[pys_decoded_len_].dmi_num += new_dmi_num;
+          dmi_pool_used_ += new_dmi_num;
 
-      // If get candiate lemmas, try to extend the path
-      if (lpi_total_ > 0) {
-        uint16 fr_row;
-        if (NULL == dmi) {
-          fr_row = oldrow;
-        } else {
-          assert(oldrow >= dmi->splstr_len);
-          fr_row = oldrow - dmi->splstr_len;
+          if (!spl_trie_->is_half_id(spl_idx))
+            matrix_[pys_decoded_len_].dmi_has_full_id = 1;
         }
-        for (PoolPosType mtrx_nd_pos = matrix_[fr_row].mtrx_nd_pos;
-             mtrx_nd_pos < matrix_[fr_row].mtrx_nd_pos +
-             matrix_[fr_row].mtrx_nd_num;
-             mtrx_nd_pos++) {
-          MatrixNode *mtrx_nd = mtrx_nd_pool_ + mtrx_nd_pos;
-
-          extend_mtrx_nd(mtrx_nd, lpi_items_, lpi_total_,
-                         dmi_pool_used_ - new_dmi_num, pys_decoded_len_);
-          if (longest_ext == 0)
-            longest_ext = ext_len;
+
+        // If get candiate lemmas, try to extend the path
+        if (lpi_total_ > 0) {
+          uint16 fr_row;
+          if (NULL == dmi) {
+            fr_row = oldrow;
+          } else {
+            assert(oldrow >= dmi->splstr_len);
+            fr_row = oldrow - dmi->splstr_len;
+          }
+          for (PoolPosType mtrx_nd_pos = matrix_[fr_row].mtrx_nd_pos;
+               mtrx_nd_pos < matrix_[fr_row].mtrx_nd_pos +
+               matrix_[fr_row].mtrx_nd_num;
+               mtrx_nd_pos++) {
+            MatrixNode *mtrx_nd = mtrx_nd_pool_.at(mtrx_nd_pos);
+
+            extend_mtrx_nd(mtrx_nd, lpi_items_, lpi_total_,
+                           dmi_pool_used_ - new_dmi_num, pys_decoded_len_);
+            if (longest_ext == 0)
+              longest_ext = ext_len;
+          }
         }
-      }
-    }  // for dmi_pos
+      }  // for dmi_pos
+    }  // for id_pos
   }  // for ext_len
-  mtrx_nd_pool_used_ += matrix_[pys_decoded_len_].mtrx_nd_num;
+  // The row may start after a gap at the end of a chunk.
+  mtrx_nd_pool_used_ = matrix_[pys_decoded_len_].mtrx_nd_pos +
+                       matrix_[pys_decoded_len_].mtrx_nd_num;
 
   if (dmi_c_phrase_)
     return true;
@@ -1170,11 +1363,12 @@ void MatrixSearch::prepare_candidates() {
     lma_size--;
   }
 
-  // Sort those partially-matched items by their unified scores.
-  myqsort(lpi_items_ + lpi_num_full_match, lpi_total_ - lpi_num_full_match,
-          sizeof(LmaPsbItem), cmp_lpi_with_unified_psb);
+  // Those partially-matched items are sorted by their unified scores when
+  // they are fetched, as only the first pages are usually shown.
+  lpi_sorted_ = lpi_num_full_match;
 
   if (kPrintDebug0) {
+    sort_candidates(lpi_total_);
     printf("-----Prepare candidates, score:\n");
     for (size_t a = 0; a < lpi_total_; a++) {
       printf("[%03d]%d    ", a, lpi_items_[a].psb);
@@ -1188,6 +1382,20 @@ void MatrixSearch::prepare_candidates() {
   }
 }
 
+void MatrixSearch::sort_candidates(size_t cand_end) {
+  if (cand_end <= lpi_sorted_ || lpi_sorted_ >= lpi_total_)
+    return;
+
+  if (cand_end < lpi_sorted_ + kCandSortStep)
+    cand_end = lpi_sorted_ + kCandSortStep;
+  if (cand_end > lpi_total_)
+    cand_end = lpi_total_;
+
+  mypartial_sort(lpi_items_ + lpi_sorted_, lpi_total_ - lpi_sorted_,
+                 cand_end - lpi_sorted_, LpiLessByUnifiedPsb());
+  lpi_sorted_ = cand_end;
+}
+
 const char* MatrixSearch::get_pystr(size_t *decoded_len) {
   if (!inited_ || NULL == decoded_len)
     return NULL;
@@ -1311,8 +1519,9 @@ void MatrixSearch::get_spl_start_id() {
   lma_id_num_ = fixed_lmas_;
   spl_id_num_ = fixed_hzs_;
 
-  MatrixNode *mtrx_nd = mtrx_nd_pool_ + matrix_[pys_decoded_len_].mtrx_nd_pos;
-  while (mtrx_nd != mtrx_nd_pool_) {
+  MatrixNode *mtrx_nd =
+      mtrx_nd_pool_.at(matrix_[pys_decoded_len_].mtrx_nd_pos);
+  while (mtrx_nd != mtrx_nd_pool_.at(0)) {
     if (fixed_hzs_ > 0) {
       if (mtrx_nd->step <= spl_start_[fixed_hzs_])
         break;
@@ -1397,18 +1606,19 @@ size_t MatrixSearch::get_spl_start(const uint16 *&spl_start) {
   return spl_id_num_;
 }
 
-size_t MatrixSearch::extend_dmi(DictExtPara *dep, DictMatchInfo *dmi_s) {
-  if (dmi_pool_used_ >= kDmiPoolSize) return 0;
+size_t MatrixSearch::extend_dmi(DictExtPara *dep, DictMatchInfo *dmi_s,
+                                PoolPosType dmi_s_pos) {
+  lpi_total_ = 0;
+  if (!dmi_pool_.reserve(dmi_pool_used_ + 1)) return 0;
 
   if (dmi_c_phrase_)
-    return extend_dmi_c(dep, dmi_s);
+    return extend_dmi_c(dep, dmi_s, dmi_s_pos);
 
-  LpiCache& lpi_cache = LpiCache::get_instance();
   uint16 splid = dep->splids[dep->splids_extended];
 
   bool cached = false;
   if (0 == dep->splids_extended)
-    cached = lpi_cache.is_cached(splid);
+    cached = lpi_cache_->is_cached(splid);
 
   // 1. If this is a half Id, get its corresponding full starting Id and
   // number of full Id.
@@ -1437,8 +1647,9 @@ size_t MatrixSearch::extend_dmi(DictExtPara *dep, DictMatchInfo *dmi_s) {
   if (handles[0] > 0)
     lpi_total_ = lpi_num;
 
+  // Even from the root, handles[0] may be 0 if the trie has run out of mile
+  // stones, which can happen when T9 digits give many spellings.
   if (NULL == dmi_s) {  // from root
-    assert(0 != handles[0]);
     mtrx_dmi_fr = dmi_pool_used_;
   }
 
@@ -1460,9 +1671,7 @@ size_t MatrixSearch::extend_dmi(DictExtPara *dep, DictMatchInfo *dmi_s) {
   }
 
   if (0 != handles[0] || 0 != handles[1]) {
-    if (dmi_pool_used_ >= kDmiPoolSize) return 0;
-
-    DictMatchInfo *dmi_add = dmi_pool_ + dmi_pool_used_;
+    DictMatchInfo *dmi_add = dmi_pool_.at(dmi_pool_used_);
     if (NULL == dmi_s) {
       fill_dmi(dmi_add, handles,
                (PoolPosType)-1, splid,
@@ -1470,7 +1679,7 @@ size_t MatrixSearch::extend_dmi(DictExtPara *dep, DictMatchInfo *dmi_s) {
                spl_trie_->is_half_id(splid) ? 0 : 1);
     } else {
       fill_dmi(dmi_add, handles,
-               dmi_s - dmi_pool_, splid, 1,
+               dmi_s_pos, splid, 1,
                dmi_s->dict_level + 1, dep->splid_end_split,
                dmi_s->splstr_len + dep->ext_len,
                spl_trie_->is_half_id(splid) ? 0 : dmi_s->all_full_id);
@@ -1487,18 +1696,22 @@ size_t MatrixSearch::extend_dmi(DictExtPara *dep, DictMatchInfo *dmi_s) {
       printf("--- lpi_total_ = %d\n", lpi_total_);
     }
 
-    myqsort(lpi_items_, lpi_total_, sizeof(LmaPsbItem), cmp_lpi_with_psb);
+    mysort(lpi_items_, lpi_total_, LpiLessByPsb());
     if (NULL == dmi_s && spl_trie_->is_half_id(splid))
-      lpi_total_ = lpi_cache.put_cache(splid, lpi_items_, lpi_total_);
+      lpi_total_ = lpi_cache_->put_cache(splid, lpi_items_, lpi_total_);
+  } else if (0 == ret_val) {
+    // No DMI node is added, so no matrix node can refer to the cached items.
+    lpi_total_ = 0;
   } else {
     assert(spl_trie_->is_half_id(splid));
-    lpi_total_ = lpi_cache.get_cache(splid, lpi_items_, kMaxLmaPsbItems);
+    lpi_total_ = lpi_cache_->get_cache(splid, lpi_items_, kMaxLmaPsbItems);
   }
 
   return ret_val;
 }
 
-size_t MatrixSearch::extend_dmi_c(DictExtPara *dep, DictMatchInfo *dmi_s) {
+size_t MatrixSearch::extend_dmi_c(DictExtPara *dep, DictMatchInfo *dmi_s,
+                                  PoolPosType dmi_s_pos) {
   lpi_total_ = 0;
 
   uint16 pos = dep->splids_extended;
@@ -1508,7 +1721,7 @@ size_t MatrixSearch::extend_dmi_c(DictExtPara *dep, DictMatchInfo *dmi_s) {
 
   uint16 splid = dep->splids[pos];
   if (splid == c_phrase_.spl_ids[pos]) {
-    DictMatchInfo *dmi_add = dmi_pool_ + dmi_pool_used_;
+    DictMatchInfo *dmi_add = dmi_pool_.at(dmi_pool_used_);
     MileStoneHandle handles[2];  // Actually never used.
     if (NULL == dmi_s)
       fill_dmi(dmi_add, handles,
@@ -1517,7 +1730,7 @@ size_t MatrixSearch::extend_dmi_c(DictExtPara *dep, DictMatchInfo *dmi_s) {
                spl_trie_->is_half_id(splid) ? 0 : 1);
     else
       fill_dmi(dmi_add, handles,
-               dmi_s - dmi_pool_, splid, 1,
+               dmi_s_pos, splid, 1,
                dmi_s->dict_level + 1, dep->splid_end_split,
                dmi_s->splstr_len + dep->ext_len,
                spl_trie_->is_half_id(splid) ? 0 : dmi_s->all_full_id);
@@ -1538,9 +1751,8 @@ size_t MatrixSearch::extend_mtrx_nd(MatrixNode *mtrx_nd, LmaPsbItem lpi_items[],
   assert(NULL != mtrx_nd);
   matrix_[res_row].mtrx_nd_fixed = NULL;
 
-  if (mtrx_nd_pool_used_ >= kMtrxNdPoolSize - kMaxNodeARow)
-    return 0;
-
+  // The pool has room for kMaxNodeARow nodes of res_row, which is reserved by
+  // prepare_add_char().
   if (0 == mtrx_nd->step) {
     // Because the list is sorted, if the source step is 0, it is only
     // necessary to pick up the first kMaxNodeARow items.
@@ -1548,11 +1760,25 @@ size_t MatrixSearch::extend_mtrx_nd(MatrixNode *mtrx_nd, LmaPsbItem lpi_items[],
       lpi_num = kMaxNodeARow;
   }
 
-  MatrixNode *mtrx_nd_res_min = mtrx_nd_pool_ + matrix_[res_row].mtrx_nd_pos;
+  // The bigrams which start with the lemma of mtrx_nd, if there are any.
+  NGram &ngram = NGram::get_instance();
+  const uint32 *bigrams = NULL;
+  size_t bigram_num = 0;
+  if (ngram.has_bigram())
+    bigram_num = ngram.get_bigrams(mtrx_nd->id, &bigrams);
+
+  MatrixNode *mtrx_nd_res_min =
+      mtrx_nd_pool_.at(matrix_[res_row].mtrx_nd_pos);
   for (size_t pos = 0; pos < lpi_num; pos++) {
+    // The list is sorted by the unigram scores, so they are used to prune.
     float score = mtrx_nd->score + lpi_items[pos].psb;
     if (pos > 0 && score - PRUMING_SCORE > mtrx_nd_res_min->score)
       break;
+    if (bigram_num > 0) {
+      score = mtrx_nd->score + ngram.get_bi_psb(bigrams, bigram_num,
+                                                lpi_items[pos].id,
+                                                lpi_items[pos].psb);
+    }
 
     // Try to add a new node
     size_t mtrx_nd_num = matrix_[res_row].mtrx_nd_num;
@@ -1565,8 +1791,7 @@ size_t MatrixSearch::extend_mtrx_nd(MatrixNode *mtrx_nd, LmaPsbItem lpi_items[],
       mtrx_nd_res--;
       replace = true;
     }
-    if (replace || (mtrx_nd_num < kMaxNodeARow &&
-        matrix_[res_row].mtrx_nd_pos + mtrx_nd_num < kMtrxNdPoolSize)) {
+    if (replace || mtrx_nd_num < kMaxNodeARow) {
       mtrx_nd_res->id = lpi_items[pos].id;
       mtrx_nd_res->score = score;
       mtrx_nd_res->from = mtrx_nd;
@@ -1586,7 +1811,7 @@ PoolPosType MatrixSearch::match_dmi(size_t step_to, uint16 spl_ids[],
   }
 
   for (PoolPosType dmi_pos = 0; dmi_pos < matrix_[step_to].dmi_num; dmi_pos++) {
-    DictMatchInfo *dmi = dmi_pool_ + matrix_[step_to].dmi_pos + dmi_pos;
+    DictMatchInfo *dmi = dmi_pool_.at(matrix_[step_to].dmi_pos + dmi_pos);
 
     if (dmi->dict_level != spl_id_num)
       continue;
@@ -1598,7 +1823,9 @@ PoolPosType MatrixSearch::match_dmi(size_t step_to, uint16 spl_ids[],
         break;
       }
 
-      dmi = dmi_pool_ + dmi->dmi_fr;
+      // The first spelling id is matched by a node from the root.
+      if (spl_pos + 1 < spl_id_num)
+        dmi = dmi_pool_.at(dmi->dmi_fr);
     }
     if (matched) {
       return matrix_[step_to].dmi_pos + dmi_pos;
@@ -1618,7 +1845,8 @@ char16* MatrixSearch::get_candidate0(char16 *cand_str, size_t max_len,
   LemmaIdType idxs[kMaxRowNum];
   size_t id_num = 0;
 
-  MatrixNode *mtrx_nd = mtrx_nd_pool_ + matrix_[pys_decoded_len_].mtrx_nd_pos;
+  MatrixNode *mtrx_nd =
+      mtrx_nd_pool_.at(matrix_[pys_decoded_len_].mtrx_nd_pos);
 
   if (kPrintDebug0) {
     printf("--- sentence score: %f\n", mtrx_nd->score);
@@ -1684,6 +1912,17 @@ size_t MatrixSearch::get_lpis(const uint16* splid_str, size_t splid_str_len,
   if (splid_str_len > kMaxLemmaSize)
     return 0;
 
+  // Get the version before searching, so that a list got while the user
+  // dictionary is being changed by another session is dropped later.
+  uint32 version = 0;
+  if (NULL != user_dict_)
+    version = user_dict_->get_version();
+
+  size_t num;
+  if (lma_cache_->get_cache(splid_str, splid_str_len, pfullsent, sort_by_psb,
+                            version, lma_buf, max_lma_buf, &num))
+    return num;
+
   size_t num1 = dict_trie_->get_lpis(splid_str, splid_str_len,
                                      lma_buf, max_lma_buf);
   size_t num2 = 0;
@@ -1692,10 +1931,24 @@ size_t MatrixSearch::get_lpis(const uint16* splid_str, size_t splid_str_len,
                          lma_buf + num1, max_lma_buf - num1);
   }
 
-  size_t num = num1 + num2;
+  num = num1 + num2;
+
+  // The smallest buffer which gives a list without truncation. A full buffer
+  // may have been truncated, and more than one id also needs space for the
+  // strings to remove repeated items.
+  size_t min_lma_buf = num + 1;
+  if (splid_str_len > 1) {
+    size_t str_buf = (num * sizeof(LmaPsbStrItem) + sizeof(LmaPsbItem) - 1) /
+        sizeof(LmaPsbItem);
+    if (str_buf > 1)
+      min_lma_buf = num + str_buf;
+  }
 
-  if (0 == num)
+  if (0 == num) {
+    lma_cache_->put_cache(splid_str, splid_str_len, pfullsent, sort_by_psb,
+                          version, lma_buf, 0, max_lma_buf, min_lma_buf);
     return 0;
+  }
 
   // Remove repeated items.
   if (splid_str_len > 1) {
@@ -1711,7 +1964,7 @@ size_t MatrixSearch::get_lpis(const uint16* splid_str, size_t splid_str_len,
       get_lemma_str(lma_buf[pos].id, lpsis[pos].str, kMaxLemmaSize + 1);
     }
 
-    myqsort(lpsis, lpsi_num, sizeof(LmaPsbStrItem), cmp_lpsi_with_str);
+    mysort(lpsis, lpsi_num, LpsiLessByStr());
 
     size_t remain_num = 0;
     for (size_t pos = 0; pos < lpsi_num; pos++) {
@@ -1742,7 +1995,7 @@ size_t MatrixSearch::get_lpis(const uint16* splid_str, size_t splid_str_len,
       lma_buf[pos].hanzi = hanzis[0];
     }
 
-    myqsort(lma_buf, num, sizeof(LmaPsbItem), cmp_lpi_with_hanzi);
+    mysort(lma_buf, num, LpiLessByHanzi());
 
     size_t remain_num = 0;
     for (size_t pos = 0; pos < num; pos++) {
@@ -1772,8 +2025,11 @@ size_t MatrixSearch::get_lpis(const uint16* splid_str, size_t splid_str_len,
   }
 
   if (sort_by_psb) {
-    myqsort(lma_buf, num, sizeof(LmaPsbItem), cmp_lpi_with_psb);
+    mysort(lma_buf, num, LpiLessByPsb());
   }
+
+  lma_cache_->put_cache(splid_str, splid_str_len, pfullsent, sort_by_psb,
+                        version, lma_buf, num, max_lma_buf, min_lma_buf);
   return num;
 }
 
@@ -1813,7 +2069,8 @@ uint16 MatrixSearch::get_lemma_splids(LemmaIdType id_lemma, uint16 *splids,
       if (spl_trie_->is_half_id(splids[splid_num]))
         break;
     }
-    if (splid_num == splids_max)
+    // With fuzzy Pinyin, the given full ids may differ from the lemma's own.
+    if (splid_num == splids_max && NULL == fuzzy_sets_)
       return splid_num;
   }
 
@@ -1892,19 +2149,22 @@ size_t MatrixSearch::inner_predict(const char16 *fixed_buf, uint16 fixed_len,
     }
 
     if (kPredictLimitGt1) {
-      myqsort(npre_items_ + res_total, res_this, sizeof(NPredictItem),
-              cmp_npre_by_score);
-
+      size_t res_limit = res_this;
       if (len > 3) {
-        if (res_this > kMaxPredictNumByGt3)
-          res_this = kMaxPredictNumByGt3;
+        if (res_limit > kMaxPredictNumByGt3)
+          res_limit = kMaxPredictNumByGt3;
       } else if (3 == len) {
-        if (res_this > kMaxPredictNumBy3)
-          res_this = kMaxPredictNumBy3;
+        if (res_limit > kMaxPredictNumBy3)
+          res_limit = kMaxPredictNumBy3;
       } else if (2 == len) {
-        if (res_this > kMaxPredictNumBy2)
-          res_this = kMaxPredictNumBy2;
+        if (res_limit > kMaxPredictNumBy2)
+          res_limit = kMaxPredictNumBy2;
       }
+
+      // Only the best res_limit items are kept.
+      mypartial_sort(npre_items_ + res_total, res_this, res_limit,
+                     NpreLessByScore());
+      res_this = res_limit;
     }
 
     res_total += res_this;
@@ -1912,17 +2172,19 @@ size_t MatrixSearch::inner_predict(const char16 *fixed_buf, uint16 fixed_len,
 
   res_total = remove_duplicate_npre(npre_items_, res_total);
 
-  if (kPreferLongHistoryPredict) {
-    myqsort(npre_items_, res_total, sizeof(NPredictItem),
-            cmp_npre_by_hislen_score);
-  } else {
-    myqsort(npre_items_, res_total, sizeof(NPredictItem),
-            cmp_npre_by_score);
+  // Only the first buf_len items are returned.
+  size_t res_limit = res_total;
+  if (buf_len < res_limit) {
+    res_limit = buf_len;
   }
 
-  if (buf_len < res_total) {
-    res_total = buf_len;
+  if (kPreferLongHistoryPredict) {
+    mypartial_sort(npre_items_, res_total, res_limit,
+                   NpreLessByHislenScore());
+  } else {
+    mypartial_sort(npre_items_, res_total, res_limit, NpreLessByScore());
   }
+  res_total = res_limit;
 
   if (kPrintDebug2) {
     printf("/////////////////Predicted Items Begin////////////////////>>\n");
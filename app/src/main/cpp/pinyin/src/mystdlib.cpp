@@ -14,7 +14,10 @@
  * limitations under the License.
  */
 
+#include <pthread.h>
 #include <stdlib.h>
+#include <atomic>
+#include "mystdlib.h"
 
 namespace ime_pinyin {
 
@@ -31,4 +34,47 @@ void *mybsearch(const void *k, const void *b,
                 int (*cmp)(const void *, const void *)) {
   return bsearch(k, b, n, es, cmp);
 }
+
+struct ParallelJob {
+  void (*func)(void *arg, size_t part);
+  void *arg;
+  size_t part_num;
+  std::atomic<size_t> next_part;
+};
+
+static void* run_parts(void *arg) {
+  ParallelJob *job = static_cast<ParallelJob*>(arg);
+  size_t part;
+  while ((part = job->next_part.fetch_add(1)) < job->part_num)
+    job->func(job->arg, part);
+  return NULL;
+}
+
+void myparallel_run(size_t part_num, size_t thread_num,
+                    void (*func)(void *arg, size_t part), void *arg) {
+  ParallelJob job;
+  job.func = func;
+  job.arg = arg;
+  job.part_num = part_num;
+  job.next_part.store(0);
+
+  if (thread_num > part_num)
+    thread_num = part_num;
+
+  // If a thread cannot be started, the others take its parts.
+  size_t started = 0;
+  pthread_t *threads = NULL;
+  if (thread_num > 1) {
+    threads = new pthread_t[thread_num - 1];
+    while (started < thread_num - 1 &&
+           0 == pthread_create(threads + started, NULL, run_parts, &job))
+      started++;
+  }
+
+  run_parts(&job);
+
+  for (size_t pos = 0; pos < started; pos++)
+    pthread_join(threads[pos], NULL);
+  delete [] threads;
+}
 }  // namespace ime_pinyin
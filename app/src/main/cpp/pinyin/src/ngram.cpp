@@ -58,21 +58,40 @@ int qsearch_nearest(double code_book[], double freq, int start, int end) {
     return qsearch_nearest(code_book, freq, mid, end);
 }
 
+// The items are split into this many parts to find their codes on several
+// threads. The number of parts does not change the result.
+static const size_t kCodePartNum = 64;
+
+// Find the nearest code of each item, and its distance to the code.
 size_t update_code_idx(double freqs[], size_t num, double code_book[],
-                       CODEBOOK_TYPE *code_idx) {
-  size_t changed = 0;
-  for (size_t pos = 0; pos < num; pos++) {
-    CODEBOOK_TYPE idx;
-    idx = qsearch_nearest(code_book, freqs[pos], 0, kCodeBookSize - 1);
-    if (idx != code_idx[pos])
-      changed++;
-    code_idx[pos] = idx;
-  }
-  return changed;
+                       CODEBOOK_TYPE *code_idx, double dists[],
+                       size_t thread_num) {
+  size_t changed[kCodePartNum];
+  size_t part_len = (num + kCodePartNum - 1) / kCodePartNum;
+  myparallel_for(kCodePartNum, thread_num, [&](size_t part) {
+    size_t begin = std::min(num, part * part_len);
+    size_t end = std::min(num, begin + part_len);
+    changed[part] = 0;
+    for (size_t pos = begin; pos < end; pos++) {
+      CODEBOOK_TYPE idx;
+      idx = qsearch_nearest(code_book, freqs[pos], 0, kCodeBookSize - 1);
+      if (idx != code_idx[pos])
+        changed[part]++;
+      code_idx[pos] = idx;
+      dists[pos] = distance(freqs[pos], code_book[idx]);
+    }
+  });
+
+  size_t changed_num = 0;
+  for (size_t part = 0; part < kCodePartNum; part++)
+    changed_num += changed[part];
+  return changed_num;
 }
 
+// The sums are taken in the item order, so that they are the same for any
+// number of threads.
 double recalculate_kernel(double freqs[], size_t num, double code_book[],
-                          CODEBOOK_TYPE *code_idx) {
+                          CODEBOOK_TYPE *code_idx, double dists[]) {
   double ret = 0;
 
   size_t *item_num =  new size_t[kCodeBookSize];
@@ -84,7 +103,7 @@ double recalculate_kernel(double freqs[], size_t num, double code_book[],
   memset(cb_new, 0, sizeof(double) * kCodeBookSize);
 
   for (size_t pos = 0; pos < num; pos++) {
-    ret += distance(freqs[pos], code_book[code_idx[pos]]);
+    ret += dists[pos];
 
     cb_new[code_idx[pos]] += freqs[pos];
     item_num[code_idx[pos]] += 1;
@@ -102,13 +121,17 @@ double recalculate_kernel(double freqs[], size_t num, double code_book[],
 }
 
 void iterate_codes(double freqs[], size_t num, double code_book[],
-                   CODEBOOK_TYPE *code_idx) {
+                   CODEBOOK_TYPE *code_idx, size_t thread_num) {
+  double *dists = new double[num];
+  assert(dists);
+
   size_t iter_num = 0;
   double delta_last = 0;
   do {
-    size_t changed = update_code_idx(freqs, num, code_book, code_idx);
+    size_t changed = update_code_idx(freqs, num, code_book, code_idx, dists,
+                                     thread_num);
 
-    double delta = recalculate_kernel(freqs, num, code_book, code_idx);
+    double delta = recalculate_kernel(freqs, num, code_book, code_idx, dists);
 
     if (kPrintDebug0) {
       printf("---Unigram codebook iteration: %d : %d, %.9f\n",
@@ -121,6 +144,8 @@ void iterate_codes(double freqs[], size_t num, double code_book[],
       break;
     delta_last = delta;
   } while (true);
+
+  delete [] dists;
 }
 
 
@@ -130,7 +155,14 @@ NGram::NGram() {
   initialized_ = false;
   idx_num_ = 0;
   lma_freq_idx_ = NULL;
-  sys_score_compensation_ = 0;
+  codes_in_image_ = false;
+  bi_codes_ = NULL;
+  bi_starts_ = NULL;
+  bi_items_ = NULL;
+  bi_num_ = 0;
+  bigrams_in_image_ = false;
+  total_freq_none_sys_.store(0, std::memory_order_relaxed);
+  sys_score_compensation_.store(0, std::memory_order_relaxed);
 
 #ifdef ___BUILD_MODEL___
   freq_codes_df_ = NULL;
@@ -139,16 +171,51 @@ NGram::NGram() {
 }
 
 NGram::~NGram() {
-  if (NULL != lma_freq_idx_)
-    free(lma_freq_idx_);
+  free_resource();
 
 #ifdef ___BUILD_MODEL___
   if (NULL != freq_codes_df_)
     free(freq_codes_df_);
 #endif
+}
+
+void NGram::free_bigrams() {
+  if (!bigrams_in_image_) {
+    if (NULL != bi_codes_)
+      free(bi_codes_);
+
+    if (NULL != bi_starts_)
+      free(bi_starts_);
+
+    if (NULL != bi_items_)
+      free(bi_items_);
+  }
+  bi_codes_ = NULL;
+  bi_starts_ = NULL;
+  bi_items_ = NULL;
+  bi_num_ = 0;
+  bigrams_in_image_ = false;
+}
+
+void NGram::free_resource() {
+  initialized_ = false;
+
+  free_bigrams();
+
+  if (codes_in_image_) {
+    lma_freq_idx_ = NULL;
+    freq_codes_ = NULL;
+    codes_in_image_ = false;
+    return;
+  }
+
+  if (NULL != lma_freq_idx_)
+    free(lma_freq_idx_);
+  lma_freq_idx_ = NULL;
 
   if (NULL != freq_codes_)
     free(freq_codes_);
+  freq_codes_ = NULL;
 }
 
 NGram& NGram::get_instance() {
@@ -167,68 +234,127 @@ bool NGram::save_ngram(FILE *fp) {
   if (fwrite(&idx_num_, sizeof(uint32), 1, fp) != 1)
     return false;
 
-  if (fwrite(freq_codes_, sizeof(LmaScoreType), kCodeBookSize, fp) !=
+  if (!DictImage::write_padding(fp) ||
+      fwrite(freq_codes_, sizeof(LmaScoreType), kCodeBookSize, fp) !=
       kCodeBookSize)
     return false;
 
-  if (fwrite(lma_freq_idx_, sizeof(CODEBOOK_TYPE), idx_num_, fp) != idx_num_)
+  if (!DictImage::write_padding(fp) ||
+      fwrite(lma_freq_idx_, sizeof(CODEBOOK_TYPE), idx_num_, fp) != idx_num_)
     return false;
 
   return true;
 }
 
-bool NGram::load_ngram(FILE *fp) {
-  if (NULL == fp)
+bool NGram::load_ngram(DictImage *image) {
+  if (NULL == image)
     return false;
 
-  initialized_ = false;
+  free_resource();
 
-  if (fread(&idx_num_, sizeof(uint32), 1, fp) != 1 )
+  uint32 idx_num;
+  if (!image->read(&idx_num, sizeof(uint32)))
     return false;
 
-  if (NULL != lma_freq_idx_)
-    free(lma_freq_idx_);
+  // Both tables are owned by the image.
+  const void *freq_codes = image->get_array(sizeof(LmaScoreType),
+                                            kCodeBookSize,
+                                            sizeof(LmaScoreType));
+  const void *lma_freq_idx = image->get_array(sizeof(CODEBOOK_TYPE), idx_num,
+                                              sizeof(CODEBOOK_TYPE));
+  if (NULL == freq_codes || NULL == lma_freq_idx)
+    return false;
 
-  if (NULL != freq_codes_)
-    free(freq_codes_);
+  idx_num_ = idx_num;
+  freq_codes_ = static_cast<LmaScoreType*>(const_cast<void*>(freq_codes));
+  lma_freq_idx_ =
+      static_cast<CODEBOOK_TYPE*>(const_cast<void*>(lma_freq_idx));
+  codes_in_image_ = true;
 
-  lma_freq_idx_ = static_cast<CODEBOOK_TYPE*>
-                  (malloc(idx_num_ * sizeof(CODEBOOK_TYPE)));
-  freq_codes_ = static_cast<LmaScoreType*>
-      (malloc(kCodeBookSize * sizeof(LmaScoreType)));
+  initialized_ = true;
+
+  total_freq_none_sys_.store(0, std::memory_order_relaxed);
+  return true;
+}
+
+bool NGram::save_bigram(FILE *fp) {
+  if (!initialized_ || NULL == fp)
+    return false;
 
-  if (NULL == lma_freq_idx_ || NULL == freq_codes_)
+  uint32 bi_num = bi_num_;
+  if (fwrite(&bi_num, sizeof(uint32), 1, fp) != 1)
     return false;
 
-  if (fread(freq_codes_, sizeof(LmaScoreType), kCodeBookSize, fp) !=
+  if (0 == bi_num_)
+    return true;
+
+  if (!DictImage::write_padding(fp) ||
+      fwrite(bi_codes_, sizeof(LmaScoreType), kCodeBookSize, fp) !=
       kCodeBookSize)
     return false;
 
-  if (fread(lma_freq_idx_, sizeof(CODEBOOK_TYPE), idx_num_, fp) != idx_num_)
+  if (!DictImage::write_padding(fp) ||
+      fwrite(bi_starts_, sizeof(uint32), idx_num_ + 1, fp) != idx_num_ + 1)
     return false;
 
-  initialized_ = true;
+  if (!DictImage::write_padding(fp) ||
+      fwrite(bi_items_, sizeof(uint32), bi_num_, fp) != bi_num_)
+    return false;
+
+  return true;
+}
+
+bool NGram::load_bigram(DictImage *image) {
+  if (NULL == image || !initialized_)
+    return false;
+
+  free_bigrams();
+
+  uint32 bi_num;
+  if (!image->read(&bi_num, sizeof(uint32)))
+    return false;
 
-  total_freq_none_sys_ = 0;
+  if (0 == bi_num)
+    return true;
+
+  // All tables are owned by the image.
+  const void *bi_codes = image->get_array(sizeof(LmaScoreType), kCodeBookSize,
+                                          sizeof(LmaScoreType));
+  const void *bi_starts = image->get_array(sizeof(uint32), idx_num_ + 1,
+                                           sizeof(uint32));
+  const void *bi_items = image->get_array(sizeof(uint32), bi_num,
+                                          sizeof(uint32));
+  if (NULL == bi_codes || NULL == bi_starts || NULL == bi_items)
+    return false;
+
+  // The bigrams of the last lemma must end at the end of the items.
+  if (static_cast<const uint32*>(bi_starts)[idx_num_] != bi_num)
+    return false;
+
+  bi_codes_ = static_cast<LmaScoreType*>(const_cast<void*>(bi_codes));
+  bi_starts_ = static_cast<uint32*>(const_cast<void*>(bi_starts));
+  bi_items_ = static_cast<uint32*>(const_cast<void*>(bi_items));
+  bi_num_ = bi_num;
+  bigrams_in_image_ = true;
   return true;
 }
 
 void NGram::set_total_freq_none_sys(size_t freq_none_sys) {
-  total_freq_none_sys_ = freq_none_sys;
-  if (0 == total_freq_none_sys_) {
-    sys_score_compensation_ = 0;
+  total_freq_none_sys_.store(freq_none_sys, std::memory_order_relaxed);
+  if (0 == freq_none_sys) {
+    sys_score_compensation_.store(0, std::memory_order_relaxed);
   } else {
     double factor = static_cast<double>(kSysDictTotalFreq) / (
-        kSysDictTotalFreq + total_freq_none_sys_);
-    sys_score_compensation_ = static_cast<float>(
-        log(factor) * kLogValueAmplifier);
+        kSysDictTotalFreq + freq_none_sys);
+    sys_score_compensation_.store(static_cast<float>(
+        log(factor) * kLogValueAmplifier), std::memory_order_relaxed);
   }
 }
 
 // The caller makes sure this oject is initialized.
 float NGram::get_uni_psb(LemmaIdType lma_id) {
   return  static_cast<float>(freq_codes_[lma_freq_idx_[lma_id]]) +
-      sys_score_compensation_;
+      sys_score_compensation_.load(std::memory_order_relaxed);
 }
 
 float NGram::convert_psb_to_score(double psb) {
@@ -242,10 +368,13 @@ float NGram::convert_psb_to_score(double psb) {
 
 #ifdef ___BUILD_MODEL___
 bool NGram::build_unigram(LemmaEntry *lemma_arr, size_t lemma_num,
-                          LemmaIdType next_idx_unused) {
+                          LemmaIdType next_idx_unused, size_t thread_num) {
   if (NULL == lemma_arr || 0 == lemma_num || next_idx_unused <= 1)
     return false;
 
+  // The bigrams of the lemma ids before are no longer valid.
+  free_bigrams();
+
   double total_freq = 0;
   double *freqs = new double[next_idx_unused];
   if (NULL == freqs)
@@ -316,7 +445,7 @@ bool NGram::build_unigram(LemmaEntry *lemma_arr, size_t lemma_num,
     lma_freq_idx_ = new CODEBOOK_TYPE[idx_num_];
   assert(lma_freq_idx_);
 
-  iterate_codes(freqs, idx_num_, freq_codes_df_, lma_freq_idx_);
+  iterate_codes(freqs, idx_num_, freq_codes_df_, lma_freq_idx_, thread_num);
 
   delete [] freqs;
 
@@ -337,6 +466,168 @@ bool NGram::build_unigram(LemmaEntry *lemma_arr, size_t lemma_num,
   initialized_ = true;
   return true;
 }
+
+// The probabilities of the lemmas after a lemma are estimated as if it was
+// seen this many more times, followed by lemmas in the unigram distribution,
+// so a pair seen only a few times does not get a high probability.
+static const double kBigramPriorFreq = 10;
+
+int cmp_bigram_by_ids(const void *p1, const void *p2) {
+  const BigramEntry *e1 = static_cast<const BigramEntry*>(p1);
+  const BigramEntry *e2 = static_cast<const BigramEntry*>(p2);
+  if (e1->id1 != e2->id1)
+    return e1->id1 < e2->id1 ? -1 : 1;
+  if (e1->id2 != e2->id2)
+    return e1->id2 < e2->id2 ? -1 : 1;
+  return 0;
+}
+
+// Higher freq first, then by ids.
+int cmp_bigram_by_freq(const void *p1, const void *p2) {
+  const BigramEntry *e1 = static_cast<const BigramEntry*>(p1);
+  const BigramEntry *e2 = static_cast<const BigramEntry*>(p2);
+  if (e1->freq != e2->freq)
+    return e1->freq > e2->freq ? -1 : 1;
+  return cmp_bigram_by_ids(p1, p2);
+}
+
+struct BigramLessByIds {
+  bool operator()(const BigramEntry &e1, const BigramEntry &e2) const {
+    return cmp_bigram_by_ids(&e1, &e2) < 0;
+  }
+};
+
+bool NGram::build_bigram(BigramEntry *bigram_arr, size_t num,
+                         size_t thread_num) {
+  if (!initialized_ || NULL == freq_codes_df_ || NULL == bigram_arr)
+    return false;
+
+  free_bigrams();
+
+  myparallel_sort(bigram_arr, num, BigramLessByIds(), thread_num);
+
+  // Merge the repeated pairs, and drop those with invalid ids.
+  size_t merged_num = 0;
+  for (size_t pos = 0; pos < num; pos++) {
+    const BigramEntry &entry = bigram_arr[pos];
+    if (0 == entry.id1 || entry.id1 >= idx_num_ ||
+        0 == entry.id2 || entry.id2 >= idx_num_ || entry.freq <= 0)
+      continue;
+    if (merged_num > 0 &&
+        0 == cmp_bigram_by_ids(&entry, bigram_arr + merged_num - 1)) {
+      bigram_arr[merged_num - 1].freq += entry.freq;
+      continue;
+    }
+    bigram_arr[merged_num++] = entry;
+  }
+
+  // For each first lemma, keep the most probable lemmas after it whose
+  // probabilities are higher than their unigram ones. The probabilities are
+  // put to freq.
+  size_t kept_num = 0;
+  size_t run_start = 0;
+  while (run_start < merged_num) {
+    size_t run_end = run_start + 1;
+    double total_freq = bigram_arr[run_start].freq;
+    while (run_end < merged_num &&
+           bigram_arr[run_end].id1 == bigram_arr[run_start].id1) {
+      total_freq += bigram_arr[run_end].freq;
+      run_end++;
+    }
+
+    size_t cand_end = run_start;
+    for (size_t pos = run_start; pos < run_end; pos++) {
+      double uni_psb = freq_codes_df_[lma_freq_idx_[bigram_arr[pos].id2]];
+      double psb = (bigram_arr[pos].freq + kBigramPriorFreq * uni_psb) /
+          (total_freq + kBigramPriorFreq);
+      if (psb <= uni_psb)
+        continue;
+      bigram_arr[cand_end] = bigram_arr[pos];
+      bigram_arr[cand_end].freq = static_cast<float>(psb);
+      cand_end++;
+    }
+
+    size_t cand_num = cand_end - run_start;
+    if (cand_num > kMaxBigramsPerLemma) {
+      myqsort(bigram_arr + run_start, cand_num, sizeof(BigramEntry),
+              cmp_bigram_by_freq);
+      cand_num = kMaxBigramsPerLemma;
+      myqsort(bigram_arr + run_start, cand_num, sizeof(BigramEntry),
+              cmp_bigram_by_ids);
+    }
+    memmove(bigram_arr + kept_num, bigram_arr + run_start,
+            cand_num * sizeof(BigramEntry));
+    kept_num += cand_num;
+    run_start = run_end;
+  }
+
+  if (0 == kept_num)
+    return true;
+
+  // Calculate the code book of the probabilities, starting from values
+  // spread over them.
+  double *psbs = new double[kept_num];
+  double *sorted_psbs = new double[kept_num];
+  double *code_book = new double[kCodeBookSize];
+  CODEBOOK_TYPE *code_idx = new CODEBOOK_TYPE[kept_num];
+  for (size_t pos = 0; pos < kept_num; pos++) {
+    psbs[pos] = bigram_arr[pos].freq;
+    sorted_psbs[pos] = psbs[pos];
+  }
+  myqsort(sorted_psbs, kept_num, sizeof(double), comp_double);
+
+  size_t distinct_num = 0;
+  for (size_t pos = 0; pos < kept_num; pos++) {
+    if (0 == distinct_num || sorted_psbs[pos] != sorted_psbs[distinct_num - 1])
+      sorted_psbs[distinct_num++] = sorted_psbs[pos];
+  }
+
+  if (distinct_num <= kCodeBookSize) {
+    // Every value has a code of its own.
+    for (size_t code = 0; code < kCodeBookSize; code++)
+      code_book[code] = sorted_psbs[code < distinct_num ? code :
+                                    distinct_num - 1];
+    for (size_t pos = 0; pos < kept_num; pos++)
+      code_idx[pos] = qsearch_nearest(code_book, psbs[pos], 0,
+                                      distinct_num - 1);
+  } else {
+    for (size_t code = 0; code < kCodeBookSize; code++)
+      code_book[code] = sorted_psbs[code * distinct_num / kCodeBookSize];
+    iterate_codes(psbs, kept_num, code_book, code_idx, thread_num);
+  }
+
+  bi_codes_ = static_cast<LmaScoreType*>(
+      malloc(kCodeBookSize * sizeof(LmaScoreType)));
+  bi_starts_ = static_cast<uint32*>(malloc((idx_num_ + 1) * sizeof(uint32)));
+  bi_items_ = static_cast<uint32*>(malloc(kept_num * sizeof(uint32)));
+  assert(NULL != bi_codes_ && NULL != bi_starts_ && NULL != bi_items_);
+
+  for (size_t code = 0; code < kCodeBookSize; code++) {
+    bi_codes_[code] =
+        static_cast<LmaScoreType>(convert_psb_to_score(code_book[code]));
+  }
+
+  size_t pos = 0;
+  for (LemmaIdType id = 0; id <= idx_num_; id++) {
+    bi_starts_[id] = pos;
+    while (pos < kept_num && bigram_arr[pos].id1 == id) {
+      bi_items_[pos] = (bigram_arr[pos].id2 << 8) | code_idx[pos];
+      pos++;
+    }
+  }
+  assert(pos == kept_num);
+  bi_num_ = kept_num;
+
+  delete [] psbs;
+  delete [] sorted_psbs;
+  delete [] code_book;
+  delete [] code_idx;
+
+  if (kPrintDebug0) {
+    printf("bigrams: %zu pairs read, %zu kept\n", merged_num, kept_num);
+  }
+  return true;
+}
 #endif
 
 }  // namespace ime_pinyin
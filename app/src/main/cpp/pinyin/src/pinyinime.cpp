@@ -16,6 +16,7 @@
 
 #include <stdlib.h>
 #include "pinyinime.h"
+#include "decodeworker.h"
 #include "dicttrie.h"
 #include "matrixsearch.h"
 #include "spellingtrie.h"
@@ -77,6 +78,33 @@ extern "C" {
       matrix_search->flush_cache();
   }
 
+  void im_get_lma_cache_stat(size_t *hit_num, size_t *miss_num) {
+    if (NULL == hit_num || NULL == miss_num)
+      return;
+
+    if (NULL == matrix_search) {
+      *hit_num = 0;
+      *miss_num = 0;
+      return;
+    }
+    matrix_search->get_lma_cache_stat(hit_num, miss_num);
+  }
+
+  void im_get_pool_stat(size_t *mtrx_nd_used, size_t *mtrx_nd_capacity,
+                        size_t *dmi_used, size_t *dmi_capacity) {
+    if (NULL == mtrx_nd_used || NULL == mtrx_nd_capacity ||
+        NULL == dmi_used || NULL == dmi_capacity)
+      return;
+
+    if (NULL == matrix_search) {
+      *mtrx_nd_used = *mtrx_nd_capacity = 0;
+      *dmi_used = *dmi_capacity = 0;
+      return;
+    }
+    matrix_search->get_pool_stat(mtrx_nd_used, mtrx_nd_capacity,
+                                 dmi_used, dmi_capacity);
+  }
+
   // To be updated.
   size_t im_search(const char* pybuf, size_t pylen) {
     if (NULL == matrix_search)
@@ -121,6 +149,14 @@ extern "C" {
     return matrix_search->get_candidate(cand_id, cand_str, max_len);
   }
 
+  size_t im_get_candidates(size_t start_id, size_t count, char16* cand_buf,
+                           size_t buf_len) {
+    if (NULL == matrix_search)
+      return 0;
+
+    return matrix_search->get_candidates(start_id, count, cand_buf, buf_len);
+  }
+
   size_t im_get_spl_start_pos(const uint16 *&spl_start) {
     if (NULL == matrix_search)
       return 0;
@@ -181,6 +217,163 @@ extern "C" {
     spl_trie.szm_enable_ym(enable);
   }
 
+  void im_set_fuzzy(uint16 fuzzy_flags) {
+    if (NULL != matrix_search)
+      matrix_search->set_fuzzy(fuzzy_flags);
+  }
+
+  void im_set_t9(bool enable) {
+    if (NULL != matrix_search)
+      matrix_search->set_t9(enable);
+  }
+
+  struct ime_pinyin::ImSession {
+    MatrixSearch *matrix_search;
+    char16 predict_buf[kMaxPredictNum][kMaxPredictSize + 1];
+  };
+
+  ImSession* im_open_session() {
+    if (NULL == matrix_search)
+      return NULL;
+
+    ImSession *session = new ImSession();
+    if (NULL == session)
+      return NULL;
+
+    session->matrix_search = new MatrixSearch();
+    if (NULL == session->matrix_search ||
+        !session->matrix_search->init_session(matrix_search)) {
+      im_close_session(session);
+      return NULL;
+    }
+    return session;
+  }
+
+  void im_close_session(ImSession *session) {
+    if (NULL == session)
+      return;
+
+    if (NULL != session->matrix_search) {
+      session->matrix_search->close();
+      delete session->matrix_search;
+    }
+    delete session;
+  }
+
+  size_t im_session_search(ImSession *session, const char* pybuf,
+                           size_t pylen) {
+    if (NULL == session)
+      return 0;
+
+    session->matrix_search->search(pybuf, pylen);
+    return session->matrix_search->get_candidate_num();
+  }
+
+  size_t im_session_delsearch(ImSession *session, size_t pos,
+                              bool is_pos_in_splid,
+                              bool clear_fixed_this_step) {
+    if (NULL == session)
+      return 0;
+
+    session->matrix_search->delsearch(pos, is_pos_in_splid,
+                                      clear_fixed_this_step);
+    return session->matrix_search->get_candidate_num();
+  }
+
+  void im_session_reset_search(ImSession *session) {
+    if (NULL == session)
+      return;
+
+    session->matrix_search->reset_search();
+  }
+
+  const char* im_session_get_sps_str(ImSession *session, size_t *decoded_len) {
+    if (NULL == session)
+      return NULL;
+
+    return session->matrix_search->get_pystr(decoded_len);
+  }
+
+  char16* im_session_get_candidate(ImSession *session, size_t cand_id,
+                                   char16* cand_str, size_t max_len) {
+    if (NULL == session)
+      return NULL;
+
+    return session->matrix_search->get_candidate(cand_id, cand_str, max_len);
+  }
+
+  size_t im_session_get_candidates(ImSession *session, size_t start_id,
+                                   size_t count, char16* cand_buf,
+                                   size_t buf_len) {
+    if (NULL == session)
+      return 0;
+
+    return session->matrix_search->get_candidates(start_id, count, cand_buf,
+                                                  buf_len);
+  }
+
+  size_t im_session_get_spl_start_pos(ImSession *session,
+                                      const uint16 *&spl_start) {
+    if (NULL == session)
+      return 0;
+
+    return session->matrix_search->get_spl_start(spl_start);
+  }
+
+  size_t im_session_choose(ImSession *session, size_t choice_id) {
+    if (NULL == session)
+      return 0;
+
+    return session->matrix_search->choose(choice_id);
+  }
+
+  size_t im_session_cancel_last_choice(ImSession *session) {
+    if (NULL == session)
+      return 0;
+
+    return session->matrix_search->cancel_last_choice();
+  }
+
+  size_t im_session_get_fixed_len(ImSession *session) {
+    if (NULL == session)
+      return 0;
+
+    return session->matrix_search->get_fixedlen();
+  }
+
+  size_t im_session_get_predicts(ImSession *session, const char16 *his_buf,
+                                 char16 (*&pre_buf)[kMaxPredictSize + 1]) {
+    if (NULL == session || NULL == his_buf)
+      return 0;
+
+    pre_buf = session->predict_buf;
+    return session->matrix_search->get_predicts(his_buf, pre_buf,
+                                                kMaxPredictNum);
+  }
+
+  DecodeWorker* im_open_worker(size_t page_size, DecodeListener *listener) {
+    if (NULL == matrix_search)
+      return NULL;
+
+    DecodeWorker *worker = new DecodeWorker();
+    if (NULL == worker)
+      return NULL;
+
+    if (!worker->start(matrix_search, page_size, listener)) {
+      delete worker;
+      return NULL;
+    }
+    return worker;
+  }
+
+  void im_close_worker(DecodeWorker *worker) {
+    if (NULL == worker)
+      return;
+
+    worker->stop();
+    delete worker;
+  }
+
 #ifdef __cplusplus
 }
 #endif
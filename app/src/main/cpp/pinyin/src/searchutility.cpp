@@ -32,34 +32,6 @@ bool is_composing_lemma(LemmaIdType lma_id) {
   return (kLemmaIdComposing == lma_id);
 }
 
-int cmp_lpi_with_psb(const void *p1, const void *p2) {
-  if ((static_cast<const LmaPsbItem*>(p1))->psb >
-      (static_cast<const LmaPsbItem*>(p2))->psb)
-    return 1;
-  if ((static_cast<const LmaPsbItem*>(p1))->psb <
-      (static_cast<const LmaPsbItem*>(p2))->psb)
-    return -1;
-  return 0;
-}
-
-int cmp_lpi_with_unified_psb(const void *p1, const void *p2) {
-  const LmaPsbItem *item1 = static_cast<const LmaPsbItem*>(p1);
-  const LmaPsbItem *item2 = static_cast<const LmaPsbItem*>(p2);
-
-  // The real unified psb is psb1 / lma_len1 and psb2 * lma_len2
-  // But we use psb1 * lma_len2 and psb2 * lma_len1 to get better
-  // precision.
-  size_t up1 = item1->psb * (item2->lma_len);
-  size_t up2 = item2->psb * (item1->lma_len);
-  if (up1 < up2) {
-    return -1;
-  }
-  if (up1 > up2) {
-    return 1;
-  }
-  return 0;
-}
-
 int cmp_lpi_with_id(const void *p1, const void *p2) {
   if ((static_cast<const LmaPsbItem*>(p1))->id <
       (static_cast<const LmaPsbItem*>(p2))->id)
@@ -70,22 +42,6 @@ int cmp_lpi_with_id(const void *p1, const void *p2) {
   return 0;
 }
 
-int cmp_lpi_with_hanzi(const void *p1, const void *p2) {
-  if ((static_cast<const LmaPsbItem*>(p1))->hanzi <
-      (static_cast<const LmaPsbItem*>(p2))->hanzi)
-    return -1;
-  if ((static_cast<const LmaPsbItem*>(p1))->hanzi >
-      (static_cast<const LmaPsbItem*>(p2))->hanzi)
-    return 1;
-
-  return 0;
-}
-
-int cmp_lpsi_with_str(const void *p1, const void *p2) {
-  return utf16_strcmp((static_cast<const LmaPsbStrItem*>(p1))->str,
-                      (static_cast<const LmaPsbStrItem*>(p2))->str);
-}
-
 
 int cmp_hanzis_1(const void *p1, const void *p2) {
   if (*static_cast<const char16*>(p1) <
@@ -133,60 +89,11 @@ int cmp_hanzis_8(const void *p1, const void *p2) {
                         static_cast<const char16*>(p2), 8);
 }
 
-int cmp_npre_by_score(const void *p1, const void *p2) {
-  if ((static_cast<const NPredictItem*>(p1))->psb >
-      (static_cast<const NPredictItem*>(p2))->psb)
-    return 1;
-
-  if ((static_cast<const NPredictItem*>(p1))->psb <
-      (static_cast<const NPredictItem*>(p2))->psb)
-    return -1;
-
-  return 0;
-}
-
-int cmp_npre_by_hislen_score(const void *p1, const void *p2) {
-  if ((static_cast<const NPredictItem*>(p1))->his_len <
-      (static_cast<const NPredictItem*>(p2))->his_len)
-    return 1;
-
-  if ((static_cast<const NPredictItem*>(p1))->his_len >
-      (static_cast<const NPredictItem*>(p2))->his_len)
-    return -1;
-
-  if ((static_cast<const NPredictItem*>(p1))->psb >
-      (static_cast<const NPredictItem*>(p2))->psb)
-    return 1;
-
-  if ((static_cast<const NPredictItem*>(p1))->psb <
-      (static_cast<const NPredictItem*>(p2))->psb)
-    return -1;
-
-  return 0;
-}
-
-int cmp_npre_by_hanzi_score(const void *p1, const void *p2) {
-  int ret_v = (utf16_strncmp((static_cast<const NPredictItem*>(p1))->pre_hzs,
-      (static_cast<const NPredictItem*>(p2))->pre_hzs, kMaxPredictSize));
-  if (0 != ret_v)
-    return ret_v;
-
-  if ((static_cast<const NPredictItem*>(p1))->psb >
-      (static_cast<const NPredictItem*>(p2))->psb)
-    return 1;
-
-  if ((static_cast<const NPredictItem*>(p1))->psb <
-      (static_cast<const NPredictItem*>(p2))->psb)
-    return -1;
-
-  return 0;
-}
-
 size_t remove_duplicate_npre(NPredictItem *npre_items, size_t npre_num) {
   if (NULL == npre_items || 0 == npre_num)
     return 0;
 
-  myqsort(npre_items, npre_num, sizeof(NPredictItem), cmp_npre_by_hanzi_score);
+  mysort(npre_items, npre_num, NpreLessByHanziScore());
 
   size_t remain_num = 1;  // The first one is reserved.
   for (size_t pos = 1; pos < npre_num; pos++) {
@@ -202,6 +109,28 @@ size_t remove_duplicate_npre(NPredictItem *npre_items, size_t npre_num) {
   return remain_num;
 }
 
+size_t remove_used_npre(NPredictItem *npre_items, size_t npre_num,
+                        size_t b4_used) {
+  size_t new_num = 0;
+  for (size_t i = 0; i < npre_num; i++) {
+    // Try to find it in the existing items
+    size_t e_pos;
+    for (e_pos = 1; e_pos <= b4_used; e_pos++) {
+      if (utf16_strncmp((*(npre_items - e_pos)).pre_hzs, npre_items[i].pre_hzs,
+                        kMaxPredictSize) == 0)
+        break;
+    }
+    if (e_pos <= b4_used)
+      continue;
+
+    // If not found, append it to the buffer
+    npre_items[new_num] = npre_items[i];
+    new_num++;
+  }
+
+  return new_num;
+}
+
 size_t align_to_size_t(size_t size) {
   size_t s = sizeof(size_t);
   return (size + s -1) / s * s;
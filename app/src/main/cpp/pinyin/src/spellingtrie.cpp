@@ -51,6 +51,9 @@ int compare_spl(const void* p1, const void* p2) {
   return strcmp((const char*)(p1), (const char*)(p2));
 }
 
+// The T9 digit for each letter, from 'a' to 'z'.
+static const char kT9Digits[] = "22233344455566677778889999";
+
 SpellingTrie::SpellingTrie() {
   spelling_buf_ = NULL;
   spelling_size_ = 0;
@@ -64,6 +67,8 @@ SpellingTrie::SpellingTrie() {
   instance_ = NULL;
   ym_buf_ = NULL;
   f2h_ = NULL;
+  t9_items_ = NULL;
+  t9_num_ = 0;
 
   szm_enable_shm(true);
   szm_enable_ym(true);
@@ -86,6 +91,9 @@ SpellingTrie::~SpellingTrie() {
   if (NULL != spl_ym_ids_)
     delete [] spl_ym_ids_;
 
+  if (NULL != t9_items_)
+    delete [] t9_items_;
+
   if (NULL != root_) {
     free_son_trie(root_);
     delete root_;
@@ -163,6 +171,101 @@ bool SpellingTrie::half_full_compatible(uint16 half_id, uint16 full_id) const {
   return false;
 }
 
+void SpellingTrie::build_fuzzy_sets(uint16 fuzzy_flags,
+                                    SplIdSet *sets) const {
+  // The two sides of each fuzzy pair, for initials and for the ends of
+  // finals respectively.
+  static const struct {
+    uint16 flag;
+    const char *sides[2];
+  } kFuzzyPairs[] = {
+    {kFuzzyZZh, {"Z", "Zh"}}, {kFuzzyCCh, {"C", "Ch"}},
+    {kFuzzySSh, {"S", "Sh"}}, {kFuzzyNL, {"N", "L"}},
+    {kFuzzyAnAng, {"AN", "ANG"}}, {kFuzzyEnEng, {"EN", "ENG"}},
+    {kFuzzyInIng, {"IN", "ING"}}
+  };
+  static const size_t kInitialPairNum = 4;
+  static const size_t kPairNum = sizeof(kFuzzyPairs) / sizeof(kFuzzyPairs[0]);
+
+  memset(sets, 0, sizeof(SplIdSet) * kSplIdNum);
+  if (NULL == spelling_buf_ || NULL == root_)
+    return;
+
+  for (uint16 full_id = kFullSplIdStart;
+       full_id < kFullSplIdStart + spelling_num_; full_id++) {
+    const char *spl_str =
+        spelling_buf_ + (full_id - kFullSplIdStart) * spelling_size_;
+    sets[full_id].add(full_id);
+    if (0 == fuzzy_flags)
+      continue;
+
+    // Split the spelling into its initial and final, and collect the
+    // alternatives of both. Zh/Ch/Sh are stored as "Zh", "Ch" and "Sh".
+    size_t spl_len = strlen(spl_str);
+    size_t ini_len = 0;
+    if ('h' == spl_str[1])
+      ini_len = 2;
+    else if (is_shengmu_char(spl_str[0]))
+      ini_len = 1;
+
+    const char *inis[2] = {spl_str, NULL};
+    size_t ini_lens[2] = {ini_len, 0};
+    const char *fin_ends[2] = {"", NULL};
+    size_t fin_lens[2] = {spl_len - ini_len, 0};
+    for (size_t pair = 0; pair < kPairNum; pair++) {
+      if (0 == (fuzzy_flags & kFuzzyPairs[pair].flag))
+        continue;
+      for (size_t side = 0; side < 2; side++) {
+        const char *this_side = kFuzzyPairs[pair].sides[side];
+        const char *other_side = kFuzzyPairs[pair].sides[1 - side];
+        size_t side_len = strlen(this_side);
+        if (pair < kInitialPairNum) {
+          if (side_len == ini_len &&
+              0 == strncmp(spl_str, this_side, ini_len)) {
+            inis[1] = other_side;
+            ini_lens[1] = strlen(other_side);
+          }
+        } else if (side_len <= fin_lens[0] &&
+                   0 == strcmp(spl_str + spl_len - side_len, this_side)) {
+          fin_ends[1] = other_side;
+          fin_lens[1] = fin_lens[0] - side_len;
+        }
+      }
+    }
+
+    for (size_t ini = 0; ini < 2; ini++) {
+      for (size_t fin = 0; fin < 2; fin++) {
+        if (NULL == inis[ini] || NULL == fin_ends[fin] || 0 == ini + fin)
+          continue;
+        char variant[kMaxPinyinSize + 4];
+        snprintf(variant, sizeof(variant), "%.*s%.*s%s",
+                 static_cast<int>(ini_lens[ini]), inis[ini],
+                 static_cast<int>(fin_lens[fin]), spl_str + ini_len,
+                 fin_ends[fin]);
+        const char *found = static_cast<const char*>(
+            bsearch(variant, spelling_buf_, spelling_num_, spelling_size_,
+                    compare_spl));
+        if (NULL != found) {
+          sets[full_id].add(static_cast<uint16>(
+              kFullSplIdStart + (found - spelling_buf_) / spelling_size_));
+        }
+      }
+    }
+  }
+
+  // A half id matches the sets of all the full ids it covers.
+  for (uint16 half_id = 1; half_id < kFullSplIdStart; half_id++) {
+    for (uint16 full_id = h2f_start_[half_id];
+         full_id < h2f_start_[half_id] + h2f_num_[half_id]; full_id++) {
+      const SplIdSet &full_set = sets[full_id];
+      for (uint16 id = full_set.id_min; id <= full_set.id_max; id++) {
+        if (full_set.has(id))
+          sets[half_id].add(id);
+      }
+    }
+  }
+}
+
 bool SpellingTrie::is_half_id_yunmu(uint16 splid) const {
   if (0 == splid || splid >= kFullSplIdStart)
     return false;
@@ -341,6 +444,9 @@ bool SpellingTrie::construct(const char* spelling_arr, size_t item_size,
   if (!build_f2h())
     return false;
 
+  if (!build_t9_index())
+    return false;
+
 #ifdef ___BUILD_MODEL___
   if (kPrintDebug0) {
     printf("---SpellingTrie Nodes: %d\n", node_num_);
@@ -652,6 +758,9 @@ bool SpellingTrie::save_spl_trie(FILE *fp) {
   if (fwrite(&average_score_, sizeof(unsigned char), 1, fp) != 1)
     return false;
 
+  if (!DictImage::write_padding(fp))
+    return false;
+
   if (fwrite(spelling_buf_, sizeof(char) * spelling_size_,
              spelling_num_, fp) != spelling_num_)
     return false;
@@ -659,34 +768,31 @@ bool SpellingTrie::save_spl_trie(FILE *fp) {
   return true;
 }
 
-bool SpellingTrie::load_spl_trie(FILE *fp) {
-  if (NULL == fp)
+bool SpellingTrie::load_spl_trie(DictImage *image) {
+  if (NULL == image)
     return false;
 
-  if (fread(&spelling_size_, sizeof(uint32), 1, fp) != 1)
+  uint32 spelling_size;
+  uint32 spelling_num;
+  if (!image->read(&spelling_size, sizeof(uint32)))
     return false;
 
-  if (fread(&spelling_num_, sizeof(uint32), 1, fp) != 1)
+  if (!image->read(&spelling_num, sizeof(uint32)))
     return false;
 
-  if (fread(&score_amplifier_, sizeof(float), 1, fp) != 1)
+  if (!image->read(&score_amplifier_, sizeof(float)))
     return false;
 
-  if (fread(&average_score_, sizeof(unsigned char), 1, fp) != 1)
-    return false;
-
-  if (NULL != spelling_buf_)
-    delete [] spelling_buf_;
-
-  spelling_buf_ = new char[spelling_size_ * spelling_num_];
-  if (NULL == spelling_buf_)
+  if (!image->read(&average_score_, sizeof(unsigned char)))
     return false;
 
-  if (fread(spelling_buf_, sizeof(char) * spelling_size_,
-            spelling_num_, fp) != spelling_num_)
+  // construct() sorts the table in place, so it keeps its own copy.
+  const char *spelling_arr = static_cast<const char*>
+      (image->get_array(sizeof(char) * spelling_size, spelling_num, 1));
+  if (NULL == spelling_arr)
     return false;
 
-  return construct(spelling_buf_, spelling_size_, spelling_num_,
+  return construct(spelling_arr, spelling_size, spelling_num,
                    score_amplifier_, average_score_);
 }
 
@@ -706,6 +812,92 @@ bool SpellingTrie::build_f2h() {
   return true;
 }
 
+int SpellingTrie::compare_t9_items(const void *p1, const void *p2) {
+  const T9Item *item1 = static_cast<const T9Item*>(p1);
+  const T9Item *item2 = static_cast<const T9Item*>(p2);
+  int ret = strcmp(item1->code, item2->code);
+  if (0 != ret)
+    return ret;
+  return static_cast<int>(item1->splid) - static_cast<int>(item2->splid);
+}
+
+bool SpellingTrie::build_t9_index() {
+  if (NULL != t9_items_)
+    delete [] t9_items_;
+  t9_items_ = new T9Item[kFullSplIdStart + spelling_num_];
+  if (NULL == t9_items_)
+    return false;
+  t9_num_ = 0;
+
+  for (uint16 splid = 1; splid < kFullSplIdStart + spelling_num_; splid++) {
+    const char *spl_str;
+    if (splid < kFullSplIdStart) {
+      if (0 == h2f_num_[splid])
+        continue;
+      spl_str = spelling_buf_ + (h2f_start_[splid] - kFullSplIdStart) *
+          spelling_size_;
+    } else {
+      spl_str = spelling_buf_ + (splid - kFullSplIdStart) * spelling_size_;
+      if ('\0' == spl_str[1])
+        continue;
+    }
+
+    // A half id is typed by the first char of its full spellings, or by the
+    // first two for Zh/Ch/Sh.
+    size_t code_len = strlen(spl_str);
+    if (splid < kFullSplIdStart)
+      code_len = (kHalfId2Sc_[splid] >= 'a') ? 2 : 1;
+
+    T9Item &item = t9_items_[t9_num_];
+    for (size_t pos = 0; pos < code_len; pos++) {
+      char ch = spl_str[pos];
+      item.code[pos] = kT9Digits[(ch >= 'a' ? ch - 'a' : ch - 'A')];
+    }
+    item.code[code_len] = '\0';
+    item.splid = splid;
+    t9_num_++;
+  }
+
+  qsort(t9_items_, t9_num_, sizeof(T9Item), compare_t9_items);
+  return true;
+}
+
+uint16 SpellingTrie::t9_to_splids(const char *digits, uint16 digits_len,
+                                  uint16 *splids, uint16 max_num,
+                                  bool *is_pre) const {
+  *is_pre = false;
+  if (NULL == t9_items_ || 0 == digits_len || digits_len > kMaxPinyinSize)
+    return 0;
+
+  char code[kMaxPinyinSize + 1];
+  memcpy(code, digits, digits_len);
+  code[digits_len] = '\0';
+
+  // Find the first item whose code is not less than the given one.
+  size_t item_start = 0;
+  size_t item_end = t9_num_;
+  while (item_start < item_end) {
+    size_t item_mid = (item_start + item_end) / 2;
+    if (strcmp(t9_items_[item_mid].code, code) < 0)
+      item_start = item_mid + 1;
+    else
+      item_end = item_mid;
+  }
+
+  uint16 num = 0;
+  size_t pos = item_start;
+  for (; pos < t9_num_ && 0 == strcmp(t9_items_[pos].code, code); pos++) {
+    if (num < max_num)
+      splids[num++] = t9_items_[pos].splid;
+  }
+
+  // The codes which begin with the given one follow the equal ones.
+  if (pos < t9_num_ && 0 == strncmp(t9_items_[pos].code, code, digits_len))
+    *is_pre = true;
+
+  return num;
+}
+
 size_t SpellingTrie::get_spelling_num() {
   return spelling_num_;
 }
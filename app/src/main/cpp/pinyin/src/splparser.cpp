@@ -27,6 +27,10 @@ bool SpellingParser::is_valid_to_parse(char ch) {
   return SpellingTrie::is_valid_spl_char(ch);
 }
 
+bool SpellingParser::is_valid_to_parse_t9(char ch) {
+  return ch >= '2' && ch <= '9';
+}
+
 uint16 SpellingParser::splstr_to_idxs(const char *splstr, uint16 str_len,
                                       uint16 spl_idx[], uint16 start_pos[],
                                       uint16 max_size, bool &last_is_pre) {
@@ -322,6 +326,26 @@ uint16 SpellingParser::get_splid_by_str_f(const char *splstr, uint16 str_len,
   return spl_idx[0];
 }
 
+uint16 SpellingParser::get_splids_t9(const char *splstr, uint16 str_len,
+                                     uint16 splidx[], uint16 max_size,
+                                     bool *is_pre) {
+  if (NULL == is_pre)
+    return 0;
+
+  uint16 splid_num = spl_trie_->t9_to_splids(splstr, str_len, splidx,
+                                             max_size, is_pre);
+
+  // Keep the half ids which can be typed in the current ShouZiMu mode, as
+  // splstr_to_idxs() does.
+  uint16 valid_num = 0;
+  for (uint16 pos = 0; pos < splid_num; pos++) {
+    uint16 splid = splidx[pos];
+    if (spl_trie_->if_valid_id_update(&splid))
+      splidx[valid_num++] = splid;
+  }
+  return valid_num;
+}
+
 uint16 SpellingParser::get_splids_parallel(const char *splstr, uint16 str_len,
     uint16 splidx[], uint16 max_size,
     uint16 &full_id_num, bool &is_pre) {
@@ -105,7 +105,8 @@ void Sync::finish() {
 int Sync::get_capacity() {
   UserDict::UserDictStat stat;
   userdict_->state(&stat);
-  return stat.limit_lemma_count - stat.lemma_count;
+  // Removed lemmas do not count against the limit
+  return stat.limit_lemma_count - (stat.lemma_count - stat.delete_count);
 }
 
 }
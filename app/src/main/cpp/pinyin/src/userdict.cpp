@@ -204,15 +204,24 @@ inline uint16 * UserDict::get_lemma_word(uint32 offset) {
 inline LemmaIdType UserDict::get_max_lemma_id() {
   // When a lemma is deleted, we don't not claim its id back for
   // simplicity and performance
-  return start_id_ + dict_info_.lemma_count - 1;
+  return start_id_ + id_count_ - 1;
 }
 
 inline bool UserDict::is_valid_lemma_id(LemmaIdType id) {
-  if (id >= start_id_ && id <= get_max_lemma_id())
+  // A lemma dropped by compact() has no offset any more
+  if (id >= start_id_ && id <= get_max_lemma_id() &&
+      (offsets_by_id_[id - start_id_] & kUserDictOffsetFlagRemove) == 0)
     return true;
   return false;
 }
 
+inline void UserDict::mark_lemmas_dirty(UserDictState state) {
+  if (journal_.is_open())
+    return;
+  if (state_ < state)
+    state_ = state;
+}
+
 inline bool UserDict::is_valid_state() {
   if (state_ == USER_DICT_NONE)
     return false;
@@ -220,8 +229,10 @@ inline bool UserDict::is_valid_state() {
 }
 
 UserDict::UserDict()
-    : start_id_(0),
+    : total_other_nfreq_(0),
+      start_id_(0),
       version_(0),
+      max_pause_us_(0),
       lemmas_(NULL),
       offsets_(NULL),
       scores_(NULL),
@@ -236,13 +247,19 @@ UserDict::UserDict()
       offsets_by_id_(NULL),
       lemma_count_left_(0),
       lemma_size_left_(0),
+      id_count_(0),
+      id_count_left_(0),
+      end_id_(0),
       dict_file_(NULL),
-      state_(USER_DICT_NONE) {
+      state_(USER_DICT_NONE),
+      splid_index_(NULL),
+      reclaim_heap_(NULL),
+      reclaim_num_(0),
+      reclaim_heap_size_(0),
+      reclaim_pos_(0) {
   memset(&dict_info_, 0, sizeof(dict_info_));
   memset(&load_time_, 0, sizeof(load_time_));
-#ifdef ___CACHE_ENABLED___
-  cache_init();
-#endif
+  memset(&sync_time_, 0, sizeof(sync_time_));
 }
 
 UserDict::~UserDict() {
@@ -259,6 +276,7 @@ bool UserDict::load_dict(const char *file_name, LemmaIdType start_id,
     return false;
 
   start_id_ = start_id;
+  end_id_ = end_id;
 
   if (false == validate(file_name) && false == reset(file_name)) {
     goto error;
@@ -268,8 +286,17 @@ bool UserDict::load_dict(const char *file_name, LemmaIdType start_id,
   }
 
   state_ = USER_DICT_SYNC;
+  version_++;
 
   gettimeofday(&load_time_, NULL);
+  sync_time_ = load_time_;
+
+  if (journal_.is_open() &&
+      !journal_.start(&g_mutex_, &g_last_update_, &sync_time_)) {
+    // Without the thread, the replayed lemmas are written back on close.
+    journal_.close(NULL, 0);
+    state_ = USER_DICT_DEFRAGMENTED;
+  }
 
 #ifdef ___DEBUG_PERF___
   DEBUG_PERF_END;
@@ -285,6 +312,22 @@ bool UserDict::load_dict(const char *file_name, LemmaIdType start_id,
 bool UserDict::close_dict() {
   if (state_ == USER_DICT_NONE)
     return true;
+  end_reclaim();
+  // Removed lemmas stay in memory until here, as defragment() renumbers the
+  // lemma ids which searches may hold.
+  if (dict_info_.free_count > 0 &&
+      dict_info_.free_count * 4 >= dict_info_.lemma_count)
+    defragment();
+  if (journal_.is_open()) {
+    // The journal has the changed lemmas, the dictionary file is only
+    // rewritten for the other changes.
+    size_t image_size = 0;
+    uint8 *image = NULL;
+    if (state_ != USER_DICT_SYNC)
+      image = build_image(&image_size);
+    journal_.close(image, image_size);
+    goto out;
+  }
   if (state_ == USER_DICT_SYNC)
     goto out;
 
@@ -293,9 +336,9 @@ bool UserDict::close_dict() {
   // To do a safe flush, we have to discard all newly added
   // lemmas and try to reload dict file.
   pthread_mutex_lock(&g_mutex_);
-  if (load_time_.tv_sec > g_last_update_.tv_sec ||
-    (load_time_.tv_sec == g_last_update_.tv_sec &&
-     load_time_.tv_usec > g_last_update_.tv_usec)) {
+  if (sync_time_.tv_sec > g_last_update_.tv_sec ||
+    (sync_time_.tv_sec == g_last_update_.tv_sec &&
+     sync_time_.tv_usec > g_last_update_.tv_usec)) {
     write_back();
     gettimeofday(&g_last_update_, NULL);
   }
@@ -311,8 +354,9 @@ bool UserDict::close_dict() {
 #ifdef ___PREDICT_ENABLED___
   free(predicts_);
 #endif
+  free(splid_index_);
 
-  version_ = 0;
+  version_++;
   dict_file_ = NULL;
   lemmas_ = NULL;
 #ifdef ___SYNC_ENABLED___
@@ -326,10 +370,13 @@ bool UserDict::close_dict() {
 #ifdef ___PREDICT_ENABLED___
   predicts_ = NULL;
 #endif
+  splid_index_ = NULL;
 
   memset(&dict_info_, 0, sizeof(dict_info_));
   lemma_count_left_ = 0;
   lemma_size_left_ = 0;
+  id_count_ = 0;
+  id_count_left_ = 0;
   state_ = USER_DICT_NONE;
 
   return true;
@@ -364,24 +411,6 @@ MileStoneHandle UserDict::extend_dict(MileStoneHandle from_handle,
   return ((*lpi_num > 0 || need_extend) ? 1 : 0);
 }
 
-int UserDict::is_fuzzy_prefix_spell_id(
-    const uint16 * id1, uint16 len1, const UserDictSearchable *searchable) {
-  if (len1 < searchable->splids_len)
-    return 0;
-
-  SpellingTrie &spl_trie = SpellingTrie::get_instance();
-  uint32 i = 0;
-  for (i = 0; i < searchable->splids_len; i++) {
-    const char py1 = *spl_trie.get_spelling_str(id1[i]);
-    uint16 off = 8 * (i % 4);
-    const char py2 = ((searchable->signature[i/4] & (0xff << off)) >> off);
-    if (py1 == py2)
-      continue;
-    return 0;
-  }
-  return 1;
-}
-
 int UserDict::fuzzy_compare_spell_id(
     const uint16 * id1, uint16 len1, const UserDictSearchable *searchable) {
   if (len1 < searchable->splids_len)
@@ -404,72 +433,187 @@ int UserDict::fuzzy_compare_spell_id(
   return 0;
 }
 
-bool UserDict::is_prefix_spell_id(
-    const uint16 * fullids, uint16 fulllen,
-    const UserDictSearchable *searchable) {
-  if (fulllen < searchable->splids_len)
-    return false;
+uint32 UserDict::locate_where_to_insert_in_offsets(
+    const UserDictSearchable *searchable, uint32 count) {
+  uint32 begin = 0;
+  uint32 end = count;
 
-  uint32 i = 0;
-  for (; i < searchable->splids_len; i++) {
-    uint16 start_id = searchable->splid_start[i];
-    uint16 count = searchable->splid_count[i];
-    if (fullids[i] >= start_id && fullids[i] < start_id + count)
-      continue;
+  while (begin < end) {
+    uint32 middle = (begin + end) >> 1;
+    uint32 offset = offsets_[middle] & kUserDictOffsetMask;
+    uint8 nchar = get_lemma_nchar(offset);
+    const uint16 * splids = get_lemma_spell_ids(offset);
+
+    if (fuzzy_compare_spell_id(splids, nchar, searchable) < 0)
+      begin = middle + 1;
     else
-      return false;
+      end = middle;
   }
-  return true;
+
+  return begin;
 }
 
-bool UserDict::equal_spell_id(
-    const uint16 * fullids, uint16 fulllen,
-    const UserDictSearchable *searchable) {
-  if (fulllen != searchable->splids_len)
-    return false;
+inline uint16 UserDict::get_index_splid(uint32 index, uint16 pos) {
+  uint32 offset = offsets_[splid_index_[index]] & kUserDictOffsetMask;
+  if (get_lemma_nchar(offset) <= pos)
+    return 0;
+  return get_lemma_spell_ids(offset)[pos];
+}
 
-  uint32 i = 0;
-  for (; i < fulllen; i++) {
-    uint16 start_id = searchable->splid_start[i];
-    uint16 count = searchable->splid_count[i];
-    if (fullids[i] >= start_id && fullids[i] < start_id + count)
-      continue;
+uint32 UserDict::locate_in_index(uint32 begin, uint32 end, uint16 pos,
+                                 uint16 splid) {
+  while (begin < end) {
+    uint32 middle = (begin + end) >> 1;
+    if (get_index_splid(middle, pos) < splid)
+      begin = middle + 1;
     else
-      return false;
+      end = middle;
   }
-  return true;
+  return begin;
 }
 
-int32 UserDict::locate_first_in_offsets(const UserDictSearchable * searchable) {
-  int32 begin = 0;
-  int32 end = dict_info_.lemma_count - 1;
-  int32 middle = -1;
+void UserDict::search_index(UserDictIndexQuery *query, uint32 begin,
+                            uint32 end, uint16 pos) {
+  const UserDictSearchable *searchable = query->searchable;
+  uint16 start_id = searchable->splid_start[pos];
+  begin = locate_in_index(begin, end, pos, start_id);
+  end = locate_in_index(begin, end, pos,
+                        start_id + searchable->splid_count[pos]);
 
-  int32 first_prefix = middle;
-  int32 last_matched = middle;
+  bool last = (pos + 1 == searchable->splids_len);
+  if (last && begin < end)
+    query->prefix_found = true;
 
-  while (begin <= end) {
-    middle = (begin + end) >> 1;
-    uint32 offset = offsets_[middle];
-    uint8 nchar = get_lemma_nchar(offset);
-    const uint16 * splids = get_lemma_spell_ids(offset);
-    int cmp = fuzzy_compare_spell_id(splids, nchar, searchable);
-    int pre = is_fuzzy_prefix_spell_id(splids, nchar, searchable);
+  // For a half id, the block holds several full ids, each of which has its
+  // own nested blocks.
+  while (begin < end) {
+    uint16 splid = get_index_splid(begin, pos);
+    uint32 next = locate_in_index(begin + 1, end, pos, splid + 1);
 
-    if (pre)
-      first_prefix = middle;
-
-    if (cmp < 0) {
-      begin = middle + 1;
-    } else if (cmp > 0) {
-      end = middle - 1;
+    if (!last) {
+      search_index(query, begin, next, pos + 1);
     } else {
-      end = middle - 1;
-      last_matched = middle;
+      // Lemmas without more spelling ids come first in the block
+      uint32 stop = locate_in_index(begin, next, pos + 1, 1);
+      for (uint32 i = begin; i < stop; i++) {
+        uint32 off = splid_index_[i];
+        uint32 offset = offsets_[off];
+        // Ignore deleted lemmas
+        if (offset & kUserDictOffsetFlagRemove)
+          continue;
+        if (NULL != query->lemma_str) {
+          if (memcmp(get_lemma_word(offset), query->lemma_str,
+                     (pos + 1) << 1) == 0) {
+            query->located = off;
+            return;
+          }
+        } else {
+          if (query->lpi_num >= query->lpi_max)
+            return;
+          LmaPsbItem *lpi = query->lpi_items + query->lpi_num;
+          lpi->psb = translate_score(scores_[off]);
+          lpi->id = ids_[off];
+          lpi->lma_len = pos + 1;
+          query->lpi_num++;
+        }
+      }
     }
+
+    if (query->located != -1 ||
+        (NULL == query->lemma_str && query->lpi_num >= query->lpi_max))
+      return;
+    begin = next;
+  }
+}
+
+int UserDict::compare_splids_at(uint32 a, uint32 b) {
+  uint32 offset_a = offsets_[a] & kUserDictOffsetMask;
+  uint32 offset_b = offsets_[b] & kUserDictOffsetMask;
+  uint8 nchar_a = get_lemma_nchar(offset_a);
+  uint8 nchar_b = get_lemma_nchar(offset_b);
+  const uint16 * splids_a = get_lemma_spell_ids(offset_a);
+  const uint16 * splids_b = get_lemma_spell_ids(offset_b);
+
+  uint8 minl = nchar_a < nchar_b ? nchar_a : nchar_b;
+  for (uint8 i = 0; i < minl; i++) {
+    if (splids_a[i] != splids_b[i])
+      return splids_a[i] < splids_b[i] ? -1 : 1;
   }
+  return (int)nchar_a - (int)nchar_b;
+}
+
+int UserDict::compare_words_at(uint32 a, uint32 b) {
+  a &= kUserDictOffsetMask;
+  b &= kUserDictOffsetMask;
+  uint8 nchar_a = get_lemma_nchar(a);
+  uint8 nchar_b = get_lemma_nchar(b);
+  const uint16 * words_a = get_lemma_word(a);
+  const uint16 * words_b = get_lemma_word(b);
+
+  uint8 minl = nchar_a < nchar_b ? nchar_a : nchar_b;
+  for (uint8 i = 0; i < minl; i++) {
+    if (words_a[i] != words_b[i])
+      return words_a[i] < words_b[i] ? -1 : 1;
+  }
+  return (int)nchar_a - (int)nchar_b;
+}
 
-  return first_prefix;
+void UserDict::sift_down_by(uint32 * array, uint32 i, uint32 n,
+                            UserDictCompare cmp) {
+  uint32 temp = array[i];
+  while (i * 2 + 1 < n) {
+    uint32 child = i * 2 + 1;
+    if (child + 1 < n && (this->*cmp)(array[child], array[child + 1]) < 0)
+      child++;
+    if ((this->*cmp)(temp, array[child]) >= 0)
+      break;
+    array[i] = array[child];
+    i = child;
+  }
+  array[i] = temp;
+}
+
+void UserDict::sort_by(uint32 * array, uint32 n, UserDictCompare cmp) {
+  if (n < 2)
+    return;
+  for (uint32 i = n / 2; i > 0; i--)
+    sift_down_by(array, i - 1, n, cmp);
+  for (uint32 i = n - 1; i > 0; i--) {
+    uint32 temp = array[0];
+    array[0] = array[i];
+    array[i] = temp;
+    sift_down_by(array, 0, i, cmp);
+  }
+}
+
+void UserDict::build_index() {
+  for (uint32 i = 0; i < dict_info_.lemma_count; i++)
+    splid_index_[i] = i;
+  sort_by(splid_index_, dict_info_.lemma_count,
+          &UserDict::compare_splids_at);
+}
+
+void UserDict::insert_to_index(uint32 pos) {
+  // The new lemma is the last one in dict_info_.lemma_count
+  uint32 count = dict_info_.lemma_count - 1;
+  for (uint32 i = 0; i < count; i++) {
+    if (splid_index_[i] >= pos)
+      splid_index_[i]++;
+  }
+
+  // Insert after the lemmas with the same spelling ids
+  uint32 begin = 0;
+  uint32 end = count;
+  while (begin < end) {
+    uint32 middle = (begin + end) >> 1;
+    if (compare_splids_at(splid_index_[middle], pos) <= 0)
+      begin = middle + 1;
+    else
+      end = middle;
+  }
+  memmove(splid_index_ + begin + 1, splid_index_ + begin,
+          (count - begin) << 2);
+  splid_index_[begin] = pos;
 }
 
 void UserDict::prepare_locate(UserDictSearchable *searchable,
@@ -512,11 +656,13 @@ size_t UserDict::_get_lpis(const uint16 *splid_str,
     return 0;
   if (lpi_max <= 0)
     return 0;
+  if (0 == splid_str_len || splid_str_len > kMaxLemmaSize)
+    return 0;
 
   if (0 == pthread_mutex_trylock(&g_mutex_)) {
-    if (load_time_.tv_sec < g_last_update_.tv_sec ||
-      (load_time_.tv_sec == g_last_update_.tv_sec &&
-       load_time_.tv_usec < g_last_update_.tv_usec)) {
+    if (sync_time_.tv_sec < g_last_update_.tv_sec ||
+      (sync_time_.tv_sec == g_last_update_.tv_sec &&
+       sync_time_.tv_usec < g_last_update_.tv_usec)) {
       // Others updated disk file, have to reload
       pthread_mutex_unlock(&g_mutex_);
       flush_cache();
@@ -529,81 +675,18 @@ size_t UserDict::_get_lpis(const uint16 *splid_str,
   UserDictSearchable searchable;
   prepare_locate(&searchable, splid_str, splid_str_len);
 
-  uint32 max_off = dict_info_.lemma_count;
-#ifdef ___CACHE_ENABLED___
-  int32 middle;
-  uint32 start, count;
-  bool cached = cache_hit(&searchable, &start, &count);
-  if (cached) {
-    middle = start;
-    max_off = start + count;
-  } else {
-    middle = locate_first_in_offsets(&searchable);
-    start = middle;
-  }
-#else
-  int32 middle = locate_first_in_offsets(&searchable);
-#endif
-
-  if (middle == -1) {
-#ifdef ___CACHE_ENABLED___
-    if (!cached)
-      cache_push(USER_DICT_MISS_CACHE, &searchable, 0, 0);
-#endif
-    return 0;
-  }
-
-  size_t lpi_current = 0;
-
-  bool fuzzy_break = false;
-  bool prefix_break = false;
-  while ((size_t)middle < max_off && !fuzzy_break && !prefix_break) {
-    if (lpi_current >= lpi_max)
-      break;
-    uint32 offset = offsets_[middle];
-    // Ignore deleted lemmas
-    if (offset & kUserDictOffsetFlagRemove) {
-      middle++;
-      continue;
-    }
-    uint8 nchar = get_lemma_nchar(offset);
-    uint16 * splids = get_lemma_spell_ids(offset);
-#ifdef ___CACHE_ENABLED___
-    if (!cached && 0 != fuzzy_compare_spell_id(splids, nchar, &searchable)) {
-#else
-    if (0 != fuzzy_compare_spell_id(splids, nchar, &searchable)) {
-#endif
-      fuzzy_break = true;
-    }
-
-    if (prefix_break == false) {
-      if (is_fuzzy_prefix_spell_id(splids, nchar, &searchable)) {
-        if (*need_extend == false &&
-            is_prefix_spell_id(splids, nchar, &searchable)) {
-          *need_extend = true;
-        }
-      } else {
-        prefix_break = true;
-      }
-    }
+  UserDictIndexQuery query;
+  query.searchable = &searchable;
+  query.lemma_str = NULL;
+  query.located = -1;
+  query.lpi_items = lpi_items;
+  query.lpi_max = lpi_max;
+  query.lpi_num = 0;
+  query.prefix_found = false;
+  search_index(&query, 0, dict_info_.lemma_count, 0);
 
-    if (equal_spell_id(splids, nchar, &searchable) == true) {
-      lpi_items[lpi_current].psb = translate_score(scores_[middle]);
-      lpi_items[lpi_current].id = ids_[middle];
-      lpi_items[lpi_current].lma_len = nchar;
-      lpi_current++;
-    }
-    middle++;
-  }
-
-#ifdef ___CACHE_ENABLED___
-  if (!cached) {
-    count = middle - start;
-    cache_push(USER_DICT_CACHE, &searchable, start, count);
-  }
-#endif
-
-  return lpi_current;
+  *need_extend = query.prefix_found;
+  return query.lpi_num;
 }
 
 uint16 UserDict::get_lemma_str(LemmaIdType id_lemma, char16* str_buf,
@@ -689,84 +772,34 @@ size_t UserDict::predict(const char16 last_hzs[], uint16 hzs_len,
 
 int32 UserDict::locate_in_offsets(char16 lemma_str[], uint16 splid_str[],
                                   uint16 lemma_len) {
-  int32 max_off = dict_info_.lemma_count;
+  if (0 == lemma_len || lemma_len > kMaxLemmaSize)
+    return -1;
 
   UserDictSearchable searchable;
   prepare_locate(&searchable, splid_str, lemma_len);
-#ifdef ___CACHE_ENABLED___
-  int32 off;
-  uint32 start, count;
-  bool cached = load_cache(&searchable, &start, &count);
-  if (cached) {
-    off = start;
-    max_off = start + count;
-  } else {
-    off = locate_first_in_offsets(&searchable);
-    start = off;
-  }
-#else
-  int32 off = locate_first_in_offsets(&searchable);
-#endif
-
-  if (off == -1) {
-    return off;
-  }
 
-  while (off < max_off) {
-    uint32 offset = offsets_[off];
-    if (offset & kUserDictOffsetFlagRemove) {
-      off++;
-      continue;
-    }
-    uint16 * splids = get_lemma_spell_ids(offset);
-#ifdef ___CACHE_ENABLED___
-    if (!cached && 0 != fuzzy_compare_spell_id(splids, lemma_len, &searchable))
-      break;
-#else
-    if (0 != fuzzy_compare_spell_id(splids, lemma_len, &searchable))
-      break;
-#endif
-    if (equal_spell_id(splids, lemma_len, &searchable) == true) {
-      uint16 * str = get_lemma_word(offset);
-      uint32 i = 0;
-      for (i = 0; i < lemma_len; i++) {
-        if (str[i] == lemma_str[i])
-          continue;
-        break;
-      }
-      if (i < lemma_len) {
-        off++;
-        continue;
-      }
-#ifdef ___CACHE_ENABLED___
-      // No need to save_cache here, since current function is invoked by
-      // put_lemma. It's rarely possible for a user input same lemma twice.
-      // That means first time user type a new lemma, it is newly added into
-      // user dictionary, then it's possible that user type the same lemma
-      // again.
-      // Another reason save_cache can not be invoked here is this function
-      // aborts when lemma is found, and it never knows the count.
-#endif
-      return off;
-    }
-    off++;
-  }
+  UserDictIndexQuery query;
+  query.searchable = &searchable;
+  query.lemma_str = lemma_str;
+  query.located = -1;
+  query.lpi_items = NULL;
+  query.lpi_max = 0;
+  query.lpi_num = 0;
+  query.prefix_found = false;
+  search_index(&query, 0, dict_info_.lemma_count, 0);
 
-  return -1;
+  return query.located;
 }
 
 #ifdef ___PREDICT_ENABLED___
 uint32 UserDict::locate_where_to_insert_in_predicts(
     const uint16 * words, int lemma_len) {
-  int32 begin = 0;
-  int32 end = dict_info_.lemma_count - 1;
-  int32 middle = end;
-
-  uint32 last_matched = middle;
+  uint32 begin = 0;
+  uint32 end = dict_info_.lemma_count - 1;
 
-  while (begin <= end) {
-    middle = (begin + end) >> 1;
-    uint32 offset = offsets_[middle];
+  while (begin < end) {
+    uint32 middle = (begin + end) >> 1;
+    uint32 offset = predicts_[middle] & kUserDictOffsetMask;
     uint8 nchar = get_lemma_nchar(offset);
     const uint16 * ws = get_lemma_word(offset);
 
@@ -790,18 +823,14 @@ uint32 UserDict::locate_where_to_insert_in_predicts(
         cmp = 1;
     }
 
-    if (cmp < 0) {
+    // Insert after the lemmas with the same words
+    if (cmp <= 0)
       begin = middle + 1;
-      last_matched = middle;
-    } else if (cmp > 0) {
-      end = middle - 1;
-    } else {
-      end = middle - 1;
-      last_matched = middle;
-    }
+    else
+      end = middle;
   }
 
-  return last_matched;
+  return begin;
 }
 
 int32 UserDict::locate_first_in_predicts(const uint16 * words, int lemma_len) {
@@ -813,7 +842,7 @@ int32 UserDict::locate_first_in_predicts(const uint16 * words, int lemma_len) {
 
   while (begin <= end) {
     middle = (begin + end) >> 1;
-    uint32 offset = offsets_[middle];
+    uint32 offset = predicts_[middle] & kUserDictOffsetMask;
     uint8 nchar = get_lemma_nchar(offset);
     const uint16 * ws = get_lemma_word(offset);
 
@@ -931,13 +960,20 @@ void UserDict::remove_lemma_from_sync_list(uint32 offset) {
 #ifdef ___PREDICT_ENABLED___
 void UserDict::remove_lemma_from_predict_list(uint32 offset) {
   offset &= kUserDictOffsetMask;
-  uint32 i = 0;
-  for (; i < dict_info_.lemma_count; i++) {
+  uint8 nchar = get_lemma_nchar(offset);
+  const uint16 * words = get_lemma_word(offset);
+  int32 i = locate_first_in_predicts(words, nchar);
+  if (i == -1)
+    return;
+  // Lemmas with the same words are next to each other
+  for (; (uint32)i < dict_info_.lemma_count; i++) {
     unsigned int off = (predicts_[i] & kUserDictOffsetMask);
     if (off == offset) {
       predicts_[i] |= kUserDictOffsetFlagRemove;
       break;
     }
+    if (compare_words_at(off, offset) != 0)
+      break;
   }
 }
 #endif
@@ -955,6 +991,7 @@ bool UserDict::remove_lemma_by_offset_index(int offset_index) {
   uint32 nchar = get_lemma_nchar(offset);
 
   offsets_[off] |= kUserDictOffsetFlagRemove;
+  log_lemma(UserDictJournal::kOpRemove, offset, 0, 0);
 
 #ifdef ___SYNC_ENABLED___
   // Remove corresponding sync item
@@ -967,8 +1004,8 @@ bool UserDict::remove_lemma_by_offset_index(int offset_index) {
   dict_info_.free_count++;
   dict_info_.free_size += (2 + (nchar << 2));
 
-  if (state_ < USER_DICT_OFFSET_DIRTY)
-    state_ = USER_DICT_OFFSET_DIRTY;
+  mark_lemmas_dirty(USER_DICT_OFFSET_DIRTY);
+  version_++;
   return true;
 }
 
@@ -996,9 +1033,6 @@ void UserDict::flush_cache() {
   close_dict();
   load_dict(file, start_id, kUserDictIdEnd);
   free((void*)file);
-#ifdef ___CACHE_ENABLED___
-  cache_init();
-#endif
   return;
 }
 
@@ -1107,8 +1141,13 @@ bool UserDict::load(const char *file, LemmaIdType start_id) {
 #ifdef ___PREDICT_ENABLED___
   uint32 *predicts = NULL;
 #endif
+  uint32 *splid_index = NULL;
   size_t i;
   int err;
+  // Room for the lemmas which the journal may add.
+  size_t journal_count = 0;
+  size_t journal_size = 0;
+  size_t alloc_count, alloc_size;
 
   err = fseek(fp, -1 * sizeof(dict_info), SEEK_END);
   if (err) goto error;
@@ -1116,17 +1155,22 @@ bool UserDict::load(const char *file, LemmaIdType start_id) {
   readed = fread(&dict_info, 1, sizeof(dict_info), fp);
   if (readed != sizeof(dict_info)) goto error;
 
-  lemmas = (uint8 *)malloc(
-      dict_info.lemma_size +
-      (kUserDictPreAlloc * (2 + (kUserDictAverageNchar << 2))));
+  // Without a journal, the changes are written back on close as before.
+  if (journal_.open(file))
+    journal_.get_replay_size(&journal_count, &journal_size);
+  alloc_count = kUserDictPreAlloc + journal_count;
+  alloc_size = kUserDictPreAlloc * (2 + (kUserDictAverageNchar << 2)) +
+      journal_size;
+
+  lemmas = (uint8 *)malloc(dict_info.lemma_size + alloc_size);
 
   if (!lemmas) goto error;
 
-  offsets = (uint32 *)malloc((dict_info.lemma_count + kUserDictPreAlloc) << 2);
+  offsets = (uint32 *)malloc((dict_info.lemma_count + alloc_count) << 2);
   if (!offsets) goto error;
 
 #ifdef ___PREDICT_ENABLED___
-  predicts = (uint32 *)malloc((dict_info.lemma_count + kUserDictPreAlloc) << 2);
+  predicts = (uint32 *)malloc((dict_info.lemma_count + alloc_count) << 2);
   if (!predicts) goto error;
 #endif
 
@@ -1135,16 +1179,20 @@ bool UserDict::load(const char *file, LemmaIdType start_id) {
   if (!syncs) goto error;
 #endif
 
-  scores = (uint32 *)malloc((dict_info.lemma_count + kUserDictPreAlloc) << 2);
+  scores = (uint32 *)malloc((dict_info.lemma_count + alloc_count) << 2);
   if (!scores) goto error;
 
-  ids = (uint32 *)malloc((dict_info.lemma_count + kUserDictPreAlloc) << 2);
+  ids = (uint32 *)malloc((dict_info.lemma_count + alloc_count) << 2);
   if (!ids) goto error;
 
   offsets_by_id = (uint32 *)malloc(
-      (dict_info.lemma_count + kUserDictPreAlloc) << 2);
+      (dict_info.lemma_count + alloc_count) << 2);
   if (!offsets_by_id) goto error;
 
+  splid_index = (uint32 *)malloc(
+      (dict_info.lemma_count + alloc_count) << 2);
+  if (!splid_index) goto error;
+
   err = fseek(fp, 4, SEEK_SET);
   if (err) goto error;
 
@@ -1207,10 +1255,26 @@ bool UserDict::load(const char *file, LemmaIdType start_id) {
 #ifdef ___PREDICT_ENABLED___
   predicts_ = predicts;
 #endif
-  lemma_count_left_ = kUserDictPreAlloc;
-  lemma_size_left_ = kUserDictPreAlloc * (2 + (kUserDictAverageNchar << 2));
+  splid_index_ = splid_index;
+  lemma_count_left_ = alloc_count;
+  lemma_size_left_ = alloc_size;
+  id_count_ = dict_info.lemma_count;
+  id_count_left_ = alloc_count;
   memcpy(&dict_info_, &dict_info, sizeof(dict_info));
+
+  build_index();
+#ifdef ___PREDICT_ENABLED___
+  // Older versions kept predicts_ out of order, sort it again so that it can
+  // be searched by words. It is written back together with offsets_.
+  for (i = 1; i < dict_info_.lemma_count; i++) {
+    if (compare_words_at(predicts_[i - 1], predicts_[i]) > 0) {
+      sort_by(predicts_, dict_info_.lemma_count, &UserDict::compare_words_at);
+      break;
+    }
+  }
+#endif
   state_ = USER_DICT_SYNC;
+  replay_journal();
 
   fclose(fp);
 
@@ -1229,6 +1293,8 @@ bool UserDict::load(const char *file, LemmaIdType start_id) {
 #ifdef ___PREDICT_ENABLED___
   if (predicts) free(predicts);
 #endif
+  if (splid_index) free(splid_index);
+  journal_.close(NULL, 0);
   fclose(fp);
   pthread_mutex_unlock(&g_mutex_);
   return false;
@@ -1270,6 +1336,124 @@ void UserDict::write_back() {
   state_ = USER_DICT_SYNC;
 }
 
+bool UserDict::grow_buffers() {
+  // Grow by a quarter, so that a large dictionary is not copied too often.
+  size_t count = dict_info_.lemma_count / 4;
+  if (count < kUserDictPreAlloc)
+    count = kUserDictPreAlloc;
+  size_t size = count * (2 + (kUserDictAverageNchar << 2));
+
+  size_t count_capacity = (dict_info_.lemma_count + lemma_count_left_ + count)
+      << 2;
+  uint8 * lemmas = (uint8 *)realloc(
+      lemmas_, dict_info_.lemma_size + lemma_size_left_ + size);
+  if (!lemmas)
+    return false;
+  lemmas_ = lemmas;
+
+  // A buffer which is grown is just larger than needed if a later one
+  // can't be grown.
+  uint32 ** buffers[] = {
+    &offsets_, &scores_, &ids_, &splid_index_,
+#ifdef ___PREDICT_ENABLED___
+    &predicts_,
+#endif
+  };
+  for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+    uint32 * buffer = (uint32 *)realloc(*buffers[i], count_capacity);
+    if (!buffer)
+      return false;
+    *buffers[i] = buffer;
+  }
+  lemma_count_left_ += count;
+  lemma_size_left_ += size;
+
+  // offsets_by_id_ also has the ids of the lemmas dropped by compact()
+  uint32 * offsets_by_id = (uint32 *)realloc(
+      offsets_by_id_, (id_count_ + id_count_left_ + count) << 2);
+  if (!offsets_by_id)
+    return false;
+  offsets_by_id_ = offsets_by_id;
+  id_count_left_ += count;
+  return true;
+}
+
+uint8 * UserDict::build_image(size_t *size) {
+  *size = get_dict_file_size(&dict_info_);
+  uint8 * image = (uint8 *)malloc(*size);
+  if (!image)
+    return NULL;
+
+  uint8 * p = image;
+  uint32 version = kUserDictVersion;
+  memcpy(p, &version, 4);
+  p += 4;
+  memcpy(p, lemmas_, dict_info_.lemma_size);
+  p += dict_info_.lemma_size;
+  memcpy(p, offsets_, dict_info_.lemma_count << 2);
+  p += dict_info_.lemma_count << 2;
+#ifdef ___PREDICT_ENABLED___
+  memcpy(p, predicts_, dict_info_.lemma_count << 2);
+  p += dict_info_.lemma_count << 2;
+#endif
+  memcpy(p, scores_, dict_info_.lemma_count << 2);
+  p += dict_info_.lemma_count << 2;
+#ifdef ___SYNC_ENABLED___
+  memcpy(p, syncs_, dict_info_.sync_count << 2);
+  p += dict_info_.sync_count << 2;
+#endif
+  memcpy(p, &dict_info_, sizeof(dict_info_));
+  return image;
+}
+
+void UserDict::log_lemma(uint8 op, uint32 offset, uint32 score, uint8 flags) {
+  if (!journal_.is_open())
+    return;
+  journal_.append(op, flags, score, dict_info_.total_nfreq,
+                  get_lemma_nchar(offset), get_lemma_spell_ids(offset),
+                  get_lemma_word(offset));
+
+  // Only copying the dictionary is done here, the thread writes it.
+  if (journal_.need_compact()) {
+    size_t image_size;
+    uint8 * image = build_image(&image_size);
+    if (image)
+      journal_.compact(image, image_size);
+  }
+}
+
+void UserDict::replay_journal() {
+  const UserDictJournal::Record * record;
+  while ((record = journal_.next_record()) != NULL) {
+    uint16 * splids = (uint16 *)UserDictJournal::get_splids(record);
+    char16 * lemma_str = (char16 *)UserDictJournal::get_lemma(record);
+    int32 off = locate_in_offsets(lemma_str, splids, record->nchar);
+
+    if (record->op == UserDictJournal::kOpRemove) {
+      if (off != -1)
+        remove_lemma_by_offset_index(off);
+    } else {
+      if (off == -1) {
+        if (append_a_lemma(lemma_str, splids, record->nchar,
+                           extract_score_freq(record->score),
+                           extract_score_lmt(record->score)) == 0)
+          continue;
+        off = locate_in_offsets(lemma_str, splids, record->nchar);
+        if (off == -1)
+          continue;
+      }
+      scores_[off] = record->score;
+#ifdef ___SYNC_ENABLED___
+      if (record->flags & UserDictJournal::kFlagSync)
+        queue_lemma_for_sync(ids_[off]);
+#endif
+    }
+    // The records have the state after the change, so it doesn't matter
+    // whether the change is in the dictionary file already.
+    dict_info_.total_nfreq = record->total_nfreq;
+  }
+}
+
 #ifdef ___SYNC_ENABLED___
 void UserDict::write_back_sync(int fd) {
   int err = lseek(fd, 4 + dict_info_.lemma_size
@@ -1358,233 +1542,97 @@ void UserDict::write_back_all(int fd) {
   write(fd, &dict_info_, sizeof(dict_info_));
 }
 
-#ifdef ___CACHE_ENABLED___
-bool UserDict::load_cache(UserDictSearchable *searchable,
-                          uint32 *offset, uint32 *length) {
-  UserDictCache *cache = &caches_[searchable->splids_len - 1];
-  if (cache->head == cache->tail)
-    return false;
-
-  uint16 j, sig_len = kMaxLemmaSize / 4;
-  uint16 i = cache->head;
-  while (1) {
-    j = 0;
-    for (; j < sig_len; j++) {
-      if (cache->signatures[i][j] != searchable->signature[j])
-        break;
-    }
-    if (j < sig_len) {
-      i++;
-      if (i >= kUserDictCacheSize)
-        i -= kUserDictCacheSize;
-      if (i == cache->tail)
-        break;
-      continue;
-    }
-    *offset = cache->offsets[i];
-    *length = cache->lengths[i];
-    return true;
-  }
-  return false;
-}
-
-void UserDict::save_cache(UserDictSearchable *searchable,
-                          uint32 offset, uint32 length) {
-  UserDictCache *cache = &caches_[searchable->splids_len - 1];
-  uint16 next = cache->tail;
-
-  cache->offsets[next] = offset;
-  cache->lengths[next] = length;
-  uint16 sig_len = kMaxLemmaSize / 4;
-  uint16 j = 0;
-  for (; j < sig_len; j++) {
-    cache->signatures[next][j] = searchable->signature[j];
-  }
-
-  if (++next >= kUserDictCacheSize) {
-    next -= kUserDictCacheSize;
-  }
-  if (next == cache->head) {
-    cache->head++;
-    if (cache->head >= kUserDictCacheSize) {
-      cache->head -= kUserDictCacheSize;
-    }
-  }
-  cache->tail = next;
-}
-
-void UserDict::reset_cache() {
-  memset(caches_, 0, sizeof(caches_));
-}
-
-bool UserDict::load_miss_cache(UserDictSearchable *searchable) {
-  UserDictMissCache *cache = &miss_caches_[searchable->splids_len - 1];
-  if (cache->head == cache->tail)
-    return false;
-
-  uint16 j, sig_len = kMaxLemmaSize / 4;
-  uint16 i = cache->head;
-  while (1) {
-    j = 0;
-    for (; j < sig_len; j++) {
-      if (cache->signatures[i][j] != searchable->signature[j])
-        break;
-    }
-    if (j < sig_len) {
-      i++;
-      if (i >= kUserDictMissCacheSize)
-        i -= kUserDictMissCacheSize;
-      if (i == cache->tail)
-        break;
-      continue;
-    }
-    return true;
-  }
-  return false;
-}
-
-void UserDict::save_miss_cache(UserDictSearchable *searchable) {
-  UserDictMissCache *cache = &miss_caches_[searchable->splids_len - 1];
-  uint16 next = cache->tail;
-
-  uint16 sig_len = kMaxLemmaSize / 4;
-  uint16 j = 0;
-  for (; j < sig_len; j++) {
-    cache->signatures[next][j] = searchable->signature[j];
-  }
-
-  if (++next >= kUserDictMissCacheSize) {
-    next -= kUserDictMissCacheSize;
-  }
-  if (next == cache->head) {
-    cache->head++;
-    if (cache->head >= kUserDictMissCacheSize) {
-      cache->head -= kUserDictMissCacheSize;
-    }
-  }
-  cache->tail = next;
-}
-
-void UserDict::reset_miss_cache() {
-  memset(miss_caches_, 0, sizeof(miss_caches_));
-}
-
-void UserDict::cache_init() {
-  reset_cache();
-  reset_miss_cache();
-}
-
-bool UserDict::cache_hit(UserDictSearchable *searchable,
-                         uint32 *offset, uint32 *length) {
-  bool hit = load_miss_cache(searchable);
-  if (hit) {
-    *offset = 0;
-    *length = 0;
-    return true;
-  }
-  hit = load_cache(searchable, offset, length);
-  if (hit) {
-    return true;
+uint32 UserDict::move_offset(const UserDictMovedRun * runs, uint32 run_num,
+                             uint32 offset) {
+  // Find the last run which begins at or before offset
+  uint32 begin = 0;
+  uint32 end = run_num;
+  while (begin < end) {
+    uint32 middle = (begin + end) >> 1;
+    if (runs[middle].begin <= offset)
+      begin = middle + 1;
+    else
+      end = middle;
   }
-  return false;
+  if (begin > 0 && offset < runs[begin - 1].end)
+    return offset - runs[begin - 1].shift;
+  return offset;
 }
 
-void UserDict::cache_push(UserDictCacheType type,
-                         UserDictSearchable *searchable,
-                         uint32 offset, uint32 length) {
-  switch (type) {
-    case USER_DICT_MISS_CACHE:
-      save_miss_cache(searchable);
-      break;
-    case USER_DICT_CACHE:
-      save_cache(searchable, offset, length);
-      break;
-    default:
-      break;
-  }
+void UserDict::defragment(void) {
+  compact(true);
 }
 
-#endif
-
-void UserDict::defragment(void) {
+void UserDict::compact(bool renumber_ids) {
 #ifdef ___DEBUG_PERF___
   DEBUG_PERF_BEGIN;
 #endif
   if (is_valid_state() == false)
     return;
-  // Fixup offsets_, set REMOVE flag to lemma's flag if needed
-  size_t first_freed = 0;
-  size_t first_inuse = 0;
-  while (first_freed < dict_info_.lemma_count) {
-    // Find first freed offset
-    while ((offsets_[first_freed] & kUserDictOffsetFlagRemove) == 0 &&
-            first_freed < dict_info_.lemma_count) {
-      first_freed++;
-    }
-    if (first_freed < dict_info_.lemma_count) {
-      // Save REMOVE flag to lemma flag
-      int off = offsets_[first_freed];
-      set_lemma_flag(off, kUserDictLemmaFlagRemove);
-    } else {
-      break;
+  struct timeval pause_begin;
+  gettimeofday(&pause_begin, NULL);
+  // The ids of the lemmas being reclaimed are going to change
+  if (renumber_ids)
+    end_reclaim();
+  // Each run moved is preceded by a removed lemma
+  UserDictMovedRun * runs = (UserDictMovedRun *)malloc(
+      sizeof(UserDictMovedRun) * (dict_info_.lemma_count + 1));
+  if (!runs)
+    return;
+  uint32 run_num = 0;
+  // Fixup splid_index_ first. Lemmas in use keep their order in offsets_, so
+  // the new position of a lemma is the number of lemmas in use before it.
+  bool index_fixed = false;
+  uint32 * ranks = (uint32 *)malloc((dict_info_.lemma_count + 1) << 2);
+  if (ranks) {
+    uint32 rank = 0;
+    for (uint32 i = 0; i < dict_info_.lemma_count; i++) {
+      ranks[i] = rank;
+      if ((offsets_[i] & kUserDictOffsetFlagRemove) == 0)
+        rank++;
     }
-    // Find first inuse offse after first_freed
-    first_inuse = first_freed + 1;
-    while ((offsets_[first_inuse] & kUserDictOffsetFlagRemove) &&
-           (first_inuse < dict_info_.lemma_count)) {
-      // Save REMOVE flag to lemma flag
-      int off = offsets_[first_inuse];
-      set_lemma_flag(off, kUserDictLemmaFlagRemove);
-      first_inuse++;
+    uint32 n = 0;
+    for (uint32 i = 0; i < dict_info_.lemma_count; i++) {
+      uint32 pos = splid_index_[i];
+      if ((offsets_[pos] & kUserDictOffsetFlagRemove) == 0)
+        splid_index_[n++] = ranks[pos];
     }
-    if (first_inuse >= dict_info_.lemma_count) {
-      break;
+    free(ranks);
+    index_fixed = true;
+  }
+  // Fixup offsets_, set REMOVE flag to lemma's flag if needed. Lemmas in use
+  // are moved down in one pass, keeping their order. A reclaim in progress
+  // goes on from the same lemma.
+  uint32 inuse = 0;
+  uint32 reclaim_pos = reclaim_pos_;
+  for (uint32 i = 0; i < dict_info_.lemma_count; i++) {
+    if (i == reclaim_pos_)
+      reclaim_pos = inuse;
+    if (offsets_[i] & kUserDictOffsetFlagRemove) {
+      set_lemma_flag(offsets_[i], kUserDictLemmaFlagRemove);
+      if (!renumber_ids)
+        offsets_by_id_[ids_[i] - start_id_] |= kUserDictOffsetFlagRemove;
+      continue;
     }
-    // Swap offsets_
-    int tmp = offsets_[first_inuse];
-    offsets_[first_inuse] = offsets_[first_freed];
-    offsets_[first_freed] = tmp;
-    // Move scores_, no need to swap
-    tmp = scores_[first_inuse];
-    scores_[first_inuse] = scores_[first_freed];
-    scores_[first_freed] = tmp;
-    // Swap ids_
-    LemmaIdType tmpid = ids_[first_inuse];
-    ids_[first_inuse] = ids_[first_freed];
-    ids_[first_freed] = tmpid;
-    // Go on
-    first_freed++;
-  }
+    offsets_[inuse] = offsets_[i];
+    scores_[inuse] = scores_[i];
+    ids_[inuse] = ids_[i];
+    inuse++;
+  }
+  if (reclaim_pos_ >= dict_info_.lemma_count)
+    reclaim_pos = inuse;
+  reclaim_pos_ = reclaim_pos;
 #ifdef ___PREDICT_ENABLED___
   // Fixup predicts_
-  first_freed = 0;
-  first_inuse = 0;
-  while (first_freed < dict_info_.lemma_count) {
-    // Find first freed offset
-    while ((predicts_[first_freed] & kUserDictOffsetFlagRemove) == 0 &&
-            first_freed < dict_info_.lemma_count) {
-      first_freed++;
-    }
-    if (first_freed >= dict_info_.lemma_count)
-      break;
-    // Find first inuse offse after first_freed
-    first_inuse = first_freed + 1;
-    while ((predicts_[first_inuse] & kUserDictOffsetFlagRemove)
-           && (first_inuse < dict_info_.lemma_count)) {
-      first_inuse++;
-    }
-    if (first_inuse >= dict_info_.lemma_count) {
-      break;
-    }
-    // Swap offsets_
-    int tmp = predicts_[first_inuse];
-    predicts_[first_inuse] = predicts_[first_freed];
-    predicts_[first_freed] = tmp;
-    // Go on
-    first_freed++;
+  uint32 predict_inuse = 0;
+  for (uint32 i = 0; i < dict_info_.lemma_count; i++) {
+    if ((predicts_[i] & kUserDictOffsetFlagRemove) == 0)
+      predicts_[predict_inuse++] = predicts_[i];
   }
 #endif
-  dict_info_.lemma_count = first_freed;
+  dict_info_.lemma_count = inuse;
+  if (!index_fixed)
+    build_index();
   // Fixup lemmas_
   size_t begin = 0;
   size_t end = 0;
@@ -1601,8 +1649,10 @@ void UserDict::defragment(void) {
     }
     break;
   }
-  if (dst >= real_size)
+  if (dst >= real_size) {
+    free(runs);
     return;
+  }
 
   end = dst;
   while (end < real_size) {
@@ -1628,26 +1678,27 @@ void UserDict::defragment(void) {
       break;
     }
     memmove(lemmas_ + dst, lemmas_ + begin, end - begin);
-    for (size_t j = 0; j < dict_info_.lemma_count; j++) {
-      if (offsets_[j] >= begin && offsets_[j] < end) {
-        offsets_[j] -= (begin - dst);
-        offsets_by_id_[ids_[j] - start_id_] = offsets_[j];
-      }
+    runs[run_num].begin = begin;
+    runs[run_num].end = end;
+    runs[run_num].shift = begin - dst;
+    run_num++;
+    dst += (end - begin);
+  }
+
+  // Fix up the offsets after all runs are moved, so that each offset is
+  // looked up once instead of being checked against every run.
+  for (size_t j = 0; j < dict_info_.lemma_count; j++) {
+    offsets_[j] = move_offset(runs, run_num, offsets_[j]);
 #ifdef ___PREDICT_ENABLED___
-      if (predicts_[j] >= begin && predicts_[j] < end) {
-        predicts_[j] -= (begin - dst);
-      }
+    predicts_[j] = move_offset(runs, run_num, predicts_[j]);
 #endif
-    }
+  }
 #ifdef ___SYNC_ENABLED___
-    for (size_t j = 0; j < dict_info_.sync_count; j++) {
-      if (syncs_[j] >= begin && syncs_[j] < end) {
-        syncs_[j] -= (begin - dst);
-      }
-    }
-#endif
-    dst += (end - begin);
+  for (size_t j = 0; j < dict_info_.sync_count; j++) {
+    syncs_[j] = move_offset(runs, run_num, syncs_[j]);
   }
+#endif
+  free(runs);
 
   dict_info_.free_count = 0;
   dict_info_.free_size = 0;
@@ -1655,26 +1706,35 @@ void UserDict::defragment(void) {
   lemma_size_left_ = total_size - dict_info_.lemma_size;
   lemma_count_left_ = total_count - dict_info_.lemma_count;
 
-  // XXX Without following code,
-  // offsets_by_id_ is not reordered.
-  // That's to say, all removed lemmas' ids are not collected back.
-  // There may not be room for addition of new lemmas due to
-  // offsests_by_id_ reason, although lemma_size_left_ is fixed.
-  // By default, we do want defrag as fast as possible, because
-  // during defrag procedure, other peers can not write new lemmas
-  // to user dictionary file.
-  // XXX If write-back is invoked immediately after
-  // this defragment, no need to fix up following in-mem data.
-  for (uint32 i = 0; i < dict_info_.lemma_count; i++) {
-    ids_[i] = start_id_ + i;
-    offsets_by_id_[i] = offsets_[i];
+  if (renumber_ids) {
+    // XXX Without following code,
+    // offsets_by_id_ is not reordered.
+    // That's to say, all removed lemmas' ids are not collected back.
+    // There may not be room for addition of new lemmas due to
+    // offsests_by_id_ reason, although lemma_size_left_ is fixed.
+    // By default, we do want defrag as fast as possible, because
+    // during defrag procedure, other peers can not write new lemmas
+    // to user dictionary file.
+    // XXX If write-back is invoked immediately after
+    // this defragment, no need to fix up following in-mem data.
+    for (uint32 i = 0; i < dict_info_.lemma_count; i++) {
+      ids_[i] = start_id_ + i;
+      offsets_by_id_[i] = offsets_[i];
+    }
+    id_count_left_ += id_count_ - dict_info_.lemma_count;
+    id_count_ = dict_info_.lemma_count;
+  } else {
+    for (uint32 i = 0; i < dict_info_.lemma_count; i++)
+      offsets_by_id_[ids_[i] - start_id_] = offsets_[i];
   }
 
   state_ = USER_DICT_DEFRAGMENTED;
+  version_++;
+  record_pause(&pause_begin);
 
 #ifdef ___DEBUG_PERF___
   DEBUG_PERF_END;
-  LOGD_PERF("defragment");
+  LOGD_PERF("compact");
 #endif
 }
 
@@ -1713,8 +1773,9 @@ LemmaIdType UserDict::put_lemma_no_sync(char16 lemma_str[], uint16 splids[],
             > dict_info_.limit_lemma_size)) {
       // XXX Always reclaim and defrag in sync code path
       //     sync thread is background thread and ok with heavy work
+      // The ids are kept, as the decoder may be searching at the same time.
       reclaim();
-      defragment();
+      compact(false);
       flush_cache();
       again = 1;
       goto begin;
@@ -1940,6 +2001,8 @@ bool UserDict::state(UserDictStat * stat) {
   stat->limit_lemma_count = dict_info_.limit_lemma_count;
   stat->limit_lemma_size = dict_info_.limit_lemma_size;
   stat->reclaim_ratio = dict_info_.reclaim_ratio;
+  stat->journal_size = journal_.size();
+  stat->max_pause_us = max_pause_us_;
   return true;
 }
 
@@ -1967,57 +2030,116 @@ void UserDict::reclaim() {
       break;
   }
 
-  // XXX Reclaim is only based on count, not size
-  uint32 count = dict_info_.lemma_count;
-  int rc = count * dict_info_.reclaim_ratio / 100;
-
-  UserDictScoreOffsetPair * score_offset_pairs = NULL;
-  score_offset_pairs = (UserDictScoreOffsetPair *)malloc(
-      sizeof(UserDictScoreOffsetPair) * rc);
-  if (score_offset_pairs == NULL) {
-    return;
+  // Start over, as the reclaim in progress may have been for fewer lemmas
+  end_reclaim();
+  while (reclaim_step()) {
   }
+}
 
-  for (int i = 0; i < rc; i++) {
-    int s = scores_[i];
-    score_offset_pairs[i].score = s;
-    score_offset_pairs[i].offset_index = i;
-  }
+inline bool UserDict::is_limit_reached(uint16 lemma_len) {
+  uint32 count = dict_info_.lemma_count - dict_info_.free_count;
+  uint32 size = dict_info_.lemma_size - dict_info_.free_size;
+  return (dict_info_.limit_lemma_count > 0 &&
+          count >= dict_info_.limit_lemma_count)
+      || (dict_info_.limit_lemma_size > 0 &&
+          size + (2 + (lemma_len << 2)) > dict_info_.limit_lemma_size);
+}
 
-  for (int i = (rc + 1) / 2; i >= 0; i--)
-    shift_down(score_offset_pairs, i, rc);
+bool UserDict::reclaim_step() {
+  if (is_valid_state() == false)
+    return false;
 
-  for (uint32 i = rc; i < dict_info_.lemma_count; i++) {
-    int s = scores_[i];
-    if (s < score_offset_pairs[0].score) {
-      score_offset_pairs[0].score = s;
-      score_offset_pairs[0].offset_index = i;
-      shift_down(score_offset_pairs, 0, rc);
-    }
+  struct timeval begin;
+  gettimeofday(&begin, NULL);
+
+  if (reclaim_heap_ == NULL) {
+    if (dict_info_.reclaim_ratio == 0)
+      return false;
+    // XXX Reclaim is only based on count, not size
+    uint32 count = dict_info_.lemma_count - dict_info_.free_count;
+    uint32 rc = count * dict_info_.reclaim_ratio / 100;
+    if (rc == 0)
+      rc = count;
+    if (rc == 0)
+      return false;
+    reclaim_heap_ = (UserDictScoreIdPair *)malloc(
+        sizeof(UserDictScoreIdPair) * rc);
+    if (reclaim_heap_ == NULL)
+      return false;
+    reclaim_num_ = rc;
+    reclaim_heap_size_ = 0;
+    reclaim_pos_ = 0;
   }
 
-  for (int i = 0; i < rc; i++) {
-    int off = score_offset_pairs[i].offset_index;
-    remove_lemma_by_offset_index(off);
+  if (reclaim_pos_ < dict_info_.lemma_count) {
+    uint32 end = reclaim_pos_ + kUserDictReclaimScanStep;
+    if (end > dict_info_.lemma_count)
+      end = dict_info_.lemma_count;
+    for (; reclaim_pos_ < end; reclaim_pos_++) {
+      if (offsets_[reclaim_pos_] & kUserDictOffsetFlagRemove)
+        continue;
+      int s = scores_[reclaim_pos_];
+      if (reclaim_heap_size_ < reclaim_num_) {
+        reclaim_heap_[reclaim_heap_size_].score = s;
+        reclaim_heap_[reclaim_heap_size_].id = ids_[reclaim_pos_];
+        reclaim_heap_size_++;
+        if (reclaim_heap_size_ == reclaim_num_) {
+          for (int i = reclaim_num_ / 2; i >= 0; i--)
+            shift_down(reclaim_heap_, i, reclaim_num_);
+        }
+      } else if (s < reclaim_heap_[0].score) {
+        reclaim_heap_[0].score = s;
+        reclaim_heap_[0].id = ids_[reclaim_pos_];
+        shift_down(reclaim_heap_, 0, reclaim_num_);
+      }
+    }
+    if (reclaim_pos_ < dict_info_.lemma_count) {
+      record_pause(&begin);
+      return true;
+    }
   }
-  if (rc > 0) {
-    if (state_ < USER_DICT_OFFSET_DIRTY)
-      state_ = USER_DICT_OFFSET_DIRTY;
+
+  // A lemma removed since it was looked at is not found again
+  for (uint32 i = 0; i < kUserDictReclaimRemoveStep &&
+       reclaim_heap_size_ > 0; i++) {
+    reclaim_heap_size_--;
+    remove_lemma(reclaim_heap_[reclaim_heap_size_].id);
   }
 
-  free(score_offset_pairs);
+  bool more = reclaim_heap_size_ > 0;
+  if (!more)
+    end_reclaim();
+  record_pause(&begin);
+  return more;
+}
+
+void UserDict::end_reclaim() {
+  free(reclaim_heap_);
+  reclaim_heap_ = NULL;
+  reclaim_num_ = 0;
+  reclaim_heap_size_ = 0;
+  reclaim_pos_ = 0;
+}
+
+void UserDict::record_pause(const struct timeval *begin) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  int64 us = (int64)(now.tv_sec - begin->tv_sec) * 1000000 +
+      (now.tv_usec - begin->tv_usec);
+  if (us > (int64)max_pause_us_)
+    max_pause_us_ = (uint32)us;
 }
 
-inline void UserDict::swap(UserDictScoreOffsetPair * sop, int i, int j) {
-  int s = sop[i].score;
-  int p = sop[i].offset_index;
-  sop[i].score = sop[j].score;
-  sop[i].offset_index = sop[j].offset_index;
-  sop[j].score = s;
-  sop[j].offset_index = p;
+inline void UserDict::swap(UserDictScoreIdPair * sip, int i, int j) {
+  int s = sip[i].score;
+  LemmaIdType id = sip[i].id;
+  sip[i].score = sip[j].score;
+  sip[i].id = sip[j].id;
+  sip[j].score = s;
+  sip[j].id = id;
 }
 
-void UserDict::shift_down(UserDictScoreOffsetPair * sop, int i, int n) {
+void UserDict::shift_down(UserDictScoreIdPair * sip, int i, int n) {
   int par = i;
   while (par < n) {
     int left = par * 2 + 1;
@@ -2025,19 +2147,19 @@ void UserDict::shift_down(UserDictScoreOffsetPair * sop, int i, int n) {
     if (left >= n && right >= n)
       break;
     if (right >= n) {
-      if (sop[left].score > sop[par].score) {
-        swap(sop, left, par);
+      if (sip[left].score > sip[par].score) {
+        swap(sip, left, par);
         par = left;
         continue;
       }
-    } else if (sop[left].score > sop[right].score &&
-               sop[left].score > sop[par].score) {
-      swap(sop, left, par);
+    } else if (sip[left].score > sip[right].score &&
+               sip[left].score > sip[par].score) {
+      swap(sip, left, par);
       par = left;
       continue;
-    } else if (sop[right].score > sop[left].score &&
-               sop[right].score > sop[par].score) {
-      swap(sop, right, par);
+    } else if (sip[right].score > sip[left].score &&
+               sip[right].score > sip[par].score) {
+      swap(sip, right, par);
       par = right;
       continue;
     }
@@ -2059,47 +2181,65 @@ LemmaIdType UserDict::_put_lemma(char16 lemma_str[], uint16 splids[],
     return 0;
   int32 off = locate_in_offsets(lemma_str, splids, lemma_len);
   if (off != -1) {
-    int delta_score = count - scores_[off];
+    // The score also has the last modified time, only the frequency counts
+    int delta_score = count - extract_score_freq(scores_[off]);
     dict_info_.total_nfreq += delta_score;
     scores_[off] = build_score(lmt, count);
-    if (state_ < USER_DICT_SCORE_DIRTY)
-      state_ = USER_DICT_SCORE_DIRTY;
+    mark_lemmas_dirty(USER_DICT_SCORE_DIRTY);
+    log_lemma(UserDictJournal::kOpPut, offsets_[off], scores_[off], 0);
+    version_++;
 #ifdef ___DEBUG_PERF___
     DEBUG_PERF_END;
     LOGD_PERF("_put_lemma(update)");
 #endif
     return ids_[off];
   } else {
-    if ((dict_info_.limit_lemma_count > 0 &&
-        dict_info_.lemma_count >= dict_info_.limit_lemma_count)
-        || (dict_info_.limit_lemma_size > 0 &&
-            dict_info_.lemma_size + (2 + (lemma_len << 2))
-            > dict_info_.limit_lemma_size)) {
-      // XXX Don't defragment here, it's too time-consuming.
+    // Reclaim a step for each new lemma rather than all at once, so that
+    // typing is not stalled. The lemma is dropped while there is no room.
+    if (reclaim_heap_ != NULL || is_limit_reached(lemma_len))
+      reclaim_step();
+    if (is_limit_reached(lemma_len))
       return 0;
-    }
     int flushed = 0;
-    if (lemma_count_left_ == 0 ||
+    // Drop the removed lemmas before the buffers grow, if they are a quarter
+    // or more of the dictionary, so that the buffers only grow with the
+    // lemmas in use.
+    if ((lemma_count_left_ == 0 || id_count_left_ == 0 ||
+         lemma_size_left_ < (size_t)(2 + (lemma_len << 2))) &&
+        dict_info_.free_count > 0 &&
+        dict_info_.free_count * 4 >= dict_info_.lemma_count)
+      compact(false);
+    if (lemma_count_left_ == 0 || id_count_left_ == 0 ||
         lemma_size_left_ < (size_t)(2 + (lemma_len << 2))) {
 
-      // XXX When there is no space for new lemma, we flush to disk
-      // flush_cache() may be called by upper user
-      // and better place shoule be found instead of here
-      flush_cache();
-      flushed = 1;
-      // Or simply return and do nothing
-      // return 0;
+      // The journal has the lemmas on disk already, so the buffers are grown
+      // instead, without waiting for the journal thread.
+      if (!journal_.is_open() || !grow_buffers()) {
+        // XXX When there is no space for new lemma, we flush to disk
+        // flush_cache() may be called by upper user
+        // and better place shoule be found instead of here
+        flush_cache();
+        flushed = 1;
+        // Or simply return and do nothing
+        // return 0;
+      }
     }
 #ifdef ___DEBUG_PERF___
     DEBUG_PERF_END;
     LOGD_PERF(flushed ? "_put_lemma(flush+add)" : "_put_lemma(add)");
 #endif
     LemmaIdType id = append_a_lemma(lemma_str, splids, lemma_len, count, lmt);
+    uint8 flags = 0;
 #ifdef ___SYNC_ENABLED___
     if (syncs_ && id != 0) {
       queue_lemma_for_sync(id);
+      flags = UserDictJournal::kFlagSync;
     }
 #endif
+    if (id != 0) {
+      log_lemma(UserDictJournal::kOpPut, offsets_by_id_[id - start_id_],
+                build_score(lmt, count), flags);
+    }
     return id;
   }
   return 0;
@@ -2150,15 +2290,18 @@ LemmaIdType UserDict::update_lemma(LemmaIdType lemma_id, int16 delta_count,
       lmt = time(NULL);
     }
     scores_[off] = build_score(lmt, count);
-    if (state_ < USER_DICT_SCORE_DIRTY)
-      state_ = USER_DICT_SCORE_DIRTY;
+    mark_lemmas_dirty(USER_DICT_SCORE_DIRTY);
+    version_++;
 #ifdef ___DEBUG_PERF___
     DEBUG_PERF_END;
     LOGD_PERF("update_lemma");
 #endif
+    uint8 flags = 0;
 #ifdef ___SYNC_ENABLED___
     queue_lemma_for_sync(ids_[off]);
+    flags = UserDictJournal::kFlagSync;
 #endif
+    log_lemma(UserDictJournal::kOpPut, offsets_[off], scores_[off], flags);
     return ids_[off];
   }
   return 0;
@@ -2169,14 +2312,31 @@ size_t UserDict::get_total_lemma_count() {
 }
 
 void UserDict::set_total_lemma_count_of_others(size_t count) {
+  // The scores of all lemmas depend on it.
+  if (total_other_nfreq_ != static_cast<uint32>(count))
+    version_++;
   total_other_nfreq_ = count;
 }
 
+uint32 UserDict::get_version() {
+  // Like _get_lpis(), reload first if others updated the disk file, so that
+  // the caller sees the new version.
+  if (is_valid_state() && 0 == pthread_mutex_trylock(&g_mutex_)) {
+    bool updated = sync_time_.tv_sec < g_last_update_.tv_sec ||
+        (sync_time_.tv_sec == g_last_update_.tv_sec &&
+         sync_time_.tv_usec < g_last_update_.tv_usec);
+    pthread_mutex_unlock(&g_mutex_);
+    if (updated)
+      flush_cache();
+  }
+  return version_;
+}
+
 LemmaIdType UserDict::append_a_lemma(char16 lemma_str[], uint16 splids[],
                                    uint16 lemma_len, uint16 count, uint64 lmt) {
   LemmaIdType id = get_max_lemma_id() + 1;
   size_t offset = dict_info_.lemma_size;
-  if (offset > kUserDictOffsetMask)
+  if (offset > kUserDictOffsetMask || id > end_id_)
     return 0;
 
   lemmas_[offset] = 0;
@@ -2195,6 +2355,8 @@ LemmaIdType UserDict::append_a_lemma(char16 lemma_str[], uint16 splids[],
 #endif
 
   offsets_by_id_[id - start_id_] = offset;
+  id_count_++;
+  id_count_left_--;
 
   dict_info_.lemma_count++;
   dict_info_.lemma_size += (2 + (lemma_len << 2));
@@ -2206,16 +2368,7 @@ LemmaIdType UserDict::append_a_lemma(char16 lemma_str[], uint16 splids[],
   UserDictSearchable searchable;
   prepare_locate(&searchable, splids, lemma_len);
 
-  size_t i = 0;
-  while (i < off) {
-    offset = offsets_[i];
-    uint32 nchar = get_lemma_nchar(offset);
-    uint16 * spl = get_lemma_spell_ids(offset);
-
-    if (0 <= fuzzy_compare_spell_id(spl, nchar, &searchable))
-      break;
-    i++;
-  }
+  uint32 i = locate_where_to_insert_in_offsets(&searchable, off);
   if (i != off) {
     uint32 temp = offsets_[off];
     memmove(offsets_ + i + 1, offsets_ + i, (off - i) << 2);
@@ -2229,6 +2382,7 @@ LemmaIdType UserDict::append_a_lemma(char16 lemma_str[], uint16 splids[],
     memmove(ids_ + i + 1, ids_ + i, (off - i) << 2);
     ids_[i] = temp;
   }
+  insert_to_index(i);
 
 #ifdef ___PREDICT_ENABLED___
   uint32 j = 0;
@@ -2241,12 +2395,8 @@ LemmaIdType UserDict::append_a_lemma(char16 lemma_str[], uint16 splids[],
   }
 #endif
 
-  if (state_ < USER_DICT_LEMMA_DIRTY)
-    state_ = USER_DICT_LEMMA_DIRTY;
-
-#ifdef ___CACHE_ENABLED___
-  cache_init();
-#endif
+  mark_lemmas_dirty(USER_DICT_LEMMA_DIRTY);
+  version_++;
 
   dict_info_.total_nfreq += count;
   return id;
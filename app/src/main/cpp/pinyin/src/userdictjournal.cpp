@@ -0,0 +1,528 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "userdictjournal.h"
+
+namespace ime_pinyin {
+
+// Write all of buf to fd, at the end of the file if fd is opened with
+// O_APPEND.
+static bool write_all(int fd, const uint8 *buf, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd, buf, size);
+    if (written < 0) {
+      if (EINTR == errno)
+        continue;
+      return false;
+    }
+    buf += written;
+    size -= written;
+  }
+  return true;
+}
+
+static bool read_all(int fd, uint8 *buf, size_t size, off_t pos) {
+  while (size > 0) {
+    ssize_t readed = pread(fd, buf, size, pos);
+    if (readed < 0) {
+      if (EINTR == errno)
+        continue;
+      return false;
+    }
+    if (0 == readed)
+      return false;
+    buf += readed;
+    size -= readed;
+    pos += readed;
+  }
+  return true;
+}
+
+// Write buf to a new file, and sync it before it is renamed.
+static bool write_file(const char *file, const uint8 *buf, size_t size) {
+  int fd = ::open(file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0)
+    return false;
+  bool ok = write_all(fd, buf, size) && 0 == fsync(fd);
+  if (0 != ::close(fd))
+    ok = false;
+  if (!ok)
+    unlink(file);
+  return ok;
+}
+
+UserDictJournal::UserDictJournal() {
+  journal_file_ = NULL;
+  dict_file_ = NULL;
+  fd_ = -1;
+  replay_buf_ = NULL;
+  file_mutex_ = NULL;
+  last_update_ = NULL;
+  sync_time_ = NULL;
+  started_ = false;
+  pending_buf_ = NULL;
+  image_ = NULL;
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&cond_, NULL);
+  reset();
+}
+
+UserDictJournal::~UserDictJournal() {
+  close(NULL, 0);
+  pthread_cond_destroy(&cond_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+void UserDictJournal::reset() {
+  if (fd_ >= 0)
+    ::close(fd_);
+  fd_ = -1;
+  free(journal_file_);
+  journal_file_ = NULL;
+  free(dict_file_);
+  dict_file_ = NULL;
+  free(replay_buf_);
+  replay_buf_ = NULL;
+  replay_size_ = 0;
+  replay_pos_ = 0;
+  file_size_ = 0;
+  stopping_ = false;
+  free(pending_buf_);
+  pending_buf_ = NULL;
+  pending_size_ = 0;
+  pending_capacity_ = 0;
+  pending_num_ = 0;
+  memset(&pending_deadline_, 0, sizeof(pending_deadline_));
+  free(image_);
+  image_ = NULL;
+  image_size_ = 0;
+  image_pos_ = 0;
+  compacting_ = false;
+  queued_end_ = 0;
+}
+
+uint32 UserDictJournal::get_checksum(const uint8 *buf, size_t size) {
+  // FNV-1a, enough to find a torn or garbled record.
+  uint32 hash = 2166136261u;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= buf[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+bool UserDictJournal::open(const char *dict_file) {
+  close(NULL, 0);
+  if (NULL == dict_file)
+    return false;
+
+  size_t len = strlen(dict_file);
+  journal_file_ = static_cast<char*>(malloc(len + sizeof(".journal")));
+  dict_file_ = strdup(dict_file);
+  if (NULL == journal_file_ || NULL == dict_file_) {
+    reset();
+    return false;
+  }
+  memcpy(journal_file_, dict_file, len);
+  memcpy(journal_file_ + len, ".journal", sizeof(".journal"));
+
+  fd_ = ::open(journal_file_, O_RDWR | O_CREAT | O_APPEND, 0666);
+  if (fd_ < 0) {
+    reset();
+    return false;
+  }
+
+  off_t size = lseek(fd_, 0, SEEK_END);
+  uint32 version = 0;
+  if (size >= static_cast<off_t>(sizeof(version))) {
+    replay_buf_ = static_cast<uint8*>(malloc(size));
+    if (NULL == replay_buf_ || !read_all(fd_, replay_buf_, size, 0)) {
+      reset();
+      return false;
+    }
+    memcpy(&version, replay_buf_, sizeof(version));
+  }
+
+  if (kJournalVersion != version) {
+    // A new journal, or one in an unknown format.
+    free(replay_buf_);
+    replay_buf_ = NULL;
+    version = kJournalVersion;
+    if (0 != ftruncate(fd_, 0) ||
+        !write_all(fd_, reinterpret_cast<uint8*>(&version), sizeof(version))) {
+      reset();
+      return false;
+    }
+    file_size_ = sizeof(version);
+  } else {
+    size_t pos = sizeof(version);
+    while (pos + sizeof(Record) <= static_cast<size_t>(size)) {
+      Record record;
+      memcpy(&record, replay_buf_ + pos, sizeof(record));
+      if ((kOpPut != record.op && kOpRemove != record.op) ||
+          0 == record.nchar || record.nchar > kMaxLemmaSize)
+        break;
+      size_t record_size = get_record_size(record.nchar);
+      if (pos + record_size > static_cast<size_t>(size))
+        break;
+      uint32 checksum = record.checksum;
+      memset(replay_buf_ + pos + offsetof(Record, checksum), 0,
+             sizeof(checksum));
+      bool valid = checksum == get_checksum(replay_buf_ + pos, record_size);
+      memcpy(replay_buf_ + pos + offsetof(Record, checksum), &checksum,
+             sizeof(checksum));
+      if (!valid)
+        break;
+      pos += record_size;
+    }
+
+    // Cut off the torn record, the following ones can't be trusted.
+    if (pos < static_cast<size_t>(size) && 0 != ftruncate(fd_, pos)) {
+      reset();
+      return false;
+    }
+    replay_size_ = pos;
+    replay_pos_ = sizeof(version);
+    file_size_ = pos;
+  }
+  queued_end_ = file_size_;
+  return true;
+}
+
+void UserDictJournal::get_replay_size(size_t *put_num, size_t *lemma_size) {
+  *put_num = 0;
+  *lemma_size = 0;
+  size_t pos = sizeof(kJournalVersion);
+  while (pos < replay_size_) {
+    const Record *record = reinterpret_cast<const Record*>(replay_buf_ + pos);
+    if (kOpPut == record->op) {
+      (*put_num)++;
+      *lemma_size += 2 + (record->nchar << 2);
+    }
+    pos += get_record_size(record->nchar);
+  }
+}
+
+const UserDictJournal::Record* UserDictJournal::next_record() {
+  if (replay_pos_ >= replay_size_)
+    return NULL;
+  const Record *record =
+      reinterpret_cast<const Record*>(replay_buf_ + replay_pos_);
+  replay_pos_ += get_record_size(record->nchar);
+  return record;
+}
+
+bool UserDictJournal::start(pthread_mutex_t *file_mutex,
+                            struct timeval *last_update,
+                            struct timeval *sync_time) {
+  if (started_ || fd_ < 0 || NULL == file_mutex || NULL == last_update ||
+      NULL == sync_time)
+    return false;
+
+  // The records have been replayed.
+  free(replay_buf_);
+  replay_buf_ = NULL;
+  replay_size_ = 0;
+  replay_pos_ = 0;
+
+  file_mutex_ = file_mutex;
+  last_update_ = last_update;
+  sync_time_ = sync_time;
+  stopping_ = false;
+  if (0 != pthread_create(&thread_, NULL, thread_main, this))
+    return false;
+  started_ = true;
+  return true;
+}
+
+void UserDictJournal::close(uint8 *image, size_t image_size) {
+  if (started_) {
+    pthread_mutex_lock(&mutex_);
+    stopping_ = true;
+    pthread_cond_signal(&cond_);
+    pthread_mutex_unlock(&mutex_);
+
+    pthread_join(thread_, NULL);
+    started_ = false;
+  }
+
+  // All records are written, so the image includes the whole journal.
+  if (NULL != image && fd_ >= 0 && NULL != file_mutex_)
+    write_image(image, image_size, file_size_);
+  free(image);
+  reset();
+}
+
+void UserDictJournal::append(uint8 op, uint8 flags, uint32 score,
+                             int32 total_nfreq, uint16 nchar,
+                             const uint16 *splids, const char16 *lemma) {
+  if (!started_ || 0 == nchar || nchar > kMaxLemmaSize)
+    return;
+
+  size_t record_size = get_record_size(nchar);
+  pthread_mutex_lock(&mutex_);
+  if (pending_size_ + record_size > pending_capacity_) {
+    size_t capacity = pending_capacity_ * 2;
+    if (capacity < pending_size_ + record_size)
+      capacity = kGroupSize * get_record_size(kMaxLemmaSize);
+    uint8 *buf = static_cast<uint8*>(realloc(pending_buf_, capacity));
+    if (NULL == buf) {
+      pthread_mutex_unlock(&mutex_);
+      return;
+    }
+    pending_buf_ = buf;
+    pending_capacity_ = capacity;
+  }
+
+  uint8 *buf = pending_buf_ + pending_size_;
+  Record record;
+  record.op = op;
+  record.flags = flags;
+  record.nchar = nchar;
+  record.spare = 0;
+  record.score = score;
+  record.total_nfreq = total_nfreq;
+  record.checksum = 0;
+  memcpy(buf, &record, sizeof(record));
+  memcpy(buf + sizeof(record), splids, nchar << 1);
+  memcpy(buf + sizeof(record) + (nchar << 1), lemma, nchar << 1);
+  record.checksum = get_checksum(buf, record_size);
+  memcpy(buf + offsetof(Record, checksum), &record.checksum,
+         sizeof(record.checksum));
+
+  pending_size_ += record_size;
+  queued_end_ += record_size;
+  if (0 == pending_num_) {
+    clock_gettime(CLOCK_REALTIME, &pending_deadline_);
+    pending_deadline_.tv_sec += kCommitDelayMs / 1000;
+    pending_deadline_.tv_nsec += (kCommitDelayMs % 1000) * 1000000;
+    if (pending_deadline_.tv_nsec >= 1000000000) {
+      pending_deadline_.tv_sec++;
+      pending_deadline_.tv_nsec -= 1000000000;
+    }
+  }
+  pending_num_++;
+  // Wake the thread up to wait for the deadline, or to write a full group.
+  if (1 == pending_num_ || pending_num_ >= kGroupSize)
+    pthread_cond_signal(&cond_);
+  pthread_mutex_unlock(&mutex_);
+}
+
+bool UserDictJournal::need_compact() {
+  if (!started_)
+    return false;
+  pthread_mutex_lock(&mutex_);
+  bool need = !compacting_ && queued_end_ >= kCompactSize;
+  pthread_mutex_unlock(&mutex_);
+  return need;
+}
+
+void UserDictJournal::compact(uint8 *image, size_t image_size) {
+  pthread_mutex_lock(&mutex_);
+  if (!started_ || compacting_ || NULL == image) {
+    pthread_mutex_unlock(&mutex_);
+    free(image);
+    return;
+  }
+  image_ = image;
+  image_size_ = image_size;
+  image_pos_ = queued_end_;
+  compacting_ = true;
+  pthread_cond_signal(&cond_);
+  pthread_mutex_unlock(&mutex_);
+}
+
+size_t UserDictJournal::size() {
+  pthread_mutex_lock(&mutex_);
+  size_t size = queued_end_;
+  pthread_mutex_unlock(&mutex_);
+  return size;
+}
+
+void* UserDictJournal::thread_main(void *arg) {
+  static_cast<UserDictJournal*>(arg)->run();
+  return NULL;
+}
+
+void UserDictJournal::run() {
+  pthread_mutex_lock(&mutex_);
+  for (;;) {
+    while (!stopping_ && NULL == image_ && pending_num_ < kGroupSize) {
+      if (0 == pending_num_) {
+        pthread_cond_wait(&cond_, &mutex_);
+      } else if (ETIMEDOUT == pthread_cond_timedwait(&cond_, &mutex_,
+                                                     &pending_deadline_)) {
+        break;
+      }
+    }
+
+    uint8 *buf = pending_buf_;
+    size_t size = pending_size_;
+    pending_buf_ = NULL;
+    pending_size_ = 0;
+    pending_capacity_ = 0;
+    pending_num_ = 0;
+
+    uint8 *image = image_;
+    size_t image_size = image_size_;
+    size_t image_pos = image_pos_;
+    image_ = NULL;
+    bool stopping = stopping_;
+    pthread_mutex_unlock(&mutex_);
+
+    // The records are written before the image, so that the journal file
+    // has all records which the image includes.
+    if (size > 0 && !write_records(buf, size)) {
+      pthread_mutex_lock(&mutex_);
+      queued_end_ -= size;
+      pthread_mutex_unlock(&mutex_);
+    }
+    free(buf);
+    if (NULL != image) {
+      write_image(image, image_size, image_pos);
+      free(image);
+    }
+
+    pthread_mutex_lock(&mutex_);
+    if (NULL != image)
+      compacting_ = false;
+    if (stopping)
+      break;
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+bool UserDictJournal::write_records(const uint8 *buf, size_t size) {
+  pthread_mutex_lock(file_mutex_);
+
+  // Another UserDict of the same file may have compacted the journal.
+  struct stat file_stat, fd_stat;
+  if (0 == fstat(fd_, &fd_stat) &&
+      (0 != stat(journal_file_, &file_stat) ||
+       file_stat.st_ino != fd_stat.st_ino)) {
+    int fd = ::open(journal_file_, O_RDWR | O_CREAT | O_APPEND, 0666);
+    if (fd >= 0) {
+      dup2(fd, fd_);
+      ::close(fd);
+    }
+  }
+  off_t end = lseek(fd_, 0, SEEK_END);
+  if (end >= 0)
+    file_size_ = end;
+
+  bool ok = write_all(fd_, buf, size) && 0 == fdatasync(fd_);
+  if (ok) {
+    file_size_ += size;
+    mark_written();
+  } else {
+    // Don't leave a torn record which would hide the later ones.
+    ftruncate(fd_, file_size_);
+  }
+  pthread_mutex_unlock(file_mutex_);
+  return ok;
+}
+
+bool UserDictJournal::write_image(const uint8 *image, size_t image_size,
+                                  size_t image_pos) {
+  size_t len = strlen(dict_file_);
+  char *dict_tmp = static_cast<char*>(malloc(len + sizeof(".tmp")));
+  len = strlen(journal_file_);
+  char *journal_tmp = static_cast<char*>(malloc(len + sizeof(".tmp")));
+  if (NULL == dict_tmp || NULL == journal_tmp) {
+    free(dict_tmp);
+    free(journal_tmp);
+    return false;
+  }
+  sprintf(dict_tmp, "%s.tmp", dict_file_);
+  sprintf(journal_tmp, "%s.tmp", journal_file_);
+
+  // The slow part is done without the file lock.
+  bool ok = write_file(dict_tmp, image, image_size);
+
+  uint8 *tail = NULL;
+  size_t tail_size = 0;
+  if (ok) {
+    pthread_mutex_lock(file_mutex_);
+    if (is_stale()) {
+      // The image would drop the lemmas written by others.
+      ok = false;
+    } else {
+      // Keep the records which were written after the image was taken.
+      uint32 version = kJournalVersion;
+      if (image_pos < sizeof(version) || image_pos > file_size_)
+        image_pos = file_size_;
+      tail_size = sizeof(version) + file_size_ - image_pos;
+      tail = static_cast<uint8*>(malloc(tail_size));
+      ok = NULL != tail;
+      if (ok) {
+        memcpy(tail, &version, sizeof(version));
+        ok = read_all(fd_, tail + sizeof(version),
+                      tail_size - sizeof(version), image_pos);
+      }
+      ok = ok && write_file(journal_tmp, tail, tail_size);
+      ok = ok && 0 == rename(dict_tmp, dict_file_);
+    }
+
+    if (ok) {
+      // The records before image_pos are in the dictionary file now. If the
+      // journal can't be replaced, they are only replayed again.
+      if (0 == rename(journal_tmp, journal_file_)) {
+        int fd = ::open(journal_file_, O_RDWR | O_APPEND);
+        if (fd >= 0) {
+          dup2(fd, fd_);
+          ::close(fd);
+          pthread_mutex_lock(&mutex_);
+          queued_end_ -= file_size_ - tail_size;
+          pthread_mutex_unlock(&mutex_);
+          file_size_ = tail_size;
+        }
+      }
+      mark_written();
+    }
+    pthread_mutex_unlock(file_mutex_);
+  }
+
+  if (!ok)
+    unlink(dict_tmp);
+  unlink(journal_tmp);
+  free(tail);
+  free(dict_tmp);
+  free(journal_tmp);
+  return ok;
+}
+
+bool UserDictJournal::is_stale() {
+  return timercmp(last_update_, sync_time_, >);
+}
+
+void UserDictJournal::mark_written() {
+  // If others wrote the dictionary file, the owner still has to reload it.
+  bool stale = is_stale();
+  gettimeofday(last_update_, NULL);
+  if (!stale)
+    *sync_time_ = *last_update_;
+}
+
+}  // namespace ime_pinyin
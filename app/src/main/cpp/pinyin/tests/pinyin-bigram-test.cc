@@ -0,0 +1,171 @@
+// Checks that the bigrams of a dictionary image change the sentence decoded.
+//
+// A small raw lemma list is written, where 的 is much more frequent than 得,
+// so "tade" gives 他的. A bigram file says that 他 is often followed by 得.
+// Two images are built from the list, without and with the bigram file, and
+// saved; both must be of the current version. Each image is then loaded by
+// the decoder: "tade" must give 他的 without the bigrams and 他得 with them,
+// and an input without a bigram pair must give the same sentence with both.
+//
+// The files are created with the prefix PREFIX, and removed at the end.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "dictimage.h"
+#include "dicttrie.h"
+#include "ngram.h"
+#include "pinyinime.h"
+
+namespace {
+
+using ime_pinyin::char16;
+
+struct RawLemma {
+  const char16_t *hanzis;
+  int freq;
+  const char *pinyin;
+};
+
+const RawLemma LEMMAS[] = {
+    {u"他", 50000, "ta"},   {u"的", 90000, "de"},  {u"得", 8000, "de"},
+    {u"地", 20000, "de"},   {u"我", 60000, "wo"},  {u"们", 30000, "men"},
+    {u"我们", 20000, "wo men"},
+    // Each half id needs a spelling of its Yunmu.
+    {u"啊", 1000, "a"},     {u"饿", 1000, "e"},    {u"哦", 1000, "o"},
+    {u"日", 1000, "ri"},    {u"书", 1000, "shu"},  {u"女", 1000, "nv"},
+};
+
+// The unigram codebook needs at least as many distinct frequencies as it has
+// codes, so other lemmas are added with the spellings below.
+const char *const FILLER_SPELLINGS[] = {"ma", "ni", "hao", "shi", "zhong",
+                                        "guo", "ren", "lai", "qu", "xue"};
+
+constexpr std::size_t FILLER_NUM = ime_pinyin::kCodeBookSize + 44;
+
+// Writes str as UTF-16LE with a BOM.
+bool write_utf16(const std::string &file, const std::u16string &str) {
+  std::ofstream out(file, std::ios::binary | std::ios::trunc);
+  const std::u16string text = u"\ufeff" + str;
+  for (char16_t ch : text) {
+    out.put(static_cast<char>(ch & 0xff));
+    out.put(static_cast<char>(ch >> 8));
+  }
+  return static_cast<bool>(out);
+}
+
+std::u16string ascii(const char *str) {
+  return std::u16string(str, str + std::strlen(str));
+}
+
+std::u16string raw_list() {
+  std::u16string raw;
+  for (const RawLemma &lemma : LEMMAS) {
+    raw += lemma.hanzis;
+    raw += u' ' + ascii(std::to_string(lemma.freq).c_str()) + u" 0 " +
+           ascii(lemma.pinyin) + u'\n';
+  }
+  for (std::size_t i = 0; i < FILLER_NUM; ++i) {
+    raw += static_cast<char16_t>(0x5000 + i);
+    raw += u' ' + ascii(std::to_string(10 + i).c_str()) + u" 0 " +
+           ascii(FILLER_SPELLINGS[i % (sizeof(FILLER_SPELLINGS) /
+                                       sizeof(FILLER_SPELLINGS[0]))]) +
+           u'\n';
+  }
+  return raw;
+}
+
+// Builds and saves an image, and returns whether it has the current version.
+bool build(const std::string &raw, const char *bigram,
+           const std::string &image) {
+  ime_pinyin::DictTrie *dict_trie = new ime_pinyin::DictTrie();
+  const bool built = dict_trie->build_dict(raw.c_str(), nullptr, bigram, 1) &&
+                     dict_trie->save_dict(image.c_str());
+  delete dict_trie;
+  if (!built) {
+    std::fprintf(stderr, "error: failed to build %s\n", image.c_str());
+    return false;
+  }
+
+  ime_pinyin::uint32 header[2] = {0, 0};
+  std::ifstream in(image, std::ios::binary);
+  in.read(reinterpret_cast<char *>(header), sizeof(header));
+  if ((header[0] != ime_pinyin::kDictImageMagic) ||
+      (header[1] != ime_pinyin::kDictImageVersion)) {
+    std::fprintf(stderr, "error: %s is not of version %u\n", image.c_str(),
+                 static_cast<unsigned>(ime_pinyin::kDictImageVersion));
+    return false;
+  }
+  return true;
+}
+
+// The sentence candidate of pinyin.
+std::u16string sentence(const char *pinyin) {
+  ime_pinyin::im_reset_search();
+  if (ime_pinyin::im_search(pinyin, std::strlen(pinyin)) == 0) {
+    return std::u16string();
+  }
+  char16 candidate[ime_pinyin::kMaxSearchSteps + 1];
+  if (ime_pinyin::im_get_candidate(0, candidate,
+                                   ime_pinyin::kMaxSearchSteps + 1)
+      == nullptr) {
+    return std::u16string();
+  }
+  return reinterpret_cast<const char16_t *>(candidate);
+}
+
+// Loads image and checks the sentences of "tade" and "wode".
+bool check(const std::string &image, const char16_t *expected) {
+  if (!ime_pinyin::im_open_decoder(image.c_str(), "")) {
+    std::fprintf(stderr, "error: failed to load %s\n", image.c_str());
+    return false;
+  }
+  bool ok = true;
+  if (sentence("tade") != expected) {
+    std::fprintf(stderr, "error: %s: tade does not give the expected "
+                 "sentence\n", image.c_str());
+    ok = false;
+  }
+  if (sentence("wode") != u"我的") {
+    std::fprintf(stderr, "error: %s: wode gives another sentence\n",
+                 image.c_str());
+    ok = false;
+  }
+  ime_pinyin::im_close_decoder();
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::fprintf(stderr, "Usage: %s PREFIX\n", argv[0]);
+    return 1;
+  }
+  const std::string prefix = argv[1];
+  const std::string raw = prefix + ".raw.txt";
+  const std::string bigram = prefix + ".bigram.txt";
+  const std::string unigram_image = prefix + ".unigram.dat";
+  const std::string bigram_image = prefix + ".bigram.dat";
+
+  std::size_t failures = 0;
+  if (!write_utf16(raw, raw_list()) ||
+      !write_utf16(bigram, u"他 得 5000\n")) {
+    std::fprintf(stderr, "error: failed to write %s\n", prefix.c_str());
+    return 1;
+  }
+  failures += !build(raw, nullptr, unigram_image);
+  failures += !build(raw, bigram.c_str(), bigram_image);
+  if (failures == 0) {
+    failures += !check(unigram_image, u"他的");
+    failures += !check(bigram_image, u"他得");
+  }
+
+  for (const std::string &file : {raw, bigram, unigram_image, bigram_image}) {
+    std::remove(file.c_str());
+  }
+  std::printf("failures: %zu\n", failures);
+  return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+// Checks fuzzy Pinyin and that turning it off restores the exact results.
+//
+// The candidates of each input are recorded with fuzzy Pinyin off. With the
+// fuzzy pair of an input on, the input must give the sentence of its exact
+// spelling, for example "zongguo" gives 中国 with z/zh. When fuzzy Pinyin is
+// turned off again, every input must give the recorded candidates.
+//
+// No user dictionary is opened, so that the candidates do not depend on
+// earlier searches.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "pinyinime.h"
+#include "spellingtrie.h"
+
+namespace {
+
+using ime_pinyin::char16;
+
+struct Input {
+  const char *pinyin;
+  ime_pinyin::uint16 fuzzy_flags;
+  const char16_t *expected;
+};
+
+const Input INPUTS[] = {
+    {"zongguo", ime_pinyin::kFuzzyZZh, u"中国"},
+    {"sanghai", ime_pinyin::kFuzzySSh, u"上海"},
+    {"cangcheng", ime_pinyin::kFuzzyCCh, u"长城"},
+    {"nanjin", ime_pinyin::kFuzzyInIng, u"南京"},
+    {"rengshi", ime_pinyin::kFuzzyEnEng, u"认识"},
+    {"zhongguo", ime_pinyin::kFuzzyZZh, u"中国"},
+};
+
+// The number of candidates compared between searches.
+constexpr std::size_t CANDIDATES = 10;
+
+std::u16string search(const char *pinyin) {
+  ime_pinyin::im_reset_search();
+  const std::size_t num = ime_pinyin::im_search(pinyin, std::strlen(pinyin));
+  std::u16string candidates;
+  char16 candidate[ime_pinyin::kMaxSearchSteps + 1];
+  for (std::size_t i = 0; (i < num) && (i < CANDIDATES); ++i) {
+    if (ime_pinyin::im_get_candidate(i, candidate,
+                                     ime_pinyin::kMaxSearchSteps + 1)
+        != nullptr) {
+      candidates += reinterpret_cast<const char16_t *>(candidate);
+      candidates += u' ';
+    }
+  }
+  return candidates;
+}
+
+// The first candidate of candidates, which is the sentence candidate.
+std::u16string first(const std::u16string &candidates) {
+  return candidates.substr(0, candidates.find(u' '));
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::fprintf(stderr, "Usage: %s DICT\n", argv[0]);
+    return 1;
+  }
+  if (!ime_pinyin::im_open_decoder(argv[1], "")) {
+    std::fprintf(stderr, "error: failed to open %s\n", argv[1]);
+    return 1;
+  }
+
+  std::size_t failures = 0;
+  std::vector<std::u16string> exact;
+  for (const Input &input : INPUTS) {
+    exact.push_back(search(input.pinyin));
+  }
+  if (first(exact[0]) == INPUTS[0].expected) {
+    std::fprintf(stderr, "error: %s gives the fuzzy sentence without fuzzy "
+                 "Pinyin\n", INPUTS[0].pinyin);
+    failures++;
+  }
+
+  for (const Input &input : INPUTS) {
+    ime_pinyin::im_set_fuzzy(input.fuzzy_flags);
+    if (first(search(input.pinyin)) != input.expected) {
+      std::fprintf(stderr, "error: %s: not the expected sentence with fuzzy "
+                   "flags 0x%x\n", input.pinyin, input.fuzzy_flags);
+      failures++;
+    }
+  }
+
+  // All pairs at once, then off again.
+  ime_pinyin::im_set_fuzzy(ime_pinyin::kFuzzyZZh | ime_pinyin::kFuzzyCCh |
+                           ime_pinyin::kFuzzySSh | ime_pinyin::kFuzzyNL |
+                           ime_pinyin::kFuzzyAnAng | ime_pinyin::kFuzzyEnEng |
+                           ime_pinyin::kFuzzyInIng);
+  for (const Input &input : INPUTS) {
+    search(input.pinyin);
+  }
+  ime_pinyin::im_set_fuzzy(0);
+  for (std::size_t i = 0; i < exact.size(); ++i) {
+    if (search(INPUTS[i].pinyin) != exact[i]) {
+      std::fprintf(stderr, "error: %s: the candidates differ after fuzzy "
+                   "Pinyin is turned off\n", INPUTS[i].pinyin);
+      failures++;
+    }
+  }
+
+  ime_pinyin::im_close_decoder();
+  std::printf("inputs: %zu, failures: %zu\n",
+              sizeof(INPUTS) / sizeof(INPUTS[0]), failures);
+  return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,282 @@
+// Checks the journal of a user dictionary.
+//
+// Records written by the journal thread must be read back by open(). A
+// record at the end of the file which was not completely written, or whose
+// checksum does not match, is cut off with the records after it. Records
+// are written in groups: a single record waits for the commit delay, and a
+// full group is written at once. When an image of the dictionary is handed
+// over, it replaces the dictionary file by a rename, and the journal keeps
+// only the records queued after the image was taken.
+//
+// The files are created at USER_DICT and USER_DICT.journal, and removed at
+// the end.
+
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "userdictjournal.h"
+
+namespace {
+
+using ime_pinyin::UserDictJournal;
+
+// The size of the version at the start of the journal file.
+constexpr std::size_t HEADER_SIZE = 4;
+constexpr std::uint16_t NCHAR = 3;
+constexpr std::size_t RECORD_SIZE = sizeof(UserDictJournal::Record) + NCHAR * 4;
+
+struct Files {
+  std::string dict;
+  std::string journal;
+  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  struct timeval last_update = {0, 0};
+  struct timeval sync_time = {0, 0};
+};
+
+std::size_t file_size(const std::string &file) {
+  struct stat st;
+  return (stat(file.c_str(), &st) == 0) ? static_cast<std::size_t>(st.st_size)
+                                        : 0;
+}
+
+std::string read_file(const std::string &file) {
+  std::ifstream in(file, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>());
+}
+
+void write_file(const std::string &file, const std::string &content) {
+  std::ofstream out(file, std::ios::binary | std::ios::trunc);
+  out.write(content.data(), content.size());
+}
+
+void remove_files(const Files &files) {
+  std::remove(files.dict.c_str());
+  std::remove(files.journal.c_str());
+}
+
+bool start(UserDictJournal &journal, Files &files) {
+  return journal.open(files.dict.c_str()) &&
+         journal.start(&files.mutex, &files.last_update, &files.sync_time);
+}
+
+// Queues a put record of lemma number n.
+void append(UserDictJournal &journal, std::uint32_t n) {
+  std::uint16_t splids[NCHAR];
+  ime_pinyin::char16 lemma[NCHAR];
+  for (std::uint16_t i = 0; i < NCHAR; ++i) {
+    splids[i] = static_cast<std::uint16_t>(30 + i);
+    lemma[i] = static_cast<ime_pinyin::char16>(0x4e00 + n * NCHAR + i);
+  }
+  journal.append(UserDictJournal::kOpPut, 0, 1000 + n, static_cast<int>(n),
+                 NCHAR, splids, lemma);
+}
+
+// Writes num records to a new journal and closes it.
+bool write_records(Files &files, std::uint32_t num) {
+  remove_files(files);
+  UserDictJournal journal;
+  if (!start(journal, files)) {
+    return false;
+  }
+  for (std::uint32_t n = 0; n < num; ++n) {
+    append(journal, n);
+  }
+  journal.close(nullptr, 0);
+  return file_size(files.journal) == HEADER_SIZE + num * RECORD_SIZE;
+}
+
+// Reads the journal and returns the number of records, which must be
+// lemmas 0, 1, ... in order.
+std::size_t replay(Files &files, bool *in_order) {
+  UserDictJournal journal;
+  *in_order = journal.open(files.dict.c_str());
+  std::size_t num = 0;
+  while (const UserDictJournal::Record *record = journal.next_record()) {
+    const ime_pinyin::char16 *lemma = UserDictJournal::get_lemma(record);
+    if ((record->op != UserDictJournal::kOpPut) || (record->nchar != NCHAR) ||
+        (record->score != 1000 + num) ||
+        (lemma[0] != 0x4e00 + num * NCHAR)) {
+      *in_order = false;
+    }
+    num++;
+  }
+  journal.close(nullptr, 0);
+  return num;
+}
+
+// Waits until the journal file has size bytes, at most timeout_ms.
+bool wait_for_size(const std::string &file, std::size_t size,
+                   int timeout_ms) {
+  const auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds(timeout_ms);
+  while (file_size(file) != size) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return true;
+}
+
+bool check(bool ok, const char *what) {
+  if (!ok) {
+    std::fprintf(stderr, "error: %s\n", what);
+  }
+  return ok;
+}
+
+// A record cut in the middle is dropped, and the file is cut before it.
+std::size_t test_torn_tail(Files &files) {
+  std::size_t failures = 0;
+  if (!check(write_records(files, 5), "torn tail: records not written")) {
+    return 1;
+  }
+  const std::size_t torn_size = HEADER_SIZE + 4 * RECORD_SIZE + RECORD_SIZE / 2;
+  if (truncate(files.journal.c_str(), torn_size) != 0) {
+    return 1;
+  }
+  bool in_order = false;
+  failures += !check(replay(files, &in_order) == 4 && in_order,
+                     "torn tail: the complete records are not replayed");
+  failures += !check(file_size(files.journal) == HEADER_SIZE + 4 * RECORD_SIZE,
+                     "torn tail: the torn record is not cut off");
+  return failures;
+}
+
+// A garbled record is dropped with the records after it.
+std::size_t test_checksum(Files &files) {
+  std::size_t failures = 0;
+  if (!check(write_records(files, 5), "checksum: records not written")) {
+    return 1;
+  }
+  std::string content = read_file(files.journal);
+  content[HEADER_SIZE + 2 * RECORD_SIZE + RECORD_SIZE - 1] ^= 0x01;
+  write_file(files.journal, content);
+  bool in_order = false;
+  failures += !check(replay(files, &in_order) == 2 && in_order,
+                     "checksum: the records before the garbled one are not "
+                     "replayed");
+  failures += !check(file_size(files.journal) == HEADER_SIZE + 2 * RECORD_SIZE,
+                     "checksum: the garbled record is not cut off");
+  return failures;
+}
+
+// A single record waits for the commit delay; a full group does not.
+std::size_t test_group_commit(Files &files) {
+  std::size_t failures = 0;
+  remove_files(files);
+  UserDictJournal journal;
+  if (!check(start(journal, files), "group commit: failed to open")) {
+    return 1;
+  }
+
+  append(journal, 0);
+  failures += !check(file_size(files.journal) == HEADER_SIZE,
+                     "group commit: a single record is written at once");
+  failures += !check(
+      wait_for_size(files.journal, HEADER_SIZE + RECORD_SIZE,
+                    UserDictJournal::kCommitDelayMs * 5),
+      "group commit: a single record is not written after the delay");
+
+  for (std::uint32_t n = 1; n < UserDictJournal::kGroupSize; ++n) {
+    append(journal, n);
+  }
+  failures += !check(file_size(files.journal) == HEADER_SIZE + RECORD_SIZE,
+                     "group commit: a part of a group is written at once");
+  append(journal, UserDictJournal::kGroupSize);
+  failures += !check(
+      wait_for_size(files.journal,
+                    HEADER_SIZE + (UserDictJournal::kGroupSize + 1) *
+                                      RECORD_SIZE,
+                    UserDictJournal::kCommitDelayMs / 2),
+      "group commit: a full group is not written before the delay");
+  journal.close(nullptr, 0);
+
+  bool in_order = false;
+  failures += !check(replay(files, &in_order) ==
+                             UserDictJournal::kGroupSize + 1 && in_order,
+                     "group commit: the records are not replayed");
+  return failures;
+}
+
+// The image replaces the dictionary file, and only the records queued after
+// it stay in the journal.
+std::size_t test_compaction(Files &files) {
+  std::size_t failures = 0;
+  remove_files(files);
+  write_file(files.dict, "old dictionary");
+  struct stat old_stat;
+  stat(files.dict.c_str(), &old_stat);
+
+  UserDictJournal journal;
+  if (!check(start(journal, files), "compaction: failed to open")) {
+    return 1;
+  }
+  std::uint32_t num = 0;
+  while (!journal.need_compact()) {
+    append(journal, num++);
+  }
+  failures += !check(journal.size() >= UserDictJournal::kCompactSize,
+                     "compaction: needed before the journal is large");
+
+  const std::string image_content = "new dictionary";
+  uint8_t *image = static_cast<uint8_t *>(std::malloc(image_content.size()));
+  std::memcpy(image, image_content.data(), image_content.size());
+  journal.compact(image, image_content.size());
+  // Queued after the image was taken, so they must stay in the journal.
+  for (std::uint32_t n = 0; n < 2; ++n) {
+    append(journal, n);
+  }
+  journal.close(nullptr, 0);
+
+  failures += !check(read_file(files.dict) == image_content,
+                     "compaction: the dictionary file is not replaced");
+  struct stat new_stat;
+  stat(files.dict.c_str(), &new_stat);
+  failures += !check(new_stat.st_ino != old_stat.st_ino,
+                     "compaction: the dictionary file is not renamed over");
+  failures += !check(file_size(files.dict + ".tmp") == 0 &&
+                         file_size(files.journal + ".tmp") == 0,
+                     "compaction: temporary files are left");
+  bool in_order = false;
+  failures += !check(replay(files, &in_order) == 2 && in_order,
+                     "compaction: the journal does not keep only the later "
+                     "records");
+  std::printf("compaction: %u records before the image\n",
+              static_cast<unsigned>(num));
+  return failures;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::fprintf(stderr, "Usage: %s USER_DICT\n", argv[0]);
+    return 1;
+  }
+  Files files;
+  files.dict = argv[1];
+  files.journal = files.dict + ".journal";
+
+  std::size_t failures = 0;
+  failures += test_torn_tail(files);
+  failures += test_checksum(files);
+  failures += test_group_commit(files);
+  failures += test_compaction(files);
+  remove_files(files);
+  std::printf("failures: %zu\n", failures);
+  return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+// Checks that the lemma list cache never gives a list which searching the
+// dictionaries would not give.
+//
+// LmaCache is first checked on its own: a list is found only under its whole
+// key and a buffer size which gives the same list, all lists are dropped when
+// the version of the user dictionary changes, and the least recently used
+// lists and the lists overwritten in the ring buffer are dropped.
+//
+// Then a phrase is typed on the decoder with a user dictionary. Typing it
+// again must hit the cache. After a sentence composed of other candidates is
+// learned, which changes the user dictionary, the candidates must differ from
+// the ones before, and equal the ones of a new session, whose cache is
+// empty.
+//
+// The user dictionary is created at USER_DICT and removed at the end.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "lmacache.h"
+#include "pinyinime.h"
+
+namespace {
+
+using ime_pinyin::char16;
+using ime_pinyin::ImSession;
+using ime_pinyin::LmaCache;
+using ime_pinyin::LmaPsbItem;
+using ime_pinyin::uint16;
+
+// A phrase, and the candidate chosen first to compose a sentence which is not
+// the first candidate, like 一书职业 for "yishuzhiye".
+struct Phrase {
+  const char *pinyin;
+  std::size_t choice;
+};
+
+const Phrase PHRASES[] = {
+    {"shiyanjiqi", 1},
+    {"yishuzhiye", 2},
+    {"xinxianshuiguo", 2},
+};
+
+// The number of candidates compared between searches.
+constexpr std::size_t CANDIDATES = 10;
+
+constexpr std::size_t LPI_MAX = 64;
+
+std::vector<LmaPsbItem> make_items(std::size_t num, std::size_t first_id) {
+  std::vector<LmaPsbItem> items(num);
+  for (std::size_t i = 0; i < num; ++i) {
+    items[i].id = first_id + i;
+    items[i].lma_len = 2;
+    items[i].psb = static_cast<uint16>(i);
+    items[i].hanzi = 0;
+  }
+  return items;
+}
+
+bool get(LmaCache &cache, const uint16 *splids, uint16 num,
+         const char16 *excl_str, bool sorted, ime_pinyin::uint32 version,
+         std::size_t lpi_max, std::size_t expected_num,
+         std::size_t expected_first_id) {
+  LmaPsbItem items[LmaCache::kMaxItemsPerEntry];
+  std::size_t lpi_num = 0;
+  if (!cache.get_cache(splids, num, excl_str, sorted, version, items, lpi_max,
+                       &lpi_num)) {
+    return false;
+  }
+  return (lpi_num == expected_num) &&
+         ((lpi_num == 0) || (items[0].id == expected_first_id));
+}
+
+bool check(bool ok, const char *what) {
+  if (!ok) {
+    std::fprintf(stderr, "error: %s\n", what);
+  }
+  return ok;
+}
+
+std::size_t test_cache() {
+  std::size_t failures = 0;
+  LmaCache cache;
+  const uint16 key[] = {300, 301};
+  const uint16 other[] = {300, 302};
+  const char16 excl[] = {0x4e2d, 0};
+  const std::vector<LmaPsbItem> list = make_items(10, 1000);
+
+  // The list is got with a buffer of LPI_MAX items, and not truncated.
+  cache.put_cache(key, 2, nullptr, true, 1, list.data(), list.size(), LPI_MAX,
+                  list.size());
+  failures += !check(get(cache, key, 2, nullptr, true, 1, LPI_MAX, 10, 1000),
+                     "a put list is not found");
+  failures += !check(get(cache, key, 2, nullptr, true, 1, 10, 10, 1000),
+                     "a list is not found with a large enough buffer");
+  failures += !check(!get(cache, key, 2, nullptr, true, 1, 9, 10, 1000),
+                     "a list is found with a buffer which truncates it");
+  failures += !check(!get(cache, other, 2, nullptr, true, 1, LPI_MAX, 10,
+                          1000),
+                     "a list is found under other spelling ids");
+  failures += !check(!get(cache, key, 1, nullptr, true, 1, LPI_MAX, 10, 1000),
+                     "a list is found under a prefix of its spelling ids");
+  failures += !check(!get(cache, key, 2, excl, true, 1, LPI_MAX, 10, 1000),
+                     "a list is found with another excluded string");
+  failures += !check(!get(cache, key, 2, nullptr, false, 1, LPI_MAX, 10, 1000),
+                     "a sorted list is found for an unsorted search");
+
+  // Another user dictionary version drops every list, also for the old one.
+  failures += !check(!get(cache, key, 2, nullptr, true, 2, LPI_MAX, 10, 1000),
+                     "a list is found after the version changed");
+  failures += !check(!get(cache, key, 2, nullptr, true, 1, LPI_MAX, 10, 1000),
+                     "a list is kept after the version changed");
+
+  // The least recently used list is replaced when all entries are used.
+  for (uint16 i = 0; i < LmaCache::kMaxEntries; ++i) {
+    const uint16 splids[] = {static_cast<uint16>(100 + i)};
+    const std::vector<LmaPsbItem> items = make_items(1, i);
+    cache.put_cache(splids, 1, nullptr, true, 1, items.data(), items.size(),
+                    LPI_MAX, 1);
+  }
+  const uint16 first[] = {100};
+  const uint16 second[] = {101};
+  failures += !check(get(cache, first, 1, nullptr, true, 1, LPI_MAX, 1, 0),
+                     "a list is dropped before the cache is full");
+  const uint16 extra[] = {99};
+  cache.put_cache(extra, 1, nullptr, true, 1, list.data(), 1, LPI_MAX, 1);
+  failures += !check(get(cache, first, 1, nullptr, true, 1, LPI_MAX, 1, 0),
+                     "a recently used list is replaced");
+  failures += !check(!get(cache, second, 1, nullptr, true, 1, LPI_MAX, 1, 1),
+                     "the least recently used list is not replaced");
+
+  // The ring buffer holds four of the longest lists, so the fifth one
+  // overwrites the first.
+  const std::vector<LmaPsbItem> longest =
+      make_items(LmaCache::kMaxItemsPerEntry, 5000);
+  for (uint16 i = 0; i < 5; ++i) {
+    const uint16 splids[] = {static_cast<uint16>(400 + i)};
+    cache.put_cache(splids, 1, nullptr, true, 1, longest.data(),
+                    longest.size(), LPI_MAX, longest.size());
+  }
+  const uint16 overwritten[] = {400};
+  const uint16 last[] = {404};
+  failures += !check(!get(cache, overwritten, 1, nullptr, true, 1, LPI_MAX,
+                          longest.size(), 5000),
+                     "an overwritten list is found");
+  failures += !check(get(cache, last, 1, nullptr, true, 1, LPI_MAX,
+                         longest.size(), 5000),
+                     "the last long list is not found");
+
+  // Longer lists are not cached at all.
+  const std::vector<LmaPsbItem> too_long =
+      make_items(LmaCache::kMaxItemsPerEntry + 1, 9000);
+  cache.put_cache(key, 2, nullptr, true, 1, too_long.data(), too_long.size(),
+                  too_long.size(), too_long.size());
+  failures += !check(!get(cache, key, 2, nullptr, true, 1, too_long.size(),
+                          too_long.size(), 9000),
+                     "a list longer than the limit is cached");
+  return failures;
+}
+
+std::u16string candidates(ImSession *session, std::size_t num) {
+  std::u16string result;
+  char16 candidate[ime_pinyin::kMaxSearchSteps + 1];
+  for (std::size_t i = 0; (i < num) && (i < CANDIDATES); ++i) {
+    const char16 *got =
+        (session != nullptr)
+            ? ime_pinyin::im_session_get_candidate(
+                  session, i, candidate, ime_pinyin::kMaxSearchSteps + 1)
+            : ime_pinyin::im_get_candidate(i, candidate,
+                                           ime_pinyin::kMaxSearchSteps + 1);
+    if (got != nullptr) {
+      result += reinterpret_cast<const char16_t *>(candidate);
+      result += u' ';
+    }
+  }
+  return result;
+}
+
+std::u16string search(const char *phrase) {
+  ime_pinyin::im_reset_search();
+  return candidates(nullptr,
+                    ime_pinyin::im_search(phrase, std::strlen(phrase)));
+}
+
+std::u16string session_search(const char *phrase) {
+  ImSession *session = ime_pinyin::im_open_session();
+  const std::size_t num =
+      ime_pinyin::im_session_search(session, phrase, std::strlen(phrase));
+  std::u16string result = candidates(session, num);
+  ime_pinyin::im_close_session(session);
+  return result;
+}
+
+std::size_t test_decoder(const char *dict, const char *user_dict) {
+  std::size_t failures = 0;
+  std::remove(user_dict);
+  std::remove((std::string(user_dict) + ".journal").c_str());
+  if (!ime_pinyin::im_open_decoder(dict, user_dict)) {
+    std::fprintf(stderr, "error: failed to open %s\n", dict);
+    return 1;
+  }
+
+  for (const Phrase &entry : PHRASES) {
+    const char *phrase = entry.pinyin;
+    const std::u16string before = search(phrase);
+    std::size_t hits_before = 0, misses = 0;
+    ime_pinyin::im_get_lma_cache_stat(&hits_before, &misses);
+    failures += !check(search(phrase) == before,
+                       "the candidates differ when typed again");
+    std::size_t hits = 0;
+    ime_pinyin::im_get_lma_cache_stat(&hits, &misses);
+    failures += !check(hits > hits_before,
+                       "typing the same phrase again does not hit the cache");
+
+    // The composed sentence is learned in the user dictionary.
+    ime_pinyin::im_reset_search();
+    ime_pinyin::im_search(phrase, std::strlen(phrase));
+    std::size_t num = ime_pinyin::im_choose(entry.choice);
+    while (num > 1) {
+      num = ime_pinyin::im_choose(0);
+    }
+
+    const std::u16string after = search(phrase);
+    if (after == before) {
+      std::fprintf(stderr, "error: %s: the candidates do not change after a "
+                   "lemma is learned\n", phrase);
+      failures++;
+    }
+    if (after != session_search(phrase)) {
+      std::fprintf(stderr, "error: %s: the candidates differ from the ones "
+                   "of a new cache\n", phrase);
+      failures++;
+    }
+  }
+
+  std::size_t hits = 0, misses = 0;
+  ime_pinyin::im_get_lma_cache_stat(&hits, &misses);
+  std::printf("decoder: %zu hits, %zu misses\n", hits, misses);
+  ime_pinyin::im_close_decoder();
+  std::remove(user_dict);
+  std::remove((std::string(user_dict) + ".journal").c_str());
+  return failures;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    std::fprintf(stderr, "Usage: %s DICT USER_DICT\n", argv[0]);
+    return 1;
+  }
+  std::size_t failures = test_cache();
+  failures += test_decoder(argv[1], argv[2]);
+  std::printf("failures: %zu\n", failures);
+  return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+// Checks that the search pools grow past their first chunk and that the
+// chunks are reused correctly.
+//
+// The pools start with one chunk in the buffer of the decoder. A T9 digit
+// string types several spellings for each group of digits, and the lemmas
+// learned in the user dictionary add dictionary match nodes which the system
+// dictionary does not have, so that a long digit string needs more nodes
+// than the first chunk of the pool has. Every prefix must be decoded to its
+// whole length, and typing the string again, when the grown chunks are
+// reused, must give the same candidates. Build with -fsanitize=address to
+// also check the accesses across the chunks.
+//
+// The user dictionary is created at USER_DICT and removed at the end.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "pinyinime.h"
+
+namespace {
+
+using ime_pinyin::char16;
+
+// Syllables which type 9 and 4 on T9 keys, or start with them.
+const char *const SYLLABLES[] = {
+    "zi",  "xi",  "yi",   "zhi",  "xu",   "yu",    "zu",   "xiu",
+    "you", "zhu", "ying", "xing", "zong", "zhong", "yong", "xiong",
+};
+
+constexpr std::size_t SYLLABLE_NUM = sizeof(SYLLABLES) / sizeof(SYLLABLES[0]);
+
+const char *const DIGITS[] = {
+    "949494949494949494949494949494949494949",
+    "966496649664966496649664966496649664966",
+};
+
+// The number of candidates of each search in the trace.
+constexpr std::size_t TRACE_CANDIDATES = 5;
+
+struct PoolStat {
+  std::size_t mtrx_nd_used = 0;
+  std::size_t mtrx_nd_capacity = 0;
+  std::size_t dmi_used = 0;
+  std::size_t dmi_capacity = 0;
+};
+
+void remove_user_dict(const char *user_dict) {
+  std::remove(user_dict);
+  std::remove((std::string(user_dict) + ".journal").c_str());
+}
+
+// Learns a lemma for each phrase of four syllables, by choosing a candidate
+// which is not the first one.
+void learn_lemmas() {
+  for (std::size_t a = 0; a < SYLLABLE_NUM; ++a) {
+    for (std::size_t b = 0; b < SYLLABLE_NUM; ++b) {
+      const std::string phrase = std::string(SYLLABLES[a]) + SYLLABLES[b] +
+                                 SYLLABLES[(a + b) % SYLLABLE_NUM] +
+                                 SYLLABLES[(a * b) % SYLLABLE_NUM];
+      ime_pinyin::im_reset_search();
+      ime_pinyin::im_search(phrase.c_str(), phrase.size());
+      std::size_t num = ime_pinyin::im_choose(1);
+      while ((num > 1) && (ime_pinyin::im_get_fixed_len() < 4)) {
+        num = ime_pinyin::im_choose(0);
+      }
+    }
+  }
+}
+
+// Types digits key by key, and returns the candidates seen on the way.
+// Returns false if a prefix is not decoded to its whole length.
+bool type_digits(const char *digits, std::u16string &trace, PoolStat &max) {
+  const std::size_t length = std::strlen(digits);
+  ime_pinyin::im_reset_search();
+  for (std::size_t keys = 1; keys <= length; ++keys) {
+    const std::size_t num = ime_pinyin::im_search(digits, keys);
+    std::size_t decoded_len = 0;
+    ime_pinyin::im_get_sps_str(&decoded_len);
+    if (decoded_len != keys) {
+      std::fprintf(stderr, "error: %.*s: decoded %zu of %zu keys\n",
+                   static_cast<int>(keys), digits, decoded_len, keys);
+      return false;
+    }
+
+    trace += u'#';
+    char16 candidate[ime_pinyin::kMaxSearchSteps + 1];
+    for (std::size_t i = 0; (i < num) && (i < TRACE_CANDIDATES); ++i) {
+      if (ime_pinyin::im_get_candidate(i, candidate,
+                                       ime_pinyin::kMaxSearchSteps + 1)
+          != nullptr) {
+        trace += u' ';
+        trace += reinterpret_cast<const char16_t *>(candidate);
+      }
+    }
+
+    PoolStat stat;
+    ime_pinyin::im_get_pool_stat(&stat.mtrx_nd_used, &stat.mtrx_nd_capacity,
+                                 &stat.dmi_used, &stat.dmi_capacity);
+    if ((stat.mtrx_nd_used > stat.mtrx_nd_capacity) ||
+        (stat.dmi_used > stat.dmi_capacity)) {
+      std::fprintf(stderr, "error: %.*s: more nodes used than the capacity\n",
+                   static_cast<int>(keys), digits);
+      return false;
+    }
+    if (stat.mtrx_nd_used > max.mtrx_nd_used) {
+      max.mtrx_nd_used = stat.mtrx_nd_used;
+    }
+    if (stat.dmi_used > max.dmi_used) {
+      max.dmi_used = stat.dmi_used;
+    }
+    max.mtrx_nd_capacity = stat.mtrx_nd_capacity;
+    max.dmi_capacity = stat.dmi_capacity;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    std::fprintf(stderr, "Usage: %s DICT USER_DICT\n", argv[0]);
+    return 1;
+  }
+  const char *dict = argv[1];
+  const char *user_dict = argv[2];
+
+  remove_user_dict(user_dict);
+  if (!ime_pinyin::im_open_decoder(dict, user_dict)) {
+    std::fprintf(stderr, "error: failed to open %s\n", dict);
+    return 1;
+  }
+
+  // The capacity before any search is the first chunk.
+  PoolStat first;
+  ime_pinyin::im_get_pool_stat(&first.mtrx_nd_used, &first.mtrx_nd_capacity,
+                               &first.dmi_used, &first.dmi_capacity);
+
+  learn_lemmas();
+  ime_pinyin::im_set_t9(true);
+
+  std::size_t failures = 0;
+  PoolStat max;
+  for (const char *digits : DIGITS) {
+    std::u16string trace;
+    std::u16string again;
+    if (!type_digits(digits, trace, max) || !type_digits(digits, again, max)) {
+      failures++;
+    } else if (trace != again) {
+      std::fprintf(stderr, "error: %s: the candidates differ when typed "
+                   "again\n", digits);
+      failures++;
+    }
+  }
+
+  ime_pinyin::im_set_t9(false);
+  ime_pinyin::im_close_decoder();
+  remove_user_dict(user_dict);
+
+  std::printf("matrix nodes: max %zu used, capacity %zu, first chunk %zu\n",
+              max.mtrx_nd_used, max.mtrx_nd_capacity, first.mtrx_nd_capacity);
+  std::printf("dmi nodes: max %zu used, capacity %zu, first chunk %zu\n",
+              max.dmi_used, max.dmi_capacity, first.dmi_capacity);
+  // A row has at most a few matrix nodes, so the matrix node pool is not
+  // expected to grow, but the DMI pool must.
+  if (max.dmi_used <= first.dmi_capacity) {
+    std::fprintf(stderr, "error: the dmi node pool did not grow\n");
+    failures++;
+  }
+  return (failures == 0) ? 0 : 1;
+}
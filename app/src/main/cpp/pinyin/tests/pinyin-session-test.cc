@@ -0,0 +1,275 @@
+// Checks that decoder sessions on different threads do not disturb each
+// other.
+//
+// Each sentence is typed letter by letter, then the second candidate is
+// chosen, the choice is cancelled, and the predictions after the sentence
+// candidate are fetched. The candidates seen on the way make up the trace
+// of the sentence. The traces are first recorded in a single session, then
+// several threads replay all sentences in their own sessions at the same
+// time, and every trace must equal the recorded one. Build with
+// -fsanitize=thread to also check the sharing of the dictionaries.
+//
+// No user dictionary is opened for the traces, so that choices do not change
+// the scores of later searches and the traces stay the same in any order.
+// Then the decoder is opened again with a user dictionary, which all sessions
+// share: a sentence learned in one session must be the sentence candidate of
+// another session, which searched the same spelling before. The user
+// dictionary is created at USER_DICT and removed at the end.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pinyinime.h"
+
+namespace {
+
+using ime_pinyin::char16;
+using ime_pinyin::ImSession;
+
+const char *const SENTENCES[] = {
+    "nihao",
+    "zhongguo",
+    "women",
+    "beijingdaxue",
+    "xian",
+    "wm",
+    "zg",
+    "zhonghuarenmingongheguo",
+    "womenyiqiqukandianyingranhouchifan",
+    "jintiantianqihenhaowomenqugongyuan",
+    "qingnibawenjianfadaowodeyouxiangli",
+    "zhuangjiadedongxijinnianchangde",
+};
+
+constexpr std::size_t SENTENCE_NUM = sizeof(SENTENCES) / sizeof(SENTENCES[0]);
+
+// The spelling learned through the user dictionary, and the candidate chosen
+// first to compose a sentence which is not the first candidate.
+const char *const LEARNED_SPELLING = "yishuzhiye";
+constexpr std::size_t LEARNED_CHOICE = 2;
+
+// The number of candidates of each search in the trace.
+constexpr std::size_t TRACE_CANDIDATES = 5;
+
+void print_usage(const char *cmd) {
+  std::fprintf(stderr,
+               "Usage: %s [OPTION]... DICT USER_DICT\n\n"
+               "Options:\n"
+               "  -t, --threads=N     run N sessions (default: 8)\n"
+               "  -n, --repeat=N      replay the sentences N times "
+               "(default: 20)\n"
+               "  -h, --help          print this help\n",
+               cmd);
+}
+
+void append_number(std::u16string &trace, std::size_t number) {
+  trace += u'#';
+  for (const char c : std::to_string(number)) {
+    trace += static_cast<char16_t>(c);
+  }
+}
+
+void append_candidates(ImSession *session, std::size_t num,
+                       std::u16string &trace) {
+  append_number(trace, num);
+  char16 candidate[ime_pinyin::kMaxSearchSteps + 1];
+  for (std::size_t i = 0; (i < num) && (i < TRACE_CANDIDATES); ++i) {
+    if (ime_pinyin::im_session_get_candidate(session, i, candidate,
+                                             ime_pinyin::kMaxSearchSteps + 1)
+        != nullptr) {
+      trace += u' ';
+      trace += reinterpret_cast<const char16_t *>(candidate);
+    }
+  }
+}
+
+std::u16string run_sentence(ImSession *session, const char *sentence) {
+  std::u16string trace;
+  const std::size_t length = std::strlen(sentence);
+  ime_pinyin::im_session_reset_search(session);
+  std::size_t num = 0;
+  for (std::size_t letters = 1; letters <= length; ++letters) {
+    num = ime_pinyin::im_session_search(session, sentence, letters);
+    append_candidates(session, num, trace);
+  }
+
+  char16 sentence_cand[ime_pinyin::kMaxSearchSteps + 1] = {0};
+  ime_pinyin::im_session_get_candidate(session, 0, sentence_cand,
+                                       ime_pinyin::kMaxSearchSteps + 1);
+
+  if (num > 1) {
+    num = ime_pinyin::im_session_choose(session, 1);
+    append_number(trace, ime_pinyin::im_session_get_fixed_len(session));
+    append_candidates(session, num, trace);
+    num = ime_pinyin::im_session_cancel_last_choice(session);
+    append_candidates(session, num, trace);
+  }
+
+  char16 (*predicts)[ime_pinyin::kMaxPredictSize + 1] = nullptr;
+  const std::size_t predict_num =
+      ime_pinyin::im_session_get_predicts(session, sentence_cand, predicts);
+  append_number(trace, predict_num);
+  for (std::size_t i = 0; i < predict_num; ++i) {
+    trace += u' ';
+    trace += reinterpret_cast<const char16_t *>(predicts[i]);
+  }
+  return trace;
+}
+
+std::u16string sentence_candidate(ImSession *session, const char *spelling) {
+  ime_pinyin::im_session_reset_search(session);
+  ime_pinyin::im_session_search(session, spelling, std::strlen(spelling));
+  char16 candidate[ime_pinyin::kMaxSearchSteps + 1] = {0};
+  ime_pinyin::im_session_get_candidate(session, 0, candidate,
+                                       ime_pinyin::kMaxSearchSteps + 1);
+  return reinterpret_cast<const char16_t *>(candidate);
+}
+
+void remove_user_dict(const char *user_dict) {
+  std::remove(user_dict);
+  std::remove((std::string(user_dict) + ".journal").c_str());
+}
+
+// Learns a sentence in one session, and returns the number of failures to
+// find it in another one.
+std::size_t test_shared_user_dict(const char *dict, const char *user_dict) {
+  remove_user_dict(user_dict);
+  if (!ime_pinyin::im_open_decoder(dict, user_dict)) {
+    std::fprintf(stderr, "error: failed to open %s with %s\n", dict,
+                 user_dict);
+    return 1;
+  }
+  ImSession *learner = ime_pinyin::im_open_session();
+  ImSession *reader = ime_pinyin::im_open_session();
+  std::size_t failures = 0;
+  if ((learner == nullptr) || (reader == nullptr)) {
+    std::fprintf(stderr, "error: failed to open a session\n");
+    failures++;
+  } else {
+    const std::u16string before = sentence_candidate(reader, LEARNED_SPELLING);
+
+    ime_pinyin::im_session_reset_search(learner);
+    ime_pinyin::im_session_search(learner, LEARNED_SPELLING,
+                                  std::strlen(LEARNED_SPELLING));
+    std::size_t num = ime_pinyin::im_session_choose(learner, LEARNED_CHOICE);
+    while (num > 1) {
+      num = ime_pinyin::im_session_choose(learner, 0);
+    }
+    char16 learned[ime_pinyin::kMaxSearchSteps + 1] = {0};
+    ime_pinyin::im_session_get_candidate(learner, 0, learned,
+                                         ime_pinyin::kMaxSearchSteps + 1);
+
+    const std::u16string after = sentence_candidate(reader, LEARNED_SPELLING);
+    if ((after == before) ||
+        (after != reinterpret_cast<const char16_t *>(learned))) {
+      std::fprintf(stderr, "error: %s: a sentence learned in one session is "
+                   "not the sentence candidate of another\n",
+                   LEARNED_SPELLING);
+      failures++;
+    }
+  }
+  ime_pinyin::im_close_session(reader);
+  ime_pinyin::im_close_session(learner);
+  ime_pinyin::im_close_decoder();
+  remove_user_dict(user_dict);
+  return failures;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  std::size_t thread_num = 8;
+  std::size_t repeat = 20;
+  const char *dict = nullptr;
+  const char *user_dict = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if ((std::strcmp(arg, "-h") == 0) || (std::strcmp(arg, "--help") == 0)) {
+      print_usage(argv[0]);
+      return 0;
+    } else if ((std::strcmp(arg, "-t") == 0) && (i + 1 < argc)) {
+      thread_num = std::strtoul(argv[++i], nullptr, 10);
+    } else if (std::strncmp(arg, "--threads=", 10) == 0) {
+      thread_num = std::strtoul(arg + 10, nullptr, 10);
+    } else if ((std::strcmp(arg, "-n") == 0) && (i + 1 < argc)) {
+      repeat = std::strtoul(argv[++i], nullptr, 10);
+    } else if (std::strncmp(arg, "--repeat=", 9) == 0) {
+      repeat = std::strtoul(arg + 9, nullptr, 10);
+    } else if ((arg[0] != '-') && (dict == nullptr)) {
+      dict = arg;
+    } else if ((arg[0] != '-') && (user_dict == nullptr)) {
+      user_dict = arg;
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if ((dict == nullptr) || (user_dict == nullptr) || (thread_num == 0) ||
+      (repeat == 0)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  if (!ime_pinyin::im_open_decoder(dict, "")) {
+    std::fprintf(stderr, "error: failed to open %s\n", dict);
+    return 1;
+  }
+
+  std::vector<std::u16string> expected(SENTENCE_NUM);
+  ImSession *session = ime_pinyin::im_open_session();
+  if (session == nullptr) {
+    std::fprintf(stderr, "error: failed to open a session\n");
+    ime_pinyin::im_close_decoder();
+    return 1;
+  }
+  for (std::size_t s = 0; s < SENTENCE_NUM; ++s) {
+    expected[s] = run_sentence(session, SENTENCES[s]);
+  }
+  ime_pinyin::im_close_session(session);
+
+  // Each thread starts at a different sentence, so that different sessions
+  // search different spellings at the same time.
+  std::vector<std::size_t> mismatches(thread_num, 0);
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < thread_num; ++t) {
+    threads.emplace_back([t, repeat, &expected, &mismatches]() {
+      ImSession *session = ime_pinyin::im_open_session();
+      if (session == nullptr) {
+        mismatches[t]++;
+        return;
+      }
+      for (std::size_t r = 0; r < repeat; ++r) {
+        for (std::size_t i = 0; i < SENTENCE_NUM; ++i) {
+          const std::size_t s = (i + t) % SENTENCE_NUM;
+          if (run_sentence(session, SENTENCES[s]) != expected[s]) {
+            mismatches[t]++;
+          }
+        }
+      }
+      ime_pinyin::im_close_session(session);
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  ime_pinyin::im_close_decoder();
+
+  std::size_t total = 0;
+  for (std::size_t t = 0; t < thread_num; ++t) {
+    if (mismatches[t] > 0) {
+      std::fprintf(stderr, "thread %zu: %zu sentences differ\n", t,
+                   mismatches[t]);
+    }
+    total += mismatches[t];
+  }
+  std::printf("threads: %zu, sentences: %zu, mismatches: %zu\n", thread_num,
+              thread_num * repeat * SENTENCE_NUM, total);
+
+  const std::size_t failures = test_shared_user_dict(dict, user_dict);
+  std::printf("shared user dictionary failures: %zu\n", failures);
+  return ((total == 0) && (failures == 0)) ? 0 : 1;
+}
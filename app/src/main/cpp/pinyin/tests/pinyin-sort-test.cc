@@ -0,0 +1,123 @@
+// Checks that selecting candidates a page at a time with mypartial_sort()
+// gives the same order as sorting all of them at once with a stable sort.
+//
+// MatrixSearch::sort_candidates() only sorts the candidates up to the one
+// that is asked for, at least kCandSortStep more each time. The order of
+// the candidates must not depend on how they were asked for, and items with
+// equal scores must keep the order in which the search produced them, as
+// the stable sort keeps them. Random arrays of LmaPsbItem with few distinct
+// scores, so with many ties, are selected in random steps and compared
+// against std::stable_sort() with the same comparator.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "mystdlib.h"
+#include "searchutility.h"
+
+namespace {
+
+using ime_pinyin::LmaPsbItem;
+using ime_pinyin::LpiLessByUnifiedPsb;
+
+// The same as MatrixSearch::kCandSortStep.
+constexpr std::size_t SORT_STEP = 32;
+
+void print_usage(const char *cmd) {
+  std::fprintf(stderr,
+               "Usage: %s [OPTION]...\n\n"
+               "Options:\n"
+               "  -n, --arrays=N      check N random arrays (default: 5000)\n"
+               "  -h, --help          print this help\n",
+               cmd);
+}
+
+// The id of an item is its position before sorting, so equal items can be
+// told apart.
+std::vector<LmaPsbItem> make_items(std::minstd_rand &random, std::size_t num,
+                                   unsigned psb_num) {
+  std::vector<LmaPsbItem> items(num);
+  for (std::size_t i = 0; i < num; ++i) {
+    std::memset(&items[i], 0, sizeof(LmaPsbItem));
+    items[i].id = i;
+    items[i].lma_len = 1 + random() % 4;
+    items[i].psb = static_cast<ime_pinyin::uint16>(random() % psb_num);
+    items[i].hanzi = static_cast<ime_pinyin::char16>(0x4e00 + i);
+  }
+  return items;
+}
+
+// Selects the items the way MatrixSearch::sort_candidates() does, with
+// random requests, until all are sorted.
+void select_in_steps(std::minstd_rand &random, std::vector<LmaPsbItem> &items) {
+  const std::size_t total = items.size();
+  std::size_t sorted = 0;
+  while (sorted < total) {
+    std::size_t end = sorted + 1 + random() % (2 * SORT_STEP);
+    if (end < sorted + SORT_STEP)
+      end = sorted + SORT_STEP;
+    if (end > total)
+      end = total;
+    ime_pinyin::mypartial_sort(items.data() + sorted, total - sorted,
+                               end - sorted, LpiLessByUnifiedPsb());
+    sorted = end;
+  }
+}
+
+// Returns whether the selected items equal the stably sorted ones.
+bool check_array(std::minstd_rand &random, std::size_t index) {
+  const std::size_t num = random() % 2000;
+  const unsigned psb_num = 1 + random() % 64;
+  std::vector<LmaPsbItem> expected = make_items(random, num, psb_num);
+  std::vector<LmaPsbItem> selected = expected;
+
+  std::stable_sort(expected.begin(), expected.end(), LpiLessByUnifiedPsb());
+  select_in_steps(random, selected);
+
+  for (std::size_t i = 0; i < num; ++i) {
+    if (selected[i].id != expected[i].id) {
+      std::fprintf(stderr,
+                   "array %zu (%zu items, %u scores): item %zu is %zu, "
+                   "expected %zu\n",
+                   index, num, psb_num, i,
+                   static_cast<std::size_t>(selected[i].id),
+                   static_cast<std::size_t>(expected[i].id));
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  std::size_t array_num = 5000;
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if ((std::strcmp(arg, "-h") == 0) || (std::strcmp(arg, "--help") == 0)) {
+      print_usage(argv[0]);
+      return 0;
+    } else if ((std::strcmp(arg, "-n") == 0) && (i + 1 < argc)) {
+      array_num = std::strtoul(argv[++i], nullptr, 10);
+    } else if (std::strncmp(arg, "--arrays=", 9) == 0) {
+      array_num = std::strtoul(arg + 9, nullptr, 10);
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  std::minstd_rand random(44);
+  std::size_t mismatches = 0;
+  for (std::size_t i = 0; i < array_num; ++i) {
+    if (!check_array(random, i)) {
+      mismatches++;
+    }
+  }
+  std::printf("arrays: %zu, mismatches: %zu\n", array_num, mismatches);
+  return (mismatches == 0) ? 0 : 1;
+}
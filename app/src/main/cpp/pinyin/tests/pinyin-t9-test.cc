@@ -0,0 +1,249 @@
+// Checks the decoding of T9 digits and the switch between T9 and QWERTY.
+//
+// Each digit string is typed key by key and must give the expected sentence
+// candidate, the same one as its pinyin gives in QWERTY mode. Switching the
+// mode resets the search, so that nothing decoded in one mode is reused in
+// the other: the input of the other mode is not decoded, and the candidates
+// after switching back equal the ones typed before. Long strings of digits
+// which type many spellings, which the rows of T9 are limited for, must be
+// decoded to their whole length.
+//
+// The T9 index of the spelling trie is checked against the spellings of the
+// QWERTY parser: the digits of each spelling, and each prefix of them, must
+// give the ids which the QWERTY parser gives for the spellings typed by the
+// same digits, and whether a longer spelling begins with them.
+//
+// No user dictionary is opened, so that the candidates do not depend on
+// earlier choices.
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+
+#include "pinyinime.h"
+#include "splparser.h"
+
+namespace {
+
+using ime_pinyin::char16;
+
+struct Sentence {
+  const char *digits;
+  const char *pinyin;
+  const char16_t *expected;
+};
+
+const Sentence SENTENCES[] = {
+    {"64426", "nihao", u"你好"},
+    {"94664486", "zhongguo", u"中国"},
+    {"96636", "women", u"我们"},
+    {"2345464", "beijing", u"北京"},
+};
+
+const char *const LONG_DIGITS[] = {
+    "949494949494949494949494949494949494949",
+    "444444444444444444444444444444444444444",
+    "234567892345678923456789234567892345678",
+};
+
+// The number of candidates compared between searches.
+constexpr std::size_t CANDIDATES = 10;
+
+// Types digits key by key, and returns the candidates of the last search.
+// Returns an empty string if a prefix is not decoded to its whole length.
+std::u16string type_keys(const char *keys) {
+  const std::size_t length = std::strlen(keys);
+  ime_pinyin::im_reset_search();
+  std::size_t num = 0;
+  for (std::size_t n = 1; n <= length; ++n) {
+    num = ime_pinyin::im_search(keys, n);
+    std::size_t decoded_len = 0;
+    ime_pinyin::im_get_sps_str(&decoded_len);
+    if (decoded_len != n) {
+      std::fprintf(stderr, "error: %.*s: decoded %zu of %zu keys\n",
+                   static_cast<int>(n), keys, decoded_len, n);
+      return std::u16string();
+    }
+  }
+
+  std::u16string candidates;
+  char16 candidate[ime_pinyin::kMaxSearchSteps + 1];
+  for (std::size_t i = 0; (i < num) && (i < CANDIDATES); ++i) {
+    if (ime_pinyin::im_get_candidate(i, candidate,
+                                     ime_pinyin::kMaxSearchSteps + 1)
+        != nullptr) {
+      candidates += reinterpret_cast<const char16_t *>(candidate);
+      candidates += u' ';
+    }
+  }
+  return candidates;
+}
+
+// The first candidate of candidates, which is the sentence candidate.
+std::u16string first(const std::u16string &candidates) {
+  return candidates.substr(0, candidates.find(u' '));
+}
+
+// The digit of each letter on a phone keypad.
+const char KEYPAD[] = "22233344455566677778889999";
+
+typedef std::map<std::string, std::set<ime_pinyin::uint16>> SpellingsByDigits;
+
+// Adds the spellings which begin with prefix to spellings, by their digits.
+void add_spellings(ime_pinyin::SpellingParser &parser,
+                   const std::string &prefix, const std::string &digits,
+                   SpellingsByDigits &spellings) {
+  for (char ch = 'a'; ch <= 'z'; ++ch) {
+    const std::string str = prefix + ch;
+    bool is_pre = false;
+    const ime_pinyin::uint16 splid =
+        parser.get_splid_by_str(str.c_str(), str.size(), &is_pre);
+    const std::string code = digits + KEYPAD[ch - 'a'];
+    if (splid != 0) {
+      spellings[code].insert(splid);
+    }
+    if (is_pre) {
+      add_spellings(parser, str, code, spellings);
+    }
+  }
+}
+
+std::size_t test_index() {
+  ime_pinyin::SpellingParser parser;
+  SpellingsByDigits spellings;
+  add_spellings(parser, "", "", spellings);
+
+  // The digits of the spellings, and their prefixes.
+  std::set<std::string> codes;
+  for (const auto &entry : spellings) {
+    for (std::size_t len = 1; len <= entry.first.size(); ++len) {
+      codes.insert(entry.first.substr(0, len));
+    }
+  }
+
+  std::size_t failures = 0;
+  for (const std::string &code : codes) {
+    const auto found = spellings.find(code);
+    const std::set<ime_pinyin::uint16> expected =
+        (found != spellings.end()) ? found->second
+                                   : std::set<ime_pinyin::uint16>();
+    const auto next = spellings.upper_bound(code);
+    const bool expected_pre = (next != spellings.end()) &&
+                              (next->first.compare(0, code.size(), code) == 0);
+
+    ime_pinyin::uint16 splids[ime_pinyin::kMaxSearchSteps];
+    bool is_pre = false;
+    const ime_pinyin::uint16 num = parser.get_splids_t9(
+        code.c_str(), code.size(), splids, ime_pinyin::kMaxSearchSteps,
+        &is_pre);
+    if ((std::set<ime_pinyin::uint16>(splids, splids + num) != expected) ||
+        (is_pre != expected_pre)) {
+      std::fprintf(stderr, "error: %s: the T9 index differs from the "
+                   "spellings\n", code.c_str());
+      failures++;
+    }
+  }
+
+  // Digits which type nothing.
+  for (const char *code : {"1", "0", "99999"}) {
+    ime_pinyin::uint16 splids[ime_pinyin::kMaxSearchSteps];
+    bool is_pre = true;
+    if ((parser.get_splids_t9(code, std::strlen(code), splids,
+                              ime_pinyin::kMaxSearchSteps, &is_pre) != 0) ||
+        is_pre) {
+      std::fprintf(stderr, "error: %s: types spellings\n", code);
+      failures++;
+    }
+  }
+  std::printf("index: %zu digit strings of spellings, %zu with prefixes\n",
+              spellings.size(), codes.size());
+  return failures;
+}
+
+// Returns the number of keys of keys that the current mode decodes.
+std::size_t decoded_keys(const char *keys) {
+  ime_pinyin::im_reset_search();
+  ime_pinyin::im_search(keys, std::strlen(keys));
+  std::size_t decoded_len = 0;
+  ime_pinyin::im_get_sps_str(&decoded_len);
+  return decoded_len;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::fprintf(stderr, "Usage: %s DICT\n", argv[0]);
+    return 1;
+  }
+  if (!ime_pinyin::im_open_decoder(argv[1], "")) {
+    std::fprintf(stderr, "error: failed to open %s\n", argv[1]);
+    return 1;
+  }
+
+  std::size_t failures = test_index();
+  for (const Sentence &sentence : SENTENCES) {
+    ime_pinyin::im_set_t9(true);
+    const std::u16string t9 = type_keys(sentence.digits);
+    if (first(t9) != sentence.expected) {
+      std::fprintf(stderr, "error: %s: not the expected sentence\n",
+                   sentence.digits);
+      failures++;
+    }
+
+    // Switching resets the search, and digits are not input of QWERTY.
+    ime_pinyin::im_set_t9(false);
+    std::size_t decoded_len = 1;
+    ime_pinyin::im_get_sps_str(&decoded_len);
+    if (decoded_len != 0) {
+      std::fprintf(stderr, "error: %s: the search is kept after switching "
+                   "to QWERTY\n", sentence.digits);
+      failures++;
+    }
+    if (decoded_keys(sentence.digits) != 0) {
+      std::fprintf(stderr, "error: %s: digits are decoded in QWERTY mode\n",
+                   sentence.digits);
+      failures++;
+    }
+    const std::u16string qwerty = type_keys(sentence.pinyin);
+    if (first(qwerty) != sentence.expected) {
+      std::fprintf(stderr, "error: %s: not the expected sentence\n",
+                   sentence.pinyin);
+      failures++;
+    }
+
+    ime_pinyin::im_set_t9(true);
+    ime_pinyin::im_get_sps_str(&decoded_len);
+    if (decoded_len != 0) {
+      std::fprintf(stderr, "error: %s: the search is kept after switching "
+                   "to T9\n", sentence.pinyin);
+      failures++;
+    }
+    if (decoded_keys(sentence.pinyin) != 0) {
+      std::fprintf(stderr, "error: %s: letters are decoded in T9 mode\n",
+                   sentence.pinyin);
+      failures++;
+    }
+    if (type_keys(sentence.digits) != t9) {
+      std::fprintf(stderr, "error: %s: the candidates differ after "
+                   "switching back\n", sentence.digits);
+      failures++;
+    }
+  }
+
+  ime_pinyin::im_set_t9(true);
+  for (const char *digits : LONG_DIGITS) {
+    if (type_keys(digits).empty()) {
+      failures++;
+    }
+  }
+
+  ime_pinyin::im_set_t9(false);
+  ime_pinyin::im_close_decoder();
+  std::printf("sentences: %zu, long strings: %zu, failures: %zu\n",
+              sizeof(SENTENCES) / sizeof(SENTENCES[0]),
+              sizeof(LONG_DIGITS) / sizeof(LONG_DIGITS[0]), failures);
+  return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,337 @@
+// Replays a fixed script of decoder operations and compares the candidates,
+// choices and predictions with a recorded trace.
+//
+// The script types random spellings letter by letter, sometimes deleting
+// the last letter. It fetches pages of candidates from random positions,
+// sometimes all of them. It chooses candidates, cancels choices, deletes
+// spelling ids, and fetches the predictions after the sentence candidate.
+// Every step writes a line of the trace. The script is generated from a
+// fixed seed with std::minstd_rand, which gives the same numbers on all
+// platforms.
+//
+// The candidates are sorted lazily, a page at a time (see
+// MatrixSearch::sort_candidates()), so the trace checks that the order does
+// not depend on which candidates were asked for first. With --record the
+// trace is written instead of compared; record it again only when the
+// order is meant to change.
+//
+// No user dictionary is opened, so the trace only depends on the system
+// dictionary.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "pinyinime.h"
+
+namespace {
+
+using ime_pinyin::char16;
+using ime_pinyin::ImSession;
+
+// Initials alone are left out. Their lemma lists are long enough to trip
+// the assertions in MatrixSearch::get_lpis() in debug builds.
+const char *const SYLLABLES[] = {
+    "zhong", "hua", "ren", "min", "gong", "he", "guo", "wan", "sui", "shi",
+    "jie", "wo", "men", "yi", "qi", "qu", "kan", "dian", "ying", "ran",
+    "hou", "chi", "fan", "hao", "bu", "jin", "tian", "hen", "xian", "zai",
+    "jian", "le", "ni", "gai", "hui", "jia", "shui", "jiao", "a", "e",
+    "ou", "ang", "er", "'",
+};
+
+constexpr std::size_t SYLLABLE_NUM = sizeof(SYLLABLES) / sizeof(SYLLABLES[0]);
+
+// The number of spellings in the script.
+constexpr std::size_t INPUT_NUM = 300;
+
+// The number of candidates shown as the first page.
+constexpr std::size_t FIRST_PAGE = 10;
+
+constexpr std::size_t CAND_MAX_LEN = ime_pinyin::kMaxSearchSteps + 1;
+
+void print_usage(const char *cmd) {
+  std::fprintf(stderr,
+               "Usage: %s [OPTION]... DICT TRACE\n\n"
+               "Options:\n"
+               "  -r, --record        write TRACE instead of comparing with it\n"
+               "  -h, --help          print this help\n",
+               cmd);
+}
+
+void append_utf8(std::string &line, const char16 *str) {
+  for (; *str != 0; ++str) {
+    const unsigned c = *str;
+    if (c < 0x80) {
+      line += static_cast<char>(c);
+    } else if (c < 0x800) {
+      line += static_cast<char>(0xc0 | (c >> 6));
+      line += static_cast<char>(0x80 | (c & 0x3f));
+    } else {
+      line += static_cast<char>(0xe0 | (c >> 12));
+      line += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+      line += static_cast<char>(0x80 | (c & 0x3f));
+    }
+  }
+}
+
+class Script {
+ public:
+  explicit Script(ImSession *session) : session_(session), random_(44) {}
+
+  std::vector<std::string> run() {
+    for (std::size_t i = 0; i < INPUT_NUM; ++i) {
+      run_input();
+    }
+    return std::move(lines_);
+  }
+
+ private:
+  ImSession *session_;
+  std::minstd_rand random_;
+  std::vector<std::string> lines_;
+  std::size_t cand_num_ = 0;
+
+  std::size_t next(std::size_t bound) {
+    return random_() % bound;
+  }
+
+  // The decoded spelling, the fixed length, and the first page.
+  void dump(const char *step) {
+    std::size_t decoded_len = 0;
+    const char *sps = ime_pinyin::im_session_get_sps_str(session_,
+                                                         &decoded_len);
+    std::string line = step;
+    line += ' ';
+    line += sps;
+    line += " decoded=" + std::to_string(decoded_len);
+    line += " fixed=" +
+            std::to_string(ime_pinyin::im_session_get_fixed_len(session_));
+    line += " num=" + std::to_string(cand_num_) + ':';
+    char16 cand[CAND_MAX_LEN];
+    for (std::size_t i = 0; (i < cand_num_) && (i < FIRST_PAGE); ++i) {
+      if (ime_pinyin::im_session_get_candidate(session_, i, cand,
+                                               CAND_MAX_LEN) == nullptr) {
+        break;
+      }
+      line += ' ';
+      append_utf8(line, cand);
+    }
+    lines_.push_back(line);
+  }
+
+  // A page of count candidates from start, fetched in one call.
+  void dump_page(std::size_t start, std::size_t count) {
+    std::vector<char16> buf(count * CAND_MAX_LEN);
+    const std::size_t num = ime_pinyin::im_session_get_candidates(
+        session_, start, count, buf.data(), buf.size());
+    std::string line = "page " + std::to_string(start) + '+' +
+                       std::to_string(num) + ':';
+    const char16 *cand = buf.data();
+    for (std::size_t i = 0; i < num; ++i) {
+      line += ' ';
+      append_utf8(line, cand);
+      while (*cand != 0) {
+        ++cand;
+      }
+      ++cand;
+    }
+    lines_.push_back(line);
+  }
+
+  void search(const std::string &spelling) {
+    cand_num_ = ime_pinyin::im_session_search(session_, spelling.c_str(),
+                                              spelling.length());
+  }
+
+  void run_input() {
+    std::string spelling;
+    const std::size_t target = 5 + next(45);
+    while (spelling.length() < target) {
+      spelling += SYLLABLES[next(SYLLABLE_NUM)];
+    }
+    lines_.push_back("input " + spelling);
+
+    ime_pinyin::im_session_reset_search(session_);
+    cand_num_ = 0;
+    for (std::size_t len = 1; len <= spelling.length(); ++len) {
+      search(spelling.substr(0, len));
+      // Short spellings have the most candidates, up to about 1400.
+      if ((len <= 2) && (cand_num_ > 0) && (next(3) == 0)) {
+        dump_page(next(cand_num_), 1 + next(20));
+      }
+      if (next(8) == 0) {
+        dump("search");
+      }
+      if ((len > 2) && (next(10) == 0)) {
+        search(spelling.substr(0, len - 1));
+        dump("back");
+        search(spelling.substr(0, len));
+      }
+    }
+    dump("search");
+
+    // Pages from random positions, deep ones included, before the first
+    // page has been asked for in some inputs.
+    const std::size_t page_num = next(4);
+    for (std::size_t p = 0; (p < page_num) && (cand_num_ > 0); ++p) {
+      dump_page(next(cand_num_), 1 + next(20));
+    }
+    if ((cand_num_ > 0) && (next(10) == 0)) {
+      dump_page(0, cand_num_);
+    }
+
+    char16 sentence[CAND_MAX_LEN] = {0};
+    if (cand_num_ > 0) {
+      ime_pinyin::im_session_get_candidate(session_, 0, sentence,
+                                           CAND_MAX_LEN);
+    }
+
+    // A choice can split the rest of the spelling differently. Choosing
+    // again after that is not supported by the decoder (choose() asserts,
+    // cancel_last_choice() can crash), so the script stops choosing then.
+    const ime_pinyin::uint16 *spl_start = nullptr;
+    const std::size_t spl_num =
+        ime_pinyin::im_session_get_spl_start_pos(session_, spl_start);
+    for (std::size_t c = 0; c < 3; ++c) {
+      if ((ime_pinyin::im_session_get_fixed_len(session_) >= spl_num) ||
+          (cand_num_ < 3)) {
+        break;
+      }
+      cand_num_ = ime_pinyin::im_session_choose(session_, next(3));
+      dump("choose");
+      const std::size_t chosen_spl_num =
+          ime_pinyin::im_session_get_spl_start_pos(session_, spl_start);
+      if (chosen_spl_num != spl_num) {
+        break;
+      }
+    }
+    if (next(2) == 0) {
+      cand_num_ = ime_pinyin::im_session_cancel_last_choice(session_);
+      dump("cancel");
+    }
+    if (next(3) == 0) {
+      cand_num_ = ime_pinyin::im_session_delsearch(session_, next(4), false,
+                                                   false);
+      dump("delete");
+    }
+
+    if (sentence[0] != 0) {
+      char16 (*predicts)[ime_pinyin::kMaxPredictSize + 1] = nullptr;
+      const std::size_t predict_num =
+          ime_pinyin::im_session_get_predicts(session_, sentence, predicts);
+      std::string line = "predict " + std::to_string(predict_num) + ':';
+      for (std::size_t i = 0; i < predict_num; ++i) {
+        line += ' ';
+        append_utf8(line, predicts[i]);
+      }
+      lines_.push_back(line);
+    }
+  }
+};
+
+bool read_trace(const char *filename, std::vector<std::string> &lines) {
+  std::FILE *file = std::fopen(filename, "r");
+  if (file == nullptr) {
+    return false;
+  }
+  std::string line;
+  int c;
+  while ((c = std::fgetc(file)) != EOF) {
+    if (c == '\n') {
+      lines.push_back(line);
+      line.clear();
+    } else {
+      line += static_cast<char>(c);
+    }
+  }
+  std::fclose(file);
+  return true;
+}
+
+bool write_trace(const char *filename, const std::vector<std::string> &lines) {
+  std::FILE *file = std::fopen(filename, "w");
+  if (file == nullptr) {
+    return false;
+  }
+  for (const std::string &line : lines) {
+    std::fputs(line.c_str(), file);
+    std::fputc('\n', file);
+  }
+  return std::fclose(file) == 0;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  bool record = false;
+  const char *dict = nullptr;
+  const char *trace = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if ((std::strcmp(arg, "-h") == 0) || (std::strcmp(arg, "--help") == 0)) {
+      print_usage(argv[0]);
+      return 0;
+    } else if ((std::strcmp(arg, "-r") == 0) ||
+               (std::strcmp(arg, "--record") == 0)) {
+      record = true;
+    } else if ((arg[0] != '-') && (dict == nullptr)) {
+      dict = arg;
+    } else if ((arg[0] != '-') && (trace == nullptr)) {
+      trace = arg;
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if ((dict == nullptr) || (trace == nullptr)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  if (!ime_pinyin::im_open_decoder(dict, "")) {
+    std::fprintf(stderr, "error: failed to open %s\n", dict);
+    return 1;
+  }
+  ImSession *session = ime_pinyin::im_open_session();
+  if (session == nullptr) {
+    std::fprintf(stderr, "error: failed to open a session\n");
+    ime_pinyin::im_close_decoder();
+    return 1;
+  }
+  const std::vector<std::string> lines = Script(session).run();
+  ime_pinyin::im_close_session(session);
+  ime_pinyin::im_close_decoder();
+
+  if (record) {
+    if (!write_trace(trace, lines)) {
+      std::fprintf(stderr, "error: failed to write %s\n", trace);
+      return 1;
+    }
+    std::printf("recorded %zu lines\n", lines.size());
+    return 0;
+  }
+
+  std::vector<std::string> expected;
+  if (!read_trace(trace, expected)) {
+    std::fprintf(stderr, "error: failed to read %s\n", trace);
+    return 1;
+  }
+  std::size_t mismatches = 0;
+  for (std::size_t i = 0; (i < lines.size()) || (i < expected.size()); ++i) {
+    const std::string line = (i < lines.size()) ? lines[i] : "";
+    const std::string want = (i < expected.size()) ? expected[i] : "";
+    if (line != want) {
+      if (mismatches < 5) {
+        std::fprintf(stderr, "line %zu:\n  expected: %s\n  actual:   %s\n",
+                     i + 1, want.c_str(), line.c_str());
+      }
+      mismatches++;
+    }
+  }
+  std::printf("lines: %zu, mismatches: %zu\n", expected.size(), mismatches);
+  return (mismatches == 0) ? 0 : 1;
+}
@@ -0,0 +1,280 @@
+// Checks the spelling id index of a user dictionary against a brute force
+// search of the lemmas put.
+//
+// Random lemmas are put, and some of them removed again. get_lemma_id() must
+// find exactly the lemmas in use, get_lpis() must give the lemmas in use
+// whose spelling ids match, for full ids and for half ids which span several
+// full ones, and predict() must give the lemmas in use which start with the
+// given characters. This is checked while the removed lemmas are only
+// flagged, after they are dropped by defragment(), and after the dictionary
+// is loaded again.
+//
+// The user dictionary is created at USER_DICT and removed at the end.
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "dictdef.h"
+#include "pinyinime.h"
+#include "searchutility.h"
+#include "spellingtrie.h"
+#include "splparser.h"
+#include "userdict.h"
+
+namespace {
+
+using ime_pinyin::char16;
+using ime_pinyin::LemmaIdType;
+using ime_pinyin::uint16;
+using ime_pinyin::UserDict;
+
+// Several syllables share their initials, so that a half id spans several
+// full ids.
+const char *const SYLLABLES[] = {
+    "zhong", "zhang", "zhi", "zu",  "shi", "shang", "su",  "ni",
+    "na",    "hao",   "he",  "hua", "ren", "ri",    "guo", "ge",
+};
+
+constexpr std::size_t SYLLABLE_NUM = sizeof(SYLLABLES) / sizeof(SYLLABLES[0]);
+
+constexpr std::size_t PUTS = 2000;
+
+// Large enough for all the lemmas a query may give.
+constexpr std::size_t ITEMS_MAX = 1024;
+
+struct Lemma {
+  std::vector<uint16> splids;
+  bool removed = false;
+};
+
+// The lemmas put, by their words. Each syllable has its own character, so
+// that a word has one spelling.
+typedef std::map<std::u16string, Lemma> Lemmas;
+
+void remove_user_dict(const char *user_dict) {
+  std::remove(user_dict);
+  std::remove((std::string(user_dict) + ".journal").c_str());
+}
+
+LemmaIdType get_lemma_id(UserDict &dict, const std::u16string &word,
+                         const Lemma &lemma) {
+  std::u16string buf = word;
+  std::vector<uint16> splids = lemma.splids;
+  return dict.get_lemma_id(reinterpret_cast<char16 *>(&buf[0]), splids.data(),
+                           buf.size());
+}
+
+std::u16string get_word(UserDict &dict, LemmaIdType id) {
+  char16 word[ime_pinyin::kMaxLemmaSize + 1];
+  const uint16 length =
+      dict.get_lemma_str(id, word, ime_pinyin::kMaxLemmaSize + 1);
+  return std::u16string(reinterpret_cast<const char16_t *>(word), length);
+}
+
+// The words get_lpis() gives for splids.
+std::set<std::u16string> get_lpis(UserDict &dict,
+                                  const std::vector<uint16> &splids) {
+  static ime_pinyin::LmaPsbItem items[ITEMS_MAX];
+  const std::size_t num =
+      dict.get_lpis(splids.data(), splids.size(), items, ITEMS_MAX);
+  std::set<std::u16string> words;
+  for (std::size_t i = 0; i < num; ++i) {
+    words.insert(get_word(dict, items[i].id));
+  }
+  return words;
+}
+
+// The words of the lemmas in use whose spelling ids match splids, where a
+// half id matches the full ids it spans.
+std::set<std::u16string> brute_force_lpis(const Lemmas &lemmas,
+                                          const std::vector<uint16> &splids) {
+  const ime_pinyin::SpellingTrie &trie =
+      ime_pinyin::SpellingTrie::get_instance();
+  std::set<std::u16string> words;
+  for (const auto &entry : lemmas) {
+    const Lemma &lemma = entry.second;
+    if (lemma.removed || (lemma.splids.size() != splids.size())) {
+      continue;
+    }
+    bool match = true;
+    for (std::size_t i = 0; (i < splids.size()) && match; ++i) {
+      match = trie.is_half_id(splids[i])
+                  ? trie.half_full_compatible(splids[i], lemma.splids[i])
+                  : (splids[i] == lemma.splids[i]);
+    }
+    if (match) {
+      words.insert(entry.first);
+    }
+  }
+  return words;
+}
+
+// The words predict() gives for the characters of prefix.
+std::set<std::u16string> predict(UserDict &dict,
+                                 const std::u16string &prefix) {
+  static ime_pinyin::NPredictItem items[ITEMS_MAX];
+  const std::size_t num =
+      dict.predict(reinterpret_cast<const char16 *>(prefix.data()),
+                   prefix.size(), items, ITEMS_MAX, 0);
+  std::set<std::u16string> words;
+  for (std::size_t i = 0; i < num; ++i) {
+    words.insert(prefix +
+                 reinterpret_cast<const char16_t *>(items[i].pre_hzs));
+  }
+  return words;
+}
+
+std::set<std::u16string> brute_force_predict(const Lemmas &lemmas,
+                                             const std::u16string &prefix) {
+  std::set<std::u16string> words;
+  for (const auto &entry : lemmas) {
+    if (!entry.second.removed && (entry.first.size() > prefix.size()) &&
+        (entry.first.compare(0, prefix.size(), prefix) == 0)) {
+      words.insert(entry.first);
+    }
+  }
+  return words;
+}
+
+std::size_t check(UserDict &dict, const Lemmas &lemmas, const char *phase) {
+  const ime_pinyin::SpellingTrie &trie =
+      ime_pinyin::SpellingTrie::get_instance();
+  std::size_t failures = 0;
+  std::size_t queries = 0;
+  std::set<std::vector<uint16>> queried;
+  std::set<std::u16string> prefixes;
+  for (const auto &entry : lemmas) {
+    const Lemma &lemma = entry.second;
+    const LemmaIdType id = get_lemma_id(dict, entry.first, lemma);
+    if ((id == 0) != lemma.removed) {
+      std::fprintf(stderr, "error: %s: a lemma %s\n", phase,
+                   lemma.removed ? "is found after it was removed"
+                                 : "in use is not found");
+      failures++;
+    } else if ((id != 0) && (get_word(dict, id) != entry.first)) {
+      std::fprintf(stderr, "error: %s: an id gives another lemma\n", phase);
+      failures++;
+    }
+
+    // The full ids, the half ids, and the first id half only.
+    std::vector<uint16> half = lemma.splids;
+    for (uint16 &splid : half) {
+      splid = trie.full_to_half(splid);
+    }
+    std::vector<uint16> first_half = lemma.splids;
+    first_half[0] = half[0];
+    for (const std::vector<uint16> &splids : {lemma.splids, half, first_half}) {
+      if (!queried.insert(splids).second) {
+        continue;
+      }
+      queries++;
+      if (get_lpis(dict, splids) != brute_force_lpis(lemmas, splids)) {
+        std::fprintf(stderr, "error: %s: get_lpis() differs for %zu spelling "
+                     "ids\n", phase, splids.size());
+        failures++;
+      }
+    }
+    prefixes.insert(entry.first.substr(0, 1));
+    prefixes.insert(entry.first.substr(0, 2));
+  }
+
+  for (const std::u16string &prefix : prefixes) {
+    queries++;
+    if (predict(dict, prefix) != brute_force_predict(lemmas, prefix)) {
+      std::fprintf(stderr, "error: %s: predict() differs for %zu "
+                   "characters\n", phase, prefix.size());
+      failures++;
+    }
+  }
+  std::printf("%s: %zu lemmas, %zu queries, %zu failures\n", phase,
+              lemmas.size(), queries, failures);
+  return failures;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    std::fprintf(stderr, "Usage: %s DICT USER_DICT\n", argv[0]);
+    return 1;
+  }
+  const char *user_dict = argv[2];
+
+  // The spelling table comes with the system dictionary.
+  if (!ime_pinyin::im_open_decoder(argv[1], "")) {
+    std::fprintf(stderr, "error: failed to open %s\n", argv[1]);
+    return 1;
+  }
+  ime_pinyin::SpellingParser parser;
+  uint16 splids[SYLLABLE_NUM];
+  for (std::size_t s = 0; s < SYLLABLE_NUM; ++s) {
+    bool is_pre = false;
+    splids[s] = parser.get_splid_by_str(SYLLABLES[s], std::strlen(SYLLABLES[s]),
+                                        &is_pre);
+  }
+
+  remove_user_dict(user_dict);
+  UserDict *dict = new UserDict();
+  if (!dict->load_dict(user_dict, ime_pinyin::kUserDictIdStart,
+                       ime_pinyin::kUserDictIdEnd)) {
+    std::fprintf(stderr, "error: failed to open %s\n", user_dict);
+    return 1;
+  }
+
+  // Lemmas of one to four syllables.
+  std::minstd_rand random(1);
+  Lemmas lemmas;
+  std::size_t failures = 0;
+  for (std::size_t n = 0; n < PUTS; ++n) {
+    std::u16string word;
+    Lemma lemma;
+    const std::size_t length = 1 + random() % 4;
+    for (std::size_t i = 0; i < length; ++i) {
+      const std::size_t s = random() % SYLLABLE_NUM;
+      word += static_cast<char16_t>(0x4e00 + s);
+      lemma.splids.push_back(splids[s]);
+    }
+    std::u16string buf = word;
+    if (dict->put_lemma(reinterpret_cast<char16 *>(&buf[0]),
+                        lemma.splids.data(), buf.size(), 1) == 0) {
+      std::fprintf(stderr, "error: failed to put a lemma\n");
+      failures++;
+      break;
+    }
+    lemmas[word] = lemma;
+  }
+
+  // Every third lemma is removed.
+  std::size_t n = 0;
+  for (auto &entry : lemmas) {
+    if ((n++ % 3 == 0) &&
+        dict->remove_lemma(get_lemma_id(*dict, entry.first, entry.second))) {
+      entry.second.removed = true;
+    }
+  }
+  failures += check(*dict, lemmas, "removed");
+
+  dict->defragment();
+  failures += check(*dict, lemmas, "defragmented");
+  delete dict;
+
+  dict = new UserDict();
+  if (!dict->load_dict(user_dict, ime_pinyin::kUserDictIdStart,
+                       ime_pinyin::kUserDictIdEnd)) {
+    std::fprintf(stderr, "error: failed to load %s again\n", user_dict);
+    failures++;
+  } else {
+    failures += check(*dict, lemmas, "reloaded");
+  }
+  delete dict;
+
+  ime_pinyin::im_close_decoder();
+  remove_user_dict(user_dict);
+  std::printf("failures: %zu\n", failures);
+  return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+// Checks that a user dictionary under a long run of insertions and
+// deletions stays within its limits, in memory and on disk, and that the
+// lemma ids held by the decoder stay valid.
+//
+// Random lemmas are put into a dictionary with a small lemma count limit,
+// and some of those put recently are removed again. Removed lemmas are
+// dropped from memory while the dictionary is open, which must not change
+// the ids of the other lemmas: an id which was handed out must give its own
+// lemma, or nothing once the lemma is gone, and never another lemma. The
+// dictionary is closed and loaded again at the end, and the lemmas in use
+// must still be there.
+//
+// The user dictionary is created at USER_DICT and removed at the end.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "dictdef.h"
+#include "pinyinime.h"
+#include "splparser.h"
+#include "userdict.h"
+
+namespace {
+
+using ime_pinyin::char16;
+using ime_pinyin::LemmaIdType;
+using ime_pinyin::UserDict;
+
+const char *const SYLLABLES[] = {
+    "zhong", "hua", "ren", "min", "gong", "he", "guo", "wan",
+    "sui",   "shi", "jie", "wo",  "men",  "yi", "qi",  "qu",
+};
+
+constexpr std::size_t SYLLABLE_NUM = sizeof(SYLLABLES) / sizeof(SYLLABLES[0]);
+
+constexpr std::size_t LIMIT_LEMMA_COUNT = 300;
+constexpr std::size_t RECLAIM_RATIO = 20;
+constexpr std::size_t ROUNDS = 20000;
+
+// The lemmas in memory, including the removed ones, may be a third more
+// than the limit before they are dropped, and the buffers grow by a quarter.
+constexpr std::size_t MAX_LEMMA_COUNT = LIMIT_LEMMA_COUNT * 2;
+
+// The number of recently put lemmas whose ids are kept.
+constexpr std::size_t HELD_LEMMAS = 64;
+
+struct Lemma {
+  std::u16string word;
+  std::vector<ime_pinyin::uint16> splids;
+  LemmaIdType id = 0;
+};
+
+void remove_user_dict(const char *user_dict) {
+  std::remove(user_dict);
+  std::remove((std::string(user_dict) + ".journal").c_str());
+}
+
+// A lemma of two to four syllables. Each syllable has its own character, so
+// that different lemmas have different words.
+Lemma make_lemma(std::minstd_rand &random,
+                 const ime_pinyin::uint16 (&splids)[SYLLABLE_NUM]) {
+  Lemma lemma;
+  const std::size_t length = 2 + random() % 3;
+  for (std::size_t i = 0; i < length; ++i) {
+    const std::size_t s = random() % SYLLABLE_NUM;
+    lemma.word += static_cast<char16_t>(0x4e00 + s);
+    lemma.splids.push_back(splids[s]);
+  }
+  return lemma;
+}
+
+bool put_lemma(UserDict &dict, Lemma &lemma) {
+  lemma.id = dict.put_lemma(reinterpret_cast<char16 *>(&lemma.word[0]),
+                            lemma.splids.data(), lemma.word.size(), 1);
+  return lemma.id != 0;
+}
+
+// The id of lemma must give the lemma, or nothing if the lemma was removed.
+bool check_id(UserDict &dict, const Lemma &lemma) {
+  char16 word[ime_pinyin::kMaxLemmaSize + 1];
+  const ime_pinyin::uint16 length =
+      dict.get_lemma_str(lemma.id, word, ime_pinyin::kMaxLemmaSize + 1);
+  if ((length != 0) &&
+      (std::u16string(reinterpret_cast<const char16_t *>(word), length)
+       != lemma.word)) {
+    std::fprintf(stderr, "error: id %u gives another lemma\n",
+                 static_cast<unsigned>(lemma.id));
+    return false;
+  }
+  return true;
+}
+
+bool check_limits(UserDict &dict, std::size_t round) {
+  UserDict::UserDictStat stat;
+  if (!dict.state(&stat)) {
+    std::fprintf(stderr, "error: the dictionary is not open\n");
+    return false;
+  }
+  if ((stat.lemma_count - stat.delete_count > LIMIT_LEMMA_COUNT) ||
+      (stat.lemma_count > MAX_LEMMA_COUNT)) {
+    std::fprintf(stderr,
+                 "error: round %zu: %u lemmas, %u of them removed\n", round,
+                 static_cast<unsigned>(stat.lemma_count),
+                 static_cast<unsigned>(stat.delete_count));
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    std::fprintf(stderr, "Usage: %s DICT USER_DICT\n", argv[0]);
+    return 1;
+  }
+  const char *user_dict = argv[2];
+
+  // The spelling table comes with the system dictionary.
+  if (!ime_pinyin::im_open_decoder(argv[1], "")) {
+    std::fprintf(stderr, "error: failed to open %s\n", argv[1]);
+    return 1;
+  }
+  ime_pinyin::SpellingParser parser;
+  ime_pinyin::uint16 splids[SYLLABLE_NUM];
+  for (std::size_t s = 0; s < SYLLABLE_NUM; ++s) {
+    bool is_pre = false;
+    splids[s] = parser.get_splid_by_str(SYLLABLES[s], std::strlen(SYLLABLES[s]),
+                                        &is_pre);
+  }
+
+  remove_user_dict(user_dict);
+  UserDict *dict = new UserDict();
+  if (!dict->load_dict(user_dict, ime_pinyin::kUserDictIdStart,
+                       ime_pinyin::kUserDictIdEnd)) {
+    std::fprintf(stderr, "error: failed to open %s\n", user_dict);
+    return 1;
+  }
+  dict->set_limit(LIMIT_LEMMA_COUNT, 0, RECLAIM_RATIO);
+
+  std::minstd_rand random(1);
+  std::vector<Lemma> held;
+  std::size_t failures = 0;
+  std::size_t removed = 0;
+  for (std::size_t round = 0; (round < ROUNDS) && (failures == 0); ++round) {
+    Lemma lemma = make_lemma(random, splids);
+    if (put_lemma(*dict, lemma)) {
+      if (held.size() == HELD_LEMMAS) {
+        held.erase(held.begin() + random() % HELD_LEMMAS);
+      }
+      held.push_back(lemma);
+    }
+    if ((round % 3 == 0) && !held.empty() &&
+        dict->remove_lemma(held[random() % held.size()].id)) {
+      removed++;
+    }
+    for (const Lemma &h : held) {
+      if (!check_id(*dict, h)) {
+        failures++;
+        break;
+      }
+    }
+    if (!check_limits(*dict, round)) {
+      failures++;
+    }
+  }
+
+  // The lemmas still in use must be found by their words after a reload.
+  std::vector<Lemma> in_use;
+  for (Lemma &h : held) {
+    if (dict->get_lemma_id(reinterpret_cast<char16 *>(&h.word[0]),
+                           h.splids.data(), h.word.size()) == h.id) {
+      in_use.push_back(h);
+    }
+  }
+  UserDict::UserDictStat stat;
+  dict->state(&stat);
+  const std::size_t disk_size = stat.disk_size;
+  delete dict;
+
+  dict = new UserDict();
+  if (!dict->load_dict(user_dict, ime_pinyin::kUserDictIdStart,
+                       ime_pinyin::kUserDictIdEnd)) {
+    std::fprintf(stderr, "error: failed to load %s again\n", user_dict);
+    failures++;
+  } else {
+    for (Lemma &h : in_use) {
+      if (dict->get_lemma_id(reinterpret_cast<char16 *>(&h.word[0]),
+                             h.splids.data(), h.word.size()) == 0) {
+        std::fprintf(stderr, "error: a lemma is lost after a reload\n");
+        failures++;
+        break;
+      }
+    }
+    if (!check_limits(*dict, ROUNDS)) {
+      failures++;
+    }
+  }
+  delete dict;
+  ime_pinyin::im_close_decoder();
+  remove_user_dict(user_dict);
+
+  std::printf("rounds: %zu, removed: %zu, lemmas in use: %zu of %zu held, "
+              "file size: %zu\n", ROUNDS, removed, in_use.size(), held.size(),
+              disk_size);
+  return (failures == 0) ? 0 : 1;
+}
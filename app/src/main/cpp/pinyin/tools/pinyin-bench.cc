@@ -0,0 +1,282 @@
+// Measures how the decoding time grows with the length of a pinyin sentence.
+//
+// Each sentence is typed letter by letter on a new search, the way the
+// keyboard calls im_search(), and the time of each key stroke is recorded.
+// Each prefix is also searched from an empty search space, which costs the
+// sum of the key strokes before it; that time divided by the length stays
+// flat when the decoder is linear in the input length.
+//
+// With --compare, the same sentences are also typed on a second dictionary,
+// for example one built without bigrams, and the average time of a key
+// stroke on both is printed.
+//
+// FILE has one pinyin sentence per line. Without FILE, a built-in list of
+// sentences of 30 to 40 letters is used. Sentences are cut at the maximum
+// length that the decoder accepts, and every prefix must be decoded to its
+// whole length, otherwise the timing is not of the whole input and the
+// program fails.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "pinyinime.h"
+
+namespace {
+
+using ime_pinyin::char16;
+
+const char *const SENTENCES[] = {
+    "zhonghuarenmingongheguochengliyuyijiusijiunian",
+    "womenyiqiqukandianyingranhouchifanhaobuhao",
+    "jintiantianqihenhaowomenqugongyuansanbuba",
+    "xianzaishijianbuzaoleniyinggaihuijiashuijiao",
+    "zhegewentiwomenxuyaozaikaolvyixiazaijueding",
+    "tamenzuotianwanshangzaijiaokanlelianggedianying",
+    "qingnibawenjianfadaowodeyouxiangliwoxiawukan",
+    "zhuangjiadedongxijinnianchangdebutaihaoa",
+};
+
+// The decoder keeps at most kMaxSearchSteps - 1 letters.
+constexpr std::size_t MAX_LENGTH = ime_pinyin::kMaxSearchSteps - 1;
+
+struct Row {
+  double key_us = 0.0;
+  double full_us = 0.0;
+  double decoded_len = 0.0;
+  std::size_t count = 0;
+};
+
+struct Result {
+  std::vector<Row> rows = std::vector<Row>(MAX_LENGTH + 1);
+  std::size_t max_mtrx_nd = 0;
+  std::size_t mtrx_nd_capacity = 0;
+  std::size_t max_dmi = 0;
+  std::size_t dmi_capacity = 0;
+  // The number of searches which did not decode all their letters.
+  std::size_t truncated = 0;
+};
+
+void print_usage(const char *cmd) {
+  std::fprintf(stderr,
+               "Usage: %s [OPTION]... DICT [FILE]\n\n"
+               "Options:\n"
+               "  -n, --repeat=N      type each sentence N times (default: 20)\n"
+               "  -c, --compare=DICT  also type the sentences on DICT\n"
+               "  -h, --help          print this help\n",
+               cmd);
+}
+
+bool read_file(const char *path, std::vector<std::string> &sentences) {
+  std::ifstream file(path);
+  if (!file) {
+    std::fprintf(stderr, "error: failed to open %s\n", path);
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    if (!line.empty() && (line.back() == '\r')) {
+      line.pop_back();
+    }
+    if (!line.empty()) {
+      sentences.push_back(line);
+    }
+  }
+  return true;
+}
+
+double elapsed_us(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - begin)
+      .count();
+}
+
+// Searches the first length letters of sentence, and fetches the sentence
+// candidate, which is what the keyboard shows after each key stroke.
+std::size_t search(const std::string &sentence, std::size_t length) {
+  const std::string prefix = sentence.substr(0, length);
+  ime_pinyin::im_search(prefix.c_str(), prefix.size());
+
+  char16 candidate[ime_pinyin::kMaxSearchSteps + 1];
+  ime_pinyin::im_get_candidate(0, candidate, ime_pinyin::kMaxSearchSteps + 1);
+
+  std::size_t decoded_len = 0;
+  ime_pinyin::im_get_sps_str(&decoded_len);
+  return decoded_len;
+}
+
+// Types the sentences repeat times on the dictionary dict.
+bool measure(const char *dict, const std::vector<std::string> &sentences,
+             std::size_t repeat, Result &result) {
+  // No user dictionary, so that the results do not change between runs.
+  if (!ime_pinyin::im_open_decoder(dict, "")) {
+    std::fprintf(stderr, "error: failed to open %s\n", dict);
+    return false;
+  }
+
+  std::vector<Row> &rows = result.rows;
+  for (std::size_t r = 0; r < repeat; ++r) {
+    for (const std::string &sentence : sentences) {
+      ime_pinyin::im_reset_search();
+      for (std::size_t length = 1; length <= sentence.size(); ++length) {
+        const auto begin = std::chrono::steady_clock::now();
+        const std::size_t decoded_len = search(sentence, length);
+        rows[length].key_us += elapsed_us(begin);
+        rows[length].decoded_len += decoded_len;
+        rows[length].count++;
+        if (decoded_len != length) {
+          if (result.truncated == 0) {
+            std::fprintf(stderr, "error: %s: decoded %zu of %zu letters\n",
+                         sentence.substr(0, length).c_str(), decoded_len,
+                         length);
+          }
+          result.truncated++;
+        }
+
+        std::size_t mtrx_nd_used, dmi_used;
+        ime_pinyin::im_get_pool_stat(&mtrx_nd_used, &result.mtrx_nd_capacity,
+                                     &dmi_used, &result.dmi_capacity);
+        if (mtrx_nd_used > result.max_mtrx_nd) {
+          result.max_mtrx_nd = mtrx_nd_used;
+        }
+        if (dmi_used > result.max_dmi) {
+          result.max_dmi = dmi_used;
+        }
+      }
+
+      for (std::size_t length = 1; length <= sentence.size(); ++length) {
+        ime_pinyin::im_reset_search();
+        const auto begin = std::chrono::steady_clock::now();
+        search(sentence, length);
+        rows[length].full_us += elapsed_us(begin);
+      }
+    }
+  }
+
+  ime_pinyin::im_close_decoder();
+  return true;
+}
+
+// The average time of a key stroke.
+double average_key_us(const Result &result) {
+  double key_us = 0.0;
+  std::size_t count = 0;
+  for (const Row &row : result.rows) {
+    key_us += row.key_us;
+    count += row.count;
+  }
+  return (count > 0) ? (key_us / count) : 0.0;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  std::size_t repeat = 20;
+  const char *compare = nullptr;
+  std::vector<const char *> inputs;
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if ((std::strcmp(arg, "-h") == 0) || (std::strcmp(arg, "--help") == 0)) {
+      print_usage(argv[0]);
+      return 0;
+    } else if ((std::strcmp(arg, "-n") == 0) && (i + 1 < argc)) {
+      repeat = std::strtoul(argv[++i], nullptr, 10);
+    } else if (std::strncmp(arg, "--repeat=", 9) == 0) {
+      repeat = std::strtoul(arg + 9, nullptr, 10);
+    } else if ((std::strcmp(arg, "-c") == 0) && (i + 1 < argc)) {
+      compare = argv[++i];
+    } else if (std::strncmp(arg, "--compare=", 10) == 0) {
+      compare = arg + 10;
+    } else if (arg[0] != '-') {
+      inputs.push_back(arg);
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (inputs.empty() || (inputs.size() > 2) || (repeat == 0)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<std::string> sentences;
+  if (inputs.size() == 2) {
+    if (!read_file(inputs[1], sentences)) {
+      return 1;
+    }
+  } else {
+    sentences.assign(std::begin(SENTENCES), std::end(SENTENCES));
+  }
+  for (std::string &sentence : sentences) {
+    if (sentence.size() > MAX_LENGTH) {
+      sentence.resize(MAX_LENGTH);
+    }
+  }
+
+  Result result;
+  if (!measure(inputs[0], sentences, repeat, result)) {
+    return 1;
+  }
+  Result compared;
+  if ((compare != nullptr) &&
+      !measure(compare, sentences, repeat, compared)) {
+    return 1;
+  }
+
+  const std::vector<Row> &rows = result.rows;
+  std::printf("%6s %8s %10s %10s %14s\n", "length", "decoded", "key(us)",
+              "full(us)", "full/letter");
+  double min_per_letter = 0.0;
+  double max_per_letter = 0.0;
+  for (std::size_t length = 1; length < rows.size(); ++length) {
+    const Row &row = rows[length];
+    if (row.count == 0) {
+      continue;
+    }
+    const double full_us = row.full_us / row.count;
+    const double per_letter = full_us / length;
+    std::printf("%6zu %8.1f %10.1f %10.1f %14.2f\n", length,
+                row.decoded_len / row.count, row.key_us / row.count, full_us,
+                per_letter);
+    // Short prefixes are dominated by the fixed cost of a search.
+    if (length >= 10) {
+      if ((min_per_letter == 0.0) || (per_letter < min_per_letter)) {
+        min_per_letter = per_letter;
+      }
+      if (per_letter > max_per_letter) {
+        max_per_letter = per_letter;
+      }
+    }
+  }
+
+  std::printf("\nsentences: %zu, repeat: %zu\n", sentences.size(), repeat);
+  std::printf("full/letter from 10 letters: %.2f - %.2f us\n", min_per_letter,
+              max_per_letter);
+  std::printf("matrix nodes: max %zu used, capacity %zu\n", result.max_mtrx_nd,
+              result.mtrx_nd_capacity);
+  std::printf("dmi nodes: max %zu used, capacity %zu\n", result.max_dmi,
+              result.dmi_capacity);
+
+  if (compare != nullptr) {
+    const double key_us = average_key_us(result);
+    const double compared_key_us = average_key_us(compared);
+    std::printf("\nkey stroke: %.2f us, %.2f us on %s (%+.1f%%)\n", key_us,
+                compared_key_us, compare,
+                (compared_key_us > 0.0)
+                    ? ((key_us / compared_key_us - 1.0) * 100.0)
+                    : 0.0);
+  }
+
+  const std::size_t truncated = result.truncated + compared.truncated;
+  if (truncated > 0) {
+    std::fprintf(stderr, "error: %zu searches did not decode all letters\n",
+                 truncated);
+    return 1;
+  }
+  return 0;
+}
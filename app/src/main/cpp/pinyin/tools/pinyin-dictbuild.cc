@@ -0,0 +1,113 @@
+// Builds the binary dictionary, dict_pinyin.dat, from a raw lemma list.
+//
+// RAW is a UTF-16LE file with a BOM, and one lemma per line:
+//
+//   Hanzis frequency gbk_flag pinyin...
+//
+// with one pinyin for each Hanzi. Without --valid, lemmas whose gbk_flag is
+// not 0 are dropped; with it, lemmas with Hanzis outside the list are dropped.
+//
+// With --bigram, the bigrams used to score sentences are built from FILE, in
+// the same encoding, with one pair of lemmas per line:
+//
+//   Hanzis1 Hanzis2 frequency
+//
+// where frequency is how often Hanzis2 follows Hanzis1 in a corpus.
+//
+// OUT is written in the aligned layout that the decoder maps in place, and it
+// is the same for any number of jobs.
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "dicttrie.h"
+
+namespace {
+
+void print_usage(const char *cmd) {
+  std::fprintf(stderr,
+               "Usage: %s [OPTION]... RAW OUT\n\n"
+               "Options:\n"
+               "  -j, --jobs=N        build on N threads (default: number of "
+               "processors)\n"
+               "  -v, --valid=FILE    keep only the Hanzis listed in FILE, a "
+               "UTF-16LE file\n"
+               "  -b, --bigram=FILE   build the bigrams from FILE, a UTF-16LE "
+               "file\n"
+               "  -h, --help          print this help\n",
+               cmd);
+}
+
+std::size_t processor_num() {
+  const long num = sysconf(_SC_NPROCESSORS_ONLN);
+  return (num > 0) ? static_cast<std::size_t>(num) : 1;
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - begin)
+      .count();
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  std::size_t jobs = processor_num();
+  const char *valid_hzs = nullptr;
+  const char *bigrams = nullptr;
+  std::vector<const char *> inputs;
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if ((std::strcmp(arg, "-h") == 0) || (std::strcmp(arg, "--help") == 0)) {
+      print_usage(argv[0]);
+      return 0;
+    } else if ((std::strcmp(arg, "-j") == 0) && (i + 1 < argc)) {
+      jobs = std::strtoul(argv[++i], nullptr, 10);
+    } else if (std::strncmp(arg, "--jobs=", 7) == 0) {
+      jobs = std::strtoul(arg + 7, nullptr, 10);
+    } else if ((std::strcmp(arg, "-v") == 0) && (i + 1 < argc)) {
+      valid_hzs = argv[++i];
+    } else if (std::strncmp(arg, "--valid=", 8) == 0) {
+      valid_hzs = arg + 8;
+    } else if ((std::strcmp(arg, "-b") == 0) && (i + 1 < argc)) {
+      bigrams = argv[++i];
+    } else if (std::strncmp(arg, "--bigram=", 9) == 0) {
+      bigrams = arg + 9;
+    } else if (arg[0] != '-') {
+      inputs.push_back(arg);
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if ((inputs.size() != 2) || (jobs == 0)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  const auto begin = std::chrono::steady_clock::now();
+  ime_pinyin::DictTrie *dict_trie = new ime_pinyin::DictTrie();
+  if (!dict_trie->build_dict(inputs[0], valid_hzs, bigrams, jobs)) {
+    std::fprintf(stderr, "error: failed to build the dictionary from %s\n",
+                 inputs[0]);
+    delete dict_trie;
+    return 1;
+  }
+  const double build_ms = elapsed_ms(begin);
+
+  const bool saved = dict_trie->save_dict(inputs[1]);
+  delete dict_trie;
+  if (!saved) {
+    std::fprintf(stderr, "error: failed to write %s\n", inputs[1]);
+    return 1;
+  }
+
+  std::printf("\nbuilt %s on %zu threads in %.1f ms, written in %.1f ms\n",
+              inputs[1], jobs, build_ms, elapsed_ms(begin) - build_ms);
+  return 0;
+}
@@ -104,9 +104,10 @@ class ModernKeyboardLayoutManager(private val context: Context) {
     fun getLayoutVariant(
         config: KeyboardLayoutConfig,
         shiftState: Int,
-        isNumeric: Boolean
+        isNumeric: Boolean,
+        isT9: Boolean = false
     ): List<List<KeyboardKey>> {
-        Log.d("KeyboardLayout", "Getting variant - shift: $shiftState, numeric: $isNumeric")
+        Log.d("KeyboardLayout", "Getting variant - shift: $shiftState, numeric: $isNumeric, t9: $isT9")
 
         return when {
             isNumeric -> {
@@ -114,6 +115,10 @@ class ModernKeyboardLayoutManager(private val context: Context) {
                 val numericConfig = loadNumericLayout()
                 numericConfig?.layouts?.get("default") ?: createFallbackNumericLayout()
             }
+            isT9 && config.layouts.containsKey("t9") -> {
+                Log.d("KeyboardLayout", "Loading t9 layout")
+                config.layouts["t9"] ?: createFallbackLayout()
+            }
             shiftState > 0 && config.supportsShift -> {
                 Log.d("KeyboardLayout", "Loading shift layout")
                 config.layouts["shift"] ?: config.layouts["default"] ?: createFallbackLayout()
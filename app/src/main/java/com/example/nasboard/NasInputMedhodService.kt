@@ -115,6 +115,9 @@ class NasInputMethodService : InputMethodService() {
         "0", "1", "2", "3", "4", "5", "6", "7", "8", "9"
     )
 
+    // 九键布局中数字键的按键码前缀，见chinese.json中的t9布局
+    private val t9KeyPrefix = "T9_"
+
     // 是否正在显示表情界面
     private var isShowingEmoji = false
 
@@ -141,6 +144,13 @@ class NasInputMethodService : InputMethodService() {
 
         // 使用新的拼音解码器
         pinyinDecoder = PinyinDecoder.getInstance(this)
+        // 初始化时使用设置中的模糊音和九键
+        pinyinDecoder.setFuzzy(settingsManager.fuzzyPinyinFlags)
+        pinyinDecoder.setT9Enabled(settingsManager.isChineseT9Enabled)
+        // 后台解码的候选词在主线程上回调
+        pinyinDecoder.setDecodeListener { pinyin, candidates, _ ->
+            onChineseCandidatesDecoded(pinyin, candidates)
+        }
 
         emojiManager = EmojiManager(this)
         emojiHistoryManager = EmojiHistoryManager.getInstance(this)
@@ -844,6 +854,11 @@ class NasInputMethodService : InputMethodService() {
                 resetContext()
             }
             else -> {
+                // 九键布局的数字键，解码器把数字串解码为拼音
+                if (key.startsWith(t9KeyPrefix) && currentKeyboardType == KeyboardType.CHINESE) {
+                    handleChineseLetterKey(key.removePrefix(t9KeyPrefix))
+                    return
+                }
                 // 检查是否是标点符号或数字
                 if (key in punctuationAndDigits) {
                     handlePunctuationOrDigit(key)
@@ -931,11 +946,7 @@ class NasInputMethodService : InputMethodService() {
 
         if (currentInput.isNotEmpty()) {
             // 哈萨克语模式：提交当前输入
-            val textToCommit = if (conversionManager.getCurrentConversionState().isConversionMode) {
-                conversionManager.convertText(currentInput.toString()) + " "
-            } else {
-                currentInput.toString() + " "
-            }
+            val textToCommit = convertComposingTextForOutput() + " "
             inputConnection?.commitText(textToCommit, 1)
 
             // 记录最后提交的词
@@ -958,11 +969,7 @@ class NasInputMethodService : InputMethodService() {
 
         if (currentInput.isNotEmpty()) {
             // 修复：添加转换检查
-            val textToCommit = if (conversionManager.getCurrentConversionState().isConversionMode) {
-                conversionManager.convertText(currentInput.toString()) + " "
-            } else {
-                currentInput.toString() + " "
-            }
+            val textToCommit = convertComposingTextForOutput() + " "
             inputConnection?.commitText(textToCommit, 1)
 
             // 记录最后提交的词
@@ -1027,7 +1034,7 @@ class NasInputMethodService : InputMethodService() {
         val inputConnection = currentInputConnection
 
         if (currentInput.isNotEmpty()) {
-            val textToCommit = convertTextForOutput(currentInput.toString()) + " "
+            val textToCommit = convertComposingTextForOutput() + " "
             inputConnection?.commitText(textToCommit, 1)
 
             // 记录最后提交的词
@@ -1193,11 +1200,7 @@ class NasInputMethodService : InputMethodService() {
 
         if (currentInput.isNotEmpty()) {
             // 哈萨克语模式：直接提交当前输入
-            val textToCommit = if (conversionManager.getCurrentConversionState().isConversionMode) {
-                conversionManager.convertText(currentInput.toString())
-            } else {
-                currentInput.toString()
-            }
+            val textToCommit = convertComposingTextForOutput()
             inputConnection?.commitText(textToCommit, 1)
 
             // 记录最后提交的词
@@ -1225,11 +1228,7 @@ class NasInputMethodService : InputMethodService() {
 
         if (currentInput.isNotEmpty()) {
             // 修复：添加转换检查
-            val textToCommit = if (conversionManager.getCurrentConversionState().isConversionMode) {
-                conversionManager.convertText(currentInput.toString())
-            } else {
-                currentInput.toString()
-            }
+            val textToCommit = convertComposingTextForOutput()
             inputConnection?.commitText(textToCommit, 1)
 
             // 记录最后提交的词
@@ -1307,7 +1306,7 @@ class NasInputMethodService : InputMethodService() {
         val inputConnection = currentInputConnection
 
         if (currentInput.isNotEmpty()) {
-            val textToCommit = convertTextForOutput(currentInput.toString())
+            val textToCommit = convertComposingTextForOutput()
             inputConnection?.commitText(textToCommit, 1)
 
             // 记录最后提交的词
@@ -1437,6 +1436,7 @@ class NasInputMethodService : InputMethodService() {
 
         // 切换语言时清空当前输入
         currentInput.clear()
+        conversionManager.resetComposingText()
         chineseInputBuffer.clear()
         updateCandidateView()
 
@@ -1480,11 +1480,21 @@ class NasInputMethodService : InputMethodService() {
         return conversionManager.convertText(text)
     }
 
+    // 提交组字文本：每次按键已经流式转换过，这里只转换还没确定的最后几个字符
+    private fun convertComposingTextForOutput(): String {
+        val text = conversionManager.convertComposingText(currentInput.toString())
+        conversionManager.resetComposingText()
+        return text
+    }
+
     private fun updateCandidateView() {
         Log.d("NasInputMethod", "Updating candidate view. KeyboardType: $currentKeyboardType, " +
                 "Chinese buffer: '$chineseInputBuffer', General buffer: '$currentInput', " +
                 "isShowingContextPredictions: $isShowingContextPredictions")
 
+        // 转换模式下组字文本每变一次就流式转换新增的字符，清空时转换状态也随之重置
+        conversionManager.convertComposingText(currentInput.toString())
+
         when (currentKeyboardType) {
             KeyboardType.CHINESE -> {
                 updateChineseCandidateView()
@@ -1567,15 +1577,12 @@ class NasInputMethodService : InputMethodService() {
         candidateView?.updatePinyin(pinyin)
 
         if (pinyin.isNotEmpty()) {
-            // 使用拼音解码器获取候选词
-            val candidates = pinyinDecoder.getSmartCandidates(pinyin)
-            candidateView?.updateCandidates(candidates)
-            Log.d("NasInputMethod", "拼音解码器找到中文候选词: $candidates for pinyin: $pinyin")
-            chineseComposingState = if (candidates.isNotEmpty()) {
-                ChineseComposingState.CANDIDATE
-            } else {
-                ChineseComposingState.COMPOSING
+            // 在后台解码，候选词由onChineseCandidatesDecoded()更新；
+            // 后台解码不可用时同步获取
+            if (pinyinDecoder.postSearch(pinyin)) {
+                return
             }
+            showChineseCandidates(pinyin, pinyinDecoder.getSmartCandidates(pinyin))
         } else {
             // 没有拼音输入时，检查是否需要显示上下文预测
             if (lastChineseWord != null) {
@@ -1595,6 +1602,24 @@ class NasInputMethodService : InputMethodService() {
         }
     }
 
+    // 后台解码的结果，拼音已经改变时丢弃
+    private fun onChineseCandidatesDecoded(pinyin: String, candidates: List<String>) {
+        if (currentKeyboardType != KeyboardType.CHINESE || chineseInputBuffer.toString() != pinyin) {
+            return
+        }
+        showChineseCandidates(pinyin, candidates)
+    }
+
+    private fun showChineseCandidates(pinyin: String, candidates: List<String>) {
+        candidateView?.updateCandidates(candidates)
+        Log.d("NasInputMethod", "拼音解码器找到中文候选词: $candidates for pinyin: $pinyin")
+        chineseComposingState = if (candidates.isNotEmpty()) {
+            ChineseComposingState.CANDIDATE
+        } else {
+            ChineseComposingState.COMPOSING
+        }
+    }
+
     // 修正后的哈萨克语候选词视图更新
     private fun updateKazakhCandidateView() {
         val currentInputText = currentInput.toString()
@@ -2049,6 +2074,10 @@ class NasInputMethodService : InputMethodService() {
         // 刷新键盘视图设置
         keyboardView?.refreshKeyboardSettings()
 
+        // 模糊音和九键可能在设置中修改过，没有变化时不做任何事
+        pinyinDecoder.setFuzzy(settingsManager.fuzzyPinyinFlags)
+        pinyinDecoder.setT9Enabled(settingsManager.isChineseT9Enabled)
+
         // 开始新的输入时重置上下文
         resetContext()
         if (currentKeyboardType == KeyboardType.CHINESE) {
@@ -2070,6 +2099,7 @@ class NasInputMethodService : InputMethodService() {
         // 清空当前输入
         currentInput.clear()
         chineseInputBuffer.clear()
+        conversionManager.resetComposingText()
         // 停止长按删除
         isDeletePressed = false
         isFastDeleteMode = false
@@ -2092,6 +2122,7 @@ class NasInputMethodService : InputMethodService() {
         userDictScope.cancel()
 
         // 清理拼音解码器
+        pinyinDecoder.setDecodeListener(null)
         pinyinDecoder.close()
 
         // 清理英文词库管理器
@@ -2105,6 +2136,9 @@ class NasInputMethodService : InputMethodService() {
         kazakhDictionaryManager.close()
         kazakhUserDictManager.close()
 
+        // 释放字母转换引擎
+        conversionManager.close()
+
         // 清理Handler
         handler.removeCallbacksAndMessages(null)
         keyboardView = null
@@ -128,7 +128,7 @@ class NasKeyboardView @JvmOverloads constructor(
                 if (config != null) {
                     Log.d("NasKeyboardView", "Config loaded: ${config.name}, supportsShift: ${config.supportsShift}")
 
-                    val rows = modernLayoutManager.getLayoutVariant(config, shiftState, isNumeric)
+                    val rows = modernLayoutManager.getLayoutVariant(config, shiftState, isNumeric, isT9Layout())
                     Log.d("NasKeyboardView", "Got ${rows.size} rows from layout")
 
                     if (rows.isNotEmpty()) {
@@ -151,6 +151,11 @@ class NasKeyboardView @JvmOverloads constructor(
         }
     }
 
+    // 中文键盘在设置中打开九键时使用九键布局
+    private fun isT9Layout(): Boolean {
+        return currentKeyboardType == KeyboardType.CHINESE && settingsManager.isChineseT9Enabled
+    }
+
     private fun createEmergencyFallback() {
         Log.w("NasKeyboardView", "Creating emergency fallback layout")
         // 创建一个简单的紧急布局
@@ -200,7 +205,7 @@ class NasKeyboardView @JvmOverloads constructor(
         Log.d("NasKeyboardView", "onSizeChanged: $w x $h")
 
         if (currentLayoutConfig != null) {
-            val rows = modernLayoutManager.getLayoutVariant(currentLayoutConfig!!, shiftState, isNumeric)
+            val rows = modernLayoutManager.getLayoutVariant(currentLayoutConfig!!, shiftState, isNumeric, isT9Layout())
             currentKeyBounds = modernLayoutManager.calculateKeyBounds(rows, w, h)
             invalidate()
         } else {
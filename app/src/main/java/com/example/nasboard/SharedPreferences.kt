@@ -13,6 +13,8 @@ class KeyboardSettingsManager private constructor(context: Context) {
         private const val KEY_CHINESE_ENABLED = "chinese_enabled"
         private const val KEY_ENGLISH_ENABLED = "english_enabled"
         private const val KEY_RUSSIAN_ENABLED = "russian_enabled"
+        private const val KEY_FUZZY_PINYIN = "fuzzy_pinyin"
+        private const val KEY_CHINESE_T9 = "chinese_t9"
 
         @Volatile
         private var instance: KeyboardSettingsManager? = null
@@ -53,6 +55,16 @@ class KeyboardSettingsManager private constructor(context: Context) {
         get() = prefs.getBoolean(KEY_RUSSIAN_ENABLED, true)
         set(value) = prefs.edit().putBoolean(KEY_RUSSIAN_ENABLED, value).apply()
 
+    // 启用的模糊音，PinyinDecoder.FUZZY_XXX的组合，默认关闭
+    var fuzzyPinyinFlags: Int
+        get() = prefs.getInt(KEY_FUZZY_PINYIN, 0)
+        set(value) = prefs.edit().putInt(KEY_FUZZY_PINYIN, value).apply()
+
+    // 中文键盘使用九键布局，默认使用全键盘
+    var isChineseT9Enabled: Boolean
+        get() = prefs.getBoolean(KEY_CHINESE_T9, false)
+        set(value) = prefs.edit().putBoolean(KEY_CHINESE_T9, value).apply()
+
     // 获取所有启用的键盘类型
     fun getEnabledKeyboardTypes(): List<KeyboardType> {
         val enabledTypes = mutableListOf<KeyboardType>()
@@ -93,6 +105,8 @@ class KeyboardSettingsManager private constructor(context: Context) {
             putBoolean(KEY_CHINESE_ENABLED, true)
             putBoolean(KEY_ENGLISH_ENABLED, true)
             putBoolean(KEY_RUSSIAN_ENABLED, true)
+            putInt(KEY_FUZZY_PINYIN, 0)
+            putBoolean(KEY_CHINESE_T9, false)
         }.apply()
     }
 }
\ No newline at end of file
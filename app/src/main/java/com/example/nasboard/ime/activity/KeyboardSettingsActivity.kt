@@ -15,6 +15,7 @@ import androidx.appcompat.app.AppCompatActivity
 import androidx.recyclerview.widget.LinearLayoutManager
 import androidx.recyclerview.widget.RecyclerView
 import com.example.nasboard.KeyboardSettingsManager
+import com.example.nasboard.ime.dictionary.PinyinDecoder
 import com.example.nasboard.ime.theme.ThemeAdapter
 import com.example.nasboard.ime.theme.ThemeManager
 import kotlinx.coroutines.CoroutineScope
@@ -36,6 +37,11 @@ class KeyboardSettingsActivity : AppCompatActivity() {
     private lateinit var resetButton: Button
     private lateinit var backButton: Button
 
+    private lateinit var chineseT9Switch: Switch
+
+    // 模糊音开关，和FUZZY_OPTIONS一一对应
+    private val fuzzySwitches = mutableListOf<Switch>()
+
     // 新主题设置视图组件
     private lateinit var currentThemeTextView: TextView
     private lateinit var themesProgressBar: ProgressBar
@@ -44,6 +50,19 @@ class KeyboardSettingsActivity : AppCompatActivity() {
 
     private lateinit var themeAdapter: ThemeAdapter
 
+    companion object {
+        // 模糊音选项：显示的名称和PinyinDecoder中的标志
+        private val FUZZY_OPTIONS = listOf(
+            "z = zh" to PinyinDecoder.FUZZY_Z_ZH,
+            "c = ch" to PinyinDecoder.FUZZY_C_CH,
+            "s = sh" to PinyinDecoder.FUZZY_S_SH,
+            "n = l" to PinyinDecoder.FUZZY_N_L,
+            "an = ang" to PinyinDecoder.FUZZY_AN_ANG,
+            "en = eng" to PinyinDecoder.FUZZY_EN_ENG,
+            "in = ing" to PinyinDecoder.FUZZY_IN_ING
+        )
+    }
+
     override fun onCreate(savedInstanceState: Bundle?) {
         super.onCreate(savedInstanceState)
 
@@ -240,6 +259,84 @@ class KeyboardSettingsActivity : AppCompatActivity() {
         }
         layout.addView(keyboardHintText)
 
+        // === 拼音设置部分 ===
+        val pinyinSettingsTitle = TextView(this).apply {
+            text = "拼音设置"
+            textSize = 18f
+            setTypeface(null, Typeface.BOLD)
+            setPadding(0, 20, 0, 20)
+        }
+        layout.addView(pinyinSettingsTitle)
+
+        // 九键开关
+        val chineseT9Layout = LinearLayout(this).apply {
+            orientation = LinearLayout.HORIZONTAL
+            setPadding(0, 20, 0, 20)
+        }
+
+        val chineseT9Label = TextView(this).apply {
+            text = "中文九键 (T9)"
+            textSize = 18f
+            layoutParams = LinearLayout.LayoutParams(
+                0,
+                LinearLayout.LayoutParams.WRAP_CONTENT
+            ).apply {
+                weight = 1f
+            }
+        }
+
+        chineseT9Switch = Switch(this).apply {
+            text = ""
+        }
+
+        chineseT9Layout.addView(chineseT9Label)
+        chineseT9Layout.addView(chineseT9Switch)
+        layout.addView(chineseT9Layout)
+
+        // 模糊音标题
+        val fuzzyTitle = TextView(this).apply {
+            text = "模糊音"
+            textSize = 16f
+            setPadding(0, 20, 0, 0)
+        }
+        layout.addView(fuzzyTitle)
+
+        for ((name, _) in FUZZY_OPTIONS) {
+            val fuzzyLayout = LinearLayout(this).apply {
+                orientation = LinearLayout.HORIZONTAL
+                setPadding(0, 20, 0, 20)
+            }
+
+            val fuzzyLabel = TextView(this).apply {
+                text = name
+                textSize = 18f
+                layoutParams = LinearLayout.LayoutParams(
+                    0,
+                    LinearLayout.LayoutParams.WRAP_CONTENT
+                ).apply {
+                    weight = 1f
+                }
+            }
+
+            val fuzzySwitch = Switch(this).apply {
+                text = ""
+            }
+            fuzzySwitches.add(fuzzySwitch)
+
+            fuzzyLayout.addView(fuzzyLabel)
+            fuzzyLayout.addView(fuzzySwitch)
+            layout.addView(fuzzyLayout)
+        }
+
+        // 模糊音提示文本
+        val fuzzyHintText = TextView(this).apply {
+            text = "打开后输入其中一个拼音也会出现另一个拼音的候选词"
+            textSize = 14f
+            setPadding(0, 30, 0, 30)
+            setTextColor(0xFF666666.toInt())
+        }
+        layout.addView(fuzzyHintText)
+
         // === 新增主题设置部分 ===
         val themeSettingsTitle = TextView(this).apply {
             text = "主题设置"
@@ -359,6 +456,19 @@ class KeyboardSettingsActivity : AppCompatActivity() {
             validateAndUpdateSwitches()
         }
 
+        // 九键和模糊音开关，输入法在下次开始输入时使用新的设置
+        chineseT9Switch.setOnCheckedChangeListener { _, isChecked ->
+            settingsManager.isChineseT9Enabled = isChecked
+        }
+
+        fuzzySwitches.forEachIndexed { index, fuzzySwitch ->
+            val flag = FUZZY_OPTIONS[index].second
+            fuzzySwitch.setOnCheckedChangeListener { _, isChecked ->
+                val flags = settingsManager.fuzzyPinyinFlags
+                settingsManager.fuzzyPinyinFlags = if (isChecked) flags or flag else flags and flag.inv()
+            }
+        }
+
         // 设置主题相关视图
         setupThemeSettings()
 
@@ -460,6 +570,13 @@ class KeyboardSettingsActivity : AppCompatActivity() {
         englishSwitch.isChecked = settingsManager.isEnglishEnabled
         russianSwitch.isChecked = settingsManager.isRussianEnabled
 
+        chineseT9Switch.isChecked = settingsManager.isChineseT9Enabled
+
+        val fuzzyFlags = settingsManager.fuzzyPinyinFlags
+        fuzzySwitches.forEachIndexed { index, fuzzySwitch ->
+            fuzzySwitch.isChecked = (fuzzyFlags and FUZZY_OPTIONS[index].second) != 0
+        }
+
         validateAndUpdateSwitches()
     }
 
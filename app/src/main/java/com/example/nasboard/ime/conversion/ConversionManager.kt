@@ -21,6 +21,13 @@ class ConversionManager {
 
     private var currentKeyboardType = KeyboardType.LATIN
 
+    // 编译好的转换引擎，按(源, 目标)缓存
+    private val transliterators = mutableMapOf<Pair<KeyboardType, KeyboardType>, Transliterator>()
+
+    // 组字文本的流式转换状态
+    private var composingStream: Transliterator.Stream? = null
+    private var composingTransliterator: Transliterator? = null
+
     // 拉丁文到西里尔文映射（用于转换）
     private val latinToCyrillicMap = mapOf(
         "a" to "а", "ä" to "ә", "b" to "б", "v" to "в", "g" to "г", "ğ" to "ғ", "d" to "д", "e" to "е",
@@ -195,154 +202,61 @@ class ConversionManager {
             return text
         }
 
-        var convertedText = text
-
-        // 根据源语言和目标语言选择正确的映射表
-        Log.d("ConversionManager", "Converting from $currentKeyboardType to $targetLanguage")
-
-        when (currentKeyboardType) {
-            KeyboardType.LATIN -> {
-                when (targetLanguage) {
-                    KeyboardType.CYRILLIC_KAZAKH -> {
-                        convertedText = convertLatinToCyrillic(text)
-                    }
-                    KeyboardType.ARABIC -> {
-                        convertedText = convertLatinToArabic(text)
-                    }
-                    else -> {
-                        // 不需要转换
-                    }
-                }
-            }
-            KeyboardType.CYRILLIC_KAZAKH -> {
-                when (targetLanguage) {
-                    KeyboardType.LATIN -> {
-                        convertedText = convertCyrillicToLatin(text)
-                    }
-                    KeyboardType.ARABIC -> {
-                        convertedText = convertCyrillicToArabic(text)
-                    }
-                    else -> {
-                        // 不需要转换
-                    }
-                }
-            }
-            KeyboardType.ARABIC -> {
-                when (targetLanguage) {
-                    KeyboardType.LATIN -> {
-                        convertedText = convertArabicToLatin(text)
-                    }
-                    KeyboardType.CYRILLIC_KAZAKH -> {
-                        convertedText = convertArabicToCyrillic(text)
-                    }
-                    else -> {
-                        // 不需要转换
-                    }
-                }
-            }
-            else -> {
-                // 不需要转换
-            }
-        }
+        val convertedText = getTransliterator(currentKeyboardType, targetLanguage)?.convert(text) ?: text
 
         Log.d("ConversionManager", "Converted text: '$convertedText'")
         return convertedText
     }
 
-    // 新增：专门处理拉丁文到西里尔文的转换
-    private fun convertLatinToCyrillic(text: String): String {
-        var result = text
-        // 先处理复合字符
-        val compoundMap = latinToCyrillicMap.filter { it.key.length > 1 }
-        compoundMap.forEach { (from, to) ->
-            result = result.replace(from, to, ignoreCase = true)
-        }
-        // 再处理单个字符
-        val singleMap = latinToCyrillicMap.filter { it.key.length == 1 }
-        singleMap.forEach { (from, to) ->
-            result = result.replace(from, to, ignoreCase = true)
+    // 组字文本的流式转换：每次输入只转换新增的字符，返回当前组字文本的转换结果
+    fun convertComposingText(text: String): String {
+        // 中文键盘不进行任何转换
+        if (currentKeyboardType == KeyboardType.CHINESE) {
+            return text
         }
-        return result
-    }
 
-    // 新增：专门处理拉丁文到阿拉伯文的转换
-    private fun convertLatinToArabic(text: String): String {
-        var result = text
-        // 先处理复合字符
-        val compoundMap = latinToArabicMap.filter { it.key.length > 1 }
-        compoundMap.forEach { (from, to) ->
-            result = result.replace(from, to, ignoreCase = true)
-        }
-        // 再处理单个字符
-        val singleMap = latinToArabicMap.filter { it.key.length == 1 }
-        singleMap.forEach { (from, to) ->
-            result = result.replace(from, to, ignoreCase = true)
+        val currentState = getCurrentConversionState()
+        val targetLanguage = currentState.targetLanguage
+        if (!currentState.isConversionMode || targetLanguage == null) {
+            return text
         }
-        return result
-    }
 
-    // 新增：专门处理西里尔文到拉丁文的转换
-    private fun convertCyrillicToLatin(text: String): String {
-        var result = text
-        // 先处理复合字符
-        val compoundMap = cyrillicToLatinMap.filter { it.key.length > 1 }
-        compoundMap.forEach { (from, to) ->
-            result = result.replace(from, to, ignoreCase = true)
-        }
-        // 再处理单个字符
-        val singleMap = cyrillicToLatinMap.filter { it.key.length == 1 }
-        singleMap.forEach { (from, to) ->
-            result = result.replace(from, to, ignoreCase = true)
-        }
-        return result
+        val transliterator = getTransliterator(currentKeyboardType, targetLanguage) ?: return text
+        val stream = composingStream?.takeIf { composingTransliterator === transliterator }
+            ?: transliterator.newStream().also {
+                composingStream?.close()
+                composingStream = it
+                composingTransliterator = transliterator
+            }
+        return stream.update(text)
     }
 
-    // 新增：专门处理西里尔文到阿拉伯文的转换
-    private fun convertCyrillicToArabic(text: String): String {
-        var result = text
-        // 先处理复合字符
-        val compoundMap = cyrillicToArabicMap.filter { it.key.length > 1 }
-        compoundMap.forEach { (from, to) ->
-            result = result.replace(from, to, ignoreCase = true)
-        }
-        // 再处理单个字符
-        val singleMap = cyrillicToArabicMap.filter { it.key.length == 1 }
-        singleMap.forEach { (from, to) ->
-            result = result.replace(from, to, ignoreCase = true)
-        }
-        return result
+    // 组字文本已提交或清空
+    fun resetComposingText() {
+        composingStream?.reset()
     }
 
-    // 新增：专门处理阿拉伯文到拉丁文的转换
-    private fun convertArabicToLatin(text: String): String {
-        var result = text
-        // 先处理复合字符
-        val compoundMap = arabicToLatinMap.filter { it.key.length > 1 }
-        compoundMap.forEach { (from, to) ->
-            result = result.replace(from, to, ignoreCase = true)
+    // 根据源语言和目标语言选择映射表，对应的转换引擎第一次用到时编译
+    private fun getTransliterator(source: KeyboardType, target: KeyboardType): Transliterator? {
+        val rules = when (source to target) {
+            KeyboardType.LATIN to KeyboardType.CYRILLIC_KAZAKH -> latinToCyrillicMap
+            KeyboardType.LATIN to KeyboardType.ARABIC -> latinToArabicMap
+            KeyboardType.CYRILLIC_KAZAKH to KeyboardType.LATIN -> cyrillicToLatinMap
+            KeyboardType.CYRILLIC_KAZAKH to KeyboardType.ARABIC -> cyrillicToArabicMap
+            KeyboardType.ARABIC to KeyboardType.LATIN -> arabicToLatinMap
+            KeyboardType.ARABIC to KeyboardType.CYRILLIC_KAZAKH -> arabicToCyrillicMap
+            else -> return null
         }
-        // 再处理单个字符
-        val singleMap = arabicToLatinMap.filter { it.key.length == 1 }
-        singleMap.forEach { (from, to) ->
-            result = result.replace(from, to, ignoreCase = true)
-        }
-        return result
+        return transliterators.getOrPut(source to target) { Transliterator(rules) }
     }
 
-    // 新增：专门处理阿拉伯文到西里尔文的转换
-    private fun convertArabicToCyrillic(text: String): String {
-        var result = text
-        // 先处理复合字符
-        val compoundMap = arabicToCyrillicMap.filter { it.key.length > 1 }
-        compoundMap.forEach { (from, to) ->
-            result = result.replace(from, to, ignoreCase = true)
-        }
-        // 再处理单个字符
-        val singleMap = arabicToCyrillicMap.filter { it.key.length == 1 }
-        singleMap.forEach { (from, to) ->
-            result = result.replace(from, to, ignoreCase = true)
-        }
-        return result
+    // 释放转换引擎
+    fun close() {
+        composingStream?.close()
+        composingStream = null
+        composingTransliterator = null
+        transliterators.values.forEach { it.close() }
+        transliterators.clear()
     }
 
     fun convertPunctuation(punctuation: String): String {
@@ -0,0 +1,115 @@
+package com.example.nasboard.ime.conversion
+
+import android.util.Log
+
+// 字母互转引擎（native）
+// 规则表只编译一次为自动机，从左到右取最长匹配的规则，没有规则的字符原样保留。
+// 大小写精确的规则优先；一个键没有精确的大小写形式时，按不区分大小写匹配
+class Transliterator(rules: Map<String, String>) {
+
+    private var handle = 0L
+
+    companion object {
+        // 加载JNI库
+        init {
+            try {
+                System.loadLibrary("nasboard-pinyin")
+            } catch (e: UnsatisfiedLinkError) {
+                Log.e("Transliterator", "Failed to load native library: ${e.message}")
+            }
+        }
+
+        @JvmStatic private external fun nativeCreate(from: Array<String>, to: Array<String>): Long
+        @JvmStatic private external fun nativeDestroy(handle: Long)
+        @JvmStatic private external fun nativeConvert(handle: Long, text: String): String
+        @JvmStatic private external fun nativeStreamCreate(handle: Long): Long
+        @JvmStatic private external fun nativeStreamDestroy(stream: Long)
+        @JvmStatic private external fun nativeStreamFeed(stream: Long, text: String): String
+        @JvmStatic private external fun nativeStreamPreview(stream: Long): String
+        @JvmStatic private external fun nativeStreamFinish(stream: Long): String
+        @JvmStatic private external fun nativeStreamReset(stream: Long)
+
+        // 补上大小写变体，原表中的规则写在后面，覆盖同名的变体
+        private fun withCaseVariants(rules: Map<String, String>): Map<String, String> {
+            val result = LinkedHashMap<String, String>()
+            rules.forEach { (from, to) ->
+                listOf(from.lowercase(), from.uppercase(), from.replaceFirstChar { it.uppercaseChar() })
+                    .forEach { result.putIfAbsent(it, to) }
+            }
+            result.putAll(rules)
+            return result
+        }
+    }
+
+    init {
+        val allRules = withCaseVariants(rules)
+        try {
+            handle = nativeCreate(allRules.keys.toTypedArray(), allRules.values.toTypedArray())
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e("Transliterator", "Failed to create transliterator: ${e.message}")
+        }
+    }
+
+    @Synchronized
+    fun convert(text: String): String {
+        if (handle == 0L || text.isEmpty()) return text
+        return nativeConvert(handle, text)
+    }
+
+    fun newStream(): Stream = Stream()
+
+    @Synchronized
+    fun close() {
+        if (handle != 0L) {
+            nativeDestroy(handle)
+            handle = 0L
+        }
+    }
+
+    // 流式转换组字文本：每次只输入新增的字符，已经确定的结果不再重新计算
+    inner class Stream {
+        private var stream = if (handle != 0L) nativeStreamCreate(handle) else 0L
+        private val input = StringBuilder()
+        private val output = StringBuilder()
+
+        // 组字文本变成text后的转换结果。text延长了上次的文本时只输入新增部分，
+        // 否则（例如删除了字符）从头开始
+        fun update(text: String): String = synchronized(this@Transliterator) {
+            if (stream == 0L) return text
+
+            if (!text.startsWith(input)) {
+                reset()
+            }
+            if (text.length > input.length) {
+                output.append(nativeStreamFeed(stream, text.substring(input.length)))
+                input.setLength(0)
+                input.append(text)
+            }
+            output.toString() + nativeStreamPreview(stream)
+        }
+
+        // 提交组字文本，返回完整的转换结果
+        fun finish(): String = synchronized(this@Transliterator) {
+            if (stream == 0L) return input.toString().also { input.setLength(0) }
+
+            output.append(nativeStreamFinish(stream))
+            val result = output.toString()
+            input.setLength(0)
+            output.setLength(0)
+            result
+        }
+
+        fun reset() = synchronized(this@Transliterator) {
+            if (stream != 0L) nativeStreamReset(stream)
+            input.setLength(0)
+            output.setLength(0)
+        }
+
+        fun close() = synchronized(this@Transliterator) {
+            if (stream != 0L) {
+                nativeStreamDestroy(stream)
+                stream = 0L
+            }
+        }
+    }
+}
@@ -1,23 +1,19 @@
 package com.example.nasboard.ime.dictionary
 
 import android.content.Context
-import android.database.sqlite.SQLiteDatabase
 import android.util.Log
 import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.withContext
-import java.io.File
-import java.io.FileOutputStream
-import java.io.InputStream
 
 class EnglishDictionaryManager private constructor(private val context: Context) {
 
-    private val trie = EnglishTrie()
+    // unigram/bigram/trigram都在native的n-gram词典中
+    private val dictionary = NgramDictionary("EnglishDictionary")
     private var isLoaded = false
-    private var database: SQLiteDatabase? = null
 
-    // 用于存储上下文预测的缓存
-    private val bigramCache = mutableMapOf<String, List<String>>()
+    // 最近提交的两个词，用于trigram上下文
     private var lastProcessedWord: String? = null
+    private var secondLastProcessedWord: String? = null
 
     companion object {
         @Volatile
@@ -33,113 +29,25 @@ class EnglishDictionaryManager private constructor(private val context: Context)
     suspend fun loadDictionary() = withContext(Dispatchers.IO) {
         if (isLoaded) return@withContext
 
-        try {
-            // 复制数据库文件到应用内部存储
-            copyDatabaseFromAssets()
-
-            // 打开数据库
-            val dbPath = context.getDatabasePath("english_dict.db").absolutePath
-            database = SQLiteDatabase.openDatabase(dbPath, null, SQLiteDatabase.OPEN_READONLY)
-
-            // 从数据库加载数据到Trie树
-            loadWordsFromDatabase()
-
-            isLoaded = true
-            Log.d("EnglishDictionary", "SQLite数据库加载完成，Trie树构建成功")
-
-        } catch (e: Exception) {
-            Log.e("EnglishDictionary", "Error loading SQLite dictionary: ${e.message}")
-        }
-    }
-
-    private fun copyDatabaseFromAssets() {
-        val dbFile = context.getDatabasePath("english_dict.db")
-
-        // 如果数据库文件已存在，先删除（确保使用最新版本）
-        if (dbFile.exists()) {
-            dbFile.delete()
-        }
-
-        // 确保目录存在
-        dbFile.parentFile?.mkdirs()
-
-        try {
-            // 从assets读取数据库文件
-            val inputStream: InputStream = context.assets.open("dict/english_dict.db")
-            val outputStream = FileOutputStream(dbFile)
-
-            // 复制文件
-            inputStream.use { input ->
-                outputStream.use { output ->
-                    input.copyTo(output)
-                }
-            }
-
-            Log.d("EnglishDictionary", "数据库文件复制完成: ${dbFile.absolutePath}")
-        } catch (e: Exception) {
-            Log.e("EnglishDictionary", "复制数据库文件失败: ${e.message}")
-            throw e
+        isLoaded = dictionary.load(context, "dict/english_ngram.dic")
+        if (isLoaded) {
+            Log.d("EnglishDictionary", "n-gram词典加载完成")
         }
     }
 
-    private fun loadWordsFromDatabase() {
-        val database = database ?: throw IllegalStateException("Database not initialized")
-
-        // 查询unigram表中的所有词语
-        val cursor = database.query(
-            "unigram",
-            arrayOf("ngram", "freq"),
-            null,
-            null,
-            null,
-            null,
-            "freq DESC" // 按频率降序排列
-        )
-
-        val words = mutableSetOf<String>()
-        var wordCount = 0
-
-        cursor.use { c ->
-            while (c.moveToNext()) {
-                val ngram = c.getString(c.getColumnIndexOrThrow("ngram"))
-                // 只添加长度大于1的词语到Trie树
-                if (ngram.isNotEmpty() && ngram.length > 1) {
-                    words.add(ngram)
-                    wordCount++
-                }
-            }
-        }
-
-        // 构建Trie树
-        words.forEach { word ->
-            trie.insert(word)
-        }
-
-        Log.d("EnglishDictionary", "从数据库加载 $wordCount 个词语到Trie树")
-    }
-
-    // 基础前缀预测
+    // 基础前缀预测，按频率排序
     fun getPredictions(prefix: String, contextWord: String? = null, maxPredictions: Int = 20): List<String> {
         if (!isLoaded || prefix.isEmpty()) return emptyList()
 
         return try {
-            // 首先从Trie树获取所有前缀匹配的词语
-            val allPredictions = trie.getWordsWithPrefix(prefix)
-
-            // 如果前缀匹配的词语太多，尝试从数据库获取更精确的预测（按频率排序）
-            if (allPredictions.size > maxPredictions * 2) {
-                getPredictionsFromDatabase(prefix, maxPredictions)
-            } else {
-                // 对Trie树结果按长度排序（短词优先）
-                allPredictions.sortedBy { it.length }.take(maxPredictions)
-            }
+            dictionary.prefixSearch(prefix, maxPredictions)
         } catch (e: Exception) {
             Log.e("EnglishDictionary", "Error getting predictions: ${e.message}")
             emptyList()
         }
     }
 
-    // 上下文预测：基于前一个词预测下一个词
+    // 上下文预测：基于前一个词（和再前一个词）预测下一个词
     fun getContextPredictions(previousWord: String, currentPrefix: String = "", maxPredictions: Int = 15): List<String> {
         if (!isLoaded || previousWord.isEmpty()) {
             return if (currentPrefix.isNotEmpty()) {
@@ -150,70 +58,28 @@ class EnglishDictionaryManager private constructor(private val context: Context)
         }
 
         return try {
-            // 构建缓存键
-            val cacheKey = "$previousWord|$currentPrefix"
-
-            // 检查缓存
-            if (bigramCache.containsKey(cacheKey)) {
-                return bigramCache[cacheKey]!!.take(maxPredictions)
-            }
-
-            val database = database ?: return emptyList()
-
             val predictions = mutableListOf<String>()
 
-            // 查询bigram表，找到基于前一个词的最可能的下一个词
-            val cursor = if (currentPrefix.isEmpty()) {
-                // 如果没有当前前缀，直接查询基于前一个词的预测
-                database.query(
-                    "bigram",
-                    arrayOf("w2", "freq"),
-                    "w1 = ?",
-                    arrayOf(previousWord),
-                    null,
-                    null,
-                    "freq DESC",
-                    maxPredictions.toString()
-                )
-            } else {
-                // 如果有当前前缀，查询既匹配前一个词又以当前前缀开头的词
-                database.query(
-                    "bigram",
-                    arrayOf("w2", "freq"),
-                    "w1 = ? AND w2 LIKE ?",
-                    arrayOf(previousWord, "$currentPrefix%"),
-                    null,
-                    null,
-                    "freq DESC",
-                    maxPredictions.toString()
-                )
+            // 前一个词是刚提交的词时，先用trigram
+            val firstWord = secondLastProcessedWord
+            if (firstWord != null && previousWord == lastProcessedWord) {
+                predictions.addAll(dictionary.trigramPredict(firstWord, previousWord, currentPrefix, maxPredictions))
             }
 
-            cursor.use { c ->
-                while (c.moveToNext()) {
-                    val word = c.getString(c.getColumnIndexOrThrow("w2"))
-                    if (word.isNotEmpty()) {
-                        predictions.add(word)
-                    }
-                }
+            // 查询bigram，找到基于前一个词、以当前前缀开头的最可能的下一个词
+            if (predictions.size < maxPredictions) {
+                val bigramPredictions = dictionary.contextPredict(previousWord, currentPrefix, maxPredictions)
+                predictions.addAll(bigramPredictions.filter { it !in predictions })
             }
 
             Log.d("EnglishDictionary", "上下文预测: '$previousWord' -> '${predictions.take(3)}...'")
 
             // 如果bigram预测结果不足，用unigram预测补充
             if (predictions.size < maxPredictions && currentPrefix.isNotEmpty()) {
-                val unigramPredictions = getPredictions(currentPrefix, null, maxPredictions - predictions.size)
+                val unigramPredictions = getPredictions(currentPrefix, null, maxPredictions)
                 predictions.addAll(unigramPredictions.filter { it !in predictions })
             }
 
-            // 更新缓存
-            bigramCache[cacheKey] = predictions
-            if (bigramCache.size > 100) {
-                // 限制缓存大小
-                val oldestKey = bigramCache.keys.first()
-                bigramCache.remove(oldestKey)
-            }
-
             predictions.take(maxPredictions)
         } catch (e: Exception) {
             Log.e("EnglishDictionary", "上下文预测失败: ${e.message}")
@@ -227,75 +93,22 @@ class EnglishDictionaryManager private constructor(private val context: Context)
         if (!isLoaded || previousWord.isEmpty()) return emptyList()
 
         return try {
-            val database = database ?: return emptyList()
+            val predictions = dictionary.contextPredict(previousWord, "", maxPredictions).toMutableList()
 
-            val predictions = mutableListOf<String>()
-
-            // 查询bigram表，只基于前一个词预测下一个词
-            val cursor = database.query(
-                "bigram",
-                arrayOf("w2", "freq"),
-                "w1 = ?",
-                arrayOf(previousWord),
-                null,
-                null,
-                "freq DESC",
-                maxPredictions.toString()
-            )
-
-            cursor.use { c ->
-                while (c.moveToNext()) {
-                    val word = c.getString(c.getColumnIndexOrThrow("w2"))
-                    if (word.isNotEmpty()) {
-                        predictions.add(word)
-                    }
-                }
-            }
-
-            // 关键修复：如果bigram预测结果不足，用高频unigram补充
+            // 如果bigram预测结果不足，用高频unigram补充
             if (predictions.size < maxPredictions) {
-                val remaining = maxPredictions - predictions.size
-                val frequentWords = getMostFrequentWords(remaining)
+                val frequentWords = dictionary.mostFrequentWords(maxPredictions)
                 predictions.addAll(frequentWords.filter { it !in predictions })
             }
 
             Log.d("EnglishDictionary", "纯上下文预测: '$previousWord' -> '$predictions'")
-            predictions
+            predictions.take(maxPredictions)
         } catch (e: Exception) {
             Log.e("EnglishDictionary", "纯上下文预测失败: ${e.message}")
             emptyList()
         }
     }
 
-    // 获取高频词
-    private fun getMostFrequentWords(maxWords: Int): List<String> {
-        val database = database ?: return emptyList()
-
-        val frequentWords = mutableListOf<String>()
-
-        val cursor = database.query(
-            "unigram",
-            arrayOf("ngram"),
-            null,
-            null,
-            null,
-            null,
-            "freq DESC",
-            maxWords.toString()
-        )
-
-        cursor.use { c ->
-            while (c.moveToNext()) {
-                val ngram = c.getString(c.getColumnIndexOrThrow("ngram"))
-                if (ngram.isNotEmpty() && ngram.length > 1) {
-                    frequentWords.add(ngram)
-                }
-            }
-        }
-
-        return frequentWords.take(maxWords)
-    }
-
     // 智能预测：自动检测是否使用上下文
     fun getSmartPredictions(textBeforeCursor: String, maxPredictions: Int = 15): List<String> {
         if (!isLoaded || textBeforeCursor.isEmpty()) return emptyList()
@@ -306,6 +119,17 @@ class EnglishDictionaryManager private constructor(private val context: Context)
 
         val currentInput = words.last()
 
+        // 有前两个词时先用trigram
+        if (words.size >= 3) {
+            val trigramPredictions = dictionary.trigramPredict(
+                words[words.size - 3], words[words.size - 2], currentInput, maxPredictions)
+            if (trigramPredictions.size >= maxPredictions) {
+                return trigramPredictions
+            }
+            val contextPredictions = getContextPredictions(words[words.size - 2], currentInput, maxPredictions)
+            return (trigramPredictions + contextPredictions.filter { it !in trigramPredictions }).take(maxPredictions)
+        }
+
         // 如果有前一个词，使用上下文预测
         if (words.size >= 2) {
             val previousWord = words[words.size - 2]
@@ -316,45 +140,10 @@ class EnglishDictionaryManager private constructor(private val context: Context)
         return getPredictions(currentInput, null, maxPredictions)
     }
 
-    // 从数据库获取预测词（按频率排序）
-    private fun getPredictionsFromDatabase(prefix: String, maxPredictions: Int): List<String> {
-        val database = database ?: return emptyList()
-
-        val predictions = mutableListOf<String>()
-
-        try {
-            val cursor = database.query(
-                "unigram",
-                arrayOf("ngram", "freq"),
-                "ngram LIKE ?",
-                arrayOf("$prefix%"),
-                null,
-                null,
-                "freq DESC", // 按频率降序排列
-                maxPredictions.toString()
-            )
-
-            cursor.use { c ->
-                while (c.moveToNext()) {
-                    val ngram = c.getString(c.getColumnIndexOrThrow("ngram"))
-                    if (ngram.isNotEmpty()) {
-                        predictions.add(ngram)
-                    }
-                }
-            }
-
-            Log.d("EnglishDictionary", "数据库查询 '$prefix' 返回 ${predictions.size} 个预测词")
-        } catch (e: Exception) {
-            Log.e("EnglishDictionary", "数据库查询失败: ${e.message}")
-        }
-
-        return predictions
-    }
-
     // 处理文本提交，更新上下文
     fun processWordSubmission(word: String) {
+        secondLastProcessedWord = lastProcessedWord
         lastProcessedWord = word
-        // 可以在这里添加更多逻辑，比如学习用户输入习惯
     }
 
     // 获取最后处理的词（用于上下文）
@@ -362,95 +151,21 @@ class EnglishDictionaryManager private constructor(private val context: Context)
         return lastProcessedWord
     }
 
-    // 检查词语是否存在（使用Trie树快速检查）
+    // 检查词语是否存在
     fun isWord(word: String): Boolean {
-        return trie.contains(word)
+        return dictionary.contains(word)
     }
 
-    // 获取词语频率（从数据库查询）
+    // 获取词语频率（近似值）
     suspend fun getWordFrequency(word: String): Int = withContext(Dispatchers.IO) {
-        val database = database ?: return@withContext 0
-
-        try {
-            val cursor = database.query(
-                "unigram",
-                arrayOf("freq"),
-                "ngram = ?",
-                arrayOf(word),
-                null,
-                null,
-                null
-            )
-
-            var frequency = 0
-            cursor.use { c ->
-                if (c.moveToFirst()) {
-                    frequency = c.getInt(c.getColumnIndexOrThrow("freq"))
-                }
-            }
-
-            frequency
-        } catch (e: Exception) {
-            Log.e("EnglishDictionary", "查询词语频率失败: ${e.message}")
-            0
-        }
+        dictionary.getFrequency(word).coerceAtMost(Int.MAX_VALUE.toLong()).toInt()
     }
 
     // 清理资源
     fun close() {
-        database?.close()
-        database = null
+        dictionary.close()
         isLoaded = false
-        bigramCache.clear()
+        lastProcessedWord = null
+        secondLastProcessedWord = null
     }
 }
-
-// Trie树实现用于高效前缀搜索
-class EnglishTrie {
-    private data class TrieNode(
-        val children: MutableMap<Char, TrieNode> = mutableMapOf(),
-        var isEndOfWord: Boolean = false
-    )
-
-    private val root = TrieNode()
-
-    fun insert(word: String) {
-        var current = root
-        for (char in word) {
-            current = current.children.getOrPut(char) { TrieNode() }
-        }
-        current.isEndOfWord = true
-    }
-
-    fun getWordsWithPrefix(prefix: String): List<String> {
-        var current = root
-
-        // 找到前缀的最后一个节点
-        for (char in prefix) {
-            current = current.children[char] ?: return emptyList()
-        }
-
-        val results = mutableListOf<String>()
-        collectWords(current, prefix, results)
-
-        return results
-    }
-
-    private fun collectWords(node: TrieNode, prefix: String, results: MutableList<String>) {
-        if (node.isEndOfWord) {
-            results.add(prefix)
-        }
-
-        for ((char, childNode) in node.children) {
-            collectWords(childNode, prefix + char, results)
-        }
-    }
-
-    fun contains(word: String): Boolean {
-        var current = root
-        for (char in word) {
-            current = current.children[char] ?: return false
-        }
-        return current.isEndOfWord
-    }
-}
\ No newline at end of file
@@ -457,6 +457,56 @@ class KazakhDictionaryManager private constructor(private val context: Context)
         nativeMarisaProcessWordSubmission(word)
     }
 
+    // ==================== 增量词典 ====================
+
+    // 在unigram词典上叠加一层增量，不需要重建词典；removedWords中的词不再可见
+    fun addUnigramDelta(words: List<String>, weights: List<Float>, removedWords: List<String> = emptyList()): Boolean {
+        if (!isLoaded || (words.isEmpty() && removedWords.isEmpty())) {
+            return false
+        }
+
+        val success = nativeAddUnigramDelta(words.toTypedArray(), weights.toFloatArray(), removedWords.toTypedArray())
+        if (success) {
+            clearCaches()
+        }
+        return success
+    }
+
+    // 用户词典的增删改：删除的词如果系统词典里也有，仍然保留
+    fun addUserWordDelta(words: List<String>, weights: List<Float>, removedWords: List<String>): Boolean {
+        if (!isLoaded || (words.isEmpty() && removedWords.isEmpty())) {
+            return false
+        }
+
+        val success = nativeAddUserWordDelta(words.toTypedArray(), weights.toFloatArray(), removedWords.toTypedArray())
+        if (success) {
+            clearCaches()
+        }
+        return success
+    }
+
+    fun loadUnigramDelta(filename: String): Boolean {
+        if (!isLoaded) {
+            return false
+        }
+
+        val success = nativeLoadUnigramDelta(filename)
+        if (success) {
+            clearCaches()
+        }
+        return success
+    }
+
+    fun compactUnigramDeltas() {
+        if (isLoaded) {
+            nativeCompactUnigramDeltas()
+        }
+    }
+
+    fun getUnigramDeltaCount(): Int {
+        return if (isLoaded) nativeGetUnigramDeltaCount() else 0
+    }
+
     // ==================== 上下文状态管理 ====================
 
     fun setShowingContextPredictions(enabled: Boolean) {
@@ -535,4 +585,11 @@ class KazakhDictionaryManager private constructor(private val context: Context)
     private external fun nativeMarisaProcessWordSubmission(word: String)
     private external fun nativeIsMarisaDictInitialized(): Boolean
     private external fun nativeCloseMarisaDict()
+
+    // 增量词典
+    private external fun nativeLoadUnigramDelta(filename: String): Boolean
+    private external fun nativeAddUnigramDelta(words: Array<String>, weights: FloatArray, removedWords: Array<String>): Boolean
+    private external fun nativeAddUserWordDelta(words: Array<String>, weights: FloatArray, removedWords: Array<String>): Boolean
+    private external fun nativeCompactUnigramDeltas()
+    private external fun nativeGetUnigramDeltaCount(): Int
 }
\ No newline at end of file
@@ -19,6 +19,11 @@ class KazakhUserDictManager private constructor(
     private val maxUserDictSize = 10000 // 最大用户词典大小
     private val autoSaveThreshold = 50 // 自动保存阈值
     private val initializationMutex = Mutex() // 使用 Mutex 替代 synchronized
+    private val deltaBatchSize = 16 // 攒够这么多个改动的词再写入一层增量
+
+    // 改动过、还没写入系统词典增量层的词
+    private val pendingDeltaWords = LinkedHashSet<String>()
+    private val dictionaryManager by lazy { KazakhDictionaryManager.getInstance(context) }
 
     companion object {
         @Volatile
@@ -72,6 +77,7 @@ class KazakhUserDictManager private constructor(
 
                     if (initNative) {
                         isLoaded = true
+                        syncUnigramDelta()
                         Log.d("KazakhUserDict", "✅ User dictionary initialized (new empty dict)")
                         return@withLock true
                     } else {
@@ -90,6 +96,7 @@ class KazakhUserDictManager private constructor(
 
                     if (loadSuccess) {
                         isLoaded = true
+                        syncUnigramDelta()
                         Log.d("KazakhUserDict", "✅ User dictionary loaded successfully")
                         return@withLock true
                     } else {
@@ -109,6 +116,7 @@ class KazakhUserDictManager private constructor(
                 if (nativeIsUserDictInitialized()) {
                     Log.d("KazakhUserDict", "Native initialized despite exception")
                     isLoaded = true
+                    syncUnigramDelta()
                     return@withLock true
                 }
 
@@ -145,6 +153,7 @@ class KazakhUserDictManager private constructor(
 
             if (initNative) {
                 isLoaded = true
+                syncUnigramDelta()
                 Log.d("KazakhUserDict", "✅ User dictionary force initialized")
                 true
             } else {
@@ -200,6 +209,7 @@ class KazakhUserDictManager private constructor(
 
             if (success) {
                 Log.d("KazakhUserDict", "✅ Word added: '$word' (freq: $frequency)")
+                recordDeltaWords(listOf(word))
                 // 检查是否需要自动保存
                 checkAutoSave()
             } else {
@@ -226,6 +236,7 @@ class KazakhUserDictManager private constructor(
 
                 if (success) {
                     Log.d("KazakhUserDict", "单词添加上下文成功: '$word' -> '$contextWord' (freq: $frequency)")
+                    recordDeltaWords(listOf(word))
                     checkAutoSave()
                 } else {
                     Log.w("KazakhUserDict", "单词添加上下文失败: '$word' -> '$contextWord'")
@@ -248,6 +259,7 @@ class KazakhUserDictManager private constructor(
             val success = nativeRemoveWord(word)
             if (success) {
                 Log.d("KazakhUserDict", "Word removed: '$word'")
+                recordDeltaWords(listOf(word))
                 checkAutoSave()
             } else {
                 Log.d("KazakhUserDict", "Word not found for removal: '$word'")
@@ -269,6 +281,7 @@ class KazakhUserDictManager private constructor(
             val success = nativeUpdateWordFrequency(word, delta)
             if (success) {
                 Log.d("KazakhUserDict", "Word frequency updated: '$word' delta=$delta")
+                recordDeltaWords(listOf(word))
                 checkAutoSave()
             }
             success
@@ -373,6 +386,7 @@ class KazakhUserDictManager private constructor(
             val success = nativeImportWords(words.toTypedArray())
             if (success) {
                 Log.d("KazakhUserDict", "Imported ${words.size} words to user dict")
+                recordDeltaWords(words)
                 // 异步保存
                 userDictScope.launch {
                     saveUserDict()
@@ -398,6 +412,8 @@ class KazakhUserDictManager private constructor(
             return false
         }
 
+        flushUnigramDelta()
+
         return try {
             val success = nativeSaveUserDict(userDictFile?.absolutePath ?: "")
             if (success) {
@@ -443,8 +459,12 @@ class KazakhUserDictManager private constructor(
         }
 
         return try {
+            // 清空前记下所有的词，清空后它们都按删除写入增量层
+            val words = nativeGetAllWords()
             val success = nativeClearUserDict()
             if (success) {
+                words?.let { recordDeltaWords(it.asList()) }
+                flushUnigramDelta()
                 isLoaded = false
                 Log.d("KazakhUserDict", "User dictionary cleared")
                 // 异步重新加载空词典
@@ -497,6 +517,62 @@ class KazakhUserDictManager private constructor(
         }
     }
 
+    // ==================== 系统词典增量 ====================
+
+    // 用户词典的增删改以增量层写入系统词典，系统词典的前缀搜索和精确匹配也能查到用户词
+    private fun recordDeltaWords(words: Collection<String>) {
+        val batchFull = synchronized(pendingDeltaWords) {
+            pendingDeltaWords.addAll(words)
+            pendingDeltaWords.size >= deltaBatchSize
+        }
+        if (batchFull) {
+            flushUnigramDelta()
+        }
+    }
+
+    fun flushUnigramDelta(): Boolean {
+        val words = synchronized(pendingDeltaWords) {
+            pendingDeltaWords.toTypedArray().also { pendingDeltaWords.clear() }
+        }
+        if (words.isEmpty()) {
+            return true
+        }
+
+        return try {
+            // 词频为0的词已经被删除
+            val frequencies = nativeGetWordFrequencies(words) ?: return false
+            val addedWords = ArrayList<String>()
+            val weights = ArrayList<Float>()
+            val removedWords = ArrayList<String>()
+            words.forEachIndexed { i, word ->
+                if (frequencies[i] > 0) {
+                    addedWords.add(word)
+                    weights.add(frequencies[i].toFloat())
+                } else {
+                    removedWords.add(word)
+                }
+            }
+
+            val success = dictionaryManager.addUserWordDelta(addedWords, weights, removedWords)
+            Log.d("KazakhUserDict", "Unigram delta: ${addedWords.size} words, ${removedWords.size} removed -> $success")
+            success
+        } catch (e: Exception) {
+            Log.e("KazakhUserDict", "Error flushing unigram delta: ${e.message}")
+            false
+        }
+    }
+
+    // 系统词典先于用户词典加载，加载后把所有用户词写入一层增量
+    private fun syncUnigramDelta() {
+        try {
+            val words = nativeGetAllWords() ?: return
+            recordDeltaWords(words.asList())
+            flushUnigramDelta()
+        } catch (e: Exception) {
+            Log.e("KazakhUserDict", "Error syncing unigram delta: ${e.message}")
+        }
+    }
+
     fun debugCheckState(): String {
         return buildString {
             append("=== User Dictionary Debug ===\n")
@@ -559,6 +635,12 @@ class KazakhUserDictManager private constructor(
     // 检查单词是否存在
     private external fun nativeContainsWord(word: String): Boolean
 
+    // 获取所有单词
+    private external fun nativeGetAllWords(): Array<String>?
+
+    // 批量查询词频，不存在的词为0
+    private external fun nativeGetWordFrequencies(words: Array<String>): IntArray?
+
     // 批量导入单词
     private external fun nativeImportWords(words: Array<String>): Boolean
 
@@ -0,0 +1,115 @@
+package com.example.nasboard.ime.dictionary
+
+import android.content.Context
+import android.util.Log
+import java.io.File
+import java.io.FileOutputStream
+
+// 英语、俄语的n-gram词典（native）
+// 词典由marisa-ngram-build从SQLite的unigram/bigram/trigram表编译而成，
+// unigram、bigram、trigram和频率都在一个mmap的marisa Trie中，不占Java堆。
+// 所有查询按频率降序返回
+class NgramDictionary(private val logTag: String) {
+
+    private var handle = 0L
+
+    val isLoaded: Boolean
+        @Synchronized get() = handle != 0L
+
+    companion object {
+        // 加载JNI库
+        init {
+            try {
+                System.loadLibrary("nasboard-pinyin")
+            } catch (e: UnsatisfiedLinkError) {
+                Log.e("NgramDictionary", "Failed to load native library: ${e.message}")
+            }
+        }
+
+        @JvmStatic private external fun nativeOpen(filename: String): Long
+        @JvmStatic private external fun nativeClose(handle: Long)
+        @JvmStatic private external fun nativePrefixSearch(handle: Long, prefix: String, maxResults: Int): Array<String>
+        @JvmStatic private external fun nativeContextPredict(handle: Long, previousWord: String, currentPrefix: String, maxResults: Int): Array<String>
+        @JvmStatic private external fun nativeTrigramPredict(handle: Long, firstWord: String, secondWord: String, currentPrefix: String, maxResults: Int): Array<String>
+        @JvmStatic private external fun nativeMostFrequentWords(handle: Long, maxResults: Int): Array<String>
+        @JvmStatic private external fun nativeExactMatch(handle: Long, word: String): Boolean
+        @JvmStatic private external fun nativeGetFrequency(handle: Long, word: String): Long
+        @JvmStatic private external fun nativeGetInfo(handle: Long): String
+    }
+
+    // 把assets中的词典复制到缓存目录后用mmap打开，文件在词典关闭前不能删除
+    @Synchronized
+    fun load(context: Context, assetPath: String): Boolean {
+        if (handle != 0L) return true
+
+        return try {
+            val dictFile = File(context.cacheDir, assetPath.substringAfterLast('/'))
+            context.assets.open(assetPath).use { input ->
+                FileOutputStream(dictFile).use { output ->
+                    input.copyTo(output)
+                }
+            }
+
+            handle = nativeOpen(dictFile.absolutePath)
+            if (handle == 0L) {
+                Log.e(logTag, "无法打开n-gram词典: ${dictFile.absolutePath}")
+                false
+            } else {
+                Log.d(logTag, nativeGetInfo(handle))
+                true
+            }
+        } catch (e: Exception) {
+            Log.e(logTag, "加载n-gram词典失败: ${e.message}")
+            false
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(logTag, "加载n-gram词典失败: ${e.message}")
+            false
+        }
+    }
+
+    @Synchronized
+    fun prefixSearch(prefix: String, maxResults: Int): List<String> {
+        if (handle == 0L || maxResults <= 0) return emptyList()
+        return nativePrefixSearch(handle, prefix, maxResults).toList()
+    }
+
+    @Synchronized
+    fun contextPredict(previousWord: String, currentPrefix: String, maxResults: Int): List<String> {
+        if (handle == 0L || maxResults <= 0) return emptyList()
+        return nativeContextPredict(handle, previousWord, currentPrefix, maxResults).toList()
+    }
+
+    @Synchronized
+    fun trigramPredict(firstWord: String, secondWord: String, currentPrefix: String, maxResults: Int): List<String> {
+        if (handle == 0L || maxResults <= 0) return emptyList()
+        return nativeTrigramPredict(handle, firstWord, secondWord, currentPrefix, maxResults).toList()
+    }
+
+    // 高频词，不含单字符的词
+    @Synchronized
+    fun mostFrequentWords(maxResults: Int): List<String> {
+        if (handle == 0L || maxResults <= 0) return emptyList()
+        return nativeMostFrequentWords(handle, maxResults).toList()
+    }
+
+    @Synchronized
+    fun contains(word: String): Boolean {
+        if (handle == 0L) return false
+        return nativeExactMatch(handle, word)
+    }
+
+    // 频率是编译时量化后的近似值
+    @Synchronized
+    fun getFrequency(word: String): Long {
+        if (handle == 0L) return 0
+        return nativeGetFrequency(handle, word)
+    }
+
+    @Synchronized
+    fun close() {
+        if (handle != 0L) {
+            nativeClose(handle)
+            handle = 0L
+        }
+    }
+}
@@ -4,6 +4,8 @@ package com.example.nasboard.ime.dictionary
 import android.content.Context
 import android.content.res.AssetManager
 import android.content.res.Resources
+import android.os.Handler
+import android.os.Looper
 import android.util.Log
 import java.io.File
 import java.io.FileOutputStream
@@ -28,8 +30,30 @@ class PinyinDecoder private constructor(context: Context) {
 
         // 在伴生对象中定义TAG常量
         private const val TAG = "PinyinDecoder"
+
+        // 后台解码每页的候选词数量，和getSmartCandidates()一致
+        private const val DECODE_PAGE_SIZE = 10
+
+        // 模糊音，可以组合使用，和spellingtrie.h中的kFuzzyXxx一致
+        const val FUZZY_Z_ZH = 0x01
+        const val FUZZY_C_CH = 0x02
+        const val FUZZY_S_SH = 0x04
+        const val FUZZY_N_L = 0x08
+        const val FUZZY_AN_ANG = 0x10
+        const val FUZZY_EN_ENG = 0x20
+        const val FUZZY_IN_ING = 0x40
     }
 
+    /**
+     * 后台解码的结果，在主线程上回调
+     */
+    fun interface DecodeListener {
+        fun onCandidates(pinyin: String, candidates: List<String>, totalNum: Int)
+    }
+
+    // 后台解码发布的一页候选词
+    private class DecodePage(val pinyin: String, val candidates: List<String>, val totalNum: Int)
+
     // ==================== Native方法声明 ====================
     // 注意：这些函数名必须与C++代码中的JNI函数名完全匹配
 
@@ -102,6 +126,14 @@ class PinyinDecoder private constructor(context: Context) {
      */
     private external fun nativeImGetChoice(choiceId: Int): String
 
+    /**
+     * 一次获取一页候选词
+     * @param start 第一个候选词ID
+     * @param count 最多获取的数量
+     * @return 依次排列的候选词，每个以'\u0000'结尾
+     */
+    private external fun nativeImGetChoices(start: Int, count: Int): CharArray
+
     /**
      * 选择候选词
      * @param choiceId 候选词ID
@@ -139,6 +171,18 @@ class PinyinDecoder private constructor(context: Context) {
      */
     private external fun nativeImSetMaxLens(maxSpsLen: Int, maxHzsLen: Int)
 
+    /**
+     * 设置模糊音
+     * @param flags FUZZY_XXX的组合，0表示关闭
+     */
+    private external fun nativeImSetFuzzy(flags: Int)
+
+    /**
+     * 设置九键输入
+     * @param enable 是否把输入当作数字2-9
+     */
+    private external fun nativeImSetT9(enable: Boolean)
+
     /**
      * 获取预测数量
      * @param fixedStr 固定字符串
@@ -160,6 +204,32 @@ class PinyinDecoder private constructor(context: Context) {
      */
     private external fun nativeImAddLetter(ch: Byte): Int
 
+    // ==================== 后台解码 ====================
+
+    /**
+     * 启动后台解码线程，它在自己的会话中解码，结果通过onDecodePage()回调
+     * @param pageSize 每页的候选词数量
+     * @return 是否启动成功
+     */
+    private external fun nativeImStartWorker(pageSize: Int): Boolean
+
+    /**
+     * 停止后台解码线程
+     */
+    private external fun nativeImStopWorker()
+
+    /**
+     * 投递拼音给后台解码，取代还没有解码的输入
+     * @return 这次输入的版本号，没有解码线程时为0
+     */
+    private external fun nativeImPostSearch(pyBuf: ByteArray, pyLen: Int): Int
+
+    /**
+     * 让后台解码重置搜索
+     * @return 版本号
+     */
+    private external fun nativeImPostReset(): Int
+
     // ==================== 测试方法 ====================
 
     /**
@@ -180,6 +250,17 @@ class PinyinDecoder private constructor(context: Context) {
     private var initialized = false
     private var initializationError: String? = null
 
+    // 后台解码的状态：最新投递的版本号，以及最新发布的一页
+    private val mainHandler = Handler(Looper.getMainLooper())
+    @Volatile private var workerStarted = false
+    @Volatile private var latestVersion = 0
+    @Volatile private var latestPage: DecodePage? = null
+    @Volatile private var decodeListener: DecodeListener? = null
+
+    // 启用的模糊音和九键输入，重新初始化后仍然有效
+    private var fuzzyFlags = 0
+    private var t9Enabled = false
+
     // ==================== 初始化 ====================
 
     init {
@@ -269,6 +350,8 @@ class PinyinDecoder private constructor(context: Context) {
                 if (result) {
                     // 步骤5：设置最大拼音和汉字长度
                     nativeImSetMaxLens(80, 80)
+                    nativeImSetFuzzy(fuzzyFlags)
+                    nativeImSetT9(t9Enabled)
                     initialized = true
 
                     Log.d(TAG, "拼音解码器初始化成功")
@@ -278,6 +361,9 @@ class PinyinDecoder private constructor(context: Context) {
                     if (testResult) {
                         Log.d(TAG, "拼音解码器测试通过，版本: ${getVersion()}")
 
+                        // 步骤7：启动后台解码，失败时仍可同步搜索
+                        startWorker()
+
                         // 打印调试信息
                         val debugInfo = debugDecoder()
                         Log.d(TAG, debugInfo)
@@ -460,13 +546,25 @@ class PinyinDecoder private constructor(context: Context) {
 
         Log.d(TAG, "获取最多 $count 个候选词")
 
-        for (i in 0 until count) {
-            val candidate = getCandidate(i)
-            if (candidate.isEmpty()) {
-                Log.d(TAG, "候选词 $i 为空，停止获取")
+        // 整页一次取回，避免每个候选词一次JNI调用
+        val packed = try {
+            nativeImGetChoices(0, count)
+        } catch (e: Exception) {
+            Log.e(TAG, "获取候选词时出错: ${e.message}")
+            CharArray(0)
+        }
+
+        var begin = 0
+        for (end in packed.indices) {
+            if (packed[end] != '\u0000') {
+                continue
+            }
+            if (end == begin) {
+                Log.d(TAG, "候选词 ${candidates.size} 为空，停止获取")
                 break
             }
-            candidates.add(candidate)
+            candidates.add(String(packed, begin, end - begin))
+            begin = end + 1
         }
 
         Log.d(TAG, "获取到 ${candidates.size} 个候选词")
@@ -484,6 +582,13 @@ class PinyinDecoder private constructor(context: Context) {
             return listOf("拼音解码器未初始化")
         }
 
+        // 后台解码已经发布了这个拼音的结果时直接使用
+        val page = latestPage
+        if (page != null && page.pinyin == pinyin) {
+            Log.d(TAG, "使用后台解码结果: '$pinyin'")
+            return page.candidates
+        }
+
         Log.d(TAG, "智能搜索拼音: '$pinyin'")
         val result = search(pinyin)
         Log.d(TAG, "拼音搜索 '$pinyin': 找到 $result 个候选词")
@@ -496,6 +601,95 @@ class PinyinDecoder private constructor(context: Context) {
         }
     }
 
+    // ==================== 后台解码 ====================
+
+    /**
+     * 设置后台解码结果的监听器，只会收到最新一次投递的结果
+     */
+    fun setDecodeListener(listener: DecodeListener?) {
+        decodeListener = listener
+    }
+
+    /**
+     * 在后台解码拼音，不阻塞调用线程。
+     * 连续投递时只解码最新的拼音，旧的结果不会回调
+     * @return 是否已投递，返回false时应使用getSmartCandidates()
+     */
+    fun postSearch(pinyin: String): Boolean {
+        if (!initialized || !workerStarted || pinyin.isEmpty()) {
+            return false
+        }
+
+        val pyBytes = pinyin.toByteArray(StandardCharsets.UTF_8)
+        val version = try {
+            nativeImPostSearch(pyBytes, pyBytes.size)
+        } catch (e: Exception) {
+            Log.e(TAG, "投递拼音时出错: ${e.message}")
+            0
+        }
+        if (version == 0) {
+            return false
+        }
+        latestVersion = version
+        return true
+    }
+
+    /**
+     * 让后台解码重置搜索，例如提交或清空输入之后
+     */
+    fun postReset() {
+        if (!initialized || !workerStarted) {
+            return
+        }
+
+        try {
+            latestVersion = nativeImPostReset()
+            latestPage = null
+        } catch (e: Exception) {
+            Log.e(TAG, "重置后台解码时出错: ${e.message}")
+        }
+    }
+
+    private fun startWorker() {
+        workerStarted = try {
+            nativeImStartWorker(DECODE_PAGE_SIZE)
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "启动后台解码失败: ${e.message}")
+            false
+        }
+        Log.d(TAG, "后台解码: ${if (workerStarted) "已启动" else "未启动"}")
+    }
+
+    private fun stopWorker() {
+        if (!workerStarted) {
+            return
+        }
+        workerStarted = false
+        try {
+            nativeImStopWorker()
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "停止后台解码失败: ${e.message}")
+        }
+        latestPage = null
+    }
+
+    /**
+     * 由native的解码线程调用，只转发仍是最新版本的一页。
+     * 版本号在主线程上比较：postSearch()要等nativeImPostSearch()返回才记下版本号，
+     * 解码线程可能在那之前就解码完了，这时在解码线程上比较会丢掉最新的一页
+     */
+    @Suppress("unused")
+    private fun onDecodePage(version: Int, pinyin: String, candidates: Array<String>, totalNum: Int) {
+        val page = DecodePage(pinyin, candidates.toList(), totalNum)
+        mainHandler.post {
+            // 在排队期间又有新的投递时丢弃
+            if (version == latestVersion) {
+                latestPage = page
+                decodeListener?.onCandidates(page.pinyin, page.candidates, page.totalNum)
+            }
+        }
+    }
+
     /**
      * 获取预测词
      * @param fixedStr 固定字符串
@@ -573,6 +767,7 @@ class PinyinDecoder private constructor(context: Context) {
         if (initialized) {
             try {
                 nativeImResetSearch()
+                postReset()
                 Log.d(TAG, "重置搜索状态")
             } catch (e: Exception) {
                 Log.e(TAG, "重置搜索状态时出错: ${e.message}")
@@ -580,6 +775,56 @@ class PinyinDecoder private constructor(context: Context) {
         }
     }
 
+    /**
+     * 设置模糊音，例如FUZZY_Z_ZH or FUZZY_AN_ANG，0表示关闭
+     * 后台解码在自己的会话中，需要重新启动才能使用新的模糊音
+     */
+    fun setFuzzy(flags: Int) {
+        if (flags == fuzzyFlags) {
+            return
+        }
+        fuzzyFlags = flags
+        if (!initialized) {
+            return
+        }
+
+        try {
+            nativeImSetFuzzy(flags)
+            if (workerStarted) {
+                stopWorker()
+                startWorker()
+            }
+            Log.d(TAG, "设置模糊音: 0x${Integer.toHexString(flags)}")
+        } catch (e: Exception) {
+            Log.e(TAG, "设置模糊音时出错: ${e.message}")
+        }
+    }
+
+    /**
+     * 设置九键输入，打开后search()的输入是数字2-9，例如"64426"解码为"nihao"
+     * 后台解码在自己的会话中，需要重新启动才能使用新的输入方式
+     */
+    fun setT9Enabled(enabled: Boolean) {
+        if (enabled == t9Enabled) {
+            return
+        }
+        t9Enabled = enabled
+        if (!initialized) {
+            return
+        }
+
+        try {
+            nativeImSetT9(enabled)
+            if (workerStarted) {
+                stopWorker()
+                startWorker()
+            }
+            Log.d(TAG, "九键输入: ${if (enabled) "打开" else "关闭"}")
+        } catch (e: Exception) {
+            Log.e(TAG, "设置九键输入时出错: ${e.message}")
+        }
+    }
+
     /**
      * 重置输入状态（用于兼容旧的接口）
      * 这个函数已经存在，但在NasInputMethodService中可能被调用了
@@ -613,6 +858,7 @@ class PinyinDecoder private constructor(context: Context) {
     fun close() {
         if (initialized) {
             try {
+                stopWorker()
                 nativeImCloseDecoder()
                 initialized = false
                 Log.d(TAG, "关闭拼音解码器")
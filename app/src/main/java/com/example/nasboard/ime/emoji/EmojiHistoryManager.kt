@@ -90,7 +90,8 @@ class EmojiHistoryManager private constructor(private val context: Context) {
         sharedPreferences.edit().remove("favorite_emoji_values").apply()
     }
 
-    private fun getRecentEmojiValues(): List<String> {
+    // 最近使用的表情，最近的在前
+    fun getRecentEmojiValues(): List<String> {
         val recentString = sharedPreferences.getString("recent_emoji_values", "") ?: ""
         return if (recentString.isEmpty()) {
             emptyList()
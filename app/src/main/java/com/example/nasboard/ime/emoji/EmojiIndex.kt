@@ -0,0 +1,81 @@
+package com.example.nasboard.ime.emoji
+
+import android.content.Context
+import android.util.Log
+import java.io.File
+import java.io.FileOutputStream
+
+// 表情搜索的关键词索引（native）
+// 索引由marisa-emoji-index从emoji_en.txt等关键词文件编译而成，
+// 名称和CLDR关键词都在一个mmap的marisa Trie中，每次搜索是一次前缀查找。
+// 结果按表情的名次排序，不区分大小写
+class EmojiIndex {
+
+    private var handle = 0L
+
+    val isLoaded: Boolean
+        @Synchronized get() = handle != 0L
+
+    companion object {
+        private const val TAG = "EmojiIndex"
+
+        // 加载JNI库
+        init {
+            try {
+                System.loadLibrary("nasboard-pinyin")
+            } catch (e: UnsatisfiedLinkError) {
+                Log.e(TAG, "Failed to load native library: ${e.message}")
+            }
+        }
+
+        @JvmStatic private external fun nativeOpen(filename: String): Long
+        @JvmStatic private external fun nativeClose(handle: Long)
+        @JvmStatic private external fun nativeSearch(handle: Long, query: String, maxResults: Int): Array<String>
+        @JvmStatic private external fun nativeGetInfo(handle: Long): String
+    }
+
+    // 把assets中的索引复制到缓存目录后用mmap打开，文件在索引关闭前不能删除
+    @Synchronized
+    fun load(context: Context, assetPath: String): Boolean {
+        if (handle != 0L) return true
+
+        return try {
+            val indexFile = File(context.cacheDir, assetPath.substringAfterLast('/'))
+            context.assets.open(assetPath).use { input ->
+                FileOutputStream(indexFile).use { output ->
+                    input.copyTo(output)
+                }
+            }
+
+            handle = nativeOpen(indexFile.absolutePath)
+            if (handle == 0L) {
+                Log.e(TAG, "无法打开表情索引: ${indexFile.absolutePath}")
+                false
+            } else {
+                Log.d(TAG, nativeGetInfo(handle))
+                true
+            }
+        } catch (e: Exception) {
+            Log.e(TAG, "加载表情索引失败: ${e.message}")
+            false
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "加载表情索引失败: ${e.message}")
+            false
+        }
+    }
+
+    // 关键词中有以query开头的词的表情
+    @Synchronized
+    fun search(query: String, maxResults: Int): List<String> {
+        if (handle == 0L || maxResults <= 0) return emptyList()
+        return nativeSearch(handle, query, maxResults).toList()
+    }
+
+    @Synchronized
+    fun close() {
+        if (handle != 0L) {
+            nativeClose(handle)
+            handle = 0L
+        }
+    }
+}
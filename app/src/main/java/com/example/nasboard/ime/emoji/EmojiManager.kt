@@ -9,14 +9,25 @@ class EmojiManager(private val context: Context) {
 
     private var emojis: Map<EmojiCategory, List<Emoji>> = emptyMap()
     private var allEmojis: List<Emoji> = emptyList()
+    private var emojisByValue: Map<String, Emoji> = emptyMap()
     private var isLoaded = false
 
+    companion object {
+        // 关键词索引只读，所有EmojiManager共用一个
+        private val keywordIndex = EmojiIndex()
+    }
+
     fun loadEmojis(): Boolean {
         if (!isLoaded) {
             emojis = loadEmojisFromAssets()
             allEmojis = emojis.values.flatten()
+            emojisByValue = allEmojis.associateBy { it.value }
             isLoaded = true
 
+            if (!keywordIndex.load(context, "emoji_index.dic")) {
+                Log.w("EmojiManager", "Emoji index unavailable, falling back to linear search")
+            }
+
             // 打印加载的统计信息
             val totalEmojis = emojis.values.sumOf { it.size }
             Log.d("EmojiManager", "Total categories loaded: ${emojis.size}")
@@ -118,14 +129,25 @@ class EmojiManager(private val context: Context) {
         return allEmojis.take(limit)
     }
 
-    fun searchEmojis(query: String): List<Emoji> {
-        if (query.isEmpty()) return emptyList()
-
-        val searchTerm = query.lowercase()
-        return allEmojis.filter { emoji ->
-            emoji.name.lowercase().contains(searchTerm) ||
-                    emoji.keywords.any { it.lowercase().contains(searchTerm) } ||
-                    emoji.value.contains(searchTerm)
+    // 搜索名称或关键词中有以query开头的词的表情，按使用频率排序，
+    // recentValues（最近使用的表情，最近的在前）中的表情排在最前面
+    fun searchEmojis(query: String, recentValues: List<String> = emptyList()): List<Emoji> {
+        if (query.isBlank()) return emptyList()
+
+        val results = if (keywordIndex.isLoaded) {
+            keywordIndex.search(query, allEmojis.size).mapNotNull { emojisByValue[it] }
+        } else {
+            val searchTerm = query.lowercase()
+            allEmojis.filter { emoji ->
+                emoji.name.lowercase().contains(searchTerm) ||
+                        emoji.keywords.any { it.lowercase().contains(searchTerm) } ||
+                        emoji.value.contains(searchTerm)
+            }
         }
+        if (recentValues.isEmpty()) return results
+
+        // 稳定排序，最近使用的按使用时间在前，其余保持原来的顺序
+        val recency = recentValues.withIndex().associate { it.value to it.index }
+        return results.sortedBy { recency[it.value] ?: Int.MAX_VALUE }
     }
 }
\ No newline at end of file
@@ -309,7 +309,7 @@ class EmojiView @JvmOverloads constructor(
     }
 
     private fun performSearch(query: String) {
-        searchResults = emojiManager.searchEmojis(query)
+        searchResults = emojiManager.searchEmojis(query, emojiHistoryManager.getRecentEmojiValues())
         showSearchResults()
         Log.d("EmojiView", "Search results: ${searchResults.size} for query: $query")
     }